@@ -260,6 +260,27 @@ pub fn build(b: *std.Build) void {
     b.installArtifact(sql_client);
     tools_step.dependOn(b.getInstallStep());
 
+    // Build cost model calibration tool
+    const calibrate_cost_model = b.addExecutable(.{
+        .name = "calibrate_cost_model",
+        .root_module = b.addModule("calibrate_cost_model", .{
+            .root_source_file = b.path("src/tools/calibrate_cost_model.zig"),
+            .target = target,
+            .optimize = optimize,
+        }),
+    });
+    calibrate_cost_model.root_module.addImport("geeqodb", geeqodb_module);
+    calibrate_cost_model.linkSystemLibrary("rocksdb");
+    b.installArtifact(calibrate_cost_model);
+    tools_step.dependOn(b.getInstallStep());
+
+    const run_calibrate_cost_model = b.addRunArtifact(calibrate_cost_model);
+    if (b.args) |args| {
+        run_calibrate_cost_model.addArgs(args);
+    }
+    const calibrate_cost_model_step = b.step("calibrate_cost_model", "Measure this host and write calibrated cost model weights");
+    calibrate_cost_model_step.dependOn(&run_calibrate_cost_model.step);
+
     // Build example tools
     const query_example = b.addExecutable(.{
         .name = "query_example",
@@ -287,5 +308,116 @@ pub fn build(b: *std.Build) void {
     gpu_benchmark.linkSystemLibrary("rocksdb");
     b.installArtifact(gpu_benchmark);
     tools_step.dependOn(b.getInstallStep());
+
+    // Benchmarks share one harness for warmup, trials, latency percentiles,
+    // allocation counts and JSON reports. Pass harness options after --,
+    // e.g. zig build benchmark-query_benchmark -Doptimize=ReleaseFast -- --trials 10
+    const harness_module = b.addModule("harness", .{
+        .root_source_file = b.path("src/benchmarks/harness.zig"),
+        .target = target,
+        .optimize = optimize,
+    });
+    harness_module.addImport("geeqodb", geeqodb_module);
+
+    const harness_test = b.addTest(.{ .root_module = harness_module });
+    harness_test.linkSystemLibrary("rocksdb");
+    const run_harness_tests = b.addRunArtifact(harness_test);
+    test_step.dependOn(&run_harness_tests.step);
+
+    // Runs the benchmarks one after another and aggregates their JSON reports
+    const run_benchmarks = b.addExecutable(.{
+        .name = "run_benchmarks",
+        .root_module = b.addModule("run_benchmarks", .{
+            .root_source_file = b.path("scripts/run_benchmarks.zig"),
+            .target = target,
+            .optimize = optimize,
+        }),
+    });
+    run_benchmarks.root_module.addImport("harness", harness_module);
+    run_benchmarks.linkSystemLibrary("rocksdb");
+    const run_all_benchmarks = b.addRunArtifact(run_benchmarks);
+    run_all_benchmarks.has_side_effects = true;
+
+    const benchmarks = [_][]const u8{
+        "database_benchmark",
+        "storage_benchmark",
+        "transaction_benchmark",
+        "query_benchmark",
+        "index_benchmark",
+        "index_query_benchmark",
+        "star_schema_benchmark",
+    };
+    for (benchmarks) |name| {
+        const benchmark = b.addExecutable(.{
+            .name = name,
+            .root_module = b.addModule(name, .{
+                .root_source_file = b.path(b.fmt("src/benchmarks/{s}.zig", .{name})),
+                .target = target,
+                .optimize = optimize,
+            }),
+        });
+        benchmark.root_module.addImport("geeqodb", geeqodb_module);
+        benchmark.root_module.addImport("harness", harness_module);
+        benchmark.linkSystemLibrary("rocksdb");
+        run_all_benchmarks.addArtifactArg(benchmark);
+
+        const run_benchmark = b.addRunArtifact(benchmark);
+        run_benchmark.has_side_effects = true;
+        if (b.args) |args| {
+            run_benchmark.addArgs(args);
+        }
+        const step = b.step(b.fmt("benchmark-{s}", .{name}), b.fmt("Run {s}", .{name}));
+        step.dependOn(&run_benchmark.step);
+    }
+
+    if (b.args) |args| {
+        run_all_benchmarks.addArgs(args);
+    }
+    const benchmark_step = b.step("benchmark", "Run all benchmarks and write a summary to benchmark_results/");
+    benchmark_step.dependOn(&run_all_benchmarks.step);
+
+    // Compares two benchmark runs and fails on hot-path regressions
+    const bench_compare = b.addExecutable(.{
+        .name = "bench_compare",
+        .root_module = b.addModule("bench_compare", .{
+            .root_source_file = b.path("src/tools/bench_compare.zig"),
+            .target = target,
+            .optimize = optimize,
+        }),
+    });
+    bench_compare.root_module.addImport("harness", harness_module);
+    bench_compare.linkSystemLibrary("rocksdb");
+    b.installArtifact(bench_compare);
+    tools_step.dependOn(b.getInstallStep());
+
+    const run_bench_compare = b.addRunArtifact(bench_compare);
+    run_bench_compare.has_side_effects = true;
+    if (b.args) |args| {
+        run_bench_compare.addArgs(args);
+    }
+    const bench_compare_step = b.step("bench_compare", "Compare two benchmark runs and fail on hot-path regressions");
+    bench_compare_step.dependOn(&run_bench_compare.step);
+
+    // Drives a running server from many connections and reports latency per query class
+    const load_client = b.addExecutable(.{
+        .name = "load_client",
+        .root_module = b.addModule("load_client", .{
+            .root_source_file = b.path("src/tools/load_client.zig"),
+            .target = target,
+            .optimize = optimize,
+        }),
+    });
+    load_client.root_module.addImport("harness", harness_module);
+    load_client.linkSystemLibrary("rocksdb");
+    b.installArtifact(load_client);
+    tools_step.dependOn(b.getInstallStep());
+
+    const run_load_client = b.addRunArtifact(load_client);
+    run_load_client.has_side_effects = true;
+    if (b.args) |args| {
+        run_load_client.addArgs(args);
+    }
+    const load_client_step = b.step("load_client", "Load a running server from N connections and report latency per query class");
+    load_client_step.dependOn(&run_load_client.step);
     // Add the tool builds to this step
 }
@@ -1,72 +1,111 @@
 const std = @import("std");
-const geeqodb = @import("geeqodb");
+const harness = @import("harness");
 
+/// Run each benchmark executable named on the command line in turn, then
+/// aggregate their JSON reports into benchmark_results/benchmark_summary_<ts>.json
+/// and a markdown table next to it. Options such as --trials N are passed on
+/// to every benchmark. `zig build benchmark` runs this over all benchmarks.
 pub fn main() !void {
     // Initialize allocator
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
-    const allocator = gpa.allocator();
+    var arena = std.heap.ArenaAllocator.init(gpa.allocator());
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    var executables = std.ArrayList([]const u8).init(allocator);
+    var forwarded = std.ArrayList([]const u8).init(allocator);
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        if (std.mem.startsWith(u8, args[i], "--")) {
+            if (i + 1 == args.len) return error.InvalidArgument;
+            try forwarded.appendSlice(&.{ args[i], args[i + 1] });
+            i += 1;
+        } else {
+            try executables.append(args[i]);
+        }
+    }
 
     // Create the benchmark_results directory if it doesn't exist
     try std.fs.cwd().makePath("benchmark_results");
-
-    // Get the current timestamp
     const timestamp = std.time.timestamp();
-    const timestamp_str = try std.fmt.allocPrint(allocator, "{d}", .{timestamp});
-    defer allocator.free(timestamp_str);
 
-    // Create the summary filename with timestamp
-    const summary_filename = try std.fmt.allocPrint(allocator, "benchmark_results/benchmark_summary_{s}.md", .{timestamp_str});
-    defer allocator.free(summary_filename);
+    var reports = std.ArrayList(harness.Report).init(allocator);
+    var failed = std.ArrayList([]const u8).init(allocator);
+    for (executables.items) |executable| {
+        const suite = std.fs.path.stem(executable);
+        const json_path = try std.fmt.allocPrint(allocator, "benchmark_results/{s}_{d}.json", .{ suite, timestamp });
+        std.debug.print("\nRunning {s}...\n", .{suite});
 
-    // Open the summary file for writing
-    const summary_file = try std.fs.cwd().createFile(summary_filename, .{});
-    defer summary_file.close();
+        // The benchmark's own output goes straight to the terminal
+        var argv = std.ArrayList([]const u8).init(allocator);
+        try argv.appendSlice(&.{ executable, "--json", json_path });
+        try argv.appendSlice(forwarded.items);
+        var child = std.process.Child.init(argv.items, allocator);
+        const term = try child.spawnAndWait();
+        if (term != .Exited or term.Exited != 0) {
+            std.debug.print("{s} failed: {}\n", .{ suite, term });
+            try failed.append(suite);
+            continue;
+        }
 
-    // Write the summary header
-    try summary_file.writeAll("# GeeqoDB Benchmark Summary\n\n");
-    try summary_file.writeAll("This file contains a summary of all benchmark results.\n\n");
+        const json = try std.fs.cwd().readFileAlloc(allocator, json_path, 64 * 1024 * 1024);
+        const report = try std.json.parseFromSliceLeaky(harness.Report, allocator, json, .{ .ignore_unknown_fields = true });
+        try reports.append(report);
+    }
 
-    // Run the benchmarks
-    try summary_file.writeAll("## Running Benchmarks\n\n");
+    const summary = harness.Summary{ .timestamp = timestamp, .suites = reports.items, .failed = failed.items };
 
-    // List of benchmarks to run
-    const benchmarks = [_][]const u8{
-        "database_benchmark",
-        "storage_benchmark",
-        "transaction_benchmark",
-        "query_benchmark",
-        "index_benchmark",
-        "index_query_benchmark",
-    };
+    const summary_filename = try std.fmt.allocPrint(allocator, "benchmark_results/benchmark_summary_{d}.json", .{timestamp});
+    {
+        const file = try std.fs.cwd().createFile(summary_filename, .{});
+        defer file.close();
+        var buffered = std.io.bufferedWriter(file.writer());
+        try std.json.stringify(summary, .{ .whitespace = .indent_2 }, buffered.writer());
+        try buffered.flush();
+    }
 
-    // Run each benchmark
-    for (benchmarks) |benchmark| {
-        try summary_file.writer().print("### Running {s}...\n\n", .{benchmark});
-        std.debug.print("Running {s}...\n", .{benchmark});
+    const markdown_filename = try std.fmt.allocPrint(allocator, "benchmark_results/benchmark_summary_{d}.md", .{timestamp});
+    {
+        const file = try std.fs.cwd().createFile(markdown_filename, .{});
+        defer file.close();
+        var buffered = std.io.bufferedWriter(file.writer());
+        try writeMarkdown(buffered.writer(), summary);
+        try buffered.flush();
+    }
 
-        // Build the command
-        const command = try std.fmt.allocPrint(allocator, "zig build benchmark-{s}", .{benchmark});
-        defer allocator.free(command);
+    std.debug.print("\nBenchmark summary written to {s} and {s}\n", .{ summary_filename, markdown_filename });
+    if (failed.items.len > 0) {
+        std.debug.print("{d} benchmark suite(s) failed\n", .{failed.items.len});
+        std.process.exit(1);
+    }
+}
 
-        // Run the command
-        const result = try std.process.Child.run(.{
-            .allocator = allocator,
-            .argv = &[_][]const u8{ "sh", "-c", command },
-        });
-        defer {
-            allocator.free(result.stdout);
-            allocator.free(result.stderr);
+fn writeMarkdown(writer: anytype, summary: harness.Summary) !void {
+    try writer.writeAll("# GeeqoDB Benchmark Summary\n\n");
+    for (summary.suites) |report| {
+        try writer.print("## {s}\n\n", .{report.suite});
+        try writer.print("{s} build, {s}-{s}, {d} CPUs\n\n", .{ report.build_mode, report.arch, report.os, report.cpu_count });
+        try writer.writeAll("| Benchmark | Params | p50 | p95 | p99 | max | ops/s | allocs/op | bytes/op |\n");
+        try writer.writeAll("| --- | --- | --- | --- | --- | --- | --- | --- | --- |\n");
+        for (report.benchmarks) |result| {
+            try writer.print("| {s} | {s} | {} | {} | {} | {} | {d:.0} | {d:.1} | {d:.0} |\n", .{
+                result.name,
+                result.params,
+                std.fmt.fmtDuration(result.p50_ns),
+                std.fmt.fmtDuration(result.p95_ns),
+                std.fmt.fmtDuration(result.p99_ns),
+                std.fmt.fmtDuration(result.max_ns),
+                result.ops_per_sec,
+                result.allocs_per_op,
+                result.bytes_per_op,
+            });
         }
-
-        // Write the result to the summary file
-        try summary_file.writer().print("```\n{s}\n```\n\n", .{result.stdout});
+        try writer.writeAll("\n");
+    }
+    if (summary.failed.len > 0) {
+        try writer.writeAll("## Failed\n\n");
+        for (summary.failed) |suite| try writer.print("- {s}\n", .{suite});
     }
-
-    // Write the summary footer
-    try summary_file.writeAll("## Conclusion\n\n");
-    try summary_file.writeAll("The benchmarks demonstrate the performance characteristics of GeeqoDB, particularly the significant performance improvements gained by using indexes for various types of queries.\n\n");
-    try summary_file.writeAll("For detailed analysis, please refer to the individual benchmark result files in the `benchmark_results` directory.\n");
-
-    std.debug.print("Benchmark summary written to {s}\n", .{summary_filename});
 }
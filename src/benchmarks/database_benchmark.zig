@@ -1,79 +1,116 @@
 const std = @import("std");
 const geeqodb = @import("geeqodb");
+const harness = @import("harness");
 const OLAPDatabase = geeqodb.core.OLAPDatabase;
 
+const row_count = 100_000;
+const rows_per_insert = 500;
+
 pub fn main() !void {
     // Initialize allocator
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
-    const allocator = gpa.allocator();
 
-    // Create data directory
-    const data_dir = "benchmark_data";
+    const suite = try harness.Suite.init(gpa.allocator(), "database_benchmark");
+    defer suite.deinit();
+    const allocator = suite.allocator();
+
+    // Start from empty data directories so every run measures the same work
+    const data_dir = "benchmark_data/database";
+    const init_dir = "benchmark_data/database_init";
+    try std.fs.cwd().deleteTree(data_dir);
+    try std.fs.cwd().deleteTree(init_dir);
     try std.fs.cwd().makePath(data_dir);
+    try std.fs.cwd().makePath(init_dir);
+
+    // Benchmark database initialization
+    std.debug.print("Benchmarking database initialization...\n", .{});
+    try suite.run("init", "", .{ .iterations = 10 }, InitContext{ .allocator = allocator, .data_dir = init_dir }, InitContext.run);
 
     // Initialize database
-    std.debug.print("Initializing database...\n", .{});
+    std.debug.print("\nSeeding {d} rows...\n", .{row_count});
     const db = try geeqodb.core.init(allocator, data_dir);
     defer db.deinit();
-    std.debug.print("Database initialized successfully!\n", .{});
-
-    // Benchmark database initialization
-    std.debug.print("\nBenchmarking database initialization...\n", .{});
-    try benchmarkDatabaseInit(allocator, data_dir);
+    try seed(allocator, db);
 
     // Benchmark query execution
     std.debug.print("\nBenchmarking query execution...\n", .{});
-    try benchmarkQueryExecution(db);
+    try benchmarkQueryExecution(suite, db);
 
+    try suite.finish();
     std.debug.print("\nBenchmarks completed successfully!\n", .{});
 }
 
-/// Benchmark database initialization
-fn benchmarkDatabaseInit(allocator: std.mem.Allocator, data_dir: []const u8) !void {
-    const iterations = 100;
-    var timer = try std.time.Timer.start();
-    var total_time: u64 = 0;
-
-    for (0..iterations) |_| {
-        timer.reset();
-        const db = try geeqodb.core.init(allocator, data_dir);
-        const elapsed = timer.read();
-        total_time += elapsed;
+const InitContext = struct {
+    allocator: std.mem.Allocator,
+    data_dir: []const u8,
+
+    fn run(self: InitContext, _: usize) !void {
+        const db = try geeqodb.core.init(self.allocator, self.data_dir);
         db.deinit();
     }
+};
+
+/// Fill `events` with rows_per_insert rows per INSERT statement
+fn seed(allocator: std.mem.Allocator, db: *OLAPDatabase) !void {
+    var create = try db.execute("CREATE TABLE events (id INTEGER, level TEXT, duration INTEGER)");
+    create.deinit();
 
-    const avg_time_ns = total_time / iterations;
-    const avg_time_ms = @as(f64, @floatFromInt(avg_time_ns)) / 1_000_000.0;
-    std.debug.print("Database initialization: {d:.3} ms average over {} iterations\n", .{ avg_time_ms, iterations });
+    const levels = [_][]const u8{ "debug", "info", "warn", "error" };
+    var query = std.ArrayList(u8).init(allocator);
+    defer query.deinit();
+    var id: usize = 0;
+    while (id < row_count) {
+        query.clearRetainingCapacity();
+        try query.appendSlice("INSERT INTO events VALUES ");
+        for (0..rows_per_insert) |i| {
+            if (i > 0) try query.appendSlice(", ");
+            try query.writer().print("({d}, '{s}', {d})", .{ id, levels[id % levels.len], (id * 7919) % 10_000 });
+            id += 1;
+        }
+        var inserted = try db.execute(query.items);
+        inserted.deinit();
+    }
 }
 
-/// Benchmark query execution
-fn benchmarkQueryExecution(db: *OLAPDatabase) !void {
-    const queries = [_][]const u8{
-        "SELECT * FROM test",
-        "SELECT id, name FROM users WHERE age > 18",
-        "SELECT COUNT(*) FROM orders GROUP BY customer_id",
-        "SELECT products.name, categories.name FROM products JOIN categories ON products.category_id = categories.id",
-    };
+const QueryContext = struct {
+    db: *OLAPDatabase,
+    query: []const u8,
 
-    const iterations = 1000;
+    fn run(self: QueryContext, _: usize) !void {
+        var result_set = try self.db.execute(self.query);
+        result_set.deinit();
+    }
+};
 
-    for (queries, 0..) |query, i| {
-        var timer = try std.time.Timer.start();
-        var total_time: u64 = 0;
+const InsertContext = struct {
+    db: *OLAPDatabase,
 
-        for (0..iterations) |_| {
-            timer.reset();
-            var result_set = try db.execute(query);
-            const elapsed = timer.read();
-            total_time += elapsed;
-            result_set.deinit();
-        }
+    fn run(self: InsertContext, n: usize) !void {
+        var buffer: [96]u8 = undefined;
+        const query = std.fmt.bufPrint(&buffer, "INSERT INTO events VALUES ({d}, 'info', {d})", .{ row_count + n, n % 10_000 }) catch unreachable;
+        var result_set = try self.db.execute(query);
+        result_set.deinit();
+    }
+};
 
-        const avg_time_ns = total_time / iterations;
-        const avg_time_ms = @as(f64, @floatFromInt(avg_time_ns)) / 1_000_000.0;
-        std.debug.print("Query {}: {d:.3} ms average over {} iterations\n", .{ i + 1, avg_time_ms, iterations });
-        std.debug.print("  Query: {s}\n", .{query});
+/// Benchmark query execution
+fn benchmarkQueryExecution(suite: *harness.Suite, db: *OLAPDatabase) !void {
+    const queries = [_]struct { name: []const u8, query: []const u8, iterations: usize, hot_path: bool = false }{
+        .{ .name = "scan", .query = "SELECT * FROM events", .iterations = 20 },
+        .{ .name = "point_filter", .query = "SELECT * FROM events WHERE id = 4242", .iterations = 50, .hot_path = true },
+        .{ .name = "range_filter", .query = "SELECT * FROM events WHERE duration >= 9900", .iterations = 50 },
+        .{ .name = "text_filter", .query = "SELECT * FROM events WHERE level = 'error'", .iterations = 20 },
+        .{ .name = "top_n", .query = "SELECT * FROM events ORDER BY duration DESC LIMIT 10", .iterations = 20, .hot_path = true },
+        .{ .name = "sort", .query = "SELECT * FROM events ORDER BY duration, id", .iterations = 5 },
+    };
+
+    const params = std.fmt.comptimePrint("rows={d}", .{row_count});
+    for (queries) |q| {
+        std.debug.print("  {s}: {s}\n", .{ q.name, q.query });
+        try suite.run(q.name, params, .{ .iterations = q.iterations, .hot_path = q.hot_path }, QueryContext{ .db = db, .query = q.query }, QueryContext.run);
     }
+
+    // Autocommit inserts, each logged to the WAL on its own
+    try suite.run("insert", params, .{ .iterations = 200, .hot_path = true }, InsertContext{ .db = db }, InsertContext.run);
 }
@@ -0,0 +1,460 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const geeqodb = @import("geeqodb");
+const CountingAllocator = geeqodb.query.profile.CountingAllocator;
+
+/// Latency histogram with HDR-style log-linear buckets: exact below 128 ns,
+/// then 64 buckets per power of two. A percentile is reported as the upper
+/// bound of its bucket, within 1/64 (about 1.6%) of the recorded value.
+pub const Histogram = struct {
+    const linear_buckets = 128;
+    const sub_buckets = 64;
+    pub const bucket_count = linear_buckets + (64 - 7) * sub_buckets;
+
+    counts: [bucket_count]u64 = [_]u64{0} ** bucket_count,
+    total: u64 = 0,
+    sum: u128 = 0,
+    min: u64 = std.math.maxInt(u64),
+    max: u64 = 0,
+
+    pub fn record(self: *Histogram, value: u64) void {
+        self.counts[bucketIndex(value)] += 1;
+        self.total += 1;
+        self.sum += value;
+        self.min = @min(self.min, value);
+        self.max = @max(self.max, value);
+    }
+
+    pub fn reset(self: *Histogram) void {
+        self.* = .{};
+    }
+
+    /// Add the samples of `other`, e.g. to combine histograms kept per thread
+    pub fn merge(self: *Histogram, other: *const Histogram) void {
+        for (&self.counts, other.counts) |*count, other_count| count.* += other_count;
+        self.total += other.total;
+        self.sum += other.sum;
+        self.min = @min(self.min, other.min);
+        self.max = @max(self.max, other.max);
+    }
+
+    pub fn mean(self: *const Histogram) f64 {
+        if (self.total == 0) return 0;
+        return @as(f64, @floatFromInt(self.sum)) / @as(f64, @floatFromInt(self.total));
+    }
+
+    /// The value at or below which `p` percent of the samples fall
+    pub fn percentile(self: *const Histogram, p: f64) u64 {
+        if (self.total == 0) return 0;
+        const wanted = @ceil(p / 100.0 * @as(f64, @floatFromInt(self.total)));
+        const rank = @max(1, @as(u64, @intFromFloat(wanted)));
+        var seen: u64 = 0;
+        for (self.counts, 0..) |count, index| {
+            seen += count;
+            if (seen >= rank) return @min(bucketUpperBound(index), self.max);
+        }
+        return self.max;
+    }
+
+    fn bucketIndex(value: u64) usize {
+        if (value < linear_buckets) return @intCast(value);
+        // Keep the top seven bits: the leading one and six bits of precision
+        const shift: u6 = @intCast(63 - @clz(value) - 6);
+        const top: usize = @intCast(value >> shift);
+        return linear_buckets + (@as(usize, shift) - 1) * sub_buckets + (top - sub_buckets);
+    }
+
+    fn bucketUpperBound(index: usize) u64 {
+        if (index < linear_buckets) return index;
+        const shift: u6 = @intCast((index - linear_buckets) / sub_buckets + 1);
+        const top: u64 = (index - linear_buckets) % sub_buckets + sub_buckets;
+        return ((top + 1) << shift) -% 1;
+    }
+};
+
+/// How one benchmark is run. Warmup trials call the body like measured ones
+/// but are not recorded.
+pub const Options = struct {
+    warmup: usize = 1,
+    trials: usize = 5,
+    iterations: usize = 1000, // Body calls per trial, each timed on its own
+    ops_per_iteration: u64 = 1, // For bodies that run a batch of operations per call
+    hot_path: bool = false, // A regression here fails bench_compare
+};
+
+/// Measurements of one benchmark, as written to JSON
+pub const Result = struct {
+    name: []const u8,
+    params: []const u8 = "", // Inputs that identify the benchmark along with its name
+    hot_path: bool = false,
+    warmup: usize,
+    trials: usize,
+    iterations: usize,
+    ops: u64,
+    mean_ns: f64,
+    p50_ns: u64,
+    p95_ns: u64,
+    p99_ns: u64,
+    max_ns: u64,
+    ops_per_sec: f64,
+    allocs_per_op: f64,
+    bytes_per_op: f64,
+    trial_ns_per_op: []const f64, // Mean of each measured trial, the samples runs are compared on
+};
+
+/// Everything one benchmark executable measured
+pub const Report = struct {
+    suite: []const u8,
+    timestamp: i64,
+    build_mode: []const u8,
+    os: []const u8,
+    arch: []const u8,
+    cpu_count: usize,
+    benchmarks: []const Result,
+};
+
+/// The reports of every suite run together by scripts/run_benchmarks.zig
+pub const Summary = struct {
+    timestamp: i64,
+    suites: []const Report,
+    failed: []const []const u8 = &.{}, // Suites that exited with an error
+};
+
+/// A set of benchmarks run by one executable. Code under test should allocate
+/// from allocator(), which counts allocations for each benchmark's report.
+///
+/// Command line: [--trials N] [--warmup N] [--json PATH] [--set NAME=VALUE]...
+/// Trial counts given there override every benchmark's own; the JSON report
+/// goes to PATH, or to benchmark_results/<suite>_<timestamp>.json. Settings
+/// are read by the suites that know them, e.g. --set scale=10.
+pub const Suite = struct {
+    backing: std.mem.Allocator, // The harness's own bookkeeping, not counted
+    arena: std.heap.ArenaAllocator,
+    name: []const u8,
+    counting: CountingAllocator,
+    histogram: Histogram = .{},
+    results: std.ArrayList(Result),
+    trials: ?usize = null,
+    warmup: ?usize = null,
+    json_path: ?[]const u8 = null,
+    settings: std.StringHashMapUnmanaged([]const u8) = .{},
+
+    pub fn init(backing: std.mem.Allocator, name: []const u8) !*Suite {
+        const suite = try backing.create(Suite);
+        errdefer backing.destroy(suite);
+        suite.* = Suite{
+            .backing = backing,
+            .arena = std.heap.ArenaAllocator.init(backing),
+            .name = name,
+            .counting = CountingAllocator.init(backing),
+            .results = std.ArrayList(Result).init(backing),
+        };
+        errdefer suite.arena.deinit();
+        try suite.parseArgs();
+        return suite;
+    }
+
+    pub fn deinit(self: *Suite) void {
+        self.results.deinit();
+        self.arena.deinit();
+        self.backing.destroy(self);
+    }
+
+    /// Allocator for the code being measured
+    pub fn allocator(self: *Suite) std.mem.Allocator {
+        return self.counting.allocator();
+    }
+
+    fn parseArgs(self: *Suite) !void {
+        const args = try std.process.argsAlloc(self.arena.allocator());
+        var i: usize = 1;
+        while (i < args.len) : (i += 1) {
+            const arg = args[i];
+            if (i + 1 == args.len) return usage(arg);
+            i += 1;
+            if (std.mem.eql(u8, arg, "--trials")) {
+                self.trials = std.fmt.parseInt(usize, args[i], 10) catch return usage(arg);
+            } else if (std.mem.eql(u8, arg, "--warmup")) {
+                self.warmup = std.fmt.parseInt(usize, args[i], 10) catch return usage(arg);
+            } else if (std.mem.eql(u8, arg, "--json")) {
+                self.json_path = args[i];
+            } else if (std.mem.eql(u8, arg, "--set")) {
+                const eq = std.mem.indexOfScalar(u8, args[i], '=') orelse return usage(arg);
+                try self.settings.put(self.arena.allocator(), args[i][0..eq], args[i][eq + 1 ..]);
+            } else {
+                return usage(arg);
+            }
+        }
+    }
+
+    fn usage(arg: []const u8) error{InvalidArgument} {
+        std.debug.print("Invalid argument {s}\nUsage: [--trials N] [--warmup N] [--json PATH] [--set NAME=VALUE]...\n", .{arg});
+        return error.InvalidArgument;
+    }
+
+    /// A --set value given on the command line
+    pub fn setting(self: *const Suite, name: []const u8) ?[]const u8 {
+        return self.settings.get(name);
+    }
+
+    /// Run `body(context, n)` for the warmup and measured trials, where n counts
+    /// calls across all trials, and record the time of each call.
+    pub fn run(self: *Suite, name: []const u8, params: []const u8, options: Options, context: anytype, body: anytype) !void {
+        const warmup = self.warmup orelse options.warmup;
+        const trials = @max(1, self.trials orelse options.trials);
+        const ops_per_trial = options.iterations * options.ops_per_iteration;
+
+        var call: usize = 0;
+        for (0..warmup) |_| {
+            for (0..options.iterations) |_| {
+                try body(context, call);
+                call += 1;
+            }
+        }
+
+        const samples = try self.arena.allocator().alloc(f64, trials);
+        self.histogram.reset();
+        const allocations_before = self.counting.allocationCount();
+        const bytes_before = self.counting.bytesAllocated();
+        var timer = try std.time.Timer.start();
+        var measured_ns: u64 = 0;
+        for (samples) |*sample| {
+            var trial_ns: u64 = 0;
+            for (0..options.iterations) |_| {
+                timer.reset();
+                try body(context, call);
+                const elapsed = timer.read();
+                call += 1;
+                trial_ns += elapsed;
+                self.histogram.record(elapsed / options.ops_per_iteration);
+            }
+            sample.* = @as(f64, @floatFromInt(trial_ns)) / @as(f64, @floatFromInt(ops_per_trial));
+            measured_ns += trial_ns;
+        }
+
+        const ops = ops_per_trial * trials;
+        const ops_f: f64 = @floatFromInt(ops);
+        const result = Result{
+            .name = name,
+            .params = params,
+            .hot_path = options.hot_path,
+            .warmup = warmup,
+            .trials = trials,
+            .iterations = options.iterations,
+            .ops = ops,
+            .mean_ns = @as(f64, @floatFromInt(measured_ns)) / ops_f,
+            .p50_ns = self.histogram.percentile(50),
+            .p95_ns = self.histogram.percentile(95),
+            .p99_ns = self.histogram.percentile(99),
+            .max_ns = self.histogram.max,
+            .ops_per_sec = ops_f / (@as(f64, @floatFromInt(@max(1, measured_ns))) / std.time.ns_per_s),
+            .allocs_per_op = @as(f64, @floatFromInt(self.counting.allocationCount() - allocations_before)) / ops_f,
+            .bytes_per_op = @as(f64, @floatFromInt(self.counting.bytesAllocated() - bytes_before)) / ops_f,
+            .trial_ns_per_op = samples,
+        };
+        try self.results.append(result);
+
+        std.debug.print("{s:<28} {s:<24} p50 {: >9} p95 {: >9} p99 {: >9} max {: >9} {d:>12.0} ops/s {d:>8.1} allocs/op\n", .{
+            name,
+            params,
+            std.fmt.fmtDuration(result.p50_ns),
+            std.fmt.fmtDuration(result.p95_ns),
+            std.fmt.fmtDuration(result.p99_ns),
+            std.fmt.fmtDuration(result.max_ns),
+            result.ops_per_sec,
+            result.allocs_per_op,
+        });
+    }
+
+    /// Write the JSON report of every benchmark run so far
+    pub fn finish(self: *Suite) !void {
+        const path = self.json_path orelse blk: {
+            try std.fs.cwd().makePath("benchmark_results");
+            break :blk try std.fmt.allocPrint(self.arena.allocator(), "benchmark_results/{s}_{d}.json", .{ self.name, std.time.timestamp() });
+        };
+
+        const report = Report{
+            .suite = self.name,
+            .timestamp = std.time.timestamp(),
+            .build_mode = @tagName(builtin.mode),
+            .os = @tagName(builtin.os.tag),
+            .arch = @tagName(builtin.cpu.arch),
+            .cpu_count = std.Thread.getCpuCount() catch 1,
+            .benchmarks = self.results.items,
+        };
+
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+        var buffered = std.io.bufferedWriter(file.writer());
+        try std.json.stringify(report, .{ .whitespace = .indent_2 }, buffered.writer());
+        try buffered.flush();
+
+        std.debug.print("Benchmark results written to {s}\n", .{path});
+    }
+};
+
+/// Outcome of a two-sided Mann–Whitney U test
+pub const MannWhitney = struct {
+    u: f64, // Pairs (x from a, y from b) with x > y, ties counting one half
+    p_value: f64,
+};
+
+/// Samples up to this many pairs without ties get an exact p-value
+const exact_pairs_limit = 400;
+
+/// Two-sided Mann–Whitney U test of whether `a` and `b` come from the same
+/// distribution. It compares ranks only, so a few noisy trials cannot swing
+/// it the way they swing a mean. Small samples without ties get the exact
+/// p-value; others the normal approximation with tie correction.
+pub fn mannWhitney(allocator: std.mem.Allocator, a: []const f64, b: []const f64) !MannWhitney {
+    if (a.len == 0 or b.len == 0) return MannWhitney{ .u = 0, .p_value = 1 };
+
+    const Sample = struct {
+        value: f64,
+        from_a: bool,
+
+        fn lessThan(_: void, x: @This(), y: @This()) bool {
+            return x.value < y.value;
+        }
+    };
+    const samples = try allocator.alloc(Sample, a.len + b.len);
+    defer allocator.free(samples);
+    for (a, 0..) |value, i| samples[i] = .{ .value = value, .from_a = true };
+    for (b, 0..) |value, i| samples[a.len + i] = .{ .value = value, .from_a = false };
+    std.mem.sort(Sample, samples, {}, Sample.lessThan);
+
+    // Tied values share the average of their ranks
+    var rank_sum_a: f64 = 0;
+    var tie_term: f64 = 0;
+    var start: usize = 0;
+    while (start < samples.len) {
+        var end = start + 1;
+        while (end < samples.len and samples[end].value == samples[start].value) end += 1;
+        const ties: f64 = @floatFromInt(end - start);
+        const rank = @as(f64, @floatFromInt(start + end + 1)) / 2.0;
+        for (samples[start..end]) |sample| {
+            if (sample.from_a) rank_sum_a += rank;
+        }
+        tie_term += ties * ties * ties - ties;
+        start = end;
+    }
+
+    const n1: f64 = @floatFromInt(a.len);
+    const n2: f64 = @floatFromInt(b.len);
+    const u = rank_sum_a - n1 * (n1 + 1) / 2;
+
+    if (tie_term == 0 and a.len * b.len <= exact_pairs_limit) {
+        return MannWhitney{ .u = u, .p_value = try exactPValue(allocator, a.len, b.len, @intFromFloat(u)) };
+    }
+
+    const n = n1 + n2;
+    const variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (variance <= 0) return MannWhitney{ .u = u, .p_value = 1 };
+    const z = @max(0, @abs(u - n1 * n2 / 2) - 0.5) / @sqrt(variance);
+    return MannWhitney{ .u = u, .p_value = @min(1, erfc(z / std.math.sqrt2)) };
+}
+
+/// Two-sided p-value of U = `u` from the exact null distribution, counted as
+/// the arrangements of n1 a's and n2 b's that reach each U
+fn exactPValue(allocator: std.mem.Allocator, n1: usize, n2: usize, u: usize) !f64 {
+    // counts[j * width + k]: arrangements of i a's and j b's with U = k, for the current i
+    const width = n1 * n2 + 1;
+    const counts = try allocator.alloc(f64, (n2 + 1) * width);
+    defer allocator.free(counts);
+
+    @memset(counts, 0);
+    for (0..n2 + 1) |j| counts[j * width] = 1; // No a's: U is 0
+    for (1..n1 + 1) |_| {
+        // The largest element is either an a, above all j b's, or a b. Row
+        // j - 1 already holds the new i; row j still holds i - 1 for every
+        // k not yet visited.
+        for (0..n2 + 1) |j| {
+            var k: usize = width;
+            while (k > 0) {
+                k -= 1;
+                const a_last = if (k >= j) counts[j * width + k - j] else 0;
+                const b_last = if (j > 0) counts[(j - 1) * width + k] else 0;
+                counts[j * width + k] = a_last + b_last;
+            }
+        }
+    }
+
+    const row = counts[n2 * width ..][0..width];
+    var total: f64 = 0;
+    var at_most: f64 = 0;
+    var at_least: f64 = 0;
+    for (row, 0..) |count, k| {
+        total += count;
+        if (k <= u) at_most += count;
+        if (k >= u) at_least += count;
+    }
+    return @min(1, 2 * @min(at_most, at_least) / total);
+}
+
+/// Complementary error function, to within 1.2e-7 (Numerical Recipes erfcc)
+fn erfc(x: f64) f64 {
+    const z = @abs(x);
+    const t = 1 / (1 + 0.5 * z);
+    const r = t * @exp(-z * z - 1.26551223 + t * (1.00002368 + t * (0.37409196 + t * (0.09678418 +
+        t * (-0.18628806 + t * (0.27886807 + t * (-1.13520398 + t * (1.48851587 +
+        t * (-0.82215223 + t * 0.17087277)))))))));
+    return if (x >= 0) r else 2 - r;
+}
+
+test "Histogram percentiles stay within a bucket of the recorded values" {
+    var histogram = Histogram{};
+    for (1..10_001) |value| histogram.record(value * 1000);
+
+    try std.testing.expectEqual(@as(u64, 10_000), histogram.total);
+    try std.testing.expectEqual(@as(u64, 10_000_000), histogram.max);
+    for ([_]f64{ 50, 95, 99 }) |p| {
+        const exact = p / 100.0 * 10_000_000.0;
+        const reported: f64 = @floatFromInt(histogram.percentile(p));
+        try std.testing.expect(reported >= exact);
+        try std.testing.expect(reported <= exact * (1.0 + 1.0 / 64.0));
+    }
+    try std.testing.expectEqual(@as(u64, 10_000_000), histogram.percentile(100));
+
+    // Small values are exact, and the largest ones still have a bucket
+    histogram.reset();
+    histogram.record(3);
+    histogram.record(std.math.maxInt(u64));
+    try std.testing.expectEqual(@as(u64, 3), histogram.percentile(50));
+    try std.testing.expectEqual(@as(u64, std.math.maxInt(u64)), histogram.percentile(100));
+
+    // Merging gives the histogram of both sample sets
+    var other = Histogram{};
+    other.record(1);
+    histogram.merge(&other);
+    try std.testing.expectEqual(@as(u64, 3), histogram.total);
+    try std.testing.expectEqual(@as(u64, 1), histogram.min);
+    try std.testing.expectEqual(@as(u64, 1), histogram.percentile(1));
+}
+
+test "Mann-Whitney separates shifted samples and not identical ones" {
+    const allocator = std.testing.allocator;
+    const base = [_]f64{ 101, 99, 100, 102, 98 };
+    const slower = [_]f64{ 111, 109, 110, 112, 108 };
+
+    // Completely separated: the most extreme of the 252 arrangements at either end
+    const shifted = try mannWhitney(allocator, &slower, &base);
+    try std.testing.expectEqual(@as(f64, 25), shifted.u);
+    try std.testing.expectApproxEqAbs(@as(f64, 2.0 / 252.0), shifted.p_value, 1e-12);
+
+    const same = try mannWhitney(allocator, &base, &base);
+    try std.testing.expectEqual(@as(f64, 12.5), same.u);
+    try std.testing.expectEqual(@as(f64, 1), same.p_value);
+
+    // Interleaved samples are not significant
+    const interleaved = [_]f64{ 100.5, 98.5, 101.5, 99.5, 97 };
+    try std.testing.expect((try mannWhitney(allocator, &interleaved, &base)).p_value > 0.5);
+
+    // Larger samples use the normal approximation
+    var fast: [30]f64 = undefined;
+    var slow: [30]f64 = undefined;
+    for (&fast, &slow, 0..) |*x, *y, i| {
+        x.* = 100 + @as(f64, @floatFromInt(i % 7));
+        y.* = 104 + @as(f64, @floatFromInt(i % 7));
+    }
+    try std.testing.expect((try mannWhitney(allocator, &slow, &fast)).p_value < 0.001);
+}
@@ -1,19 +1,22 @@
 const std = @import("std");
 const geeqodb = @import("geeqodb");
+const harness = @import("harness");
 const BTreeMapIndex = geeqodb.storage.btree_index.BTreeMapIndex;
 const SkipListIndex = geeqodb.storage.skiplist_index.SkipListIndex;
 
+// Benchmark parameters
+const num_entries = 100_000;
+const batch_size = 100; // Keys per timed iteration
+const range_size = 100;
+
 pub fn main() !void {
     // Initialize allocator
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
-    const allocator = gpa.allocator();
 
-    // Benchmark parameters
-    const num_entries = 100_000;
-    const num_lookups = 10_000;
-    const num_range_queries = 100;
-    const range_size = 100;
+    const suite = try harness.Suite.init(gpa.allocator(), "index_benchmark");
+    defer suite.deinit();
+    const allocator = suite.allocator();
 
     std.debug.print("Running index benchmarks with {d} entries...\n", .{num_entries});
 
@@ -24,108 +27,75 @@ pub fn main() !void {
     const skiplist_index = try SkipListIndex.create(allocator, "skiplist_benchmark", "benchmark_table", "benchmark_column");
     defer skiplist_index.deinit();
 
-    // Benchmark 1: Insertion
-    std.debug.print("\nBenchmark 1: Insertion of {d} entries\n", .{num_entries});
-
-    var timer = try std.time.Timer.start();
-    var i: i64 = 0;
-    while (i < num_entries) : (i += 1) {
-        try btree_index.insert(i, @as(u64, @intCast(i)));
-    }
-    const btree_insert_time = timer.read();
-
-    timer.reset();
-    i = 0;
-    while (i < num_entries) : (i += 1) {
-        try skiplist_index.insert(i, @as(u64, @intCast(i)));
-    }
-    const skiplist_insert_time = timer.read();
+    try benchmarkIndex(suite, "btree", btree_index);
+    try benchmarkIndex(suite, "skiplist", skiplist_index);
 
-    std.debug.print("BTreeMap insertion time: {d} ns ({d:.2} ns per entry)\n", .{ btree_insert_time, @as(f64, @floatFromInt(btree_insert_time)) / @as(f64, @floatFromInt(num_entries)) });
-    std.debug.print("SkipList insertion time: {d} ns ({d:.2} ns per entry)\n", .{ skiplist_insert_time, @as(f64, @floatFromInt(skiplist_insert_time)) / @as(f64, @floatFromInt(num_entries)) });
-
-    // Benchmark 2: Random lookups
-    std.debug.print("\nBenchmark 2: {d} random lookups\n", .{num_lookups});
-
-    var prng = std.Random.DefaultPrng.init(0);
-    const random = prng.random();
-
-    timer.reset();
-    var lookup_count: usize = 0;
-    while (lookup_count < num_lookups) : (lookup_count += 1) {
-        const key = random.intRangeAtMost(i64, 0, num_entries - 1);
-        _ = btree_index.get(key);
-    }
-    const btree_lookup_time = timer.read();
+    try suite.finish();
+    std.debug.print("\nBenchmarks completed successfully!\n", .{});
+}
 
-    timer.reset();
-    lookup_count = 0;
-    while (lookup_count < num_lookups) : (lookup_count += 1) {
-        const key = random.intRangeAtMost(i64, 0, num_entries - 1);
-        _ = skiplist_index.get(key);
-    }
-    const skiplist_lookup_time = timer.read();
+/// Operations on one index. Each iteration works on a batch of keys, so the
+/// per-key cost is not hidden by the timer's own overhead.
+fn IndexContext(comptime Index: type) type {
+    return struct {
+        const Self = @This();
 
-    std.debug.print("BTreeMap lookup time: {d} ns ({d:.2} ns per lookup)\n", .{ btree_lookup_time, @as(f64, @floatFromInt(btree_lookup_time)) / @as(f64, @floatFromInt(num_lookups)) });
-    std.debug.print("SkipList lookup time: {d} ns ({d:.2} ns per lookup)\n", .{ skiplist_lookup_time, @as(f64, @floatFromInt(skiplist_lookup_time)) / @as(f64, @floatFromInt(num_lookups)) });
+        index: *Index,
+        prng: std.Random.DefaultPrng = std.Random.DefaultPrng.init(0),
 
-    // Benchmark 3: Range queries
-    std.debug.print("\nBenchmark 3: {d} range queries of size {d}\n", .{ num_range_queries, range_size });
+        /// Keys above the preloaded ones, so inserts always add new entries
+        /// and removals take out the ones the inserts added
+        fn batchKeys(n: usize) struct { usize, usize } {
+            const first = num_entries + n * batch_size;
+            return .{ first, first + batch_size };
+        }
 
-    timer.reset();
-    var range_count: usize = 0;
-    while (range_count < num_range_queries) : (range_count += 1) {
-        const start_key = random.intRangeAtMost(i64, 0, num_entries - range_size - 1);
-        const end_key = start_key + range_size;
+        fn insert(self: *Self, n: usize) !void {
+            const first, const end = batchKeys(n);
+            for (first..end) |key| try self.index.insert(@intCast(key), @intCast(key));
+        }
 
-        var count: usize = 0;
-        var k = start_key;
-        while (k <= end_key) : (k += 1) {
-            if (btree_index.get(k) != null) {
-                count += 1;
+        fn lookup(self: *Self, _: usize) !void {
+            const random = self.prng.random();
+            for (0..batch_size) |_| {
+                std.mem.doNotOptimizeAway(self.index.get(random.intRangeAtMost(i64, 0, num_entries - 1)));
             }
         }
-    }
-    const btree_range_time = timer.read();
-
-    timer.reset();
-    range_count = 0;
-    while (range_count < num_range_queries) : (range_count += 1) {
-        const start_key = random.intRangeAtMost(i64, 0, num_entries - range_size - 1);
-        const end_key = start_key + range_size;
-
-        var count: usize = 0;
-        var k = start_key;
-        while (k <= end_key) : (k += 1) {
-            if (skiplist_index.get(k) != null) {
-                count += 1;
+
+        fn range(self: *Self, _: usize) !void {
+            const start_key = self.prng.random().intRangeAtMost(i64, 0, num_entries - range_size - 1);
+            var count: usize = 0;
+            var key = start_key;
+            while (key <= start_key + range_size) : (key += 1) {
+                if (self.index.get(key) != null) count += 1;
             }
+            std.mem.doNotOptimizeAway(count);
         }
-    }
-    const skiplist_range_time = timer.read();
-
-    std.debug.print("BTreeMap range query time: {d} ns ({d:.2} ns per query)\n", .{ btree_range_time, @as(f64, @floatFromInt(btree_range_time)) / @as(f64, @floatFromInt(num_range_queries)) });
-    std.debug.print("SkipList range query time: {d} ns ({d:.2} ns per query)\n", .{ skiplist_range_time, @as(f64, @floatFromInt(skiplist_range_time)) / @as(f64, @floatFromInt(num_range_queries)) });
-
-    // Benchmark 4: Deletion
-    std.debug.print("\nBenchmark 4: Deletion of {d} entries\n", .{num_entries});
 
-    timer.reset();
-    i = 0;
-    while (i < num_entries) : (i += 1) {
-        _ = btree_index.remove(i);
-    }
-    const btree_delete_time = timer.read();
+        fn remove(self: *Self, n: usize) !void {
+            const first, const end = batchKeys(n);
+            for (first..end) |key| _ = self.index.remove(@intCast(key));
+        }
+    };
+}
 
-    timer.reset();
-    i = 0;
+/// Preload the index, then time inserts, lookups, range scans and removals
+fn benchmarkIndex(suite: *harness.Suite, comptime kind: []const u8, index: anytype) !void {
+    var i: i64 = 0;
     while (i < num_entries) : (i += 1) {
-        _ = skiplist_index.remove(i);
+        try index.insert(i, @as(u64, @intCast(i)));
     }
-    const skiplist_delete_time = timer.read();
-
-    std.debug.print("BTreeMap deletion time: {d} ns ({d:.2} ns per entry)\n", .{ btree_delete_time, @as(f64, @floatFromInt(btree_delete_time)) / @as(f64, @floatFromInt(num_entries)) });
-    std.debug.print("SkipList deletion time: {d} ns ({d:.2} ns per entry)\n", .{ skiplist_delete_time, @as(f64, @floatFromInt(skiplist_delete_time)) / @as(f64, @floatFromInt(num_entries)) });
 
-    std.debug.print("\nBenchmarks completed successfully!\n", .{});
+    const Context = IndexContext(@typeInfo(@TypeOf(index)).pointer.child);
+    var context = Context{ .index = index };
+    const params = std.fmt.comptimePrint("index={s} entries={d}", .{ kind, num_entries });
+    const batches = harness.Options{ .iterations = 200, .ops_per_iteration = batch_size };
+
+    // Removals run with the same options as the inserts, so they find every key the inserts added
+    try suite.run("insert", params, batches, &context, Context.insert);
+    var lookups = batches;
+    lookups.hot_path = true;
+    try suite.run("lookup", params, lookups, &context, Context.lookup);
+    try suite.run("range", params ++ std.fmt.comptimePrint(" range={d}", .{range_size}), .{ .iterations = 200 }, &context, Context.range);
+    try suite.run("remove", params, batches, &context, Context.remove);
 }
@@ -1,14 +1,27 @@
 const std = @import("std");
 const geeqodb = @import("geeqodb");
-const QueryPlanner = geeqodb.query.planner.QueryPlanner;
+const harness = @import("harness");
+const planner = geeqodb.query.planner;
+const QueryPlanner = planner.QueryPlanner;
 const QueryExecutor = geeqodb.query.executor.QueryExecutor;
 const DatabaseContext = geeqodb.query.executor.DatabaseContext;
 
+/// Queries the planner accepts today. Its column list is one token, so it is
+/// written without spaces; GROUP BY and JOIN are left out because the planner
+/// would plan them as plain scans and the timings would mean nothing.
+const queries = [_][]const u8{
+    "SELECT * FROM test",
+    "SELECT id,name FROM users WHERE age > 18",
+};
+
 pub fn main() !void {
     // Initialize allocator
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
-    const allocator = gpa.allocator();
+
+    const suite = try harness.Suite.init(gpa.allocator(), "query_benchmark");
+    defer suite.deinit();
+    const allocator = suite.allocator();
 
     // Create a database context
     var db_context = try DatabaseContext.init(allocator);
@@ -16,132 +29,75 @@ pub fn main() !void {
 
     // Benchmark query planning and execution
     std.debug.print("Benchmarking query planning and execution...\n", .{});
-    try benchmarkQueryPlanning(allocator, db_context);
+    try benchmarkQueryPlanning(suite, allocator, db_context);
 
+    try suite.finish();
     std.debug.print("\nBenchmarks completed successfully!\n", .{});
 }
 
-/// Benchmark query planning and execution
-fn benchmarkQueryPlanning(allocator: std.mem.Allocator, db_context: *DatabaseContext) !void {
-    // Initialize query planner
-    const query_planner = try QueryPlanner.init(allocator);
-    defer query_planner.deinit();
-
-    const queries = [_][]const u8{
-        "SELECT * FROM test",
-        "SELECT id, name FROM users WHERE age > 18",
-        "SELECT COUNT(*) FROM orders GROUP BY customer_id",
-        "SELECT products.name, categories.name FROM products JOIN categories ON products.category_id = categories.id",
-    };
-
-    // Benchmark parse operation
-    const parse_iterations = 10000;
-    var timer = try std.time.Timer.start();
-    var total_time: u64 = 0;
-
-    for (0..parse_iterations) |i| {
-        const query = queries[i % queries.len];
-
-        timer.reset();
-        const ast = try query_planner.parse(query);
-        const elapsed = timer.read();
-        total_time += elapsed;
+/// The plans of every query, built once so each stage can be timed on its own
+const Stages = struct {
+    allocator: std.mem.Allocator,
+    query_planner: *QueryPlanner,
+    db_context: *DatabaseContext,
+    asts: [queries.len]*planner.AST = undefined,
+    logical_plans: [queries.len]*planner.LogicalPlan = undefined,
+    physical_plans: [queries.len]*planner.PhysicalPlan = undefined,
+
+    fn parse(self: *Stages, n: usize) !void {
+        const ast = try self.query_planner.parse(queries[n % queries.len]);
         ast.deinit();
     }
 
-    const avg_parse_time_ns = total_time / parse_iterations;
-    const avg_parse_time_ms = @as(f64, @floatFromInt(avg_parse_time_ns)) / 1_000_000.0;
-    std.debug.print("Query parse: {d:.3} ms average over {} iterations\n", .{ avg_parse_time_ms, parse_iterations });
-
-    // Benchmark plan operation
-    const plan_iterations = 10000;
-    total_time = 0;
-
-    for (0..plan_iterations) |i| {
-        const query = queries[i % queries.len];
-        const ast = try query_planner.parse(query);
-        defer ast.deinit();
-
-        timer.reset();
-        const logical_plan = try query_planner.plan(ast);
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn plan(self: *Stages, n: usize) !void {
+        const logical_plan = try self.query_planner.plan(self.asts[n % queries.len]);
         logical_plan.deinit();
     }
 
-    const avg_plan_time_ns = total_time / plan_iterations;
-    const avg_plan_time_ms = @as(f64, @floatFromInt(avg_plan_time_ns)) / 1_000_000.0;
-    std.debug.print("Query plan: {d:.3} ms average over {} iterations\n", .{ avg_plan_time_ms, plan_iterations });
-
-    // Benchmark optimize operation
-    const optimize_iterations = 10000;
-    total_time = 0;
-
-    for (0..optimize_iterations) |i| {
-        const query = queries[i % queries.len];
-        const ast = try query_planner.parse(query);
-        defer ast.deinit();
-        const logical_plan = try query_planner.plan(ast);
-        defer logical_plan.deinit();
-
-        timer.reset();
-        const physical_plan = try query_planner.optimize(logical_plan);
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn optimize(self: *Stages, n: usize) !void {
+        const physical_plan = try planner.optimize(self.query_planner, self.logical_plans[n % queries.len]);
         physical_plan.deinit();
     }
 
-    const avg_optimize_time_ns = total_time / optimize_iterations;
-    const avg_optimize_time_ms = @as(f64, @floatFromInt(avg_optimize_time_ns)) / 1_000_000.0;
-    std.debug.print("Query optimize: {d:.3} ms average over {} iterations\n", .{ avg_optimize_time_ms, optimize_iterations });
-
-    // Benchmark execute operation
-    const execute_iterations = 10000;
-    total_time = 0;
+    fn execute(self: *Stages, n: usize) !void {
+        var result_set = try QueryExecutor.execute(self.allocator, self.physical_plans[n % queries.len], self.db_context);
+        result_set.deinit();
+    }
 
-    for (0..execute_iterations) |i| {
-        const query = queries[i % queries.len];
-        const ast = try query_planner.parse(query);
+    fn endToEnd(self: *Stages, n: usize) !void {
+        const ast = try self.query_planner.parse(queries[n % queries.len]);
         defer ast.deinit();
-        const logical_plan = try query_planner.plan(ast);
+        const logical_plan = try self.query_planner.plan(ast);
         defer logical_plan.deinit();
-        const physical_plan = try query_planner.optimize(logical_plan);
+        const physical_plan = try planner.optimize(self.query_planner, logical_plan);
         defer physical_plan.deinit();
-
-        timer.reset();
-        var result_set = try QueryExecutor.execute(allocator, physical_plan, db_context);
-        const elapsed = timer.read();
-        total_time += elapsed;
+        var result_set = try QueryExecutor.execute(self.allocator, physical_plan, self.db_context);
         result_set.deinit();
     }
+};
 
-    const avg_execute_time_ns = total_time / execute_iterations;
-    const avg_execute_time_ms = @as(f64, @floatFromInt(avg_execute_time_ns)) / 1_000_000.0;
-    std.debug.print("Query execute: {d:.3} ms average over {} iterations\n", .{ avg_execute_time_ms, execute_iterations });
-
-    // Benchmark end-to-end query operation
-    const end_to_end_iterations = 1000;
-    total_time = 0;
-
-    for (0..end_to_end_iterations) |i| {
-        const query = queries[i % queries.len];
-
-        timer.reset();
-        const ast = try query_planner.parse(query);
-        const logical_plan = try query_planner.plan(ast);
-        const physical_plan = try query_planner.optimize(logical_plan);
-        var result_set = try QueryExecutor.execute(allocator, physical_plan, db_context);
-        const elapsed = timer.read();
-        total_time += elapsed;
+/// Benchmark query planning and execution
+fn benchmarkQueryPlanning(suite: *harness.Suite, allocator: std.mem.Allocator, db_context: *DatabaseContext) !void {
+    // Initialize query planner
+    const query_planner = try QueryPlanner.init(allocator);
+    defer query_planner.deinit();
 
-        // Clean up
-        result_set.deinit();
-        physical_plan.deinit();
-        logical_plan.deinit();
-        ast.deinit();
+    var stages = Stages{ .allocator = allocator, .query_planner = query_planner, .db_context = db_context };
+    for (queries, 0..) |query, i| {
+        stages.asts[i] = try query_planner.parse(query);
+        stages.logical_plans[i] = try query_planner.plan(stages.asts[i]);
+        stages.physical_plans[i] = try planner.optimize(query_planner, stages.logical_plans[i]);
     }
+    defer for (0..queries.len) |i| {
+        stages.physical_plans[i].deinit();
+        stages.logical_plans[i].deinit();
+        stages.asts[i].deinit();
+    };
 
-    const avg_end_to_end_time_ns = total_time / end_to_end_iterations;
-    const avg_end_to_end_time_ms = @as(f64, @floatFromInt(avg_end_to_end_time_ns)) / 1_000_000.0;
-    std.debug.print("End-to-end query: {d:.3} ms average over {} iterations\n", .{ avg_end_to_end_time_ms, end_to_end_iterations });
+    const params = std.fmt.comptimePrint("queries={d}", .{queries.len});
+    try suite.run("parse", params, .{ .iterations = 2000 }, &stages, Stages.parse);
+    try suite.run("plan", params, .{ .iterations = 2000 }, &stages, Stages.plan);
+    try suite.run("optimize", params, .{ .iterations = 2000 }, &stages, Stages.optimize);
+    try suite.run("execute", params, .{ .iterations = 2000, .hot_path = true }, &stages, Stages.execute);
+    try suite.run("end_to_end", params, .{ .iterations = 200, .hot_path = true }, &stages, Stages.endToEnd);
 }
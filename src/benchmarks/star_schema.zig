@@ -0,0 +1,185 @@
+const std = @import("std");
+const geeqodb = @import("geeqodb");
+const OLAPDatabase = geeqodb.core.OLAPDatabase;
+
+/// Deterministic star-schema data set: a `sales` fact table and five
+/// dimensions. Every table draws from its own PRNG seeded from `seed`, so a
+/// scale factor always produces the same rows regardless of load order.
+/// Scale factor 1 is 100K sales rows; dimensions grow with it, except
+/// `dates` (seven calendar years) and `promotions`, which are fixed.
+pub const default_seed: u64 = 0x5eed_57a2;
+
+const rows_per_insert = 1000;
+const first_year = 2020;
+const year_count = 7;
+
+pub const tables = [_]struct { name: []const u8, ddl: []const u8 }{
+    .{ .name = "dates", .ddl = "CREATE TABLE dates (date_id INTEGER, year INTEGER, month INTEGER, day INTEGER, weekday INTEGER, quarter INTEGER)" },
+    .{ .name = "customers", .ddl = "CREATE TABLE customers (customer_id INTEGER, name TEXT, segment TEXT, region TEXT, nation TEXT)" },
+    .{ .name = "products", .ddl = "CREATE TABLE products (product_id INTEGER, name TEXT, category TEXT, brand TEXT, unit_cost INTEGER)" },
+    .{ .name = "stores", .ddl = "CREATE TABLE stores (store_id INTEGER, city TEXT, region TEXT, size_sqft INTEGER)" },
+    .{ .name = "promotions", .ddl = "CREATE TABLE promotions (promo_id INTEGER, name TEXT, channel TEXT, discount_pct INTEGER)" },
+    .{ .name = "sales", .ddl = "CREATE TABLE sales (sale_id INTEGER, date_id INTEGER, customer_id INTEGER, product_id INTEGER, store_id INTEGER, promo_id INTEGER, quantity INTEGER, price_cents INTEGER, discount_pct INTEGER, revenue_cents INTEGER)" },
+};
+
+pub const segments = [_][]const u8{ "AUTOMOBILE", "BUILDING", "FURNITURE", "HOUSEHOLD", "MACHINERY" };
+pub const regions = [_][]const u8{ "AFRICA", "AMERICA", "ASIA", "EUROPE", "MIDDLE EAST" };
+pub const nations = [regions.len][5][]const u8{
+    .{ "ALGERIA", "ETHIOPIA", "KENYA", "MOROCCO", "MOZAMBIQUE" },
+    .{ "ARGENTINA", "BRAZIL", "CANADA", "PERU", "UNITED STATES" },
+    .{ "CHINA", "INDIA", "INDONESIA", "JAPAN", "VIETNAM" },
+    .{ "FRANCE", "GERMANY", "ROMANIA", "RUSSIA", "UNITED KINGDOM" },
+    .{ "EGYPT", "IRAN", "IRAQ", "JORDAN", "SAUDI ARABIA" },
+};
+pub const categories = [_][]const u8{ "Books", "Clothing", "Electronics", "Garden", "Grocery", "Sports", "Toys", "Tools" };
+pub const channels = [_][]const u8{ "none", "email", "radio", "tv", "web" };
+
+/// Row counts of every table at a scale factor
+pub const Sizes = struct {
+    dates: usize,
+    customers: usize,
+    products: usize,
+    stores: usize,
+    promotions: usize,
+    sales: usize,
+
+    pub fn init(scale: f64) Sizes {
+        return .{
+            .dates = daysBetween(first_year, first_year + year_count),
+            .customers = scaled(3_000, scale),
+            .products = scaled(2_000, scale),
+            .stores = scaled(50, scale),
+            .promotions = 100,
+            .sales = scaled(100_000, scale),
+        };
+    }
+
+    pub fn total(self: Sizes) usize {
+        return self.dates + self.customers + self.products + self.stores + self.promotions + self.sales;
+    }
+};
+
+fn scaled(base: usize, scale: f64) usize {
+    const rows: usize = @intFromFloat(@as(f64, @floatFromInt(base)) * scale);
+    return @max(rows, 1);
+}
+
+fn epochDay(year: u16) u47 {
+    var day: u47 = 0;
+    var y: u16 = std.time.epoch.epoch_year;
+    while (y < year) : (y += 1) day += std.time.epoch.getDaysInYear(y);
+    return day;
+}
+
+fn daysBetween(from_year: u16, to_year: u16) usize {
+    return epochDay(to_year) - epochDay(from_year);
+}
+
+/// The yyyymmdd key of the `n`th day from the first generated year
+pub fn dateId(n: usize) i64 {
+    const epoch_day = std.time.epoch.EpochDay{ .day = epochDay(first_year) + @as(u47, @intCast(n)) };
+    const year_day = epoch_day.calculateYearDay();
+    const month_day = year_day.calculateMonthDay();
+    return @as(i64, year_day.year) * 10_000 + @as(i64, month_day.month.numeric()) * 100 + month_day.day_index + 1;
+}
+
+/// Create every table and load it with batched multi-row INSERTs
+pub fn load(allocator: std.mem.Allocator, db: *OLAPDatabase, scale: f64, seed: u64) !Sizes {
+    const sizes = Sizes.init(scale);
+    var query = std.ArrayList(u8).init(allocator);
+    defer query.deinit();
+
+    for (tables, 0..) |table, table_index| {
+        var created = try db.execute(table.ddl);
+        created.deinit();
+
+        var prng = std.Random.DefaultPrng.init(seed ^ (@as(u64, table_index) *% 0x9e37_79b9_7f4a_7c15));
+        const random = prng.random();
+        const count = rowCount(sizes, table.name);
+        var row: usize = 0;
+        while (row < count) {
+            query.clearRetainingCapacity();
+            try query.writer().print("INSERT INTO {s} VALUES ", .{table.name});
+            const batch_start = row;
+            const end = @min(row + rows_per_insert, count);
+            while (row < end) : (row += 1) {
+                if (row > batch_start) try query.appendSlice(", ");
+                try writeRow(query.writer(), table.name, row, random, sizes);
+            }
+            var inserted = try db.execute(query.items);
+            inserted.deinit();
+        }
+    }
+    return sizes;
+}
+
+fn rowCount(sizes: Sizes, table: []const u8) usize {
+    inline for (std.meta.fields(Sizes)) |field| {
+        if (std.mem.eql(u8, field.name, table)) return @field(sizes, field.name);
+    }
+    unreachable;
+}
+
+fn writeRow(writer: anytype, table: []const u8, n: usize, random: std.Random, sizes: Sizes) !void {
+    const id = n + 1;
+    if (std.mem.eql(u8, table, "dates")) {
+        const date_id = dateId(n);
+        const month = @rem(@divTrunc(date_id, 100), 100);
+        const weekday = (epochDay(first_year) + n + 4) % 7; // 1970-01-01 was a Thursday
+        try writer.print("({d}, {d}, {d}, {d}, {d}, {d})", .{
+            date_id, @divTrunc(date_id, 10_000), month, @rem(date_id, 100), weekday, @divTrunc(month - 1, 3) + 1,
+        });
+    } else if (std.mem.eql(u8, table, "customers")) {
+        const region = random.uintLessThan(usize, regions.len);
+        try writer.print("({d}, 'Customer#{d:0>9}', '{s}', '{s}', '{s}')", .{
+            id,
+            id,
+            segments[random.uintLessThan(usize, segments.len)],
+            regions[region],
+            nations[region][random.uintLessThan(usize, nations[region].len)],
+        });
+    } else if (std.mem.eql(u8, table, "products")) {
+        const category = random.uintLessThan(usize, categories.len);
+        try writer.print("({d}, 'Product#{d:0>7}', '{s}', 'Brand#{d}{d:0>2}', {d})", .{
+            id,
+            id,
+            categories[category],
+            category + 1,
+            random.intRangeAtMost(u8, 1, 40),
+            random.intRangeAtMost(u32, 100, 50_000),
+        });
+    } else if (std.mem.eql(u8, table, "stores")) {
+        try writer.print("({d}, 'City#{d:0>4}', '{s}', {d})", .{
+            id,
+            random.uintLessThan(usize, 250),
+            regions[random.uintLessThan(usize, regions.len)],
+            random.intRangeAtMost(u32, 5_000, 100_000),
+        });
+    } else if (std.mem.eql(u8, table, "promotions")) {
+        // Promotion 1 is "no promotion", which most sales use
+        const channel = if (id == 1) 0 else 1 + random.uintLessThan(usize, channels.len - 1);
+        try writer.print("({d}, 'Promo#{d:0>3}', '{s}', {d})", .{
+            id,
+            id,
+            channels[channel],
+            if (id == 1) 0 else random.intRangeAtMost(u8, 5, 30),
+        });
+    } else if (std.mem.eql(u8, table, "sales")) {
+        const quantity = random.intRangeAtMost(u32, 1, 50);
+        const price_cents = random.intRangeAtMost(u32, 100, 100_000);
+        const promo_id = if (random.uintLessThan(u8, 4) == 0) 2 + random.uintLessThan(usize, sizes.promotions - 1) else 1;
+        const discount_pct = random.uintAtMost(u8, 10);
+        try writer.print("({d}, {d}, {d}, {d}, {d}, {d}, {d}, {d}, {d}, {d})", .{
+            id,
+            dateId(random.uintLessThan(usize, sizes.dates)),
+            1 + random.uintLessThan(usize, sizes.customers),
+            1 + random.uintLessThan(usize, sizes.products),
+            1 + random.uintLessThan(usize, sizes.stores),
+            promo_id,
+            quantity,
+            price_cents,
+            discount_pct,
+            @as(u64, quantity) * price_cents * (100 - discount_pct) / 100,
+        });
+    } else unreachable;
+}
@@ -1,5 +1,6 @@
 const std = @import("std");
 const geeqodb = @import("geeqodb");
+const harness = @import("harness");
 const RocksDB = geeqodb.storage.rocksdb.RocksDB;
 const WAL = geeqodb.storage.wal.WAL;
 
@@ -7,153 +8,106 @@ pub fn main() !void {
     // Initialize allocator
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
-    const allocator = gpa.allocator();
 
-    // Create data directory
-    const data_dir = "benchmark_data";
+    const suite = try harness.Suite.init(gpa.allocator(), "storage_benchmark");
+    defer suite.deinit();
+
+    // Start from an empty data directory so every run measures the same work
+    const data_dir = "benchmark_data/storage";
+    try std.fs.cwd().deleteTree(data_dir);
     try std.fs.cwd().makePath(data_dir);
 
     // Benchmark RocksDB operations
     std.debug.print("Benchmarking RocksDB operations...\n", .{});
-    try benchmarkRocksDB(allocator, data_dir);
+    try benchmarkRocksDB(suite, data_dir);
 
     // Benchmark WAL operations
     std.debug.print("\nBenchmarking WAL operations...\n", .{});
-    try benchmarkWAL(allocator, data_dir);
+    try benchmarkWAL(suite, data_dir);
 
+    try suite.finish();
     std.debug.print("\nBenchmarks completed successfully!\n", .{});
 }
 
-/// Benchmark RocksDB operations
-fn benchmarkRocksDB(allocator: std.mem.Allocator, data_dir: []const u8) !void {
-    // Initialize RocksDB
-    const db = try RocksDB.init(allocator, data_dir);
-    defer db.deinit();
-
-    // Benchmark put operation
-    const put_iterations = 10000;
-    var timer = try std.time.Timer.start();
-    var total_time: u64 = 0;
-
-    for (0..put_iterations) |i| {
-        const key = try std.fmt.allocPrint(allocator, "key_{}", .{i});
-        defer allocator.free(key);
-        const value = try std.fmt.allocPrint(allocator, "value_{}", .{i});
-        defer allocator.free(value);
-
-        timer.reset();
-        try db.put(key, value);
-        const elapsed = timer.read();
-        total_time += elapsed;
-    }
-
-    const avg_put_time_ns = total_time / put_iterations;
-    const avg_put_time_ms = @as(f64, @floatFromInt(avg_put_time_ns)) / 1_000_000.0;
-    std.debug.print("RocksDB put: {d:.3} ms average over {} iterations\n", .{ avg_put_time_ms, put_iterations });
-
-    // Benchmark get operation
-    const get_iterations = 10000;
-    total_time = 0;
+/// Keys are formatted on the stack so only the storage call allocates
+const key_count = 10_000;
 
-    for (0..get_iterations) |i| {
-        const key = try std.fmt.allocPrint(allocator, "key_{}", .{i % put_iterations});
-        defer allocator.free(key);
+fn formatKey(buffer: []u8, n: usize) []const u8 {
+    return std.fmt.bufPrint(buffer, "key_{d}", .{n % key_count}) catch unreachable;
+}
 
-        timer.reset();
-        const value = try db.get(allocator, key);
-        const elapsed = timer.read();
-        total_time += elapsed;
+const RocksDBContext = struct {
+    allocator: std.mem.Allocator,
+    db: *RocksDB,
 
-        if (value) |v| {
-            allocator.free(v);
-        }
+    fn put(self: *RocksDBContext, n: usize) !void {
+        var key_buffer: [32]u8 = undefined;
+        var value_buffer: [32]u8 = undefined;
+        const value = std.fmt.bufPrint(&value_buffer, "value_{d}", .{n}) catch unreachable;
+        try self.db.put(formatKey(&key_buffer, n), value);
     }
 
-    const avg_get_time_ns = total_time / get_iterations;
-    const avg_get_time_ms = @as(f64, @floatFromInt(avg_get_time_ns)) / 1_000_000.0;
-    std.debug.print("RocksDB get: {d:.3} ms average over {} iterations\n", .{ avg_get_time_ms, get_iterations });
-
-    // Benchmark delete operation
-    const delete_iterations = 10000;
-    total_time = 0;
-
-    for (0..delete_iterations) |i| {
-        const key = try std.fmt.allocPrint(allocator, "key_{}", .{i % put_iterations});
-        defer allocator.free(key);
-
-        timer.reset();
-        try db.delete(key);
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn get(self: *RocksDBContext, n: usize) !void {
+        var key_buffer: [32]u8 = undefined;
+        const value = try self.db.get(self.allocator, formatKey(&key_buffer, n));
+        if (value) |v| self.allocator.free(v);
     }
 
-    const avg_delete_time_ns = total_time / delete_iterations;
-    const avg_delete_time_ms = @as(f64, @floatFromInt(avg_delete_time_ns)) / 1_000_000.0;
-    std.debug.print("RocksDB delete: {d:.3} ms average over {} iterations\n", .{ avg_delete_time_ms, delete_iterations });
-
-    // Benchmark iterator operations
-    const iterator_iterations = 1000;
-    total_time = 0;
-
-    for (0..iterator_iterations) |_| {
-        timer.reset();
-        const iter = try db.iterator();
+    fn iterate(self: *RocksDBContext, _: usize) !void {
+        const iter = try self.db.iterator();
+        defer iter.deinit();
         iter.seekToFirst();
         while (iter.isValid()) {
             _ = iter.key() catch "";
             _ = iter.value() catch "";
             iter.next();
         }
-        const elapsed = timer.read();
-        total_time += elapsed;
-        iter.deinit();
     }
 
-    const avg_iterator_time_ns = total_time / iterator_iterations;
-    const avg_iterator_time_ms = @as(f64, @floatFromInt(avg_iterator_time_ns)) / 1_000_000.0;
-    std.debug.print("RocksDB iterator: {d:.3} ms average over {} iterations\n", .{ avg_iterator_time_ms, iterator_iterations });
-}
-
-/// Benchmark WAL operations
-fn benchmarkWAL(allocator: std.mem.Allocator, data_dir: []const u8) !void {
-    // Initialize WAL
-    const wal = try WAL.init(allocator, data_dir);
-    defer wal.deinit();
+    fn delete(self: *RocksDBContext, n: usize) !void {
+        var key_buffer: [32]u8 = undefined;
+        try self.db.delete(formatKey(&key_buffer, n));
+    }
+};
 
-    // Create a dummy file to avoid the WALClosed error
-    wal.file = std.fs.cwd().openFile("build.zig", .{}) catch null;
+/// Benchmark RocksDB operations
+fn benchmarkRocksDB(suite: *harness.Suite, data_dir: []const u8) !void {
+    // Initialize RocksDB
+    const allocator = suite.allocator();
+    const db = try RocksDB.init(allocator, data_dir);
+    defer db.deinit();
 
-    // Benchmark log transaction operation
-    const log_iterations = 10000;
-    var timer = try std.time.Timer.start();
-    var total_time: u64 = 0;
+    var context = RocksDBContext{ .allocator = allocator, .db = db };
+    const params = std.fmt.comptimePrint("keys={d}", .{key_count});
+    try suite.run("rocksdb_put", params, .{ .iterations = 2000, .hot_path = true }, &context, RocksDBContext.put);
+    try suite.run("rocksdb_get", params, .{ .iterations = 2000, .hot_path = true }, &context, RocksDBContext.get);
+    try suite.run("rocksdb_iterate", params, .{ .iterations = 20 }, &context, RocksDBContext.iterate);
+    try suite.run("rocksdb_delete", params, .{ .iterations = 2000 }, &context, RocksDBContext.delete);
+}
 
-    for (0..log_iterations) |i| {
-        const data = try std.fmt.allocPrint(allocator, "transaction_data_{}", .{i});
-        defer allocator.free(data);
+const WALContext = struct {
+    wal: *WAL,
 
-        timer.reset();
-        try wal.logTransaction(@intCast(i), data);
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn log(self: *WALContext, n: usize) !void {
+        var data_buffer: [48]u8 = undefined;
+        const data = std.fmt.bufPrint(&data_buffer, "transaction_data_{d}", .{n}) catch unreachable;
+        try self.wal.logTransaction(@intCast(n), data);
     }
 
-    const avg_log_time_ns = total_time / log_iterations;
-    const avg_log_time_ms = @as(f64, @floatFromInt(avg_log_time_ns)) / 1_000_000.0;
-    std.debug.print("WAL log transaction: {d:.3} ms average over {} iterations\n", .{ avg_log_time_ms, log_iterations });
-
-    // Benchmark recover operation
-    const recover_iterations = 100;
-    total_time = 0;
-
-    for (0..recover_iterations) |_| {
-        timer.reset();
-        try wal.recover();
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn recover(self: *WALContext, _: usize) !void {
+        try self.wal.recover();
     }
+};
+
+/// Benchmark WAL operations
+fn benchmarkWAL(suite: *harness.Suite, data_dir: []const u8) !void {
+    // Initialize WAL
+    const wal = try WAL.init(suite.allocator(), data_dir);
+    defer wal.deinit();
+    try wal.open();
 
-    const avg_recover_time_ns = total_time / recover_iterations;
-    const avg_recover_time_ms = @as(f64, @floatFromInt(avg_recover_time_ns)) / 1_000_000.0;
-    std.debug.print("WAL recover: {d:.3} ms average over {} iterations\n", .{ avg_recover_time_ms, recover_iterations });
+    var context = WALContext{ .wal = wal };
+    // Every logged transaction is synced, so each one costs an fsync
+    try suite.run("wal_log_transaction", "", .{ .iterations = 200 }, &context, WALContext.log);
+    try suite.run("wal_recover", "", .{ .iterations = 20 }, &context, WALContext.recover);
 }
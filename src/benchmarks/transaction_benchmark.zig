@@ -1,5 +1,6 @@
 const std = @import("std");
 const geeqodb = @import("geeqodb");
+const harness = @import("harness");
 const TransactionManager = geeqodb.transaction.manager.TransactionManager;
 const Transaction = geeqodb.transaction.manager.Transaction;
 
@@ -7,88 +8,95 @@ pub fn main() !void {
     // Initialize allocator
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
-    const allocator = gpa.allocator();
+
+    const suite = try harness.Suite.init(gpa.allocator(), "transaction_benchmark");
+    defer suite.deinit();
 
     // Benchmark transaction operations
     std.debug.print("Benchmarking transaction operations...\n", .{});
-    try benchmarkTransactions(allocator);
+    try benchmarkTransactions(suite);
+
+    std.debug.print("\nBenchmarking concurrent begin/commit...\n", .{});
+    try benchmarkConcurrentTransactions(suite);
 
+    try suite.finish();
     std.debug.print("\nBenchmarks completed successfully!\n", .{});
 }
 
-/// Benchmark transaction operations
-fn benchmarkTransactions(allocator: std.mem.Allocator) !void {
-    // Initialize transaction manager
-    const txn_manager = try TransactionManager.init(allocator);
-    defer txn_manager.deinit();
+const open_transactions = 10_000;
 
-    // Benchmark begin transaction operation
-    const begin_iterations = 10000;
-    var timer = try std.time.Timer.start();
-    var total_time: u64 = 0;
-    var transactions = std.ArrayList(*Transaction).init(allocator);
-    defer transactions.deinit();
+const Context = struct {
+    txn_manager: *TransactionManager,
+    first_id: u64 = 0,
 
-    for (0..begin_iterations) |_| {
-        timer.reset();
-        const txn = try txn_manager.beginTransaction();
-        const elapsed = timer.read();
-        total_time += elapsed;
-        try transactions.append(txn);
+    fn beginCommit(self: *Context, _: usize) !void {
+        const txn = try self.txn_manager.beginTransaction();
+        try self.txn_manager.commitTransaction(txn);
     }
 
-    const avg_begin_time_ns = total_time / begin_iterations;
-    const avg_begin_time_ms = @as(f64, @floatFromInt(avg_begin_time_ns)) / 1_000_000.0;
-    std.debug.print("Begin transaction: {d:.3} ms average over {} iterations\n", .{ avg_begin_time_ms, begin_iterations });
-
-    // Benchmark get transaction operation
-    const get_iterations = 10000;
-    total_time = 0;
-
-    for (0..get_iterations) |i| {
-        const txn_id = @as(u64, @intCast((i % transactions.items.len) + 1));
-
-        timer.reset();
-        _ = txn_manager.getTransaction(txn_id);
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn beginAbort(self: *Context, _: usize) !void {
+        const txn = try self.txn_manager.beginTransaction();
+        try self.txn_manager.abortTransaction(txn);
     }
 
-    const avg_get_time_ns = total_time / get_iterations;
-    const avg_get_time_ms = @as(f64, @floatFromInt(avg_get_time_ns)) / 1_000_000.0;
-    std.debug.print("Get transaction: {d:.3} ms average over {} iterations\n", .{ avg_get_time_ms, get_iterations });
-
-    // Benchmark commit transaction operation
-    const commit_iterations = transactions.items.len / 2;
-    total_time = 0;
-
-    for (0..commit_iterations) |_| {
-        const txn = transactions.pop();
-
-        timer.reset();
-        try txn_manager.commitTransaction(txn.?);
-        const elapsed = timer.read();
-        total_time += elapsed;
+    fn lookup(self: *Context, n: usize) !void {
+        const txn_id = self.first_id + n % open_transactions;
+        if (self.txn_manager.active_txns.get(txn_id) == null) return error.TransactionNotFound;
     }
+};
+
+/// Benchmark transaction operations
+fn benchmarkTransactions(suite: *harness.Suite) !void {
+    // Initialize transaction manager
+    const allocator = suite.allocator();
+    const txn_manager = try TransactionManager.init(allocator);
+    defer txn_manager.deinit();
 
-    const avg_commit_time_ns = total_time / commit_iterations;
-    const avg_commit_time_ms = @as(f64, @floatFromInt(avg_commit_time_ns)) / 1_000_000.0;
-    std.debug.print("Commit transaction: {d:.3} ms average over {} iterations\n", .{ avg_commit_time_ms, commit_iterations });
+    var context = Context{ .txn_manager = txn_manager };
+    try suite.run("begin_commit", "", .{ .iterations = 2000, .hot_path = true }, &context, Context.beginCommit);
+    try suite.run("begin_abort", "", .{ .iterations = 2000 }, &context, Context.beginAbort);
 
-    // Benchmark abort transaction operation
-    const abort_iterations = transactions.items.len;
-    total_time = 0;
+    // Look up transactions among many open ones
+    var transactions = std.ArrayList(*Transaction).init(allocator);
+    defer transactions.deinit();
+    defer for (transactions.items) |txn| txn_manager.abortTransaction(txn) catch {};
+    try transactions.ensureTotalCapacity(open_transactions);
+    for (0..open_transactions) |_| transactions.appendAssumeCapacity(try txn_manager.beginTransaction());
+    context.first_id = transactions.items[0].id;
 
-    while (transactions.items.len > 0) {
-        const txn = transactions.pop();
+    const params = std.fmt.comptimePrint("open={d}", .{open_transactions});
+    try suite.run("lookup", params, .{ .iterations = 2000 }, &context, Context.lookup);
+}
 
-        timer.reset();
-        try txn_manager.abortTransaction(txn.?);
-        const elapsed = timer.read();
-        total_time += elapsed;
+const thread_count = 32;
+const pairs_per_thread = 10_000;
+
+fn runWorkers(txn_manager: *TransactionManager, _: usize) !void {
+    const Worker = struct {
+        fn run(manager: *TransactionManager) void {
+            for (0..pairs_per_thread) |_| {
+                const txn = manager.beginTransaction() catch return;
+                manager.commitTransaction(txn) catch return;
+            }
+        }
+    };
+
+    var threads: [thread_count]std.Thread = undefined;
+    for (&threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, Worker.run, .{txn_manager});
     }
+    for (threads) |thread| thread.join();
+}
+
+/// Benchmark begin/commit pairs issued from many threads at once
+fn benchmarkConcurrentTransactions(suite: *harness.Suite) !void {
+    const txn_manager = try TransactionManager.init(suite.allocator());
+    defer txn_manager.deinit();
 
-    const avg_abort_time_ns = total_time / abort_iterations;
-    const avg_abort_time_ms = @as(f64, @floatFromInt(avg_abort_time_ns)) / 1_000_000.0;
-    std.debug.print("Abort transaction: {d:.3} ms average over {} iterations\n", .{ avg_abort_time_ms, abort_iterations });
+    // One iteration runs every thread to completion; latency is per pair
+    const params = std.fmt.comptimePrint("threads={d}", .{thread_count});
+    try suite.run("concurrent_begin_commit", params, .{
+        .iterations = 1,
+        .ops_per_iteration = thread_count * pairs_per_thread,
+    }, txn_manager, runWorkers);
 }
@@ -0,0 +1,588 @@
+const std = @import("std");
+const Value = @import("../query/result.zig").Value;
+const ColumnSchema = @import("database.zig").ColumnSchema;
+const DataType = ColumnSchema.DataType;
+
+/// Maximum number of rows appended to a table and logged as one WAL record
+pub const max_batch_rows: usize = 8192;
+
+/// Maximum size of one batch WAL record. The WAL accepts records up to
+/// wal.max_record_bytes; batches are cut much smaller so that encoding one,
+/// and parsing it back as a single INSERT during recovery, needs little
+/// memory, and so each batch holds the write lock only briefly.
+pub const max_batch_bytes: usize = 512 * 1024;
+
+/// CSV bytes parsed per chunk; files smaller than this are parsed on the
+/// calling thread
+const min_bytes_per_worker: usize = 1024 * 1024;
+
+/// Upper bound on parser threads for COPY
+const max_parse_workers: usize = 16;
+
+pub const Error = error{
+    InvalidSyntax,
+    ColumnCountMismatch,
+    InvalidValue,
+};
+
+/// Free rows allocated by the parsers in this file
+pub fn freeRows(allocator: std.mem.Allocator, rows: []const []Value) void {
+    for (rows) |row| {
+        freeRow(allocator, row);
+    }
+}
+
+fn freeRow(allocator: std.mem.Allocator, row: []Value) void {
+    for (row) |val| {
+        if (val == .text) allocator.free(val.text);
+    }
+    allocator.free(row);
+}
+
+// ---------------------------------------------------------------------------
+// INSERT ... VALUES (...), (...), ...
+// ---------------------------------------------------------------------------
+
+/// Parse the tuple list that follows the VALUES keyword of an INSERT statement.
+/// Handles quoted strings containing commas and parentheses ('' escapes a quote).
+/// Caller owns the returned rows and the values in them.
+pub fn parseValuesList(allocator: std.mem.Allocator, input: []const u8, columns: []const ColumnSchema) !std.ArrayList([]Value) {
+    var rows = std.ArrayList([]Value).init(allocator);
+    errdefer {
+        freeRows(allocator, rows.items);
+        rows.deinit();
+    }
+
+    var pos: usize = 0;
+    while (true) {
+        pos = skipWhitespace(input, pos);
+        if (pos >= input.len or input[pos] != '(') return error.InvalidSyntax;
+        pos += 1;
+
+        const row = try allocator.alloc(Value, columns.len);
+        var filled: usize = 0;
+        errdefer {
+            for (row[0..filled]) |val| {
+                if (val == .text) allocator.free(val.text);
+            }
+            allocator.free(row);
+        }
+
+        while (true) {
+            pos = skipWhitespace(input, pos);
+            if (pos >= input.len) return error.InvalidSyntax;
+
+            // Read one literal
+            const literal_start = pos;
+            var quoted = false;
+            if (input[pos] == '\'') {
+                quoted = true;
+                pos += 1;
+                while (pos < input.len) : (pos += 1) {
+                    if (input[pos] == '\'') {
+                        if (pos + 1 < input.len and input[pos + 1] == '\'') {
+                            pos += 1;
+                            continue;
+                        }
+                        break;
+                    }
+                }
+                if (pos >= input.len) return error.InvalidSyntax;
+                pos += 1;
+            } else {
+                while (pos < input.len and input[pos] != ',' and input[pos] != ')') : (pos += 1) {}
+            }
+            const literal = std.mem.trim(u8, input[literal_start..pos], &std.ascii.whitespace);
+
+            if (filled >= columns.len) return error.ColumnCountMismatch;
+            row[filled] = try parseSqlLiteral(allocator, literal, quoted, columns[filled].data_type);
+            filled += 1;
+
+            pos = skipWhitespace(input, pos);
+            if (pos >= input.len) return error.InvalidSyntax;
+            if (input[pos] == ',') {
+                pos += 1;
+                continue;
+            }
+            if (input[pos] == ')') {
+                pos += 1;
+                break;
+            }
+            return error.InvalidSyntax;
+        }
+
+        if (filled != columns.len) return error.ColumnCountMismatch;
+        try rows.append(row);
+
+        pos = skipWhitespace(input, pos);
+        if (pos >= input.len or input[pos] == ';') break;
+        if (input[pos] != ',') return error.InvalidSyntax;
+        pos += 1;
+    }
+
+    return rows;
+}
+
+fn skipWhitespace(input: []const u8, start: usize) usize {
+    var pos = start;
+    while (pos < input.len and std.ascii.isWhitespace(input[pos])) : (pos += 1) {}
+    return pos;
+}
+
+/// Convert an SQL literal into a value for a column of the given type.
+/// A quoted literal in a non-text column is parsed by that column's type,
+/// so '5' stores an integer and 'abc' is rejected.
+fn parseSqlLiteral(allocator: std.mem.Allocator, literal: []const u8, quoted: bool, data_type: DataType) !Value {
+    if (quoted) {
+        const inner = literal[1 .. literal.len - 1];
+        if (data_type != .Text) return try parseUnquoted(allocator, inner, data_type);
+
+        // Strip the quotes and collapse '' escapes
+        const text = try allocator.alloc(u8, inner.len - std.mem.count(u8, inner, "''"));
+        var out: usize = 0;
+        var i: usize = 0;
+        while (i < inner.len) : (i += 1) {
+            text[out] = inner[i];
+            out += 1;
+            if (inner[i] == '\'') i += 1;
+        }
+        return Value{ .text = text };
+    }
+
+    if (literal.len == 0) return error.InvalidSyntax;
+    if (std.ascii.eqlIgnoreCase(literal, "NULL")) return Value{ .null = {} };
+
+    return try parseUnquoted(allocator, literal, data_type);
+}
+
+/// Parse an unquoted field according to the column type
+fn parseUnquoted(allocator: std.mem.Allocator, field: []const u8, data_type: DataType) !Value {
+    switch (data_type) {
+        .Int => {
+            const i = std.fmt.parseInt(i64, field, 10) catch return error.InvalidValue;
+            return Value{ .integer = i };
+        },
+        .Float => {
+            const f = std.fmt.parseFloat(f64, field) catch return error.InvalidValue;
+            return Value{ .float = f };
+        },
+        .Bool => {
+            if (std.ascii.eqlIgnoreCase(field, "true") or std.ascii.eqlIgnoreCase(field, "t") or std.mem.eql(u8, field, "1")) {
+                return Value{ .boolean = true };
+            }
+            if (std.ascii.eqlIgnoreCase(field, "false") or std.ascii.eqlIgnoreCase(field, "f") or std.mem.eql(u8, field, "0")) {
+                return Value{ .boolean = false };
+            }
+            return error.InvalidValue;
+        },
+        .Text => return Value{ .text = try allocator.dupe(u8, field) },
+    }
+}
+
+/// Append rows as a single INSERT statement that recovery can replay.
+/// Used to give each batch exactly one WAL record.
+pub fn writeInsertStatement(writer: anytype, table_name: []const u8, rows: []const []Value) !void {
+    try writer.print("INSERT INTO {s} VALUES ", .{table_name});
+    for (rows, 0..) |row, r| {
+        if (r > 0) try writer.writeAll(", ");
+        try writer.writeByte('(');
+        for (row, 0..) |val, c| {
+            if (c > 0) try writer.writeAll(", ");
+            switch (val) {
+                .integer => |i| try writer.print("{d}", .{i}),
+                .float => |f| try writer.print("{d}", .{f}),
+                .boolean => |b| try writer.writeAll(if (b) "true" else "false"),
+                .null => try writer.writeAll("NULL"),
+                .text => |t| {
+                    try writer.writeByte('\'');
+                    for (t) |ch| {
+                        if (ch == '\'') try writer.writeByte('\'');
+                        try writer.writeByte(ch);
+                    }
+                    try writer.writeByte('\'');
+                },
+            }
+        }
+        try writer.writeByte(')');
+    }
+}
+
+/// Rough size of a row once written by writeInsertStatement
+pub fn estimateRowBytes(row: []const Value) usize {
+    var size: usize = 4;
+    for (row) |val| {
+        size += switch (val) {
+            .text => |t| t.len + 4,
+            else => 24,
+        };
+    }
+    return size;
+}
+
+// ---------------------------------------------------------------------------
+// COPY table FROM 'file.csv'
+// ---------------------------------------------------------------------------
+
+/// A memory-mapped CSV file
+pub const MappedFile = struct {
+    data: []align(std.heap.page_size_min) const u8,
+    file: std.fs.File,
+
+    pub fn open(path: []const u8) !MappedFile {
+        const file = try std.fs.cwd().openFile(path, .{ .mode = .read_only });
+        errdefer file.close();
+
+        const size = try file.getEndPos();
+        if (size == 0) {
+            return MappedFile{ .data = &[_]u8{}, .file = file };
+        }
+
+        const data = try std.posix.mmap(
+            null,
+            size,
+            std.posix.PROT.READ,
+            .{ .TYPE = .PRIVATE },
+            file.handle,
+            0,
+        );
+        return MappedFile{ .data = data, .file = file };
+    }
+
+    pub fn close(self: *MappedFile) void {
+        if (self.data.len > 0) {
+            std.posix.munmap(self.data);
+        }
+        self.file.close();
+    }
+};
+
+/// Rows parsed from one chunk of a CSV file
+const ChunkResult = struct {
+    rows: std.ArrayList([]Value),
+    err: ?anyerror = null,
+    line_offset: usize = 0,
+};
+
+/// Parse CSV data into rows, splitting the input into line-aligned chunks that
+/// are parsed on separate threads. Row order is preserved.
+/// Quoted fields may contain commas and "" escapes but not newlines.
+/// Caller owns the returned rows and the values in them.
+pub fn parseCsvParallel(allocator: std.mem.Allocator, data: []const u8, columns: []const ColumnSchema, skip_header: bool) !std.ArrayList([]Value) {
+    var rows = std.ArrayList([]Value).init(allocator);
+    errdefer {
+        freeRows(allocator, rows.items);
+        rows.deinit();
+    }
+    try parseCsvChunks(allocator, data, columns, skip_header, &rows, appendChunk);
+    return rows;
+}
+
+fn appendChunk(rows: *std.ArrayList([]Value), chunk: [][]Value) !void {
+    rows.appendSlice(chunk) catch |err| {
+        freeRows(rows.allocator, chunk);
+        return err;
+    };
+}
+
+/// Parse CSV data in rounds of line-aligned chunks, one chunk per parser
+/// thread, and pass each chunk's rows to `sink(context, rows)` in file order
+/// before the next round starts. Only one round of rows is held at a time,
+/// so memory is bounded by the chunk size rather than the file size.
+/// `sink` takes ownership of the rows, also when it fails; a parse error
+/// stops before the rows of its round reach `sink`.
+pub fn parseCsvChunks(allocator: std.mem.Allocator, data: []const u8, columns: []const ColumnSchema, skip_header: bool, context: anytype, comptime sink: anytype) !void {
+    var body = data;
+    if (skip_header) {
+        const header_end = std.mem.indexOfScalar(u8, body, '\n') orelse body.len;
+        body = body[@min(header_end + 1, body.len)..];
+    }
+
+    const cpu_count = std.Thread.getCpuCount() catch 1;
+    const max_workers = @max(1, @min(cpu_count, max_parse_workers));
+
+    var bounds: [max_parse_workers + 1]usize = undefined;
+    bounds[0] = 0;
+    while (bounds[0] < body.len) {
+        // Cut up to one chunk per worker, each ending on a line boundary
+        var chunk_count: usize = 0;
+        while (chunk_count < max_workers and bounds[chunk_count] < body.len) : (chunk_count += 1) {
+            var cut = @min(bounds[chunk_count] + min_bytes_per_worker, body.len);
+            while (cut < body.len and body[cut - 1] != '\n') : (cut += 1) {}
+            bounds[chunk_count + 1] = cut;
+        }
+
+        var results: [max_parse_workers]ChunkResult = undefined;
+        for (results[0..chunk_count]) |*r| {
+            r.* = ChunkResult{ .rows = std.ArrayList([]Value).init(allocator) };
+        }
+        defer for (results[0..chunk_count]) |*r| {
+            freeRows(allocator, r.rows.items);
+            r.rows.deinit();
+        };
+
+        parseRound(allocator, body, bounds[0 .. chunk_count + 1], columns, results[0..chunk_count]);
+        for (results[0..chunk_count]) |*r| {
+            if (r.err) |err| return err;
+        }
+        for (results[0..chunk_count]) |*r| {
+            // The sink owns the rows from here on, whatever it returns
+            const rows = r.rows.items;
+            r.rows.clearRetainingCapacity();
+            if (rows.len > 0) try sink(context, rows);
+        }
+
+        bounds[0] = bounds[chunk_count];
+    }
+}
+
+/// Parse the chunks between consecutive `bounds`, one per thread
+fn parseRound(allocator: std.mem.Allocator, body: []const u8, bounds: []const usize, columns: []const ColumnSchema, results: []ChunkResult) void {
+    if (results.len == 1) {
+        parseCsvChunk(allocator, body[bounds[0]..bounds[1]], columns, &results[0]);
+        return;
+    }
+
+    var threads: [max_parse_workers]std.Thread = undefined;
+    var spawned: usize = 0;
+    for (results, 0..) |*r, i| {
+        const chunk = body[bounds[i]..bounds[i + 1]];
+        threads[i] = std.Thread.spawn(.{}, parseCsvChunk, .{ allocator, chunk, columns, r }) catch {
+            // Fall back to parsing this chunk on the calling thread
+            parseCsvChunk(allocator, chunk, columns, r);
+            continue;
+        };
+        spawned |= @as(usize, 1) << @intCast(i);
+    }
+    for (0..results.len) |i| {
+        if (spawned & (@as(usize, 1) << @intCast(i)) != 0) threads[i].join();
+    }
+}
+
+/// Parse one line-aligned chunk of CSV data. Errors are reported through `out.err`.
+fn parseCsvChunk(allocator: std.mem.Allocator, chunk: []const u8, columns: []const ColumnSchema, out: *ChunkResult) void {
+    var lines = std.mem.splitScalar(u8, chunk, '\n');
+    while (lines.next()) |raw_line| {
+        const line = std.mem.trimRight(u8, raw_line, "\r");
+        if (line.len == 0) continue;
+
+        const row = parseCsvLine(allocator, line, columns) catch |err| {
+            out.err = err;
+            return;
+        };
+        out.rows.append(row) catch |err| {
+            freeRow(allocator, row);
+            out.err = err;
+            return;
+        };
+    }
+}
+
+/// Parse one CSV record into a row
+fn parseCsvLine(allocator: std.mem.Allocator, line: []const u8, columns: []const ColumnSchema) ![]Value {
+    const row = try allocator.alloc(Value, columns.len);
+    var filled: usize = 0;
+    errdefer {
+        for (row[0..filled]) |val| {
+            if (val == .text) allocator.free(val.text);
+        }
+        allocator.free(row);
+    }
+
+    var pos: usize = 0;
+    while (true) {
+        if (filled >= columns.len) return error.ColumnCountMismatch;
+
+        if (pos < line.len and line[pos] == '"') {
+            // Quoted field: "" is an escaped quote
+            pos += 1;
+            const start = pos;
+            var escapes: usize = 0;
+            while (pos < line.len) : (pos += 1) {
+                if (line[pos] == '"') {
+                    if (pos + 1 < line.len and line[pos + 1] == '"') {
+                        escapes += 1;
+                        pos += 1;
+                        continue;
+                    }
+                    break;
+                }
+            }
+            if (pos >= line.len) return error.InvalidSyntax;
+            const raw = line[start..pos];
+            pos += 1;
+
+            if (columns[filled].data_type == .Text) {
+                const text = try allocator.alloc(u8, raw.len - escapes);
+                var out: usize = 0;
+                var i: usize = 0;
+                while (i < raw.len) : (i += 1) {
+                    text[out] = raw[i];
+                    out += 1;
+                    if (raw[i] == '"') i += 1;
+                }
+                row[filled] = Value{ .text = text };
+            } else {
+                row[filled] = try parseUnquoted(allocator, std.mem.trim(u8, raw, " \t"), columns[filled].data_type);
+            }
+        } else {
+            const start = pos;
+            while (pos < line.len and line[pos] != ',') : (pos += 1) {}
+            const field = line[start..pos];
+            // An empty unquoted field is NULL
+            row[filled] = if (field.len == 0)
+                Value{ .null = {} }
+            else
+                try parseUnquoted(allocator, field, columns[filled].data_type);
+        }
+        filled += 1;
+
+        if (pos >= line.len) break;
+        if (line[pos] != ',') return error.InvalidSyntax;
+        pos += 1;
+    }
+
+    if (filled != columns.len) return error.ColumnCountMismatch;
+    return row;
+}
+
+test "parseValuesList handles multiple rows and quoted commas" {
+    const allocator = std.testing.allocator;
+    const columns = [_]ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "name", .data_type = .Text },
+        .{ .name = "score", .data_type = .Float },
+    };
+
+    var rows = try parseValuesList(allocator, "(1, 'Smith, John', 1.5), (2, 'O''Brien', 2), (3, NULL, NULL);", &columns);
+    defer {
+        freeRows(allocator, rows.items);
+        rows.deinit();
+    }
+
+    try std.testing.expectEqual(@as(usize, 3), rows.items.len);
+    try std.testing.expectEqual(@as(i64, 1), rows.items[0][0].integer);
+    try std.testing.expectEqualStrings("Smith, John", rows.items[0][1].text);
+    try std.testing.expectEqual(@as(f64, 1.5), rows.items[0][2].float);
+    try std.testing.expectEqualStrings("O'Brien", rows.items[1][1].text);
+    try std.testing.expectEqual(@as(f64, 2.0), rows.items[1][2].float);
+    try std.testing.expect(rows.items[2][1] == .null);
+
+    try std.testing.expectError(error.ColumnCountMismatch, parseValuesList(allocator, "(1, 'a')", &columns));
+}
+
+test "integer columns reject float literals" {
+    const allocator = std.testing.allocator;
+    const columns = [_]ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "score", .data_type = .Float },
+    };
+
+    try std.testing.expectError(error.InvalidValue, parseValuesList(allocator, "(1.5, 2.5)", &columns));
+    try std.testing.expectError(error.InvalidValue, parseCsvParallel(allocator, "2.0,1\n", &columns, false));
+}
+
+test "quoted literals follow the column type" {
+    const allocator = std.testing.allocator;
+    const columns = [_]ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "score", .data_type = .Float },
+        .{ .name = "active", .data_type = .Bool },
+        .{ .name = "name", .data_type = .Text },
+    };
+
+    var rows = try parseValuesList(allocator, "('5', '2.5', 'true', '7')", &columns);
+    defer {
+        freeRows(allocator, rows.items);
+        rows.deinit();
+    }
+    try std.testing.expectEqual(@as(i64, 5), rows.items[0][0].integer);
+    try std.testing.expectEqual(@as(f64, 2.5), rows.items[0][1].float);
+    try std.testing.expect(rows.items[0][2].boolean);
+    try std.testing.expectEqualStrings("7", rows.items[0][3].text);
+
+    try std.testing.expectError(error.InvalidValue, parseValuesList(allocator, "('five', 1, true, 'x')", &columns));
+}
+
+test "parseCsvParallel parses quoted fields and preserves order" {
+    const allocator = std.testing.allocator;
+    const columns = [_]ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "name", .data_type = .Text },
+        .{ .name = "active", .data_type = .Bool },
+    };
+
+    const csv = "id,name,active\r\n1,\"Doe, Jane\",true\r\n2,plain,false\n3,\"say \"\"hi\"\"\",\n";
+    var rows = try parseCsvParallel(allocator, csv, &columns, true);
+    defer {
+        freeRows(allocator, rows.items);
+        rows.deinit();
+    }
+
+    try std.testing.expectEqual(@as(usize, 3), rows.items.len);
+    try std.testing.expectEqualStrings("Doe, Jane", rows.items[0][1].text);
+    try std.testing.expectEqual(true, rows.items[0][2].boolean);
+    try std.testing.expectEqual(@as(i64, 2), rows.items[1][0].integer);
+    try std.testing.expectEqualStrings("say \"hi\"", rows.items[2][1].text);
+    try std.testing.expect(rows.items[2][2] == .null);
+}
+
+test "parseCsvChunks hands rows over in file order" {
+    const allocator = std.testing.allocator;
+    const columns = [_]ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "note", .data_type = .Text },
+    };
+
+    // Enough lines for several chunks
+    var csv = std.ArrayList(u8).init(allocator);
+    defer csv.deinit();
+    const line_count = 3 * min_bytes_per_worker / 100;
+    for (0..line_count) |i| try csv.writer().print("{d},{s}\n", .{ i, "x" ** 90 });
+
+    const Counter = struct {
+        allocator: std.mem.Allocator,
+        next_id: i64 = 0,
+        calls: usize = 0,
+
+        fn take(self: *@This(), rows: [][]Value) !void {
+            defer freeRows(self.allocator, rows);
+            self.calls += 1;
+            for (rows) |row| {
+                try std.testing.expectEqual(self.next_id, row[0].integer);
+                self.next_id += 1;
+            }
+        }
+    };
+    var counter = Counter{ .allocator = allocator };
+    try parseCsvChunks(allocator, csv.items, &columns, false, &counter, Counter.take);
+    try std.testing.expectEqual(@as(i64, @intCast(line_count)), counter.next_id);
+    try std.testing.expect(counter.calls > 1);
+}
+
+test "writeInsertStatement round trips through parseValuesList" {
+    const allocator = std.testing.allocator;
+    const columns = [_]ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "name", .data_type = .Text },
+    };
+
+    var rows = try parseValuesList(allocator, "(1, 'it''s'), (2, 'a, b')", &columns);
+    defer {
+        freeRows(allocator, rows.items);
+        rows.deinit();
+    }
+
+    var statement = std.ArrayList(u8).init(allocator);
+    defer statement.deinit();
+    try writeInsertStatement(statement.writer(), "t", rows.items);
+
+    const values_start = std.mem.indexOf(u8, statement.items, "VALUES").? + "VALUES".len;
+    var reparsed = try parseValuesList(allocator, statement.items[values_start..], &columns);
+    defer {
+        freeRows(allocator, reparsed.items);
+        reparsed.deinit();
+    }
+
+    try std.testing.expectEqualStrings("it's", reparsed.items[0][1].text);
+    try std.testing.expectEqualStrings("a, b", reparsed.items[1][1].text);
+}
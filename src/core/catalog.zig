@@ -0,0 +1,297 @@
+const std = @import("std");
+const TableSchema = @import("database.zig").TableSchema;
+const Index = @import("../storage/index.zig").Index;
+
+/// A (table, column) pair, hashed as one key
+pub const ColumnKey = struct {
+    table: []const u8,
+    column: []const u8,
+};
+
+pub const ColumnKeyContext = struct {
+    pub fn hash(_: ColumnKeyContext, key: ColumnKey) u64 {
+        var hasher = std.hash.Wyhash.init(0);
+        hasher.update(key.table);
+        hasher.update(&[_]u8{0}); // Keeps ("ab", "c") apart from ("a", "bc")
+        hasher.update(key.column);
+        return hasher.final();
+    }
+
+    pub fn eql(_: ColumnKeyContext, a: ColumnKey, b: ColumnKey) bool {
+        return std.mem.eql(u8, a.table, b.table) and std.mem.eql(u8, a.column, b.column);
+    }
+};
+
+pub fn ColumnKeyMap(comptime V: type) type {
+    return std.HashMapUnmanaged(ColumnKey, V, ColumnKeyContext, std.hash_map.default_max_load_percentage);
+}
+
+/// An index registered on one column
+pub const IndexEntry = struct {
+    name: []const u8,
+    table_name: []const u8,
+    column_name: []const u8,
+    index_type: Index.IndexType,
+};
+
+/// Everything the planner knows about one column
+pub const ColumnEntry = struct {
+    table: *TableSchema,
+    ordinal: usize, // Position in table.columns
+    indexes: []const IndexEntry = &.{},
+    distinct_values: ?u64 = null, // Statistics, when known
+};
+
+/// One immutable version of the catalog. Its maps are allocated from its own
+/// arena and never change after it is published.
+pub const Version = struct {
+    arena: std.heap.ArenaAllocator,
+    refs: std.atomic.Value(usize) = std.atomic.Value(usize).init(1), // The catalog's own while current
+    tables: std.StringHashMapUnmanaged(*TableSchema) = .{},
+    columns: ColumnKeyMap(ColumnEntry) = .{},
+    index_count: usize = 0,
+
+    pub fn getTable(self: *const Version, name: []const u8) ?*TableSchema {
+        return self.tables.get(name);
+    }
+
+    pub fn getColumn(self: *const Version, table_name: []const u8, column_name: []const u8) ?ColumnEntry {
+        return self.columns.get(ColumnKey{ .table = table_name, .column = column_name });
+    }
+
+    /// Indexes on a column, found with one hash lookup
+    pub fn indexesFor(self: *const Version, table_name: []const u8, column_name: []const u8) []const IndexEntry {
+        const column = self.getColumn(table_name, column_name) orelse return &.{};
+        return column.indexes;
+    }
+
+    pub fn tableCount(self: *const Version) usize {
+        return self.tables.count();
+    }
+
+    pub fn tableIterator(self: *const Version) std.StringHashMapUnmanaged(*TableSchema).Iterator {
+        return self.tables.iterator();
+    }
+};
+
+/// Catalog of tables, columns, indexes and statistics with RCU-style reads.
+/// A published version is immutable: DDL copies the current version, changes
+/// the copy and swaps an atomic pointer. Queries pin the version they plan and
+/// run against with acquire()/release(), which never block; a version that was
+/// replaced is freed by a later DDL once no query holds it.
+pub const Catalog = struct {
+    allocator: std.mem.Allocator,
+    current: std.atomic.Value(*Version),
+    // Readers between loading `current` and taking their reference. While any
+    // are, a replaced version may be about to gain one and is not freed.
+    acquiring: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+    write_mutex: std.Thread.Mutex = .{}, // Serializes DDL, never taken by readers
+    retired: std.ArrayListUnmanaged(*Version) = .{},
+    names: std.heap.ArenaAllocator, // Index names; indexes are never dropped
+
+    pub fn init(allocator: std.mem.Allocator) !Catalog {
+        const empty = try allocator.create(Version);
+        empty.* = Version{ .arena = std.heap.ArenaAllocator.init(allocator) };
+        return Catalog{
+            .allocator = allocator,
+            .current = std.atomic.Value(*Version).init(empty),
+            .names = std.heap.ArenaAllocator.init(allocator),
+        };
+    }
+
+    /// Free every version. No query may still hold one. The tables themselves
+    /// belong to the caller.
+    pub fn deinit(self: *Catalog) void {
+        self.destroyVersion(self.current.load(.seq_cst));
+        for (self.retired.items) |version| self.destroyVersion(version);
+        self.retired.deinit(self.allocator);
+        self.names.deinit();
+    }
+
+    /// Pin the current version, e.g. for the duration of a query
+    pub fn acquire(self: *Catalog) *const Version {
+        _ = self.acquiring.fetchAdd(1, .seq_cst);
+        defer _ = self.acquiring.fetchSub(1, .seq_cst);
+        const version = self.current.load(.seq_cst);
+        _ = version.refs.fetchAdd(1, .seq_cst);
+        return version;
+    }
+
+    pub fn release(_: *Catalog, version: *const Version) void {
+        _ = @constCast(version).refs.fetchSub(1, .seq_cst);
+    }
+
+    /// Look up a table. Tables are never dropped, so the pointer outlives the
+    /// version it was found in.
+    pub fn get(self: *Catalog, name: []const u8) ?*TableSchema {
+        const version = self.acquire();
+        defer self.release(version);
+        return version.getTable(name);
+    }
+
+    pub fn count(self: *Catalog) usize {
+        const version = self.acquire();
+        defer self.release(version);
+        return version.tableCount();
+    }
+
+    /// Publish a version that also holds `schema` and its columns
+    pub fn addTable(self: *Catalog, schema: *TableSchema) !void {
+        self.write_mutex.lock();
+        defer self.write_mutex.unlock();
+
+        if (self.current.load(.seq_cst).tables.contains(schema.name)) return error.TableAlreadyExists;
+        const next = try self.cloneCurrent();
+        errdefer self.destroyVersion(next);
+        const arena = next.arena.allocator();
+
+        try next.tables.put(arena, schema.name, schema);
+        for (schema.columns, 0..) |column, ordinal| {
+            try next.columns.put(arena, ColumnKey{ .table = schema.name, .column = column.name }, ColumnEntry{
+                .table = schema,
+                .ordinal = ordinal,
+            });
+        }
+        self.publish(next);
+    }
+
+    /// Publish a version with an index on `table_name.column_name`. A known
+    /// number of distinct values is recorded as the column's statistics.
+    pub fn addIndex(self: *Catalog, index_name: []const u8, table_name: []const u8, column_name: []const u8, index_type: Index.IndexType, distinct_values: ?u64) !void {
+        self.write_mutex.lock();
+        defer self.write_mutex.unlock();
+
+        const column = try self.findColumn(table_name, column_name);
+        for (column.indexes) |index| {
+            if (std.mem.eql(u8, index.name, index_name)) return error.IndexAlreadyExists;
+        }
+        const index = IndexEntry{
+            .name = try self.names.allocator().dupe(u8, index_name),
+            .table_name = column.table.name,
+            .column_name = column.table.columns[column.ordinal].name,
+            .index_type = index_type,
+        };
+
+        const next = try self.cloneCurrent();
+        errdefer self.destroyVersion(next);
+        const entry = next.columns.getPtr(ColumnKey{ .table = table_name, .column = column_name }).?;
+        const indexes = try next.arena.allocator().alloc(IndexEntry, entry.indexes.len + 1);
+        @memcpy(indexes[0..entry.indexes.len], entry.indexes);
+        indexes[entry.indexes.len] = index;
+        entry.indexes = indexes;
+        if (distinct_values) |distinct| entry.distinct_values = distinct;
+        next.index_count += 1;
+        self.publish(next);
+    }
+
+    /// Publish a version with new statistics for a column
+    pub fn setColumnStatistics(self: *Catalog, table_name: []const u8, column_name: []const u8, distinct_values: u64) !void {
+        self.write_mutex.lock();
+        defer self.write_mutex.unlock();
+
+        _ = try self.findColumn(table_name, column_name);
+        const next = try self.cloneCurrent();
+        errdefer self.destroyVersion(next);
+        next.columns.getPtr(ColumnKey{ .table = table_name, .column = column_name }).?.distinct_values = distinct_values;
+        self.publish(next);
+    }
+
+    fn findColumn(self: *Catalog, table_name: []const u8, column_name: []const u8) !ColumnEntry {
+        const version = self.current.load(.seq_cst);
+        return version.getColumn(table_name, column_name) orelse
+            return if (version.getTable(table_name) == null) error.TableNotFound else error.ColumnNotFound;
+    }
+
+    /// Copy the current version into a new, unpublished one. Caller holds write_mutex.
+    fn cloneCurrent(self: *Catalog) !*Version {
+        try self.retired.ensureUnusedCapacity(self.allocator, 1);
+        const old = self.current.load(.seq_cst);
+
+        const next = try self.allocator.create(Version);
+        next.* = Version{ .arena = std.heap.ArenaAllocator.init(self.allocator), .index_count = old.index_count };
+        errdefer self.destroyVersion(next);
+        const arena = next.arena.allocator();
+
+        next.tables = try old.tables.clone(arena);
+        next.columns = try old.columns.clone(arena);
+        // Index lists live in the old version's arena, so they are copied too
+        var it = next.columns.valueIterator();
+        while (it.next()) |column| {
+            if (column.indexes.len > 0) column.indexes = try arena.dupe(IndexEntry, column.indexes);
+        }
+        return next;
+    }
+
+    /// Make `next` current. Caller holds write_mutex and got `next` from cloneCurrent.
+    fn publish(self: *Catalog, next: *Version) void {
+        const old = self.current.swap(next, .seq_cst);
+        _ = old.refs.fetchSub(1, .seq_cst);
+        self.retired.appendAssumeCapacity(old);
+        self.reclaim();
+    }
+
+    /// Free replaced versions that no query holds. A reader that loaded one
+    /// before it was replaced but has not taken its reference yet is counted
+    /// in `acquiring`, so nothing is freed while any reader is in that window.
+    fn reclaim(self: *Catalog) void {
+        if (self.acquiring.load(.seq_cst) != 0) return;
+        var i: usize = 0;
+        while (i < self.retired.items.len) {
+            const version = self.retired.items[i];
+            if (version.refs.load(.seq_cst) == 0) {
+                _ = self.retired.swapRemove(i);
+                self.destroyVersion(version);
+            } else {
+                i += 1;
+            }
+        }
+    }
+
+    fn destroyVersion(self: *Catalog, version: *Version) void {
+        version.arena.deinit();
+        self.allocator.destroy(version);
+    }
+};
+
+test "Catalog queries keep the version they pinned" {
+    const allocator = std.testing.allocator;
+    var catalog = try Catalog.init(allocator);
+    defer catalog.deinit();
+
+    var columns = [_]@import("database.zig").ColumnSchema{
+        .{ .name = "id", .data_type = .Int },
+        .{ .name = "email", .data_type = .Text },
+    };
+    var users: TableSchema = undefined;
+    users.name = "users";
+    users.columns = &columns;
+    var events: TableSchema = undefined;
+    events.name = "events";
+    events.columns = columns[0..1];
+
+    try catalog.addTable(&users);
+    const pinned = catalog.acquire();
+    try catalog.addTable(&events);
+    try catalog.addIndex("idx_users_email", "users", "email", .BTree, 900);
+    try std.testing.expectError(error.TableAlreadyExists, catalog.addTable(&users));
+    try std.testing.expectError(error.ColumnNotFound, catalog.addIndex("idx", "users", "name", .BTree, null));
+    try std.testing.expectError(error.IndexAlreadyExists, catalog.addIndex("idx_users_email", "users", "email", .SkipList, null));
+
+    // The pinned version is unchanged and still readable after two DDLs
+    try std.testing.expectEqual(@as(usize, 1), pinned.tableCount());
+    try std.testing.expectEqual(@as(usize, 0), pinned.indexesFor("users", "email").len);
+    catalog.release(pinned);
+
+    const latest = catalog.acquire();
+    defer catalog.release(latest);
+    try std.testing.expectEqual(@as(usize, 2), latest.tableCount());
+    const email = latest.getColumn("users", "email").?;
+    try std.testing.expectEqual(@as(usize, 1), email.ordinal);
+    try std.testing.expectEqual(@as(?u64, 900), email.distinct_values);
+    try std.testing.expectEqualStrings("idx_users_email", latest.indexesFor("users", "email")[0].name);
+    try std.testing.expectEqual(&events, catalog.get("events").?);
+
+    // Released versions are freed by the next DDL
+    try catalog.setColumnStatistics("events", "id", 10);
+    try std.testing.expectEqual(@as(usize, 1), catalog.retired.items.len);
+}
@@ -5,23 +5,252 @@ const c = @import("../storage/rocksdb_c.zig");
 const WAL = @import("../storage/wal.zig").WAL;
 const planner = @import("../query/planner.zig");
 const QueryPlanner = planner.QueryPlanner;
-const QueryExecutor = @import("../query/executor.zig").QueryExecutor;
-const DatabaseContext = @import("../query/executor.zig").DatabaseContext;
+const executor = @import("../query/executor.zig");
+const QueryExecutor = executor.QueryExecutor;
+const DatabaseContext = executor.DatabaseContext;
 const transaction_manager = @import("../transaction/manager.zig");
 const TransactionManager = transaction_manager.TransactionManager;
 const Transaction = transaction_manager.Transaction;
+const Snapshot = transaction_manager.Snapshot;
+const lock_manager = @import("../transaction/lock_manager.zig");
 const ResultSet = @import("../query/result.zig").ResultSet;
 const assert = @import("../build_options.zig").assert;
+const bulk_load = @import("bulk_load.zig");
+const column_segment = @import("../storage/column_segment.zig");
+const RowSegment = column_segment.RowSegment;
+const ZoneMap = @import("../storage/zone_map.zig").ZoneMap;
+const Catalog = @import("catalog.zig").Catalog;
+const Index = @import("../storage/index.zig").Index;
 
 pub const TableSchema = struct {
     name: []const u8,
     columns: []ColumnSchema,
-    rows: std.ArrayList([]Value), // Each row is an array of Value
+    rows: std.ArrayList([]Value), // Unsealed tail rows, each an array of Value
+    tail_begin_ts: std.ArrayList(u64), // Commit timestamp that created each tail row
+    tail_end_ts: std.ArrayList(u64), // Commit timestamp that deleted each tail row, or live_ts
+    segments: std.ArrayList(*RowSegment), // Sealed, compressed blocks of rows in insert order
+    tail_zone_maps: []ZoneMap, // Per-column min/max of the tail rows, updated on insert
+    segment_rows: usize = column_segment.default_segment_rows,
+    dead_versions: usize = 0, // Deleted row versions not yet reclaimed
+    // Scans hold it shared; appends, deletes and garbage collection hold it
+    // exclusively while they change the rows, segments and version arrays
+    latch: std.Thread.RwLock = .{},
+
+    /// A DELETE collects its table once this many versions are dead, and at
+    /// least one in `gc_dead_version_divisor` of them. Collection re-encodes
+    /// every segment holding a dead version, so it is paid for in batches.
+    pub const gc_min_dead_versions = 1024;
+    pub const gc_dead_version_divisor = 8;
+
+    /// Total number of row versions in sealed segments and the tail,
+    /// including deleted versions not yet garbage collected
+    pub fn rowCount(self: *const TableSchema) usize {
+        var count = self.rows.items.len;
+        for (self.segments.items) |segment| {
+            count += segment.row_count;
+        }
+        return count;
+    }
+
+    /// Whether enough versions are dead to be worth collecting.
+    /// The caller holds `latch`.
+    pub fn needsGarbageCollection(self: *const TableSchema) bool {
+        return self.dead_versions >= @max(gc_min_dead_versions, self.rowCount() / gc_dead_version_divisor);
+    }
+
+    /// Compress full blocks of tail rows into column segments
+    pub fn sealFullSegments(self: *TableSchema) !void {
+        const allocator = self.rows.allocator;
+
+        while (self.rows.items.len >= self.segment_rows) {
+            const n = self.segment_rows;
+            const sealed = self.rows.items[0..n];
+            const segment = try RowSegment.create(allocator, sealed, self.columns, self.tail_begin_ts.items[0..n], self.tail_end_ts.items[0..n]);
+            errdefer segment.release(allocator);
+            try self.segments.append(segment);
+
+            // The segment holds its own copies, so release the row storage
+            for (sealed) |row| {
+                freeRow(allocator, row);
+            }
+            self.dropTailPrefix(n);
+
+            // The old bounds pointed into the freed rows
+            self.rebuildTailZoneMaps();
+        }
+    }
+
+    /// Reserve tail space so that appending `n` rows cannot fail
+    pub fn ensureUnusedTailCapacity(self: *TableSchema, n: usize) !void {
+        try self.rows.ensureUnusedCapacity(n);
+        try self.tail_begin_ts.ensureUnusedCapacity(n);
+        try self.tail_end_ts.ensureUnusedCapacity(n);
+    }
+
+    /// Append rows created by the commit at `commit_ts`, taking ownership of them
+    pub fn appendTailAssumeCapacity(self: *TableSchema, rows: []const []Value, commit_ts: u64) void {
+        self.rows.appendSliceAssumeCapacity(rows);
+        self.tail_begin_ts.appendNTimesAssumeCapacity(commit_ts, rows.len);
+        self.tail_end_ts.appendNTimesAssumeCapacity(transaction_manager.live_ts, rows.len);
+        self.updateTailZoneMaps(rows);
+    }
+
+    /// Widen the tail zone maps with newly appended rows
+    pub fn updateTailZoneMaps(self: *TableSchema, rows: []const []Value) void {
+        for (rows) |row| {
+            for (row, self.tail_zone_maps) |val, *zone| {
+                zone.update(val);
+            }
+        }
+    }
+
+    fn rebuildTailZoneMaps(self: *TableSchema) void {
+        @memset(self.tail_zone_maps, ZoneMap{});
+        self.updateTailZoneMaps(self.rows.items);
+    }
+
+    /// Remove the first `n` tail rows and their versions; the rows must already be freed
+    fn dropTailPrefix(self: *TableSchema, n: usize) void {
+        const remaining = self.rows.items.len - n;
+        std.mem.copyForwards([]Value, self.rows.items[0..remaining], self.rows.items[n..]);
+        std.mem.copyForwards(u64, self.tail_begin_ts.items[0..remaining], self.tail_begin_ts.items[n..]);
+        std.mem.copyForwards(u64, self.tail_end_ts.items[0..remaining], self.tail_end_ts.items[n..]);
+        self.rows.shrinkRetainingCapacity(remaining);
+        self.tail_begin_ts.shrinkRetainingCapacity(remaining);
+        self.tail_end_ts.shrinkRetainingCapacity(remaining);
+    }
+
+    /// Physically remove row versions deleted at or before `oldest_read_ts`,
+    /// which no current or future snapshot can see. Returns the number removed.
+    pub fn collectGarbage(self: *TableSchema, oldest_read_ts: u64) !usize {
+        const allocator = self.rows.allocator;
+        var reclaimed: usize = 0;
+
+        // Compact the tail in place
+        var kept: usize = 0;
+        for (self.rows.items, self.tail_begin_ts.items, self.tail_end_ts.items) |row, begin_ts, end_ts| {
+            if (end_ts <= oldest_read_ts) {
+                freeRow(allocator, row);
+                continue;
+            }
+            self.rows.items[kept] = row;
+            self.tail_begin_ts.items[kept] = begin_ts;
+            self.tail_end_ts.items[kept] = end_ts;
+            kept += 1;
+        }
+        if (kept < self.rows.items.len) {
+            reclaimed += self.rows.items.len - kept;
+            self.rows.shrinkRetainingCapacity(kept);
+            self.tail_begin_ts.shrinkRetainingCapacity(kept);
+            self.tail_end_ts.shrinkRetainingCapacity(kept);
+            self.rebuildTailZoneMaps();
+        }
+
+        // Re-encode segments that hold reclaimable versions; drop those left empty
+        var s: usize = 0;
+        while (s < self.segments.items.len) {
+            const segment = self.segments.items[s];
+            if (!segment.versions.hasReclaimable(oldest_read_ts)) {
+                s += 1;
+                continue;
+            }
+
+            const survivors = try self.survivingRows(segment, oldest_read_ts);
+            defer survivors.deinit(allocator);
+            reclaimed += segment.row_count - survivors.rows.len;
+
+            if (survivors.rows.len == 0) {
+                _ = self.segments.orderedRemove(s);
+                segment.release(allocator);
+                continue;
+            }
+            // The survivors borrow text from the old segment, so build before releasing it.
+            // Results still viewing the old segment keep it alive until they are freed.
+            self.segments.items[s] = try RowSegment.create(allocator, survivors.rows, self.columns, survivors.begin_ts, survivors.end_ts);
+            segment.release(allocator);
+            s += 1;
+        }
+
+        self.dead_versions -|= reclaimed;
+        return reclaimed;
+    }
+
+    /// Rows of a segment that must be kept, decoded with borrowed text
+    const SurvivingRows = struct {
+        values: []Value,
+        rows: [][]Value,
+        begin_ts: []u64,
+        end_ts: []u64,
+
+        fn deinit(self: SurvivingRows, allocator: std.mem.Allocator) void {
+            allocator.free(self.values);
+            allocator.free(self.rows);
+            allocator.free(self.begin_ts);
+            allocator.free(self.end_ts);
+        }
+    };
+
+    fn survivingRows(self: *const TableSchema, segment: *const RowSegment, oldest_read_ts: u64) !SurvivingRows {
+        const allocator = self.rows.allocator;
+        var count: usize = 0;
+        for (0..segment.row_count) |r| {
+            if (segment.versions.endTs(r) > oldest_read_ts) count += 1;
+        }
+
+        const values = try allocator.alloc(Value, count * self.columns.len);
+        errdefer allocator.free(values);
+        const rows = try allocator.alloc([]Value, count);
+        errdefer allocator.free(rows);
+        const begin_ts = try allocator.alloc(u64, count);
+        errdefer allocator.free(begin_ts);
+        const end_ts = try allocator.alloc(u64, count);
+
+        var out: usize = 0;
+        for (0..segment.row_count) |r| {
+            if (segment.versions.endTs(r) <= oldest_read_ts) continue;
+            rows[out] = values[out * self.columns.len .. (out + 1) * self.columns.len];
+            for (segment.columns, rows[out]) |*col, *val| val.* = col.get(r);
+            begin_ts[out] = segment.versions.beginTs(r);
+            end_ts[out] = segment.versions.endTs(r);
+            out += 1;
+        }
+
+        return SurvivingRows{ .values = values, .rows = rows, .begin_ts = begin_ts, .end_ts = end_ts };
+    }
+};
+
+fn freeRow(allocator: std.mem.Allocator, row: []Value) void {
+    for (row) |val| {
+        if (val == .text) allocator.free(val.text);
+    }
+    allocator.free(row);
+}
+
+/// Append one write to the body of a TXN: WAL record as `<len>:<record>`
+pub fn writeTransactionRecord(writer: anytype, record: []const u8) !void {
+    try writer.print("{d}:", .{record.len});
+    try writer.writeAll(record);
+}
+
+/// Splits the body of a TXN: WAL record back into the records it frames
+pub const TransactionRecordIterator = struct {
+    data: []const u8,
+
+    pub fn next(self: *TransactionRecordIterator) !?[]const u8 {
+        if (self.data.len == 0) return null;
+        const colon = std.mem.indexOfScalar(u8, self.data, ':') orelse return error.CorruptTransactionRecord;
+        const len = std.fmt.parseInt(usize, self.data[0..colon], 10) catch return error.CorruptTransactionRecord;
+        if (self.data.len - colon - 1 < len) return error.CorruptTransactionRecord;
+        const record = self.data[colon + 1 .. colon + 1 + len];
+        self.data = self.data[colon + 1 + len ..];
+        return record;
+    }
 };
 
 pub const ColumnSchema = struct {
     name: []const u8,
     data_type: DataType,
+    bloom_filter: bool = false, // Build a Bloom filter per sealed segment (BLOOM column option)
 
     pub const DataType = enum {
         Int,
@@ -63,9 +292,12 @@ pub const OLAPDatabase = struct {
     query_planner: *QueryPlanner,
     txn_manager: *TransactionManager,
     db_context: *DatabaseContext,
-    table_schemas: std.StringHashMap(*TableSchema),
-    next_txn_id: u64 = 1, // Track next transaction ID
+    table_schemas: Catalog,
+    next_txn_id: std.atomic.Value(u64) = std.atomic.Value(u64).init(1), // Id of the next WAL record
     is_recovering: bool = false, // Prevent WAL logging during recovery
+    // Serializes writers from WAL append through publishing the commit, so
+    // commits become visible in timestamp order and never half-applied
+    write_mutex: std.Thread.Mutex = .{},
 
     pub const Error = error{
         TableNotFound,
@@ -75,40 +307,80 @@ pub const OLAPDatabase = struct {
 
     /// Get the next transaction ID
     fn getNextTxnId(self: *OLAPDatabase) u64 {
-        const id = self.next_txn_id;
-        self.next_txn_id += 1;
-        return id;
+        return self.next_txn_id.fetchAdd(1, .monotonic);
     }
 
     /// Recover table schemas and data from WAL
     fn recoverFromWAL(self: *OLAPDatabase) !void {
         self.is_recovering = true;
         defer self.is_recovering = false;
-        // Get all transactions from WAL
-        var it = self.wal.transactions.iterator();
+        // Get all transactions from WAL, replayed in log order so tables exist
+        // before the batches that insert into them
+        var txn_ids = std.ArrayList(u64).init(self.allocator);
+        defer txn_ids.deinit();
+        var it = self.wal.transactions.keyIterator();
+        while (it.next()) |txn_id| {
+            try txn_ids.append(txn_id.*);
+        }
+        std.mem.sort(u64, txn_ids.items, {}, std.sort.asc(u64));
+        if (txn_ids.items.len > 0) {
+            _ = self.next_txn_id.fetchMax(txn_ids.items[txn_ids.items.len - 1] + 1, .monotonic);
+        }
+
         var replay_count: usize = 0;
-        while (it.next()) |entry| {
-            const txn_data = entry.value_ptr.*;
+        for (txn_ids.items) |txn_id| {
+            const txn_data = self.wal.transactions.get(txn_id) orelse continue;
             std.debug.print("[WAL RECOVERY] Replaying WAL entry: {s}\n", .{txn_data});
             replay_count += 1;
-            // Parse transaction data
-            if (std.mem.startsWith(u8, txn_data, "CREATE_TABLE:")) {
-                var parts = std.mem.splitSequence(u8, txn_data[13..], ":");
-                _ = parts.next() orelse continue; // table_name
-                const query = parts.next() orelse continue;
-                std.debug.print("[WAL RECOVERY] Executing CREATE TABLE: {s}\n", .{query});
-                _ = try self.execute(query);
-            } else if (std.mem.startsWith(u8, txn_data, "INSERT:")) {
-                var parts = std.mem.splitSequence(u8, txn_data[7..], ":");
-                _ = parts.next() orelse continue; // table_name
-                const query = parts.next() orelse continue;
-                std.debug.print("[WAL RECOVERY] Executing INSERT: {s}\n", .{query});
-                _ = try self.execute(query);
-            }
+            try self.replayRecord(txn_data);
         }
         std.debug.print("[WAL RECOVERY] Total WAL entries replayed: {}\n", .{replay_count});
     }
 
+    /// Re-apply one WAL record
+    fn replayRecord(self: *OLAPDatabase, txn_data: []const u8) !void {
+        if (std.mem.startsWith(u8, txn_data, "TXN:")) {
+            // An explicit transaction: every write it made, framed by length
+            var records = TransactionRecordIterator{ .data = txn_data[4..] };
+            while (try records.next()) |record| {
+                try self.replayStatement(record);
+            }
+        } else {
+            try self.replayStatement(txn_data);
+        }
+    }
+
+    fn replayStatement(self: *OLAPDatabase, txn_data: []const u8) !void {
+        // CREATE_TABLE:, INSERT: and DELETE: records carry the table name, then the statement
+        const kind_end = std.mem.indexOfScalar(u8, txn_data, ':') orelse return;
+        const kind = txn_data[0..kind_end];
+        if (!std.mem.eql(u8, kind, "CREATE_TABLE") and !std.mem.eql(u8, kind, "INSERT") and !std.mem.eql(u8, kind, "DELETE")) return;
+        const rest = txn_data[kind_end + 1 ..];
+        const sep = std.mem.indexOfScalar(u8, rest, ':') orelse return; // after table_name
+        const query = rest[sep + 1 ..];
+        std.debug.print("[WAL RECOVERY] Executing {s}: {s}\n", .{ kind, query });
+        _ = try self.execute(query);
+    }
+
+    /// Start a write. Writers run one at a time; the returned commit timestamp
+    /// stays invisible to snapshots until `endWrite` publishes it, so readers
+    /// never observe a partly applied commit.
+    pub fn beginWrite(self: *OLAPDatabase) u64 {
+        self.write_mutex.lock();
+        return self.txn_manager.allocateCommitTimestamp();
+    }
+
+    pub fn endWrite(self: *OLAPDatabase, commit_ts: u64) void {
+        self.txn_manager.publishCommit(commit_ts);
+        self.write_mutex.unlock();
+    }
+
+    /// Write one record to the WAL unless the database is replaying it
+    pub fn logRecord(self: *OLAPDatabase, data: []const u8) !void {
+        if (self.is_recovering) return;
+        try self.wal.logTransaction(self.getNextTxnId(), data);
+    }
+
     /// Execute a SQL query and return a result set
     pub fn execute(self: *OLAPDatabase, query: []const u8) !ResultSet {
         // Validate inputs
@@ -138,69 +410,47 @@ pub const OLAPDatabase = struct {
                 const col_name = std.mem.trim(u8, parts.next() orelse return error.InvalidSyntax, &std.ascii.whitespace);
                 const col_type = std.mem.trim(u8, parts.next() orelse return error.InvalidSyntax, &std.ascii.whitespace);
                 const data_type = ColumnSchema.DataType.fromString(col_type) orelse return error.InvalidDataType;
+                // Column options; other constraints such as PRIMARY KEY are accepted and ignored
+                var bloom_filter = false;
+                while (parts.next()) |option| {
+                    if (std.ascii.eqlIgnoreCase(std.mem.trim(u8, option, &std.ascii.whitespace), "BLOOM")) bloom_filter = true;
+                }
                 try columns.append(ColumnSchema{
                     .name = try self.allocator.dupe(u8, col_name),
                     .data_type = data_type,
+                    .bloom_filter = bloom_filter,
                 });
             }
+            // Log the table before publishing it, under the write mutex like
+            // every other record, so that any write that can see the table
+            // gets a later transaction ID and replays after it
+            const commit_ts = self.beginWrite();
+            defer self.endWrite(commit_ts);
+            if (self.table_schemas.get(table_name) != null) return error.TableAlreadyExists;
+            const wal_data = try std.fmt.allocPrint(self.allocator, "CREATE_TABLE:{s}:{s}", .{ table_name, query });
+            defer self.allocator.free(wal_data);
+            try self.logRecord(wal_data);
             try self.createTable(table_name, columns.items);
 
-            // Log the CREATE TABLE operation to WAL
-            if (!self.is_recovering) {
-                const wal_data = try std.fmt.allocPrint(self.allocator, "CREATE_TABLE:{s}:{s}", .{ table_name, query });
-                defer self.allocator.free(wal_data);
-                try self.wal.logTransaction(self.getNextTxnId(), wal_data);
-            }
-
             // Return an empty result set
             return try ResultSet.init(self.allocator, 0, 0);
         }
 
-        // Check for INSERT INTO
+        // Check for INSERT INTO (one or more rows)
         if (std.mem.startsWith(u8, std.mem.trim(u8, query, &std.ascii.whitespace), "INSERT INTO")) {
-            // Very basic parsing: INSERT INTO table_name VALUES (...)
-            const values_kw = std.mem.indexOf(u8, query, "VALUES") orelse return error.InvalidSyntax;
-            const before_values = std.mem.trim(u8, query[0..values_kw], &std.ascii.whitespace);
-            const after_insert = before_values[11..]; // after "INSERT INTO"
-            const table_name_end = std.mem.indexOf(u8, after_insert, " ") orelse after_insert.len;
-            const table_name = std.mem.trim(u8, after_insert[0..table_name_end], &std.ascii.whitespace);
-            const open_paren = std.mem.indexOf(u8, query, "(") orelse return error.InvalidSyntax;
-            const close_paren = std.mem.lastIndexOf(u8, query, ")") orelse return error.InvalidSyntax;
-            const values_str = std.mem.trim(u8, query[open_paren + 1 .. close_paren], &std.ascii.whitespace);
-
-            // Split values by comma (does not handle quoted commas)
-            var values_iter = std.mem.splitScalar(u8, values_str, ',');
-            var values = std.ArrayList(Value).init(self.allocator);
-            defer values.deinit();
-            while (values_iter.next()) |val_str| {
-                const trimmed = std.mem.trim(u8, val_str, &std.ascii.whitespace);
-                // Parse as integer or string (very basic)
-                if (trimmed.len > 0 and trimmed[0] == '\'') {
-                    // String literal: remove quotes
-                    if (trimmed.len < 2 or trimmed[trimmed.len - 1] != '\'') return error.InvalidSyntax;
-                    const str_val = trimmed[1 .. trimmed.len - 1];
-                    try values.append(Value{ .text = try self.allocator.dupe(u8, str_val) });
-                } else {
-                    const int_val = std.fmt.parseInt(i64, trimmed, 10) catch return error.InvalidSyntax;
-                    try values.append(Value{ .integer = int_val });
-                }
-            }
-
-            // Find the table
-            const schema_ptr = self.table_schemas.get(table_name) orelse return error.TableNotFound;
-            if (values.items.len != schema_ptr.columns.len) return error.ColumnCountMismatch;
-            // Store the row (dupe the array for storage)
-            const row = try self.allocator.dupe(Value, values.items);
-            try schema_ptr.rows.append(row);
+            try self.executeInsert(std.mem.trim(u8, query, &std.ascii.whitespace));
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
 
-            // Log the INSERT operation to WAL
-            if (!self.is_recovering) {
-                const wal_data = try std.fmt.allocPrint(self.allocator, "INSERT:{s}:{s}", .{ table_name, query });
-                defer self.allocator.free(wal_data);
-                try self.wal.logTransaction(self.getNextTxnId(), wal_data);
-            }
+        // Check for COPY table FROM 'file.csv'
+        if (std.mem.startsWith(u8, std.mem.trim(u8, query, &std.ascii.whitespace), "COPY ")) {
+            try self.executeCopy(std.mem.trim(u8, query, &std.ascii.whitespace));
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
 
-            // Return empty result set
+        // Check for DELETE FROM table [WHERE ...]
+        if (std.mem.startsWith(u8, std.mem.trim(u8, query, &std.ascii.whitespace), "DELETE FROM")) {
+            try self.executeDelete(std.mem.trim(u8, query, &std.ascii.whitespace));
             return try ResultSet.init(self.allocator, 0, 0);
         }
 
@@ -216,25 +466,305 @@ pub const OLAPDatabase = struct {
         }
     }
 
+    /// A parsed INSERT statement. The caller owns the rows until they are appended.
+    pub const InsertStatement = struct {
+        schema: *TableSchema,
+        rows: std.ArrayList([]Value),
+    };
+
+    /// Parse INSERT INTO table [(columns)] VALUES (...), (...), ...
+    pub fn parseInsert(self: *OLAPDatabase, query: []const u8) !InsertStatement {
+        const values_kw = std.mem.indexOf(u8, query, "VALUES") orelse return error.InvalidSyntax;
+        const after_insert = std.mem.trim(u8, query[11..values_kw], &std.ascii.whitespace); // after "INSERT INTO"
+        const table_name_end = std.mem.indexOfAny(u8, after_insert, " (") orelse after_insert.len;
+        const table_name = after_insert[0..table_name_end];
+
+        // Find the table
+        const schema_ptr = self.table_schemas.get(table_name) orelse return error.TableNotFound;
+
+        const rows = try bulk_load.parseValuesList(self.allocator, query[values_kw + "VALUES".len ..], schema_ptr.columns);
+        return InsertStatement{ .schema = schema_ptr, .rows = rows };
+    }
+
+    /// Execute INSERT INTO table [(columns)] VALUES (...), (...), ...
+    fn executeInsert(self: *OLAPDatabase, query: []const u8) !void {
+        var insert = try self.parseInsert(query);
+        defer insert.rows.deinit();
+        try self.appendRowsImplicitly(insert.schema, insert.rows.items, query);
+    }
+
+    /// Start an autocommit write as an implicit transaction that holds `mode`
+    /// on its table until it commits, so it waits for the locks of explicit
+    /// transactions like any other writer. The lock is taken before the write
+    /// mutex, the order an explicit transaction takes them in at COMMIT.
+    fn beginImplicitWrite(self: *OLAPDatabase, table_name: []const u8, mode: lock_manager.LockMode) !*Transaction {
+        const txn = try self.txn_manager.beginTransaction();
+        errdefer self.txn_manager.abortTransaction(txn) catch {};
+        try self.txn_manager.locks.lockTable(txn.id, lock_manager.tableId(table_name), mode);
+        return txn;
+    }
+
+    /// Append rows under an implicit transaction holding IX on the table.
+    /// Takes ownership of the rows.
+    fn appendRowsImplicitly(self: *OLAPDatabase, schema: *TableSchema, rows: [][]Value, original_query: ?[]const u8) !void {
+        const txn = self.beginImplicitWrite(schema.name, .IX) catch |err| {
+            bulk_load.freeRows(self.allocator, rows);
+            return err;
+        };
+        errdefer self.txn_manager.abortTransaction(txn) catch {};
+
+        {
+            const commit_ts = self.beginWrite();
+            defer self.endWrite(commit_ts);
+            txn.commit_ts = commit_ts;
+            try self.appendRowBatches(schema, rows, original_query, commit_ts);
+        }
+        try self.txn_manager.commitTransaction(txn);
+    }
+
+    /// Make rows visible at `commit_ts` without logging them, for writes whose
+    /// WAL record was already written. Takes ownership of the rows.
+    pub fn applyRows(self: *OLAPDatabase, schema: *TableSchema, rows: [][]Value, commit_ts: u64) !void {
+        schema.latch.lock();
+        defer schema.latch.unlock();
+        schema.ensureUnusedTailCapacity(rows.len) catch |err| {
+            bulk_load.freeRows(self.allocator, rows);
+            return err;
+        };
+        schema.appendTailAssumeCapacity(rows, commit_ts);
+        try schema.sealFullSegments();
+    }
+
+    /// Execute COPY table FROM 'file.csv' [HEADER]
+    fn executeCopy(self: *OLAPDatabase, query: []const u8) !void {
+        const after_copy = std.mem.trim(u8, query[5..], &std.ascii.whitespace); // after "COPY "
+        const table_name_end = std.mem.indexOfAny(u8, after_copy, &std.ascii.whitespace) orelse return error.InvalidSyntax;
+        const table_name = after_copy[0..table_name_end];
+
+        const rest = std.mem.trim(u8, after_copy[table_name_end..], &std.ascii.whitespace);
+        if (rest.len < 4 or !std.ascii.eqlIgnoreCase(rest[0..4], "FROM")) return error.InvalidSyntax;
+
+        const path_start = (std.mem.indexOfScalar(u8, rest, '\'') orelse return error.InvalidSyntax) + 1;
+        const path_len = std.mem.indexOfScalar(u8, rest[path_start..], '\'') orelse return error.InvalidSyntax;
+        const path = rest[path_start .. path_start + path_len];
+        const options = rest[path_start + path_len + 1 ..];
+        const skip_header = std.ascii.indexOfIgnoreCase(options, "HEADER") != null;
+
+        const schema_ptr = self.table_schemas.get(table_name) orelse return error.TableNotFound;
+
+        var file = try bulk_load.MappedFile.open(path);
+        defer file.close();
+
+        // Rows are appended as each round of chunks is parsed, so a large file
+        // never has to fit in memory. One implicit transaction holds IX for the
+        // whole load; each round commits on its own, so rows appended before a
+        // parse error stay loaded.
+        const txn = try self.beginImplicitWrite(schema_ptr.name, .IX);
+        errdefer self.txn_manager.abortTransaction(txn) catch {};
+
+        const Loader = struct {
+            db: *OLAPDatabase,
+            schema: *TableSchema,
+            txn: *Transaction,
+
+            fn append(ctx: *const @This(), rows: [][]Value) !void {
+                const commit_ts = ctx.db.beginWrite();
+                defer ctx.db.endWrite(commit_ts);
+                ctx.txn.commit_ts = commit_ts;
+                // The file may change or disappear, so the WAL records the rows themselves
+                try ctx.db.appendRowBatches(ctx.schema, rows, null, commit_ts);
+            }
+        };
+        const loader = Loader{ .db = self, .schema = schema_ptr, .txn = txn };
+        try bulk_load.parseCsvChunks(self.allocator, file.data, schema_ptr.columns, skip_header, &loader, Loader.append);
+        try self.txn_manager.commitTransaction(txn);
+    }
+
+    /// A parsed DELETE statement
+    pub const DeleteStatement = struct {
+        schema: *TableSchema,
+        predicates: ?[]const planner.Predicate, // null deletes every row
+
+        pub fn deinit(self: *DeleteStatement, allocator: std.mem.Allocator) void {
+            if (self.predicates) |preds| {
+                planner.freePredicates(allocator, preds);
+                allocator.free(preds);
+            }
+        }
+    };
+
+    /// Parse DELETE FROM table [WHERE ...]
+    pub fn parseDelete(self: *OLAPDatabase, query: []const u8) !DeleteStatement {
+        const after_delete = std.mem.trim(u8, query[11..], &std.ascii.whitespace); // after "DELETE FROM"
+        const table_name_end = std.mem.indexOfAny(u8, after_delete, " \t\r\n;") orelse after_delete.len;
+        const table_name = after_delete[0..table_name_end];
+        const schema_ptr = self.table_schemas.get(table_name) orelse return error.TableNotFound;
+
+        const rest = std.mem.trim(u8, after_delete[table_name_end..], " \t\r\n;");
+        var predicates: ?[]const planner.Predicate = null;
+        if (rest.len > 0) {
+            if (rest.len < 6 or !std.ascii.eqlIgnoreCase(rest[0..6], "WHERE ")) return error.InvalidSyntax;
+            // A WHERE clause the scan cannot evaluate must not widen into deleting every row
+            predicates = try planner.parsePredicates(self.allocator, rest[6..]) orelse return error.UnsupportedPredicate;
+        }
+        return DeleteStatement{ .schema = schema_ptr, .predicates = predicates };
+    }
+
+    /// Execute DELETE FROM table [WHERE ...]. Matching rows are not removed but
+    /// get an end timestamp, so snapshots taken before the delete still see them.
+    fn executeDelete(self: *OLAPDatabase, query: []const u8) !void {
+        var delete = try self.parseDelete(query);
+        defer delete.deinit(self.allocator);
+
+        const deleted = blk: {
+            const txn = try self.beginImplicitWrite(delete.schema.name, .X);
+            errdefer self.txn_manager.abortTransaction(txn) catch {};
+
+            const count = apply: {
+                const commit_ts = self.beginWrite();
+                defer self.endWrite(commit_ts);
+                txn.commit_ts = commit_ts;
+
+                // Log the delete before it becomes visible
+                if (!self.is_recovering) {
+                    const wal_data = try std.fmt.allocPrint(self.allocator, "DELETE:{s}:{s}", .{ delete.schema.name, query });
+                    defer self.allocator.free(wal_data);
+                    try self.wal.logTransaction(self.getNextTxnId(), wal_data);
+                }
+                break :apply try self.applyDelete(&delete, commit_ts);
+            };
+            try self.txn_manager.commitTransaction(txn);
+            break :blk count;
+        };
+        if (deleted > 0) _ = try self.collectTableGarbage(delete.schema);
+    }
+
+    /// End the versions of the latest rows matching `delete` at `commit_ts`,
+    /// without logging. Returns the number of rows deleted.
+    pub fn applyDelete(self: *OLAPDatabase, delete: *const DeleteStatement, commit_ts: u64) !usize {
+        const schema = delete.schema;
+        const scan_predicates = try executor.resolvePredicates(self.allocator, delete.predicates, schema);
+        defer self.allocator.free(scan_predicates);
+
+        schema.latch.lock();
+        defer schema.latch.unlock();
+
+        var selection = try executor.selectRows(self.allocator, schema, scan_predicates, Snapshot.latest, null);
+        defer selection.deinit();
+        if (selection.count == 0) return 0;
+
+        for (schema.segments.items, 0..) |segment, s| {
+            const bitmap = selection.segment(s);
+            if (column_segment.countSelected(bitmap) == 0) continue;
+            for (0..segment.row_count) |r| {
+                if (column_segment.isSelected(bitmap, r)) try segment.versions.markDeleted(self.allocator, r, commit_ts);
+            }
+        }
+        for (schema.tail_end_ts.items, 0..) |*end_ts, r| {
+            if (column_segment.isSelected(selection.tail(), r)) end_ts.* = commit_ts;
+        }
+        schema.dead_versions += selection.count;
+        return selection.count;
+    }
+
+    /// Reclaim row versions that no active transaction can see any more.
+    /// Returns the number of versions removed.
+    pub fn collectGarbage(self: *OLAPDatabase) !usize {
+        const oldest_read_ts = self.txn_manager.oldestActiveSnapshot();
+        var reclaimed: usize = 0;
+        const catalog = self.table_schemas.acquire();
+        defer self.table_schemas.release(catalog);
+        var it = catalog.tableIterator();
+        while (it.next()) |entry| {
+            const schema = entry.value_ptr.*;
+            schema.latch.lock();
+            defer schema.latch.unlock();
+            reclaimed += try schema.collectGarbage(oldest_read_ts);
+        }
+        return reclaimed;
+    }
+
+    /// Reclaim dead row versions of one table, if it holds enough of them to
+    /// pass the garbage collection threshold. Returns the number removed.
+    pub fn collectTableGarbage(self: *OLAPDatabase, schema: *TableSchema) !usize {
+        const oldest_read_ts = self.txn_manager.oldestActiveSnapshot();
+        schema.latch.lock();
+        defer schema.latch.unlock();
+        if (!schema.needsGarbageCollection()) return 0;
+        return try schema.collectGarbage(oldest_read_ts);
+    }
+
+    /// Append rows to a table in batches, writing one WAL record per batch
+    /// instead of one per row. Takes ownership of the rows.
+    /// `original_query` is logged verbatim when all rows fit in one batch.
+    /// The new rows become visible to snapshots at or after `commit_ts`.
+    fn appendRowBatches(self: *OLAPDatabase, schema: *TableSchema, rows: [][]Value, original_query: ?[]const u8, commit_ts: u64) !void {
+        var start: usize = 0;
+        errdefer bulk_load.freeRows(self.allocator, rows[start..]);
+
+        // The table latch is only held to change the table, never across a WAL
+        // write, so scans are not blocked on fsync. Until the commit is
+        // published its rows are invisible to them anyway.
+        {
+            schema.latch.lock();
+            defer schema.latch.unlock();
+            try schema.ensureUnusedTailCapacity(rows.len);
+        }
+
+        while (start < rows.len) {
+            // Cut the batch by row count and by encoded size so each WAL record stays recoverable
+            var end = start;
+            var batch_bytes: usize = 0;
+            while (end < rows.len and end - start < bulk_load.max_batch_rows) {
+                const row_bytes = bulk_load.estimateRowBytes(rows[end]);
+                if (end > start and batch_bytes + row_bytes > bulk_load.max_batch_bytes) break;
+                batch_bytes += row_bytes;
+                end += 1;
+            }
+            const batch = rows[start..end];
+
+            // Log the batch before it becomes visible
+            if (!self.is_recovering) {
+                var wal_data = std.ArrayList(u8).init(self.allocator);
+                defer wal_data.deinit();
+                const writer = wal_data.writer();
+
+                try writer.print("INSERT:{s}:", .{schema.name});
+                if (original_query != null and start == 0 and end == rows.len and original_query.?.len <= bulk_load.max_batch_bytes) {
+                    try writer.writeAll(original_query.?);
+                } else {
+                    try bulk_load.writeInsertStatement(writer, schema.name, batch);
+                }
+                try self.wal.logTransaction(self.getNextTxnId(), wal_data.items);
+            }
+
+            schema.latch.lock();
+            schema.appendTailAssumeCapacity(batch, commit_ts);
+            schema.latch.unlock();
+            start = end;
+        }
+
+        schema.latch.lock();
+        defer schema.latch.unlock();
+        try schema.sealFullSegments();
+    }
+
     /// Deinitialize the database
     pub fn deinit(self: *OLAPDatabase) void {
         std.debug.print("OLAPDatabase.deinit called\n", .{});
 
         // Free all table schemas
         std.debug.print("Starting table_schemas deinit, count: {}\n", .{self.table_schemas.count()});
-        if (@hasField(@TypeOf(self.table_schemas), "deinit") and self.table_schemas.count() > 0) {
-            var it = self.table_schemas.iterator();
+        if (self.table_schemas.count() > 0) {
+            const catalog = self.table_schemas.acquire();
+            defer self.table_schemas.release(catalog);
+            var it = catalog.tableIterator();
             var table_count: usize = 0;
             while (it.next()) |entry| {
                 table_count += 1;
-                std.debug.print("Deinit table {} (table_count: {})\n", .{ entry.key_ptr.*, table_count });
-
-                // Free the hash map key (table name)
-                std.debug.print("  Freeing table name: {s}\n", .{entry.key_ptr.*});
-                self.allocator.free(entry.key_ptr.*);
-                std.debug.print("  Table name freed\n", .{});
+                std.debug.print("Deinit table {s} (table_count: {})\n", .{ entry.key_ptr.*, table_count });
 
-                // Free the schema and its fields
+                // Free the schema and its fields; the catalog key is the schema's name
                 const schema = entry.value_ptr.*;
                 std.debug.print("  Freeing schema name: {s}\n", .{schema.name});
                 self.allocator.free(schema.name);
@@ -267,18 +797,26 @@ pub const OLAPDatabase = struct {
                 }
                 std.debug.print("  Deinit rows ArrayList\n", .{});
                 schema.rows.deinit();
+                schema.tail_begin_ts.deinit();
+                schema.tail_end_ts.deinit();
                 std.debug.print("  Rows ArrayList deinit complete\n", .{});
 
+                std.debug.print("  Freeing {} segments\n", .{schema.segments.items.len});
+                for (schema.segments.items) |segment| {
+                    segment.release(self.allocator);
+                }
+                schema.segments.deinit();
+                self.allocator.free(schema.tail_zone_maps);
+
                 std.debug.print("  Destroying schema\n", .{});
                 self.allocator.destroy(schema);
                 std.debug.print("  Schema destroyed\n", .{});
             }
-            std.debug.print("Deinit table_schemas HashMap\n", .{});
-            self.table_schemas.deinit();
-            std.debug.print("table_schemas HashMap deinit complete\n", .{});
         } else {
-            std.debug.print("table_schemas is empty or has no deinit method\n", .{});
+            std.debug.print("table_schemas is empty\n", .{});
         }
+        std.debug.print("Deinit table catalog\n", .{});
+        self.table_schemas.deinit();
 
         std.debug.print("Deinit RocksDB\n", .{});
         if (@intFromPtr(self.storage) != 0) {
@@ -548,22 +1086,45 @@ pub const OLAPDatabase = struct {
         // For now, we just ignore the additional backups
     }
 
+    /// Make an index on `table_name.column_name` known to the planner. The
+    /// catalog publishes a new version; queries already running keep theirs.
+    pub fn registerIndex(self: *OLAPDatabase, index_name: []const u8, table_name: []const u8, column_name: []const u8, index_type: Index.IndexType, distinct_values: ?u64) !void {
+        try self.table_schemas.addIndex(index_name, table_name, column_name, index_type, distinct_values);
+    }
+
     /// Create a table in the database
     pub fn createTable(self: *OLAPDatabase, table_name: []const u8, columns: []ColumnSchema) !void {
         std.debug.print("[createTable] Called for table: {s} (recovering: {})\n", .{ table_name, self.is_recovering });
+        // Checked again when the catalog publishes the table, which is what
+        // settles two concurrent CREATE TABLEs for the same name
         if (self.table_schemas.get(table_name) != null) {
             std.debug.print("[createTable] Table already exists: {s}\n", .{table_name});
             return error.TableAlreadyExists;
         }
+        const tail_zone_maps = try self.allocator.alloc(ZoneMap, columns.len);
+        @memset(tail_zone_maps, ZoneMap{});
         const schema = try self.allocator.create(TableSchema);
         schema.* = TableSchema{
             .name = try self.allocator.dupe(u8, table_name),
             .columns = try self.allocator.dupe(ColumnSchema, columns),
             .rows = std.ArrayList([]Value).init(self.allocator),
+            .tail_begin_ts = std.ArrayList(u64).init(self.allocator),
+            .tail_end_ts = std.ArrayList(u64).init(self.allocator),
+            .segments = std.ArrayList(*RowSegment).init(self.allocator),
+            .tail_zone_maps = tail_zone_maps,
+        };
+        // Publish a new catalog version; queries pick it up without locking
+        self.table_schemas.addTable(schema) catch |err| {
+            self.allocator.free(schema.name);
+            self.allocator.free(schema.columns);
+            schema.rows.deinit();
+            schema.tail_begin_ts.deinit();
+            schema.tail_end_ts.deinit();
+            schema.segments.deinit();
+            self.allocator.free(schema.tail_zone_maps);
+            self.allocator.destroy(schema);
+            return err;
         };
-        // Store the table name as a key in the hash map (dupe it for the map)
-        const key = try self.allocator.dupe(u8, table_name);
-        try self.table_schemas.put(key, schema);
         std.debug.print("[createTable] Table added to table_schemas: {s}\n", .{table_name});
     }
 };
@@ -574,6 +1135,9 @@ pub fn init(allocator: std.mem.Allocator, data_dir: []const u8) !*OLAPDatabase {
     errdefer allocator.destroy(db);
 
     db.allocator = allocator;
+    db.next_txn_id = std.atomic.Value(u64).init(1);
+    db.is_recovering = false;
+    db.write_mutex = .{};
 
     // If data_dir is empty, use a default directory
     const actual_data_dir = if (data_dir.len == 0) "data" else data_dir;
@@ -595,11 +1159,20 @@ pub fn init(allocator: std.mem.Allocator, data_dir: []const u8) !*OLAPDatabase {
 
     db.db_context = try DatabaseContext.init(allocator);
     errdefer db.db_context.deinit();
+    db.db_context.loadCostWeights(actual_data_dir);
+
+    // Sorts over the query memory limit spill runs here. Runs left by a
+    // process that did not shut down cleanly are removed.
+    const spill_path = try std.fs.path.join(allocator, &.{ actual_data_dir, "spill" });
+    defer allocator.free(spill_path);
+    std.fs.cwd().deleteTree(spill_path) catch {};
+    db.db_context.spill_dir = try std.fs.cwd().makeOpenPath(spill_path, .{});
 
-    db.table_schemas = std.StringHashMap(*TableSchema).init(allocator);
+    db.table_schemas = try Catalog.init(allocator);
     errdefer db.table_schemas.deinit();
 
     db.db_context.setTableSchemas(&db.table_schemas);
+    db.db_context.setTransactionManager(db.txn_manager);
 
     return db;
 }
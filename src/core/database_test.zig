@@ -229,7 +229,7 @@ test "Database recovery after crash" {
             
             // Check that the data was recovered correctly
             try std.testing.expectEqual(@as(usize, 1), result_set.row_count);
-            try std.testing.expectEqual(@as(i32, 1), result_set.rows[0].values[0].Integer);
+            try std.testing.expectEqual(@as(i32, 1), result_set.getValue(0, 0).Integer);
         }
     }.callback);
 }
@@ -0,0 +1,318 @@
+const std = @import("std");
+const database = @import("database.zig");
+const OLAPDatabase = database.OLAPDatabase;
+const transaction_manager = @import("../transaction/manager.zig");
+const Transaction = transaction_manager.Transaction;
+const IsolationLevel = transaction_manager.IsolationLevel;
+const lock_manager = @import("../transaction/lock_manager.zig");
+const result = @import("../query/result.zig");
+const ResultSet = result.ResultSet;
+const Cursor = @import("../query/executor.zig").Cursor;
+const startsWithWord = @import("../query/planner.zig").startsWithWord;
+const Snapshot = transaction_manager.Snapshot;
+const bulk_load = @import("bulk_load.zig");
+
+/// Transaction state of one client connection. Outside BEGIN ... COMMIT every
+/// statement commits on its own. Inside, reads use the transaction's snapshot
+/// and writes are buffered in a write set that COMMIT makes durable with a
+/// single WAL record and applies at one commit timestamp. ROLLBACK discards it.
+/// Reads inside a transaction do not see its own buffered writes, and a
+/// buffered DELETE matches the rows that are current when it commits.
+///
+/// At every isolation level, writes lock their table (IX for INSERT, X for
+/// DELETE) until the transaction ends, and autocommit writes take the same
+/// locks for the length of their statement, so no write commits on a table
+/// another transaction holds an incompatible lock on. SERIALIZABLE reads also
+/// take S table locks and read the latest committed data, which makes the
+/// schedule equivalent to strict two-phase locking. A transaction that
+/// deadlocks or times out on a lock is rolled back.
+pub const Session = struct {
+    allocator: std.mem.Allocator,
+    db: *OLAPDatabase,
+    txn: ?*Transaction = null,
+    write_set: std.ArrayList(Write),
+
+    pub const Op = union(enum) {
+        insert: OLAPDatabase.InsertStatement,
+        delete: OLAPDatabase.DeleteStatement,
+    };
+
+    /// A buffered write, with the statement text that the WAL records for it
+    pub const Write = struct {
+        query: []const u8,
+        op: Op,
+
+        fn deinit(self: *Write, allocator: std.mem.Allocator) void {
+            switch (self.op) {
+                .insert => |*insert| {
+                    bulk_load.freeRows(allocator, insert.rows.items);
+                    insert.rows.deinit();
+                },
+                .delete => |*delete| delete.deinit(allocator),
+            }
+            allocator.free(self.query);
+        }
+    };
+
+    pub fn init(allocator: std.mem.Allocator, db: *OLAPDatabase) Session {
+        return Session{
+            .allocator = allocator,
+            .db = db,
+            .write_set = std.ArrayList(Write).init(allocator),
+        };
+    }
+
+    /// Roll back any transaction left open, e.g. when the client disconnects
+    pub fn deinit(self: *Session) void {
+        if (self.txn != null) self.rollback() catch {};
+        self.write_set.deinit();
+    }
+
+    pub fn inTransaction(self: *const Session) bool {
+        return self.txn != null;
+    }
+
+    /// Execute a statement in this session. Handles BEGIN, COMMIT and ROLLBACK
+    /// and buffers INSERT and DELETE while a transaction is open.
+    pub fn execute(self: *Session, query: []const u8) !ResultSet {
+        const statement = std.mem.trim(u8, query, " \t\r\n;");
+
+        if (parseBegin(statement)) |isolation_level| {
+            try self.begin(isolation_level orelse return error.InvalidIsolationLevel);
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
+        if (isCommand(statement, &.{ "COMMIT", "COMMIT TRANSACTION", "END" })) {
+            try self.commit();
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
+        if (isCommand(statement, &.{ "ROLLBACK", "ROLLBACK TRANSACTION", "ABORT" })) {
+            try self.rollback();
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
+
+        const txn = self.txn orelse return try self.db.execute(query);
+
+        if (std.mem.startsWith(u8, statement, "INSERT INTO")) {
+            var insert = try self.db.parseInsert(statement);
+            errdefer {
+                bulk_load.freeRows(self.allocator, insert.rows.items);
+                insert.rows.deinit();
+            }
+            try self.lockTable(txn, insert.schema.name, .IX);
+            try self.buffer(statement, .{ .insert = insert });
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
+        if (std.mem.startsWith(u8, statement, "DELETE FROM")) {
+            var delete = try self.db.parseDelete(statement);
+            errdefer delete.deinit(self.allocator);
+            try self.lockTable(txn, delete.schema.name, .X);
+            try self.buffer(statement, .{ .delete = delete });
+            return try ResultSet.init(self.allocator, 0, 0);
+        }
+        // Schema changes and bulk loads are logged and applied on their own
+        if (std.mem.startsWith(u8, statement, "CREATE TABLE") or std.mem.startsWith(u8, statement, "COPY ")) {
+            return error.UnsupportedInTransaction;
+        }
+
+        const snapshot = try self.readSnapshot(txn, statement);
+        return self.db.db_context.executeRawAt(query, snapshot) catch |err| switch (err) {
+            error.IndexNotFound, error.MissingTableName => error.TableNotFound,
+            else => err,
+        };
+    }
+
+    /// Open a cursor over a read, to fetch its rows in batches. Inside a
+    /// transaction it reads the snapshot execute() would have used.
+    pub fn openCursor(self: *Session, query: []const u8) !*Cursor {
+        const snapshot: ?Snapshot = if (self.txn) |txn|
+            try self.readSnapshot(txn, std.mem.trim(u8, query, " \t\r\n;"))
+        else
+            null;
+        return self.db.db_context.openCursor(query, snapshot) catch |err| switch (err) {
+            error.IndexNotFound, error.MissingTableName => error.TableNotFound,
+            else => err,
+        };
+    }
+
+    /// The snapshot a read inside `txn` sees. SERIALIZABLE reads first lock
+    /// the tables they name.
+    fn readSnapshot(self: *Session, txn: *Transaction, statement: []const u8) !Snapshot {
+        if (txn.isolation_level != .Serializable) return txn.snapshot();
+        var tables = TableNameIterator{ .tokens = std.mem.tokenizeAny(u8, statement, " \t\r\n,") };
+        while (tables.next()) |table_name| try self.lockTable(txn, table_name, .S);
+        // Locking reads see everything committed before the locks were granted
+        return self.db.txn_manager.currentSnapshot();
+    }
+
+    pub fn begin(self: *Session, isolation_level: IsolationLevel) !void {
+        if (self.txn != null) return error.TransactionAlreadyActive;
+        self.txn = try self.db.txn_manager.beginTransactionWithIsolationLevel(isolation_level);
+    }
+
+    /// Log the write set as one WAL record, then apply it at a single commit
+    /// timestamp. The transaction ends here on every path. A failure before the
+    /// record is logged rolls it back; once the record is durable recovery
+    /// would replay it, so failing to apply it is fatal.
+    pub fn commit(self: *Session) !void {
+        const txn = self.txn orelse return error.NoActiveTransaction;
+        self.txn = null;
+        defer self.clearWriteSet();
+
+        var deleted: usize = 0;
+        if (self.write_set.items.len > 0) {
+            // Other writers wait from here until the commit is published
+            const commit_ts = self.db.beginWrite();
+            defer self.db.endWrite(commit_ts);
+
+            self.logWriteSet() catch |err| {
+                self.db.txn_manager.abortTransaction(txn) catch {};
+                return err;
+            };
+
+            txn.commit_ts = commit_ts;
+            deleted = self.applyWriteSet(commit_ts) catch |err| {
+                std.debug.panic("transaction {d} is logged but could not be applied: {s}", .{ txn.id, @errorName(err) });
+            };
+        }
+
+        try self.db.txn_manager.commitTransaction(txn);
+        if (deleted > 0) {
+            for (self.write_set.items) |write| {
+                switch (write.op) {
+                    .delete => |delete| _ = try self.db.collectTableGarbage(delete.schema),
+                    .insert => {},
+                }
+            }
+        }
+    }
+
+    /// Everything in a commit that can fail short of applying it: encode the
+    /// write set, make room for its rows, and write the record
+    fn logWriteSet(self: *Session) !void {
+        var record = std.ArrayList(u8).init(self.allocator);
+        defer record.deinit();
+        const writer = record.writer();
+        var entry = std.ArrayList(u8).init(self.allocator);
+        defer entry.deinit();
+
+        // Each write is framed as the record an autocommit statement would have logged
+        try writer.writeAll("TXN:");
+        for (self.write_set.items) |write| {
+            entry.clearRetainingCapacity();
+            switch (write.op) {
+                .insert => |insert| try entry.writer().print("INSERT:{s}:{s}", .{ insert.schema.name, write.query }),
+                .delete => |delete| try entry.writer().print("DELETE:{s}:{s}", .{ delete.schema.name, write.query }),
+            }
+            try database.writeTransactionRecord(writer, entry.items);
+        }
+
+        // Reserve each table's rows at once; writers are serialized, so the
+        // room is still there when the write set is applied
+        for (self.write_set.items, 0..) |write, i| {
+            if (write.op != .insert) continue;
+            const schema = write.op.insert.schema;
+            if (rowsInsertedInto(self.write_set.items[0..i], schema) > 0) continue;
+            schema.latch.lock();
+            defer schema.latch.unlock();
+            try schema.ensureUnusedTailCapacity(rowsInsertedInto(self.write_set.items, schema));
+        }
+
+        // One record means one fsync, however many statements the transaction ran
+        try self.db.logRecord(record.items);
+    }
+
+    /// Apply the logged write set in statement order. Returns the number of rows deleted.
+    fn applyWriteSet(self: *Session, commit_ts: u64) !usize {
+        var deleted: usize = 0;
+        for (self.write_set.items) |*write| {
+            switch (write.op) {
+                .insert => |*insert| {
+                    // The table now owns the rows
+                    const rows = insert.rows.items;
+                    insert.rows.items.len = 0;
+                    try self.db.applyRows(insert.schema, rows, commit_ts);
+                },
+                .delete => |*delete| deleted += try self.db.applyDelete(delete, commit_ts),
+            }
+        }
+        return deleted;
+    }
+
+    /// Discard the write set; nothing was logged or applied
+    pub fn rollback(self: *Session) !void {
+        const txn = self.txn orelse return error.NoActiveTransaction;
+        self.clearWriteSet();
+        self.txn = null;
+        try self.db.txn_manager.abortTransaction(txn);
+    }
+
+    /// Lock a table for the rest of the transaction. A deadlock victim or
+    /// timed-out waiter is rolled back.
+    fn lockTable(self: *Session, txn: *Transaction, table_name: []const u8, mode: lock_manager.LockMode) !void {
+        self.db.txn_manager.locks.lockTable(txn.id, lock_manager.tableId(table_name), mode) catch |err| {
+            self.rollback() catch {};
+            return err;
+        };
+    }
+
+    fn buffer(self: *Session, statement: []const u8, op: Op) !void {
+        const query = try self.allocator.dupe(u8, statement);
+        errdefer self.allocator.free(query);
+        try self.write_set.append(Write{ .query = query, .op = op });
+    }
+
+    fn clearWriteSet(self: *Session) void {
+        for (self.write_set.items) |*write| write.deinit(self.allocator);
+        self.write_set.clearRetainingCapacity();
+    }
+};
+
+/// Recognize BEGIN [TRANSACTION] and START TRANSACTION, each optionally
+/// followed by ISOLATION LEVEL <level>. Returns null if the statement is not
+/// a BEGIN, and an inner null if the isolation level is not recognized.
+fn parseBegin(statement: []const u8) ??IsolationLevel {
+    var rest: []const u8 = undefined;
+    if (startsWithWord(statement, "START TRANSACTION")) {
+        rest = statement["START TRANSACTION".len..];
+    } else if (startsWithWord(statement, "BEGIN TRANSACTION")) {
+        rest = statement["BEGIN TRANSACTION".len..];
+    } else if (startsWithWord(statement, "BEGIN")) {
+        rest = statement["BEGIN".len..];
+    } else {
+        return null;
+    }
+
+    rest = std.mem.trim(u8, rest, &std.ascii.whitespace);
+    if (rest.len == 0) return @as(?IsolationLevel, .ReadCommitted);
+    if (!startsWithWord(rest, "ISOLATION LEVEL")) return @as(?IsolationLevel, null);
+    return IsolationLevel.fromString(std.mem.trim(u8, rest["ISOLATION LEVEL".len..], &std.ascii.whitespace));
+}
+
+fn rowsInsertedInto(writes: []const Session.Write, schema: *const database.TableSchema) usize {
+    var rows: usize = 0;
+    for (writes) |write| {
+        if (write.op == .insert and write.op.insert.schema == schema) rows += write.op.insert.rows.items.len;
+    }
+    return rows;
+}
+
+/// Yields the table names that follow FROM and JOIN in a query
+const TableNameIterator = struct {
+    tokens: std.mem.TokenIterator(u8, .any),
+
+    fn next(self: *TableNameIterator) ?[]const u8 {
+        while (self.tokens.next()) |token| {
+            if (!std.ascii.eqlIgnoreCase(token, "FROM") and !std.ascii.eqlIgnoreCase(token, "JOIN")) continue;
+            const table = std.mem.trim(u8, self.tokens.next() orelse return null, "();");
+            if (table.len > 0) return table;
+        }
+        return null;
+    }
+};
+
+fn isCommand(statement: []const u8, forms: []const []const u8) bool {
+    for (forms) |form| {
+        if (std.ascii.eqlIgnoreCase(statement, form)) return true;
+    }
+    return false;
+}
@@ -4,6 +4,8 @@ const std = @import("std");
 pub const build_options = @import("build_options.zig");
 
 pub const core = @import("core/database.zig");
+pub const session = @import("core/session.zig");
+pub const catalog = @import("core/catalog.zig");
 pub const storage = struct {
     pub const rocksdb = @import("storage/rocksdb.zig");
     pub const wal = @import("storage/wal.zig");
@@ -11,6 +13,11 @@ pub const storage = struct {
     pub const btree_index = @import("storage/btree_index.zig");
     pub const skiplist_index = @import("storage/skiplist_index.zig");
     pub const distributed_wal = @import("storage/distributed_wal.zig");
+    pub const read_router = @import("storage/read_router.zig");
+    pub const column_segment = @import("storage/column_segment.zig");
+    pub const zone_map = @import("storage/zone_map.zig");
+    pub const bloom_filter = @import("storage/bloom_filter.zig");
+    pub const row_versions = @import("storage/row_versions.zig");
 };
 pub const query = struct {
     pub const planner = @import("query/planner.zig");
@@ -20,9 +27,13 @@ pub const query = struct {
     pub const cost_model = @import("query/cost_model.zig");
     pub const statistics = @import("query/statistics.zig");
     pub const parallel = @import("query/parallel.zig");
+    pub const profile = @import("query/profile.zig");
+    pub const explain = @import("query/explain.zig");
+    pub const sort = @import("query/sort.zig");
 };
 pub const transaction = struct {
     pub const manager = @import("transaction/manager.zig");
+    pub const lock_manager = @import("transaction/lock_manager.zig");
 };
 pub const server = @import("server/server.zig");
 pub const gpu = @import("gpu/main.zig");
@@ -88,6 +88,12 @@ pub const AdvancedQueryPlanner = struct {
         self.allocator.destroy(self);
     }
 
+    /// Cost plans with weights calibrated for this host, normally the ones a
+    /// DatabaseContext loaded from its data directory
+    pub fn setCostWeights(self: *AdvancedQueryPlanner, weights: CostModel.Weights) void {
+        if (self.cost_model) |cost| cost.weights = weights;
+    }
+
     /// Parse a SQL query into an AST
     pub fn parse(self: *AdvancedQueryPlanner, query: []const u8) !*planner.AST {
         return self.base_planner.parse(query);
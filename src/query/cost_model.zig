@@ -35,15 +35,79 @@ pub const CostModel = struct {
 
         // Fixed costs
         gpu_kernel_launch_overhead: f64 = 50.0,
+
+        /// Load weights from a JSON file written by the calibrate_cost_model tool.
+        /// Fields missing from the file keep their default values.
+        pub fn loadFromFile(allocator: std.mem.Allocator, path: []const u8) !Weights {
+            const content = try std.fs.cwd().readFileAlloc(allocator, path, 64 * 1024);
+            defer allocator.free(content);
+
+            const parsed = try std.json.parseFromSlice(Weights, allocator, content, .{ .ignore_unknown_fields = true });
+            defer parsed.deinit();
+
+            const weights = parsed.value;
+            if (!weights.isValid()) {
+                return error.InvalidCostWeights;
+            }
+            return weights;
+        }
+
+        /// Load the weights calibrated for the database in `data_dir`, or the
+        /// defaults if it has none
+        pub fn loadForDataDir(allocator: std.mem.Allocator, data_dir: []const u8) !Weights {
+            const path = try std.fs.path.join(allocator, &.{ data_dir, weights_file_name });
+            defer allocator.free(path);
+            return loadFromFile(allocator, path) catch |err| switch (err) {
+                error.FileNotFound => Weights{},
+                else => err,
+            };
+        }
+
+        /// Save weights to a JSON file
+        pub fn saveToFile(self: Weights, path: []const u8) !void {
+            if (std.fs.path.dirname(path)) |dir| {
+                try std.fs.cwd().makePath(dir);
+            }
+
+            const file = try std.fs.cwd().createFile(path, .{});
+            defer file.close();
+
+            try std.json.stringify(self, .{ .whitespace = .indent_2 }, file.writer());
+            try file.writeAll("\n");
+        }
+
+        /// Check that every weight is a finite, non-negative number
+        pub fn isValid(self: Weights) bool {
+            inline for (std.meta.fields(Weights)) |field| {
+                const value = @field(self, field.name);
+                if (!std.math.isFinite(value) or value < 0.0) {
+                    return false;
+                }
+            }
+            return true;
+        }
     };
 
-    /// Initialize a new cost model
+    /// Name of the calibrated weights file in a database's data directory
+    pub const weights_file_name = "cost_model.json";
+
+    /// Where calibrate_cost_model writes by default: the data directory the
+    /// server opens when none is given
+    pub const default_weights_path = "data/" ++ weights_file_name;
+
+    /// Initialize a new cost model with the built-in weights
     pub fn init(allocator: std.mem.Allocator, stats: *Statistics) !*CostModel {
+        return initWithWeights(allocator, stats, Weights{});
+    }
+
+    /// Initialize a cost model with given weights, such as those a
+    /// DatabaseContext loaded for its data directory
+    pub fn initWithWeights(allocator: std.mem.Allocator, stats: *Statistics, weights: Weights) !*CostModel {
         const model = try allocator.create(CostModel);
         model.* = CostModel{
             .allocator = allocator,
             .statistics = stats,
-            .weights = Weights{},
+            .weights = weights,
         };
         return model;
     }
@@ -53,6 +117,16 @@ pub const CostModel = struct {
         self.allocator.destroy(self);
     }
 
+    /// Replace the weights with calibrated ones loaded from a file.
+    /// Returns false (and keeps the current weights) if the file does not exist.
+    pub fn loadWeightsFromFile(self: *CostModel, path: []const u8) !bool {
+        self.weights = Weights.loadFromFile(self.allocator, path) catch |err| switch (err) {
+            error.FileNotFound => return false,
+            else => return err,
+        };
+        return true;
+    }
+
     /// Estimate the cost of a logical plan
     pub fn estimateLogicalPlanCost(self: *CostModel, plan: *LogicalPlan) !f64 {
         return switch (plan.node_type) {
@@ -409,3 +483,42 @@ test "CostModel GPU vs CPU cost comparison" {
     // GPU should be used for large tables
     try std.testing.expect(use_gpu_large);
 }
+
+test "CostModel weights file round trip" {
+    const allocator = std.testing.allocator;
+    const test_dir = "test_cost_model";
+
+    std.fs.cwd().deleteTree(test_dir) catch {};
+    defer std.fs.cwd().deleteTree(test_dir) catch {};
+
+    const path = test_dir ++ "/cost_model.json";
+
+    // Write a calibrated set of weights
+    var calibrated = CostModel.Weights{};
+    calibrated.cpu_index_seek_cost = 42.0;
+    calibrated.gpu_transfer_cost_per_byte = 0.0125;
+    try calibrated.saveToFile(path);
+
+    // Initialize Statistics
+    const stats = try statistics.Statistics.init(allocator);
+    defer stats.deinit();
+
+    // Initialize CostModel and load the weights
+    const cost_model = try CostModel.init(allocator, stats);
+    defer cost_model.deinit();
+
+    try std.testing.expect(try cost_model.loadWeightsFromFile(path));
+    try std.testing.expectEqual(@as(f64, 42.0), cost_model.weights.cpu_index_seek_cost);
+    try std.testing.expectEqual(@as(f64, 0.0125), cost_model.weights.gpu_transfer_cost_per_byte);
+    try std.testing.expectEqual(calibrated.cpu_scan_cost_per_row, cost_model.weights.cpu_scan_cost_per_row);
+
+    // A missing file keeps the current weights
+    try std.testing.expect(!try cost_model.loadWeightsFromFile(test_dir ++ "/missing.json"));
+    try std.testing.expectEqual(@as(f64, 42.0), cost_model.weights.cpu_index_seek_cost);
+
+    // A data directory is looked up by file name, and without one the defaults apply
+    const loaded = try CostModel.Weights.loadForDataDir(allocator, test_dir);
+    try std.testing.expectEqual(@as(f64, 42.0), loaded.cpu_index_seek_cost);
+    const defaults = try CostModel.Weights.loadForDataDir(allocator, test_dir ++ "/missing");
+    try std.testing.expectEqual(CostModel.Weights{}, defaults);
+}
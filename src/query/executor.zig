@@ -1,17 +1,42 @@
 const std = @import("std");
 const planner = @import("planner.zig");
 const result = @import("result.zig");
+const profile = @import("profile.zig");
+const explain = @import("explain.zig");
+const statistics = @import("statistics.zig");
+const CostModel = @import("cost_model.zig").CostModel;
+const sort = @import("sort.zig");
+const OperatorProfile = profile.OperatorProfile;
+const CountingAllocator = profile.CountingAllocator;
 const assert = @import("../build_options.zig").assert;
 const Index = @import("../storage/index.zig").Index;
 const BTreeMapIndex = @import("../storage/btree_index.zig").BTreeMapIndex;
 const SkipListIndex = @import("../storage/skiplist_index.zig").SkipListIndex;
 const TableSchema = @import("../core/database.zig").TableSchema;
+const catalog = @import("../core/catalog.zig");
+const Catalog = catalog.Catalog;
+const column_segment = @import("../storage/column_segment.zig");
+const transaction_manager = @import("../transaction/manager.zig");
+const TransactionManager = transaction_manager.TransactionManager;
+const Transaction = transaction_manager.Transaction;
+const Snapshot = transaction_manager.Snapshot;
+const RowSegment = column_segment.RowSegment;
+
+/// Stack space handed to each query's arena before it falls back to the heap
+const query_arena_stack_bytes = 8 * 1024;
+
+/// Memory one query's sort may use before it spills runs to disk
+pub const default_query_memory_limit: usize = 256 * 1024 * 1024;
 
 /// Database context for query execution
 pub const DatabaseContext = struct {
     allocator: std.mem.Allocator,
     indexes: std.StringHashMap(*anyopaque),
-    table_schemas: ?*std.StringHashMap(*TableSchema) = null,
+    table_schemas: ?*Catalog = null,
+    txn_manager: ?*TransactionManager = null, // Without one, queries read the latest versions
+    query_memory_limit: usize = default_query_memory_limit, // Bytes a sort may hold before it spills
+    spill_dir: ?std.fs.Dir = null, // Owned; without one, a sort over the limit fails the query
+    cost_weights: CostModel.Weights = .{}, // Calibrated for this host by loadCostWeights
 
     pub fn init(allocator: std.mem.Allocator) !*DatabaseContext {
         const context = try allocator.create(DatabaseContext);
@@ -23,6 +48,7 @@ pub const DatabaseContext = struct {
     }
 
     pub fn deinit(self: *DatabaseContext) void {
+        if (self.spill_dir) |*dir| dir.close();
         self.indexes.deinit();
         self.allocator.destroy(self);
     }
@@ -49,42 +75,264 @@ pub const DatabaseContext = struct {
         return @ptrCast(@alignCast(index_ptr));
     }
 
-    pub fn setTableSchemas(self: *DatabaseContext, schemas: *std.StringHashMap(*TableSchema)) void {
+    /// Use the cost model weights calibrated for the database in `data_dir`.
+    /// Without a weights file, or with an unreadable one, the defaults stay.
+    pub fn loadCostWeights(self: *DatabaseContext, data_dir: []const u8) void {
+        self.cost_weights = CostModel.Weights.loadForDataDir(self.allocator, data_dir) catch |err| {
+            std.debug.print("Ignoring cost model weights in {s}: {s}\n", .{ data_dir, @errorName(err) });
+            return;
+        };
+    }
+
+    pub fn setTableSchemas(self: *DatabaseContext, schemas: *Catalog) void {
         self.table_schemas = schemas;
     }
 
+    pub fn setTransactionManager(self: *DatabaseContext, txn_manager: *TransactionManager) void {
+        self.txn_manager = txn_manager;
+    }
+
     pub fn executeRaw(self: *DatabaseContext, query: []const u8) !result.ResultSet {
-        // Create a QueryPlanner instance
-        var query_planner = try planner.QueryPlanner.init(self.allocator);
-        defer query_planner.deinit();
+        // EXPLAIN [ANALYZE] <query>
+        const trimmed = std.mem.trim(u8, query, &std.ascii.whitespace);
+        if (trimmed.len > 7 and std.ascii.eqlIgnoreCase("EXPLAIN", trimmed[0..7]) and std.ascii.isWhitespace(trimmed[7])) {
+            const rest = std.mem.trimLeft(u8, trimmed[7..], &std.ascii.whitespace);
+            if (rest.len > 7 and std.ascii.eqlIgnoreCase("ANALYZE", rest[0..7]) and std.ascii.isWhitespace(rest[7])) {
+                return try self.explain(std.mem.trimLeft(u8, rest[7..], &std.ascii.whitespace), true);
+            }
+            return try self.explain(rest, false);
+        }
+
+        // Everything needed to plan the query, and the scratch its execution
+        // needs, lives in a per-query arena that is released in one step when
+        // the query finishes. Short queries are served from the stack buffer
+        // without touching the shared allocator at all.
+        var arena_fallback = std.heap.stackFallback(query_arena_stack_bytes, self.allocator);
+        var arena = std.heap.ArenaAllocator.init(arena_fallback.get());
+        defer arena.deinit();
+
+        const version = self.pinCatalog();
+        defer self.unpinCatalog(version);
+        const physical_plan = try planQuery(arena.allocator(), query, version);
 
-        // Parse the SQL query
-        const ast = try query_planner.*.parse(query);
-        defer ast.deinit();
+        // The result set is allocated from the context allocator so it outlives the arena;
+        // ownership moves to the caller, who must deinit it.
+        const manager = self.txn_manager orelse return try QueryExecutor.executeWithScratch(self.allocator, arena.allocator(), physical_plan, self, Snapshot.latest);
+
+        // Run as a read-only transaction so the query sees one snapshot throughout,
+        // and garbage collection keeps the versions it reads
+        const txn = try manager.beginTransaction();
+        errdefer manager.abortTransaction(txn) catch {};
+        var result_set = try QueryExecutor.executeWithScratch(self.allocator, arena.allocator(), physical_plan, self, txn.snapshot());
+        errdefer result_set.deinit();
+        try manager.commitTransaction(txn);
+        return result_set;
+    }
 
-        // Generate logical plan
-        const logical_plan = try query_planner.*.plan(ast);
-        defer logical_plan.deinit();
+    /// Run a query at `snapshot`, for reads inside an explicit transaction
+    pub fn executeRawAt(self: *DatabaseContext, query: []const u8, snapshot: Snapshot) !result.ResultSet {
+        var arena_fallback = std.heap.stackFallback(query_arena_stack_bytes, self.allocator);
+        var arena = std.heap.ArenaAllocator.init(arena_fallback.get());
+        defer arena.deinit();
 
-        // Optimize and create physical plan - optimize is a module function, not a method
-        const physical_plan = try planner.optimize(query_planner, logical_plan);
-        defer physical_plan.deinit();
+        const version = self.pinCatalog();
+        defer self.unpinCatalog(version);
+        const physical_plan = try planQuery(arena.allocator(), query, version);
+        return try QueryExecutor.executeWithScratch(self.allocator, arena.allocator(), physical_plan, self, snapshot);
+    }
+
+    /// Plan a query and open a cursor over it. Without `snapshot` the cursor
+    /// reads in its own read-only transaction, which ends when it is closed.
+    /// The plan lives as long as the cursor.
+    pub fn openCursor(self: *DatabaseContext, query: []const u8, snapshot: ?Snapshot) !*Cursor {
+        const arena = try self.allocator.create(std.heap.ArenaAllocator);
+        arena.* = std.heap.ArenaAllocator.init(self.allocator);
+        errdefer {
+            arena.deinit();
+            self.allocator.destroy(arena);
+        }
+        const physical_plan = blk: {
+            const version = self.pinCatalog();
+            defer self.unpinCatalog(version);
+            break :blk try planQuery(arena.allocator(), query, version);
+        };
+
+        var txn: ?*Transaction = null;
+        const read_snapshot = snapshot orelse if (self.txn_manager) |manager| blk: {
+            txn = try manager.beginTransaction();
+            break :blk txn.?.snapshot();
+        } else Snapshot.latest;
+        errdefer if (txn) |t| self.txn_manager.?.abortTransaction(t) catch {};
+
+        // The plan's arena lives as long as the cursor and holds its scratch
+        const cursor = try Cursor.open(self.allocator, arena.allocator(), physical_plan, self, read_snapshot, null);
+        cursor.plan_arena = arena;
+        cursor.txn = txn;
+        cursor.txn_manager = self.txn_manager;
+        return cursor;
+    }
+
+    /// Read view for queries that are not part of a transaction
+    fn latestSnapshot(self: *DatabaseContext) Snapshot {
+        const manager = self.txn_manager orelse return Snapshot.latest;
+        return manager.currentSnapshot();
+    }
+
+    /// Pin the current catalog version for one query, so DDL running
+    /// alongside cannot change or free what the query planned against
+    fn pinCatalog(self: *DatabaseContext) ?*const catalog.Version {
+        const schemas = self.table_schemas orelse return null;
+        return schemas.acquire();
+    }
+
+    fn unpinCatalog(self: *DatabaseContext, version: ?*const catalog.Version) void {
+        if (version) |pinned| self.table_schemas.?.release(pinned);
+    }
 
-        // Execute the physical plan
-        return try QueryExecutor.execute(self.allocator, physical_plan, self);
+    /// Parse, plan and optimize a query. Every allocation is made from `arena`,
+    /// so none of the intermediate structures are freed individually.
+    fn planQuery(arena: std.mem.Allocator, query: []const u8, version: ?*const catalog.Version) !*planner.PhysicalPlan {
+        const query_planner = try planner.QueryPlanner.init(arena);
+        query_planner.catalog = version;
+        const ast = try query_planner.parse(query);
+        const logical_plan = try query_planner.plan(ast);
+        // optimize is a module function, not a method
+        return try planner.optimize(query_planner, logical_plan);
+    }
+
+    /// Plan a query and return the chosen physical plan as a one-column result set.
+    /// With `analyze`, the query is also executed and each operator is annotated
+    /// with actual rows, batches, wall/CPU time, bytes allocated and parallel degree.
+    pub fn explain(self: *DatabaseContext, query: []const u8, analyze: bool) !result.ResultSet {
+        var arena_fallback = std.heap.stackFallback(query_arena_stack_bytes, self.allocator);
+        var arena = std.heap.ArenaAllocator.init(arena_fallback.get());
+        defer arena.deinit();
+        const arena_allocator = arena.allocator();
+
+        const version = self.pinCatalog();
+        defer self.unpinCatalog(version);
+
+        var planning_timer = try std.time.Timer.start();
+        const physical_plan = try planQuery(arena_allocator, query, version);
+        const planning_ns = planning_timer.read();
+
+        // Estimates come from the current table sizes
+        const stats = try statistics.Statistics.init(arena_allocator);
+        if (version) |pinned| {
+            var it = pinned.tableIterator();
+            while (it.next()) |entry| {
+                const schema = entry.value_ptr.*;
+                schema.latch.lockShared();
+                defer schema.latch.unlockShared();
+                try stats.addTableStatistics(entry.key_ptr.*, schema.rowCount());
+            }
+        }
+
+        // Same weights the database calibrated for this host
+        const model = try CostModel.initWithWeights(arena_allocator, stats, self.cost_weights);
+
+        var op_profile = try OperatorProfile.initForPlan(arena_allocator, physical_plan);
+
+        var execution_ns: u64 = 0;
+        if (analyze) {
+            // The analyzed rows are discarded, so they can live in the arena too.
+            // Releasing them still matters: they may hold table segments.
+            var execution_timer = try std.time.Timer.start();
+            var analyzed = try QueryExecutor.executeProfiled(arena_allocator, physical_plan, self, self.latestSnapshot(), &op_profile);
+            execution_ns = execution_timer.read();
+            analyzed.deinit();
+        }
+
+        const plan_lines = try explain.explainPlan(arena_allocator, physical_plan, model, if (analyze) &op_profile else null);
+
+        const summary_lines: usize = if (analyze) 2 else 1;
+        var result_set = try result.ResultSet.init(self.allocator, 1, plan_lines.len + summary_lines);
+        errdefer result_set.deinit();
+        result_set.columns[0].name = try self.allocator.dupe(u8, "QUERY PLAN");
+        result_set.columns[0].data_type = .String;
+
+        for (plan_lines, 0..) |line, i| {
+            try result_set.setValue(i, 0, result.Value{ .text = try self.allocator.dupe(u8, line) });
+        }
+        try result_set.setValue(plan_lines.len, 0, result.Value{
+            .text = try std.fmt.allocPrint(self.allocator, "Planning time: {d:.3} ms", .{explain.nsToMs(planning_ns)}),
+        });
+        if (analyze) {
+            try result_set.setValue(plan_lines.len + 1, 0, result.Value{
+                .text = try std.fmt.allocPrint(self.allocator, "Execution time: {d:.3} ms", .{explain.nsToMs(execution_ns)}),
+            });
+        }
+
+        return result_set;
     }
 };
 
 /// Query executor for executing physical plans
 pub const QueryExecutor = struct {
-    /// Execute a physical plan and return a result set
+    /// Number of rows an operator produces per batch
+    pub const batch_size: usize = 1024;
+
+    /// Execute a physical plan against the latest committed data and return a result set
     pub fn execute(allocator: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext) !result.ResultSet {
+        return try executeProfiled(allocator, plan, context, Snapshot.latest, null);
+    }
+
+    /// Execute a physical plan, seeing only the row versions visible in `snapshot`
+    pub fn executeAt(allocator: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot) !result.ResultSet {
+        return try executeProfiled(allocator, plan, context, snapshot, null);
+    }
+
+    /// Execute a physical plan at `snapshot`, taking the working memory that
+    /// does not outlive the call (resolved predicates, selection bitmaps, sort
+    /// keys, intermediate results) from `scratch`, such as a per-query arena.
+    /// The result set is allocated from `allocator`.
+    pub fn executeWithScratch(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot) !result.ResultSet {
+        return try executeNode(allocator, scratch, plan, context, snapshot, null);
+    }
+
+    /// Execute a physical plan, recording runtime statistics into `op_profile` when given
+    pub fn executeProfiled(allocator: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, op_profile: ?*OperatorProfile) !result.ResultSet {
+        return try executeProfiledWithScratch(allocator, allocator, plan, context, snapshot, op_profile);
+    }
+
+    /// A profiled operator counts its scratch with its other allocations
+    fn executeProfiledWithScratch(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, op_profile: ?*OperatorProfile) anyerror!result.ResultSet {
+        const p = op_profile orelse return try executeNode(allocator, scratch, plan, context, snapshot, null);
+
+        var counting = CountingAllocator.init(allocator);
+        var op_timer = try profile.OperatorTimer.start();
+
+        var result_set = try executeNode(counting.allocator(), counting.allocator(), plan, context, snapshot, p);
+        op_timer.stop(p);
+
+        // The counting wrapper only lives for this call; hand ownership back to the caller's allocator
+        result_set.rebind(allocator);
+
+        p.rows += result_set.row_count;
+        p.bytes_allocated += counting.bytesAllocated();
+        p.allocations += counting.allocationCount();
+        if (p.batches == 0 and result_set.row_count > 0) {
+            p.batches = 1;
+        }
+
+        return result_set;
+    }
+
+    fn executeNode(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, op_profile: ?*OperatorProfile) !result.ResultSet {
         // Execute the plan based on its node type
         switch (plan.node_type) {
             .IndexSeek => return try executeIndexSeek(allocator, plan, context),
             .IndexRangeScan => return try executeIndexRangeScan(allocator, plan, context),
             .IndexScan => return try executeIndexScan(allocator, plan, context),
-            .TableScan => return try executeTableScan(allocator, plan, context),
+            .TableScan => return try executeTableScan(allocator, scratch, plan, context, snapshot, op_profile),
+            .Limit, .Sort => {
+                // The cursor stops the scan once the limit is reached, and
+                // reads a sort's output back from its spilled runs
+                const cursor = try Cursor.open(allocator, scratch, plan, context, snapshot, op_profile);
+                defer cursor.close();
+                return try cursor.fetch(std.math.maxInt(usize));
+            },
+            .TopN => return try executeTopN(allocator, scratch, plan, context, snapshot, op_profile),
             else => {
                 // For other node types, we would implement specific execution strategies
                 // For now, we'll just return an empty result set
@@ -93,6 +341,30 @@ pub const QueryExecutor = struct {
         }
     }
 
+    /// ORDER BY ... LIMIT: keep the first `limit` rows of the child in key
+    /// order. The child's chunks are read in place; only the rows returned
+    /// are copied, so the child's result is scratch. The explicit error set
+    /// breaks the recursion through executeProfiledWithScratch.
+    fn executeTopN(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, op_profile: ?*OperatorProfile) anyerror!result.ResultSet {
+        const kids = plan.children orelse return error.MissingChild;
+        const sort_keys = plan.sort_keys orelse return error.MissingSortKeys;
+        const limit = std.math.cast(usize, plan.limit orelse return error.MissingLimit) orelse std.math.maxInt(usize);
+        const child_profile = childProfile(op_profile);
+
+        var input = try executeProfiledWithScratch(scratch, scratch, &kids[0], context, snapshot, child_profile);
+        defer input.deinit();
+        const keys = try sort.resolveKeys(scratch, sort_keys, input.columns);
+        defer scratch.free(keys);
+
+        var result_set = try copyHeader(allocator, input.columns);
+        errdefer result_set.deinit();
+        const chunks = input.chunks.items;
+        const workers = sort.workerCount(input.row_count, chunks.len, plan.parallel_degree);
+        if (op_profile) |p| p.parallel_degree = @intCast(workers);
+        try result_set.appendChunk(try sort.topN(allocator, scratch, chunks, input.columns.len, keys, limit, workers));
+        return result_set;
+    }
+
     /// Execute an index seek operation (direct lookup using an index)
     fn executeIndexSeek(allocator: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext) !result.ResultSet {
         // Validate that we have the necessary information
@@ -207,32 +479,14 @@ pub const QueryExecutor = struct {
 
     /// Execute a table scan operation
     /// NOTE: Caller must always deinit the returned ResultSet.
-    fn executeTableScan(allocator: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext) !result.ResultSet {
+    fn executeTableScan(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, op_profile: ?*OperatorProfile) !result.ResultSet {
         if (plan.table_name == null) {
             return error.MissingTableName;
         }
         const table_name = plan.table_name.?;
         if (context.table_schemas) |schemas| {
             if (schemas.get(table_name)) |schema| {
-                // Return result set with correct columns and rows from in-memory storage
-                var result_set = try result.ResultSet.init(allocator, schema.columns.len, schema.rows.items.len);
-                for (schema.columns, 0..) |col, i| {
-                    result_set.columns[i].name = try allocator.dupe(u8, col.name);
-                    // Map enum type to DataType
-                    result_set.columns[i].data_type = switch (col.data_type) {
-                        .Int => .Int64,
-                        .Float => .Float64,
-                        .Text => .String,
-                        .Bool => .Bool,
-                    };
-                }
-                // Copy rows
-                for (schema.rows.items, 0..) |row, r| {
-                    for (row, 0..) |val, c| {
-                        result_set.rows[r].values[c] = val;
-                    }
-                }
-                return result_set;
+                return try scanTable(allocator, scratch, plan, schema, snapshot, op_profile);
             }
         }
         // Fallback: old mock data or error
@@ -242,11 +496,543 @@ pub const QueryExecutor = struct {
             result_set.deinit();
             return err;
         };
-        result_set.rows[0].values[0] = result.Value{ .text = error_message };
+        result_set.setValue(0, 0, result.Value{ .text = error_message }) catch unreachable;
         return result_set;
     }
 };
 
+/// A scan predicate resolved against a table's columns
+pub const ScanPredicate = struct {
+    column: usize,
+    op: column_segment.CompareOp,
+    literal: result.Value,
+};
+
+/// Rows of a table chosen by a scan: one bitmap per sealed segment, then one for the tail
+pub const RowSelection = struct {
+    allocator: std.mem.Allocator,
+    bitmaps: [][]u64,
+    count: usize, // Selected rows over all bitmaps
+
+    pub fn segment(self: *const RowSelection, index: usize) []u64 {
+        return self.bitmaps[index];
+    }
+
+    pub fn tail(self: *const RowSelection) []u64 {
+        return self.bitmaps[self.bitmaps.len - 1];
+    }
+
+    pub fn deinit(self: *RowSelection) void {
+        for (self.bitmaps) |bitmap| self.allocator.free(bitmap);
+        self.allocator.free(self.bitmaps);
+    }
+};
+
+/// Select the rows of a table that are visible in `snapshot` and satisfy every
+/// predicate. Blocks whose zone maps rule out a predicate are skipped; the rest
+/// have the predicates evaluated on the compressed segments without decoding rows.
+/// The caller holds `schema.latch`.
+pub fn selectRows(allocator: std.mem.Allocator, schema: *TableSchema, predicates: []const ScanPredicate, snapshot: Snapshot, op_profile: ?*OperatorProfile) !RowSelection {
+    const bitmaps = try allocator.alloc([]u64, schema.segments.items.len + 1);
+    var built: usize = 0;
+    errdefer {
+        for (bitmaps[0..built]) |bitmap| allocator.free(bitmap);
+        allocator.free(bitmaps);
+    }
+
+    var selected_rows: usize = 0;
+    for (schema.segments.items, 0..) |segment, s| {
+        bitmaps[s] = try selectSegment(allocator, segment, predicates, snapshot, op_profile);
+        built += 1;
+        selected_rows += column_segment.countSelected(bitmaps[s]);
+    }
+
+    const tail_selection = try selectTail(allocator, schema, predicates, snapshot, op_profile);
+    bitmaps[schema.segments.items.len] = tail_selection;
+    built += 1;
+    selected_rows += column_segment.countSelected(tail_selection);
+
+    return RowSelection{ .allocator = allocator, .bitmaps = bitmaps, .count = selected_rows };
+}
+
+/// Select the rows of one sealed segment, skipping it outright when its zone
+/// maps rule out a predicate. The caller holds the table's latch.
+fn selectSegment(allocator: std.mem.Allocator, segment: *RowSegment, predicates: []const ScanPredicate, snapshot: Snapshot, op_profile: ?*OperatorProfile) ![]u64 {
+    const bitmap = try column_segment.initSelection(allocator, segment.row_count);
+
+    const skip = for (predicates) |pred| {
+        if (!segment.mayMatch(pred.column, pred.op, pred.literal)) break true;
+    } else false;
+    if (skip) {
+        @memset(bitmap, 0);
+        if (op_profile) |p| p.blocks_skipped += 1;
+        return bitmap;
+    }
+
+    segment.versions.filterVisible(snapshot, bitmap);
+    for (predicates) |pred| {
+        segment.columns[pred.column].filter(pred.op, pred.literal, bitmap);
+    }
+    return bitmap;
+}
+
+/// Select the unsealed tail rows of a table. The caller holds `schema.latch`.
+fn selectTail(allocator: std.mem.Allocator, schema: *TableSchema, predicates: []const ScanPredicate, snapshot: Snapshot, op_profile: ?*OperatorProfile) ![]u64 {
+    const tail = schema.rows.items;
+    const tail_selection = try column_segment.initSelection(allocator, tail.len);
+    const skip_tail = for (predicates) |pred| {
+        if (!schema.tail_zone_maps[pred.column].mayMatch(pred.op, pred.literal)) break true;
+    } else false;
+    if (skip_tail) {
+        @memset(tail_selection, 0);
+        if (op_profile) |p| {
+            if (tail.len > 0) p.blocks_skipped += 1;
+        }
+    } else for (tail, schema.tail_begin_ts.items, schema.tail_end_ts.items, 0..) |row, begin_ts, end_ts, r| {
+        if (!snapshot.isVisible(begin_ts, end_ts)) {
+            column_segment.clearBit(tail_selection, r);
+            continue;
+        }
+        for (predicates) |pred| {
+            if (!column_segment.matches(row[pred.column], pred.op, pred.literal)) {
+                column_segment.clearBit(tail_selection, r);
+                break;
+            }
+        }
+    }
+    return tail_selection;
+}
+
+/// Scan the row versions of a table visible in `snapshot`, evaluating the plan's
+/// predicates before any rows are decoded
+fn scanTable(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, schema: *TableSchema, snapshot: Snapshot, op_profile: ?*OperatorProfile) !result.ResultSet {
+    var result_set = try tableHeader(allocator, schema);
+    errdefer result_set.deinit();
+
+    var source = try ScanSource.init(allocator, scratch, plan, schema, snapshot, std.math.maxInt(usize), op_profile);
+    defer source.deinit();
+    while (try source.next()) |chunk| {
+        try result_set.appendChunk(chunk);
+    }
+    return result_set;
+}
+
+/// An empty result set with the columns of a table
+fn tableHeader(allocator: std.mem.Allocator, schema: *const TableSchema) !result.ResultSet {
+    var result_set = try result.ResultSet.init(allocator, schema.columns.len, 0);
+    errdefer result_set.deinit();
+    for (schema.columns, 0..) |col, i| {
+        result_set.columns[i].name = try allocator.dupe(u8, col.name);
+        // Map enum type to DataType
+        result_set.columns[i].data_type = switch (col.data_type) {
+            .Int => .Int64,
+            .Float => .Float64,
+            .Text => .String,
+            .Bool => .Bool,
+        };
+    }
+    return result_set;
+}
+
+/// An empty result set with copies of the names and types of `columns`
+fn copyHeader(allocator: std.mem.Allocator, columns: []const result.ResultColumn) !result.ResultSet {
+    var result_set = try result.ResultSet.init(allocator, columns.len, 0);
+    errdefer result_set.deinit();
+    for (result_set.columns, columns) |*column, source| {
+        column.name = try allocator.dupe(u8, source.name);
+        column.data_type = source.data_type;
+    }
+    return result_set;
+}
+
+/// The rows of one table scan, a chunk at a time: a view of the selected rows
+/// of each sealed segment, then a copy of the selected tail rows. The segment
+/// list and the tail are captured when the scan starts, so seals and garbage
+/// collection running meanwhile do not move rows under it. A segment's
+/// versions are filtered under the table latch when the scan reaches it.
+const ScanSource = struct {
+    allocator: std.mem.Allocator, // Chunks handed to the caller
+    scratch: std.mem.Allocator, // Predicates, the segment list and selection bitmaps
+    schema: *TableSchema,
+    predicates: []ScanPredicate,
+    snapshot: Snapshot,
+    segments: []*RowSegment, // Each is retained until the scan reaches it
+    next_segment: usize = 0,
+    tail: ?*result.Chunk,
+    op_profile: ?*OperatorProfile,
+
+    /// At most `max_tail_rows` selected tail rows are copied, which is all a
+    /// LIMIT can use of them
+    fn init(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *const planner.PhysicalPlan, schema: *TableSchema, snapshot: Snapshot, max_tail_rows: usize, op_profile: ?*OperatorProfile) !ScanSource {
+        const predicates = try resolvePredicates(scratch, plan.predicates, schema);
+        errdefer scratch.free(predicates);
+
+        schema.latch.lockShared();
+        defer schema.latch.unlockShared();
+
+        const segments = try scratch.dupe(*RowSegment, schema.segments.items);
+        errdefer scratch.free(segments);
+        const tail = try copyTail(allocator, scratch, schema, predicates, snapshot, max_tail_rows, op_profile);
+        for (segments) |segment| segment.retain();
+
+        return ScanSource{
+            .allocator = allocator,
+            .scratch = scratch,
+            .schema = schema,
+            .predicates = predicates,
+            .snapshot = snapshot,
+            .segments = segments,
+            .tail = tail,
+            .op_profile = op_profile,
+        };
+    }
+
+    fn deinit(self: *ScanSource) void {
+        for (self.segments[self.next_segment..]) |segment| segment.release(self.schema.rows.allocator);
+        self.scratch.free(self.segments);
+        if (self.tail) |tail| tail.release();
+        self.scratch.free(self.predicates);
+    }
+
+    /// The next chunk of selected rows, or null when the scan is done.
+    /// The caller owns the returned reference.
+    fn next(self: *ScanSource) !?*result.Chunk {
+        const segment_allocator = self.schema.rows.allocator;
+        while (self.next_segment < self.segments.len) {
+            const segment = self.segments[self.next_segment];
+            const rows = try self.selectedRows(segment);
+            self.next_segment += 1;
+            defer segment.release(segment_allocator);
+
+            if (rows.len == 0) {
+                self.allocator.free(rows);
+                continue;
+            }
+            const chunk = result.Chunk.createView(self.allocator, segment, segment_allocator, rows) catch |err| {
+                self.allocator.free(rows);
+                return err;
+            };
+            if (self.op_profile) |p| p.batches += 1;
+            return chunk;
+        }
+
+        const tail = self.tail orelse return null;
+        self.tail = null;
+        return tail;
+    }
+
+    /// Row numbers of the selected rows of `segment`
+    fn selectedRows(self: *ScanSource, segment: *RowSegment) ![]u32 {
+        const bitmap = blk: {
+            // Deletes end versions in place, so they are read under the latch
+            self.schema.latch.lockShared();
+            defer self.schema.latch.unlockShared();
+            break :blk try selectSegment(self.scratch, segment, self.predicates, self.snapshot, self.op_profile);
+        };
+        defer self.scratch.free(bitmap);
+
+        const rows = try self.allocator.alloc(u32, column_segment.countSelected(bitmap));
+        var out: usize = 0;
+        for (0..segment.row_count) |r| {
+            if (!column_segment.isSelected(bitmap, r)) continue;
+            rows[out] = @intCast(r);
+            out += 1;
+        }
+        return rows;
+    }
+};
+
+/// Copy up to `max_rows` selected tail rows, one batch at a time, into a chunk
+/// whose text shares one arena. Returns null if no row is selected.
+/// The selection bitmap is taken from `scratch`. The caller holds `schema.latch`.
+fn copyTail(allocator: std.mem.Allocator, scratch: std.mem.Allocator, schema: *TableSchema, predicates: []const ScanPredicate, snapshot: Snapshot, max_rows: usize, op_profile: ?*OperatorProfile) !?*result.Chunk {
+    const selection = try selectTail(scratch, schema, predicates, snapshot, op_profile);
+    defer scratch.free(selection);
+    const count = @min(column_segment.countSelected(selection), max_rows);
+    if (count == 0) return null;
+
+    const chunk = try result.Chunk.createOwned(allocator, schema.columns.len, count, true);
+    errdefer chunk.release();
+    const tail = schema.rows.items;
+    var batch_start: usize = 0;
+    while (chunk.row_count < count) : (batch_start += QueryExecutor.batch_size) {
+        const batch_end = @min(batch_start + QueryExecutor.batch_size, tail.len);
+        for (tail[batch_start..batch_end], batch_start..) |row, r| {
+            if (chunk.row_count == count) break;
+            if (column_segment.isSelected(selection, r)) try chunk.appendRowCopy(row);
+        }
+        if (op_profile) |p| p.batches += 1;
+    }
+    return chunk;
+}
+
+/// Pull-based execution of a plan. Each fetch() returns the next rows as a
+/// result set of at most `max_rows` rows, so a client can be sent the first
+/// rows before the rest are read, and only one batch is held at a time.
+/// A LIMIT stops the scan as soon as it has produced enough rows: the
+/// segments after that point are never filtered or decoded. An ORDER BY
+/// sorts its input when opened, within the query memory limit, and returns
+/// the rows from its runs. Other plans run to completion when opened and
+/// are then returned in batches.
+pub const Cursor = struct {
+    allocator: std.mem.Allocator,
+    header: result.ResultSet, // Column names and types, without rows
+    source: ?Source, // Null once exhausted or stopped by the LIMIT
+    source_profile: ?*OperatorProfile, // The operator under the LIMIT, when profiled
+    remaining: ?usize, // Rows the LIMIT still allows
+    current: ?*result.Chunk = null, // Chunk being returned, from `offset` on
+    offset: usize = 0,
+    // Set when opened from query text; released with the cursor
+    plan_arena: ?*std.heap.ArenaAllocator = null,
+    txn: ?*Transaction = null,
+    txn_manager: ?*TransactionManager = null,
+
+    /// Open a cursor over `plan`, which must outlive it, as must `scratch`.
+    /// Fetched rows are allocated from `allocator`.
+    pub fn open(allocator: std.mem.Allocator, scratch: std.mem.Allocator, plan: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, op_profile: ?*OperatorProfile) anyerror!*Cursor {
+        var node = plan;
+        var node_profile = op_profile;
+        var remaining: ?usize = null;
+        while (node.node_type == .Limit) {
+            const kids = node.children orelse return error.MissingChild;
+            const limit = std.math.cast(usize, node.limit orelse return error.MissingLimit) orelse std.math.maxInt(usize);
+            remaining = @min(remaining orelse limit, limit);
+            node = &kids[0];
+            node_profile = childProfile(node_profile);
+        }
+
+        var source = try Source.open(allocator, scratch, node, context, snapshot, remaining orelse std.math.maxInt(usize), node_profile);
+        errdefer source.deinit();
+        var header = try source.header(allocator);
+        errdefer header.deinit();
+
+        const cursor = try allocator.create(Cursor);
+        cursor.* = Cursor{
+            .allocator = allocator,
+            .header = header,
+            .source = source,
+            // The plan's root is profiled by the caller
+            .source_profile = if (node != plan) node_profile else null,
+            .remaining = remaining,
+        };
+        if (cursor.source_profile) |p| p.executed = true;
+        return cursor;
+    }
+
+    /// Stop the query and free the cursor, ending its transaction if it has one
+    pub fn close(self: *Cursor) void {
+        self.finish();
+        self.header.deinit();
+        if (self.txn) |txn| self.txn_manager.?.commitTransaction(txn) catch {};
+        if (self.plan_arena) |arena| {
+            arena.deinit();
+            self.allocator.destroy(arena);
+        }
+        self.allocator.destroy(self);
+    }
+
+    /// The next rows, at most `max_rows` of them. Fewer rows than asked for
+    /// means the cursor is exhausted. Sealed segment rows are not copied.
+    pub fn fetch(self: *Cursor, max_rows: usize) !result.ResultSet {
+        var batch = try copyHeader(self.allocator, self.header.columns);
+        errdefer batch.deinit();
+
+        var budget = max_rows;
+        if (self.remaining) |remaining| budget = @min(budget, remaining);
+        while (budget > 0) {
+            const chunk = self.current orelse (try self.nextChunk()) orelse break;
+            self.current = chunk;
+
+            const n = @min(budget, chunk.row_count - self.offset);
+            if (n == chunk.row_count) {
+                chunk.retain();
+                try batch.appendChunk(chunk);
+            } else {
+                try batch.appendChunk(try result.Chunk.createSlice(self.allocator, chunk, self.offset, n));
+            }
+            self.offset += n;
+            budget -= n;
+            if (self.remaining) |*remaining| remaining.* -= n;
+
+            if (self.offset == chunk.row_count) {
+                chunk.release();
+                self.current = null;
+                self.offset = 0;
+            }
+        }
+
+        // Nothing past the LIMIT is read
+        if (self.remaining) |remaining| {
+            if (remaining == 0) self.finish();
+        }
+        return batch;
+    }
+
+    /// Release the source and the chunk in progress
+    fn finish(self: *Cursor) void {
+        if (self.current) |chunk| chunk.release();
+        self.current = null;
+        if (self.source) |*source| source.deinit();
+        self.source = null;
+    }
+
+    fn nextChunk(self: *Cursor) !?*result.Chunk {
+        const source = if (self.source) |*source| source else return null;
+        if (try source.next()) |chunk| {
+            if (self.source_profile) |p| p.rows += chunk.row_count;
+            return chunk;
+        }
+        source.deinit();
+        self.source = null;
+        return null;
+    }
+};
+
+/// Where a cursor's chunks come from: a table scan read as it goes, a sort
+/// returning its runs, or the result of any other plan
+const Source = union(enum) {
+    scan: ScanSource,
+    sorted: Sorted,
+    materialized: Materialized,
+
+    const Sorted = struct {
+        sorter: *sort.ExternalSort,
+        header: result.ResultSet,
+    };
+
+    const Materialized = struct {
+        result_set: result.ResultSet,
+        next_chunk: usize = 0,
+    };
+
+    /// Start executing `node`. A table scan copies at most `max_rows` of
+    /// its tail. The explicit error set breaks the recursion with
+    /// QueryExecutor.executeNode.
+    fn open(allocator: std.mem.Allocator, scratch: std.mem.Allocator, node: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, max_rows: usize, node_profile: ?*OperatorProfile) anyerror!Source {
+        switch (node.node_type) {
+            .TableScan => if (node.table_name != null and context.table_schemas != null) {
+                if (context.table_schemas.?.get(node.table_name.?)) |schema| {
+                    return .{ .scan = try ScanSource.init(allocator, scratch, node, schema, snapshot, max_rows, node_profile) };
+                }
+            },
+            .Sort => return .{ .sorted = try openSort(allocator, scratch, node, context, snapshot, node_profile) },
+            else => {},
+        }
+        return .{ .materialized = .{ .result_set = try QueryExecutor.executeNode(allocator, scratch, node, context, snapshot, node_profile) } };
+    }
+
+    fn deinit(self: *Source) void {
+        switch (self.*) {
+            .scan => |*scan| scan.deinit(),
+            .sorted => |*sorted| {
+                sorted.sorter.destroy();
+                sorted.header.deinit();
+            },
+            .materialized => |*materialized| materialized.result_set.deinit(),
+        }
+    }
+
+    /// An empty result set with the source's columns
+    fn header(self: *const Source, allocator: std.mem.Allocator) !result.ResultSet {
+        return switch (self.*) {
+            .scan => |scan| try tableHeader(allocator, scan.schema),
+            .sorted => |sorted| try copyHeader(allocator, sorted.header.columns),
+            .materialized => |materialized| try copyHeader(allocator, materialized.result_set.columns),
+        };
+    }
+
+    /// The next chunk, or null when the source is exhausted.
+    /// The caller owns the returned reference.
+    fn next(self: *Source) !?*result.Chunk {
+        switch (self.*) {
+            .scan => |*scan| return try scan.next(),
+            .sorted => |sorted| return try sorted.sorter.next(QueryExecutor.batch_size),
+            .materialized => |*materialized| {
+                const chunks = materialized.result_set.chunks.items;
+                while (materialized.next_chunk < chunks.len) {
+                    const chunk = chunks[materialized.next_chunk];
+                    materialized.next_chunk += 1;
+                    if (chunk.row_count == 0) continue;
+                    chunk.retain();
+                    return chunk;
+                }
+                return null;
+            },
+        }
+    }
+
+    /// ORDER BY without a LIMIT: feed the child's rows to an external sort,
+    /// which spills runs to the context's spill directory once it holds more
+    /// than the query memory limit
+    fn openSort(allocator: std.mem.Allocator, scratch: std.mem.Allocator, node: *planner.PhysicalPlan, context: *DatabaseContext, snapshot: Snapshot, node_profile: ?*OperatorProfile) anyerror!Sorted {
+        const kids = node.children orelse return error.MissingChild;
+        const sort_keys = node.sort_keys orelse return error.MissingSortKeys;
+        const child_profile = childProfile(node_profile);
+
+        var input = try Source.open(allocator, scratch, &kids[0], context, snapshot, std.math.maxInt(usize), child_profile);
+        defer input.deinit();
+        var columns = try input.header(allocator);
+        errdefer columns.deinit();
+        const keys = try sort.resolveKeys(scratch, sort_keys, columns.columns);
+        defer scratch.free(keys);
+
+        const sorter = try sort.ExternalSort.create(allocator, columns.columns.len, keys, context.query_memory_limit, context.spill_dir);
+        errdefer sorter.destroy();
+        while (try input.next()) |chunk| {
+            defer chunk.release();
+            if (child_profile) |p| p.rows += chunk.row_count;
+            try sorter.add(chunk);
+        }
+        try sorter.finish();
+
+        if (child_profile) |p| p.executed = true;
+        if (node_profile) |p| p.bytes_spilled += sorter.bytes_spilled;
+        return Sorted{ .sorter = sorter, .header = columns };
+    }
+};
+
+/// The profile of an operator's first child, if it is profiled
+fn childProfile(op_profile: ?*OperatorProfile) ?*OperatorProfile {
+    const p = op_profile orelse return null;
+    return if (p.children.len > 0) &p.children[0] else null;
+}
+
+/// Map plan predicates onto column positions. LIKE and IN are not evaluated by the scan.
+/// The literals borrow from `preds`.
+pub fn resolvePredicates(allocator: std.mem.Allocator, preds: ?[]const planner.Predicate, schema: *TableSchema) ![]ScanPredicate {
+    var resolved = std.ArrayList(ScanPredicate).init(allocator);
+    errdefer resolved.deinit();
+
+    for (preds orelse &[_]planner.Predicate{}) |pred| {
+        const op: column_segment.CompareOp = switch (pred.op) {
+            .Eq => .Eq,
+            .Ne => .Ne,
+            .Lt => .Lt,
+            .Le => .Le,
+            .Gt => .Gt,
+            .Ge => .Ge,
+            .Like, .In => continue,
+        };
+        const column = for (schema.columns, 0..) |col, i| {
+            if (std.ascii.eqlIgnoreCase(col.name, pred.column)) break i;
+        } else return error.ColumnNotFound;
+
+        try resolved.append(ScanPredicate{
+            .column = column,
+            .op = op,
+            .literal = switch (pred.value) {
+                .String => |str| result.Value{ .text = str },
+                .Integer => |i| result.Value{ .integer = i },
+                .Float => |f| result.Value{ .float = f },
+                .Boolean => |b| result.Value{ .boolean = b },
+                .Null => result.Value{ .null = {} },
+            },
+        });
+    }
+
+    return try resolved.toOwnedSlice();
+}
+
 test "QueryExecutor basic functionality" {
     const allocator = std.testing.allocator;
     const planner_instance = try planner.QueryPlanner.init(allocator);
@@ -0,0 +1,251 @@
+const std = @import("std");
+const planner = @import("planner.zig");
+const cost_model = @import("cost_model.zig");
+const statistics = @import("statistics.zig");
+const profile = @import("profile.zig");
+const PhysicalPlan = planner.PhysicalPlan;
+const CostModel = cost_model.CostModel;
+const Statistics = statistics.Statistics;
+const OperatorProfile = profile.OperatorProfile;
+
+/// Render a physical plan tree as text lines, one operator per line.
+/// When `op_profile` is given (EXPLAIN ANALYZE), each operator is annotated
+/// with the runtime statistics collected while executing it.
+/// Caller owns the returned lines and must free each one and the slice.
+pub fn explainPlan(
+    allocator: std.mem.Allocator,
+    plan: *PhysicalPlan,
+    model: *CostModel,
+    op_profile: ?*const OperatorProfile,
+) ![][]const u8 {
+    var lines = std.ArrayList([]const u8).init(allocator);
+    errdefer {
+        for (lines.items) |line| allocator.free(line);
+        lines.deinit();
+    }
+
+    try explainNode(allocator, &lines, plan, model, op_profile, 0);
+
+    return try lines.toOwnedSlice();
+}
+
+/// Free lines returned by explainPlan
+pub fn freeLines(allocator: std.mem.Allocator, lines: [][]const u8) void {
+    for (lines) |line| allocator.free(line);
+    allocator.free(lines);
+}
+
+fn explainNode(
+    allocator: std.mem.Allocator,
+    lines: *std.ArrayList([]const u8),
+    plan: *PhysicalPlan,
+    model: *CostModel,
+    op_profile: ?*const OperatorProfile,
+    depth: usize,
+) !void {
+    var line = std.ArrayList(u8).init(allocator);
+    defer line.deinit();
+    const writer = line.writer();
+
+    // Indentation and arrow for child operators
+    if (depth > 0) {
+        try writer.writeByteNTimes(' ', (depth - 1) * 6 + 2);
+        try writer.writeAll("->  ");
+    }
+
+    // Operator description
+    try writer.writeAll(@tagName(plan.node_type));
+    if (plan.limit) |limit| {
+        try writer.print(" {d}", .{limit});
+    }
+    if (plan.sort_keys) |keys| {
+        try writer.writeAll(" by ");
+        for (keys, 0..) |key, i| {
+            if (i > 0) try writer.writeAll(", ");
+            try writer.writeAll(key.column);
+            if (key.descending) try writer.writeAll(" DESC");
+        }
+    }
+    if (plan.index_info) |info| {
+        try writer.print(" using {s}", .{info.name});
+    }
+    if (plan.table_name) |name| {
+        try writer.print(" on {s}", .{name});
+    }
+    if (plan.use_gpu) {
+        try writer.writeAll(" [GPU]");
+    }
+
+    // Estimates
+    const cost = try model.estimatePhysicalPlanCost(plan, plan.use_gpu);
+    const rows = estimateRows(model.statistics, plan);
+    try writer.print("  (cost={d:.2} rows={d}", .{ cost, rows });
+    if (plan.parallel_degree > 1) {
+        try writer.print(" workers={d}", .{plan.parallel_degree});
+    }
+    try writer.writeAll(")");
+
+    // Actuals
+    if (op_profile) |p| {
+        if (p.executed) {
+            try writer.print(" (actual rows={d} batches={d}", .{ p.rows, p.batches });
+            if (p.blocks_skipped > 0) {
+                try writer.print(" skipped={d}", .{p.blocks_skipped});
+            }
+            if (p.bytes_spilled > 0) {
+                try writer.writeAll(" spilled=");
+                try writeBytes(writer, p.bytes_spilled);
+            }
+            try writer.print(" wall={d:.3}ms cpu={d:.3}ms alloc=", .{
+                nsToMs(p.wall_ns),
+                nsToMs(p.cpu_ns),
+            });
+            try writeBytes(writer, p.bytes_allocated);
+            try writer.print(" allocs={d} workers={d})", .{ p.allocations, p.parallel_degree });
+        } else {
+            try writer.writeAll(" (never executed)");
+        }
+    }
+
+    try lines.append(try line.toOwnedSlice());
+
+    // Predicates on their own line, like most databases print filters
+    if (plan.predicates) |preds| {
+        if (preds.len > 0) {
+            var pred_line = std.ArrayList(u8).init(allocator);
+            defer pred_line.deinit();
+            const pred_writer = pred_line.writer();
+
+            try pred_writer.writeByteNTimes(' ', depth * 6 + 2);
+            try pred_writer.writeAll("Filter: ");
+            for (preds, 0..) |pred, i| {
+                if (i > 0) try pred_writer.writeAll(" AND ");
+                try pred_writer.print("{s} {s} ", .{ pred.column, opSymbol(pred.op) });
+                try writePlanValue(pred_writer, pred.value);
+            }
+            try lines.append(try pred_line.toOwnedSlice());
+        }
+    }
+
+    // Children
+    if (plan.children) |kids| {
+        for (kids, 0..) |*kid, i| {
+            const child_profile: ?*const OperatorProfile = if (op_profile) |p|
+                (if (i < p.children.len) &p.children[i] else null)
+            else
+                null;
+            try explainNode(allocator, lines, kid, model, child_profile, depth + 1);
+        }
+    }
+}
+
+/// Estimate the number of rows an operator produces
+pub fn estimateRows(stats: *Statistics, plan: *PhysicalPlan) u64 {
+    var rows: f64 = blk: {
+        if (plan.table_name) |name| {
+            if (stats.getTableRowCount(name)) |count| {
+                break :blk @floatFromInt(count);
+            }
+        }
+        if (plan.children) |kids| {
+            if (kids.len > 0) {
+                var child_rows: u64 = 0;
+                for (kids) |*kid| child_rows = @max(child_rows, estimateRows(stats, kid));
+                break :blk @floatFromInt(child_rows);
+            }
+        }
+        break :blk 1000.0;
+    };
+
+    if (plan.node_type == .IndexSeek) {
+        return 1;
+    }
+    if (plan.limit) |limit| {
+        return @max(@min(@as(u64, @intFromFloat(rows)), limit), 1);
+    }
+
+    if (plan.predicates) |preds| {
+        if (plan.table_name) |name| {
+            for (preds) |pred| {
+                rows *= stats.estimateSelectivity(name, pred.column, pred.op, pred.value, null);
+            }
+        }
+    }
+
+    return @intFromFloat(@max(rows, 1.0));
+}
+
+fn opSymbol(op: planner.PredicateOp) []const u8 {
+    return switch (op) {
+        .Eq => "=",
+        .Ne => "<>",
+        .Lt => "<",
+        .Le => "<=",
+        .Gt => ">",
+        .Ge => ">=",
+        .Like => "LIKE",
+        .In => "IN",
+    };
+}
+
+fn writePlanValue(writer: anytype, value: planner.PlanValue) !void {
+    switch (value) {
+        .String => |s| try writer.print("'{s}'", .{s}),
+        .Integer => |i| try writer.print("{d}", .{i}),
+        .Float => |f| try writer.print("{d}", .{f}),
+        .Boolean => |b| try writer.print("{}", .{b}),
+        .Null => try writer.writeAll("NULL"),
+    }
+}
+
+fn writeBytes(writer: anytype, bytes: u64) !void {
+    const b: f64 = @floatFromInt(bytes);
+    if (bytes >= 1024 * 1024) {
+        try writer.print("{d:.1}MB", .{b / (1024.0 * 1024.0)});
+    } else if (bytes >= 1024) {
+        try writer.print("{d:.1}KB", .{b / 1024.0});
+    } else {
+        try writer.print("{d}B", .{bytes});
+    }
+}
+
+pub fn nsToMs(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / 1_000_000.0;
+}
+
+test "explainPlan prints estimates and actuals" {
+    const allocator = std.testing.allocator;
+
+    const stats = try Statistics.init(allocator);
+    defer stats.deinit();
+    try stats.addTableStatistics("users", 5000);
+
+    const model = try CostModel.init(allocator, stats);
+    defer model.deinit();
+
+    var plan = PhysicalPlan{
+        .allocator = allocator,
+        .node_type = .TableScan,
+        .table_name = "users",
+    };
+
+    const lines = try explainPlan(allocator, &plan, model, null);
+    defer freeLines(allocator, lines);
+
+    try std.testing.expectEqual(@as(usize, 1), lines.len);
+    try std.testing.expect(std.mem.startsWith(u8, lines[0], "TableScan on users"));
+    try std.testing.expect(std.mem.indexOf(u8, lines[0], "rows=5000") != null);
+
+    const op_profile = OperatorProfile{
+        .node_type = .TableScan,
+        .executed = true,
+        .rows = 4999,
+        .batches = 5,
+        .bytes_allocated = 2048,
+    };
+    const analyzed = try explainPlan(allocator, &plan, model, &op_profile);
+    defer freeLines(allocator, analyzed);
+
+    try std.testing.expect(std.mem.indexOf(u8, analyzed[0], "actual rows=4999 batches=5") != null);
+    try std.testing.expect(std.mem.indexOf(u8, analyzed[0], "alloc=2.0KB") != null);
+}
@@ -9,6 +9,7 @@ pub const PhysicalNodeType = enum {
     NestedLoopJoin,
     HashJoin,
     Sort,
+    TopN, // Sort fused with the LIMIT above it
     Limit,
     Aggregate,
     GroupBy,
@@ -17,6 +18,7 @@ pub const PhysicalNodeType = enum {
 const std = @import("std");
 const assert = @import("../build_options.zig").assert;
 pub const Index = @import("../storage/index.zig").Index;
+const core_catalog = @import("../core/catalog.zig");
 
 // Structure to hold parsed query information
 pub const ParseInfo = struct {
@@ -33,9 +35,15 @@ pub const ParseInfo = struct {
     columns: ?[]const []const u8,
     all_columns: bool = false,
     where_clause: ?[]const u8,
+    order_by: ?[]const SortKey = null,
+    limit: ?u64 = null,
 
     pub fn deinit(self: *ParseInfo, allocator: std.mem.Allocator) void {
         allocator.free(self.table_name);
+        if (self.order_by) |keys| {
+            freeSortKeys(allocator, keys);
+            allocator.free(keys);
+        }
         if (self.columns) |cols| {
             for (cols) |col| {
                 allocator.free(col);
@@ -100,8 +108,16 @@ pub const LogicalPlan = struct {
     predicates: ?[]const Predicate,
     columns: ?[]const []const u8,
     children: ?[]LogicalPlan,
+    limit: ?u64 = null, // Limit only: rows to return
+    sort_keys: ?[]const SortKey = null, // Sort only: ORDER BY keys
 
     pub fn deinit(self: *LogicalPlan) void {
+        self.freeFields();
+        self.allocator.destroy(self);
+    }
+
+    /// Free what the node owns, but not the node, which may live in its parent's children
+    fn freeFields(self: *LogicalPlan) void {
         if (self.table_name) |name| {
             self.allocator.free(name);
         }
@@ -120,16 +136,25 @@ pub const LogicalPlan = struct {
             }
             self.allocator.free(cols);
         }
+        if (self.sort_keys) |keys| {
+            freeSortKeys(self.allocator, keys);
+            self.allocator.free(keys);
+        }
         if (self.children) |kids| {
             for (kids) |*child| {
-                child.deinit();
+                child.freeFields();
             }
             self.allocator.free(kids);
         }
-        self.allocator.destroy(self);
     }
 };
 
+/// One ORDER BY key
+pub const SortKey = struct {
+    column: []const u8,
+    descending: bool = false,
+};
+
 /// Predicate for filtering rows
 pub const Predicate = struct {
     column: []const u8,
@@ -158,9 +183,312 @@ pub const PlanValue = union(enum) {
     Null: void,
 };
 
+/// Parse a WHERE clause made of `column <op> literal` and
+/// `column BETWEEN low AND high` terms joined by AND. Returns null when the
+/// clause uses anything else (OR, functions, subqueries); callers reject such
+/// statements rather than run them unfiltered.
+pub fn parsePredicates(allocator: std.mem.Allocator, clause: []const u8) !?[]const Predicate {
+    var preds = std.ArrayList(Predicate).init(allocator);
+    defer preds.deinit();
+    errdefer freePredicates(allocator, preds.items);
+
+    if (!try parsePredicateList(allocator, clause, &preds)) {
+        freePredicates(allocator, preds.items);
+        return null;
+    }
+    if (preds.items.len == 0) return null;
+    return try preds.toOwnedSlice();
+}
+
+fn parsePredicateList(allocator: std.mem.Allocator, clause: []const u8, preds: *std.ArrayList(Predicate)) !bool {
+    var lexer = WhereLexer{ .input = clause };
+    while (true) {
+        const qualified = lexer.word() orelse return false;
+        // Drop any table qualifier: users.id -> id
+        const column = if (std.mem.lastIndexOfScalar(u8, qualified, '.')) |dot| qualified[dot + 1 ..] else qualified;
+
+        if (lexer.keyword("BETWEEN")) {
+            var low = (try lexer.literal(allocator)) orelse return false;
+            errdefer freePlanValue(allocator, low);
+            if (!lexer.keyword("AND")) {
+                freePlanValue(allocator, low);
+                return false;
+            }
+            const high = (try lexer.literal(allocator)) orelse {
+                freePlanValue(allocator, low);
+                return false;
+            };
+            errdefer freePlanValue(allocator, high);
+
+            try appendPredicate(allocator, preds, column, .Ge, low);
+            low = .{ .Null = {} };
+            try appendPredicate(allocator, preds, column, .Le, high);
+        } else {
+            const op = lexer.operator() orelse return false;
+            const value = (try lexer.literal(allocator)) orelse return false;
+            errdefer freePlanValue(allocator, value);
+            try appendPredicate(allocator, preds, column, op, value);
+        }
+
+        if (lexer.atEnd()) return true;
+        if (!lexer.keyword("AND")) return false;
+    }
+}
+
+/// Append a predicate, taking ownership of `value` on success
+fn appendPredicate(allocator: std.mem.Allocator, preds: *std.ArrayList(Predicate), column: []const u8, op: PredicateOp, value: PlanValue) !void {
+    const column_copy = try allocator.dupe(u8, column);
+    errdefer allocator.free(column_copy);
+    try preds.append(Predicate{ .column = column_copy, .op = op, .value = value });
+}
+
+/// Deep-copy predicates
+pub fn dupePredicates(allocator: std.mem.Allocator, preds: []const Predicate) ![]const Predicate {
+    const copy = try allocator.alloc(Predicate, preds.len);
+    var copied: usize = 0;
+    errdefer {
+        freePredicates(allocator, copy[0..copied]);
+        allocator.free(copy);
+    }
+    for (preds, 0..) |pred, i| {
+        const column = try allocator.dupe(u8, pred.column);
+        errdefer allocator.free(column);
+        copy[i] = Predicate{
+            .column = column,
+            .op = pred.op,
+            .value = if (pred.value == .String) PlanValue{ .String = try allocator.dupe(u8, pred.value.String) } else pred.value,
+        };
+        copied += 1;
+    }
+    return copy;
+}
+
+/// Free the columns and string values of predicates (not the slice itself)
+pub fn freePredicates(allocator: std.mem.Allocator, preds: []const Predicate) void {
+    for (preds) |pred| {
+        allocator.free(pred.column);
+        freePlanValue(allocator, pred.value);
+    }
+}
+
+fn freePlanValue(allocator: std.mem.Allocator, value: PlanValue) void {
+    if (value == .String) allocator.free(value.String);
+}
+
+/// Parse the keys of an ORDER BY clause: `column [ASC|DESC]`, separated by
+/// commas. Table qualifiers are dropped as in WHERE clauses.
+pub fn parseOrderBy(allocator: std.mem.Allocator, clause: []const u8) ![]const SortKey {
+    var keys = std.ArrayList(SortKey).init(allocator);
+    defer keys.deinit();
+    errdefer freeSortKeys(allocator, keys.items);
+
+    var items = std.mem.splitScalar(u8, clause, ',');
+    while (items.next()) |item| {
+        var words = std.mem.tokenizeAny(u8, item, &std.ascii.whitespace);
+        const qualified = words.next() orelse return error.InvalidSyntax;
+        const column = if (std.mem.lastIndexOfScalar(u8, qualified, '.')) |dot| qualified[dot + 1 ..] else qualified;
+        var descending = false;
+        if (words.next()) |direction| {
+            if (std.ascii.eqlIgnoreCase(direction, "DESC")) {
+                descending = true;
+            } else if (!std.ascii.eqlIgnoreCase(direction, "ASC")) {
+                return error.InvalidSyntax;
+            }
+            if (words.next() != null) return error.InvalidSyntax;
+        }
+
+        const column_copy = try allocator.dupe(u8, column);
+        errdefer allocator.free(column_copy);
+        try keys.append(SortKey{ .column = column_copy, .descending = descending });
+    }
+    return try keys.toOwnedSlice();
+}
+
+/// Deep-copy sort keys
+pub fn dupeSortKeys(allocator: std.mem.Allocator, keys: []const SortKey) ![]const SortKey {
+    const copy = try allocator.alloc(SortKey, keys.len);
+    var copied: usize = 0;
+    errdefer {
+        freeSortKeys(allocator, copy[0..copied]);
+        allocator.free(copy);
+    }
+    for (keys, copy) |key, *out| {
+        out.* = SortKey{ .column = try allocator.dupe(u8, key.column), .descending = key.descending };
+        copied += 1;
+    }
+    return copy;
+}
+
+/// Free the column names of sort keys; the slice itself is left to the caller
+pub fn freeSortKeys(allocator: std.mem.Allocator, keys: []const SortKey) void {
+    for (keys) |key| allocator.free(key.column);
+}
+
+/// Whether `text` starts with `word`, case-insensitively, followed by whitespace or the end
+pub fn startsWithWord(text: []const u8, word: []const u8) bool {
+    if (text.len < word.len or !std.ascii.eqlIgnoreCase(text[0..word.len], word)) return false;
+    return text.len == word.len or std.ascii.isWhitespace(text[word.len]);
+}
+
+/// Where a keyword sits in a query: its first byte and the byte after it
+const KeywordSpan = struct { start: usize, end: usize };
+
+/// Yields the whitespace-separated words of a query, skipping string literals
+const WordIterator = struct {
+    text: []const u8,
+    pos: usize = 0,
+
+    fn next(self: *WordIterator) ?KeywordSpan {
+        while (self.pos < self.text.len) {
+            const c = self.text[self.pos];
+            if (std.ascii.isWhitespace(c)) {
+                self.pos += 1;
+            } else if (c == '\'') {
+                // A doubled quote inside a literal just reopens it
+                const close = std.mem.indexOfScalarPos(u8, self.text, self.pos + 1, '\'') orelse self.text.len;
+                self.pos = @min(close + 1, self.text.len);
+            } else {
+                const start = self.pos;
+                while (self.pos < self.text.len and !std.ascii.isWhitespace(self.text[self.pos]) and self.text[self.pos] != '\'') : (self.pos += 1) {}
+                return KeywordSpan{ .start = start, .end = self.pos };
+            }
+        }
+        return null;
+    }
+};
+
+/// Find a keyword such as "LIMIT" or "ORDER BY" as whole words, separated
+/// by any whitespace and outside string literals
+fn findKeyword(text: []const u8, keyword: []const u8) ?KeywordSpan {
+    var words = WordIterator{ .text = text };
+    candidates: while (words.next()) |first| {
+        var parts = std.mem.tokenizeScalar(u8, keyword, ' ');
+        var rest = words;
+        var word = first;
+        while (true) {
+            const part = parts.next().?;
+            if (!std.ascii.eqlIgnoreCase(text[word.start..word.end], part)) continue :candidates;
+            if (parts.peek() == null) return KeywordSpan{ .start = first.start, .end = word.end };
+            word = rest.next() orelse return null;
+        }
+    }
+    return null;
+}
+
+/// Minimal lexer for WHERE clauses
+const WhereLexer = struct {
+    input: []const u8,
+    pos: usize = 0,
+
+    fn skipWhitespace(self: *WhereLexer) void {
+        while (self.pos < self.input.len and std.ascii.isWhitespace(self.input[self.pos])) : (self.pos += 1) {}
+    }
+
+    fn atEnd(self: *WhereLexer) bool {
+        self.skipWhitespace();
+        return self.pos >= self.input.len;
+    }
+
+    /// Identifier, possibly qualified
+    fn word(self: *WhereLexer) ?[]const u8 {
+        self.skipWhitespace();
+        const start = self.pos;
+        while (self.pos < self.input.len) : (self.pos += 1) {
+            const ch = self.input[self.pos];
+            if (!std.ascii.isAlphanumeric(ch) and ch != '_' and ch != '.') break;
+        }
+        if (self.pos == start or std.ascii.isDigit(self.input[start])) {
+            self.pos = start;
+            return null;
+        }
+        return self.input[start..self.pos];
+    }
+
+    /// Consume `kw` if it is the next word
+    fn keyword(self: *WhereLexer, kw: []const u8) bool {
+        const saved = self.pos;
+        if (self.word()) |w| {
+            if (std.ascii.eqlIgnoreCase(w, kw)) return true;
+        }
+        self.pos = saved;
+        return false;
+    }
+
+    fn operator(self: *WhereLexer) ?PredicateOp {
+        self.skipWhitespace();
+        const rest = self.input[self.pos..];
+        const ops = [_]struct { text: []const u8, op: PredicateOp }{
+            .{ .text = "<=", .op = .Le },
+            .{ .text = ">=", .op = .Ge },
+            .{ .text = "<>", .op = .Ne },
+            .{ .text = "!=", .op = .Ne },
+            .{ .text = "=", .op = .Eq },
+            .{ .text = "<", .op = .Lt },
+            .{ .text = ">", .op = .Gt },
+        };
+        for (ops) |entry| {
+            if (std.mem.startsWith(u8, rest, entry.text)) {
+                self.pos += entry.text.len;
+                return entry.op;
+            }
+        }
+        return null;
+    }
+
+    /// Quoted string ('' escapes a quote), number, TRUE/FALSE or NULL.
+    /// Strings are copied; the caller owns them.
+    fn literal(self: *WhereLexer, allocator: std.mem.Allocator) !?PlanValue {
+        self.skipWhitespace();
+        if (self.pos >= self.input.len) return null;
+
+        if (self.input[self.pos] == '\'') {
+            var text = std.ArrayList(u8).init(allocator);
+            errdefer text.deinit();
+            self.pos += 1;
+            while (self.pos < self.input.len) : (self.pos += 1) {
+                if (self.input[self.pos] == '\'') {
+                    if (self.pos + 1 < self.input.len and self.input[self.pos + 1] == '\'') {
+                        self.pos += 1;
+                    } else {
+                        self.pos += 1;
+                        return PlanValue{ .String = try text.toOwnedSlice() };
+                    }
+                }
+                try text.append(self.input[self.pos]);
+            }
+            text.deinit();
+            return null;
+        }
+
+        const start = self.pos;
+        while (self.pos < self.input.len) : (self.pos += 1) {
+            const ch = self.input[self.pos];
+            if (!std.ascii.isAlphanumeric(ch) and ch != '.' and ch != '-' and ch != '+' and ch != '_') break;
+        }
+        const token = self.input[start..self.pos];
+        if (token.len == 0) return null;
+
+        if (std.ascii.eqlIgnoreCase(token, "NULL")) return PlanValue{ .Null = {} };
+        if (std.ascii.eqlIgnoreCase(token, "TRUE")) return PlanValue{ .Boolean = true };
+        if (std.ascii.eqlIgnoreCase(token, "FALSE")) return PlanValue{ .Boolean = false };
+        if (std.fmt.parseInt(i64, token, 10)) |i| {
+            return PlanValue{ .Integer = i };
+        } else |_| {}
+        if (std.fmt.parseFloat(f64, token)) |f| {
+            return PlanValue{ .Float = f };
+        } else |_| {}
+        return null;
+    }
+};
+
+/// Fewest distinct values a column needs before an equality seek on its
+/// index beats a scan: below this each value matches over 5% of the rows
+const min_index_distinct_values = 20;
+
 pub const QueryPlanner = struct {
     allocator: std.mem.Allocator,
-    available_indexes: std.ArrayList(AvailableIndex),
+    available_indexes: core_catalog.ColumnKeyMap(std.ArrayListUnmanaged(AvailableIndex)), // Added with addIndex
+    catalog: ?*const core_catalog.Version = null, // Pinned catalog of the query being planned
 
     pub const AvailableIndex = struct {
         table_name: []const u8,
@@ -173,18 +501,22 @@ pub const QueryPlanner = struct {
         const planner = try allocator.create(QueryPlanner);
         planner.* = QueryPlanner{
             .allocator = allocator,
-            .available_indexes = std.ArrayList(AvailableIndex).init(allocator),
+            .available_indexes = .{},
         };
         return planner;
     }
 
     /// Deinitialize the query planner
     pub fn deinit(self: *QueryPlanner) void {
-        for (self.available_indexes.items) |index| {
-            self.allocator.free(index.table_name);
-            self.allocator.free(index.column_name);
+        var it = self.available_indexes.valueIterator();
+        while (it.next()) |indexes| {
+            for (indexes.items) |index| {
+                self.allocator.free(index.table_name);
+                self.allocator.free(index.column_name);
+            }
+            indexes.deinit(self.allocator);
         }
-        self.available_indexes.deinit();
+        self.available_indexes.deinit(self.allocator);
         self.allocator.destroy(self);
     }
 
@@ -195,7 +527,14 @@ pub const QueryPlanner = struct {
             .column_name = try self.allocator.dupe(u8, column_name),
             .index_type = index_type,
         };
-        try self.available_indexes.append(index);
+        errdefer {
+            self.allocator.free(index.table_name);
+            self.allocator.free(index.column_name);
+        }
+        // Keyed by the copies, which live as long as the entry
+        const entry = try self.available_indexes.getOrPut(self.allocator, core_catalog.ColumnKey{ .table = index.table_name, .column = index.column_name });
+        if (!entry.found_existing) entry.value_ptr.* = .{};
+        try entry.value_ptr.append(self.allocator, index);
     }
 
     /// Register an index with the planner (alias for addIndex)
@@ -204,20 +543,37 @@ pub const QueryPlanner = struct {
         try self.addIndex(table_name, column_name, index_type);
     }
 
-    /// Find indexes for a column
+    /// Find indexes for a column: the planner's own, then the catalog's.
+    /// Each source is one hash lookup on (table, column). An index known to
+    /// both (same column and type) is listed once. Caller frees the slice.
     pub fn findIndexesForColumn(self: *QueryPlanner, table_name: []const u8, column_name: []const u8) ![]const AvailableIndex {
         var result = std.ArrayList(AvailableIndex).init(self.allocator);
         defer result.deinit();
 
-        for (self.available_indexes.items) |index| {
-            if (std.mem.eql(u8, index.table_name, table_name) and std.mem.eql(u8, index.column_name, column_name)) {
-                try result.append(index);
+        const own = self.ownIndexesFor(table_name, column_name);
+        try result.appendSlice(own);
+        if (self.catalog) |version| {
+            for (version.indexesFor(table_name, column_name)) |index| {
+                if (containsIndexType(own, index.index_type)) continue;
+                try result.append(AvailableIndex{ .table_name = index.table_name, .column_name = index.column_name, .index_type = index.index_type });
             }
         }
 
         return try result.toOwnedSlice();
     }
 
+    fn ownIndexesFor(self: *QueryPlanner, table_name: []const u8, column_name: []const u8) []const AvailableIndex {
+        const indexes = self.available_indexes.getPtr(core_catalog.ColumnKey{ .table = table_name, .column = column_name }) orelse return &.{};
+        return indexes.items;
+    }
+
+    fn containsIndexType(indexes: []const AvailableIndex, index_type: Index.IndexType) bool {
+        for (indexes) |index| {
+            if (index.index_type == index_type) return true;
+        }
+        return false;
+    }
+
     /// Parse a SQL query into an AST
     pub fn parse(self: *QueryPlanner, query: []const u8) !*AST {
         // Validate inputs
@@ -229,6 +585,7 @@ pub const QueryPlanner = struct {
             .allocator = self.allocator,
             .node_type = .Select, // Default to Select
         };
+        errdefer ast.deinit();
 
         // Simple tokenization of the query string
         const trimmed_query = std.mem.trim(u8, query, &std.ascii.whitespace);
@@ -239,7 +596,7 @@ pub const QueryPlanner = struct {
 
             // Basic parsing of "SELECT * FROM table_name"
             // or "SELECT col1, col2 FROM table_name"
-            var tokens = std.mem.tokenizeSequence(u8, trimmed_query, " ");
+            var tokens = std.mem.tokenizeAny(u8, trimmed_query, &std.ascii.whitespace);
 
             // Skip "SELECT"
             _ = tokens.next();
@@ -256,6 +613,26 @@ pub const QueryPlanner = struct {
             // Get table name
             const table_name = tokens.next() orelse return error.InvalidSyntax;
 
+            // LIMIT <count> ends the query
+            var limit: ?u64 = null;
+            if (findKeyword(trimmed_query, "LIMIT")) |keyword| {
+                var limit_tokens = std.mem.tokenizeAny(u8, trimmed_query[keyword.end..], " \t\r\n;");
+                const count = limit_tokens.next() orelse return error.InvalidSyntax;
+                limit = std.fmt.parseInt(u64, count, 10) catch return error.InvalidSyntax;
+            }
+
+            // ORDER BY runs up to the LIMIT
+            var order_by: ?[]const SortKey = null;
+            if (findKeyword(trimmed_query, "ORDER BY")) |keyword| {
+                var clause = trimmed_query[keyword.end..];
+                if (findKeyword(clause, "LIMIT")) |end| clause = clause[0..end.start];
+                order_by = try parseOrderBy(self.allocator, std.mem.trimRight(u8, clause, " \t\r\n;"));
+            }
+            errdefer if (order_by) |keys| {
+                freeSortKeys(self.allocator, keys);
+                self.allocator.free(keys);
+            };
+
             // Set up LogicalPlan based on the parsed query
             // We'll use this later in the plan() method
             var parse_info = try self.allocator.create(ParseInfo);
@@ -264,8 +641,21 @@ pub const QueryPlanner = struct {
                 .table_name = try self.allocator.dupe(u8, table_name),
                 .columns = null,
                 .where_clause = null,
+                .order_by = order_by,
+                .limit = limit,
             };
 
+            // Keep the WHERE clause up to the next trailing clause
+            if (findKeyword(trimmed_query, "WHERE")) |keyword| {
+                var clause = trimmed_query[keyword.end..];
+                for ([_][]const u8{ "GROUP BY", "HAVING", "ORDER BY", "LIMIT" }) |next_keyword| {
+                    if (findKeyword(clause, next_keyword)) |end| clause = clause[0..end.start];
+                }
+                clause = std.mem.trim(u8, clause, &std.ascii.whitespace);
+                if (std.mem.endsWith(u8, clause, ";")) clause = clause[0 .. clause.len - 1];
+                parse_info.where_clause = try self.allocator.dupe(u8, clause);
+            }
+
             // Parse columns
             if (std.mem.eql(u8, columns_str, "*")) {
                 // SELECT * - all columns
@@ -344,13 +734,23 @@ pub const QueryPlanner = struct {
         // Create a logical plan based on the query type
         switch (ast.node_type) {
             .Select => {
+                // A WHERE clause the scan cannot evaluate must not widen into returning every row
+                const predicates = if (parse_info.where_clause) |clause|
+                    try parsePredicates(self.allocator, clause) orelse return error.UnsupportedPredicate
+                else
+                    null;
+                errdefer if (predicates) |preds| {
+                    freePredicates(self.allocator, preds);
+                    self.allocator.free(preds);
+                };
+
                 // Create a scan node
                 const logical_plan = try self.allocator.create(LogicalPlan);
                 logical_plan.* = LogicalPlan{
                     .allocator = self.allocator,
                     .node_type = .Scan,
                     .table_name = try self.allocator.dupe(u8, parse_info.table_name),
-                    .predicates = null,
+                    .predicates = predicates,
                     .columns = null,
                     .children = null,
                 };
@@ -364,6 +764,37 @@ pub const QueryPlanner = struct {
                     logical_plan.columns = columns;
                 }
 
+                // ORDER BY sorts the scan's rows
+                if (parse_info.order_by) |keys| {
+                    const sort_keys = try dupeSortKeys(self.allocator, keys);
+                    const children = try self.allocator.alloc(LogicalPlan, 1);
+                    children[0] = logical_plan.*;
+                    logical_plan.* = LogicalPlan{
+                        .allocator = self.allocator,
+                        .node_type = .Sort,
+                        .table_name = null,
+                        .predicates = null,
+                        .columns = null,
+                        .children = children,
+                        .sort_keys = sort_keys,
+                    };
+                }
+
+                // LIMIT becomes the parent of the scan, or of the sort
+                if (parse_info.limit) |limit| {
+                    const children = try self.allocator.alloc(LogicalPlan, 1);
+                    children[0] = logical_plan.*;
+                    logical_plan.* = LogicalPlan{
+                        .allocator = self.allocator,
+                        .node_type = .Limit,
+                        .table_name = null,
+                        .predicates = null,
+                        .columns = null,
+                        .children = children,
+                        .limit = limit,
+                    };
+                }
+
                 return logical_plan;
             },
             .Create, .Insert, .Update, .Delete => {
@@ -387,18 +818,29 @@ pub const QueryPlanner = struct {
         }
     }
 
-    /// Find the best index for a predicate
+    /// Find the best index for a predicate. The catalog's distinct-value
+    /// statistic rules out indexes on columns so repetitive that a seek
+    /// would visit more rows than a scan skips.
     pub fn findBestIndex(self: *QueryPlanner, table_name: []const u8, column_name: []const u8) !?AvailableIndex {
-        const indexes = try self.findIndexesForColumn(table_name, column_name);
-        defer self.allocator.free(indexes);
-
-        if (indexes.len == 0) {
-            return null;
+        if (self.catalog) |version| {
+            if (version.getColumn(table_name, column_name)) |column| {
+                if (column.distinct_values) |distinct| {
+                    if (distinct < min_index_distinct_values) return null;
+                }
+            }
         }
 
-        // For now, just return the first index
-        // In a real implementation, we would use statistics to choose the best index
-        return indexes[0];
+        // Every candidate indexes the same column, so take the first one
+        // without building the full list
+        const own = self.ownIndexesFor(table_name, column_name);
+        if (own.len > 0) return own[0];
+        if (self.catalog) |version| {
+            const indexes = version.indexesFor(table_name, column_name);
+            if (indexes.len > 0) {
+                return AvailableIndex{ .table_name = indexes[0].table_name, .column_name = indexes[0].column_name, .index_type = indexes[0].index_type };
+            }
+        }
+        return null;
     }
 
     /// Find the best access method for a predicate
@@ -416,7 +858,7 @@ test "Query planner initialization" {
     defer planner.deinit();
 
     try std.testing.expectEqual(allocator, planner.allocator);
-    try std.testing.expectEqual(@as(usize, 0), planner.available_indexes.items.len);
+    try std.testing.expectEqual(@as(usize, 0), planner.available_indexes.count());
 }
 
 test "Query planner index management" {
@@ -482,6 +924,106 @@ test "Query planner access method selection" {
     try std.testing.expectEqual(AccessMethod.IndexSeek, try planner.findBestAccessMethod("users", "id"));
 }
 
+test "WHERE clauses become scan predicates" {
+    const allocator = std.testing.allocator;
+    const planner = try QueryPlanner.init(allocator);
+    defer planner.deinit();
+
+    const ast = try planner.parse("SELECT * FROM events WHERE ts BETWEEN 100 AND 200 AND kind = 'it''s' ORDER BY ts");
+    defer ast.deinit();
+
+    const logical_plan = try planner.plan(ast);
+    defer logical_plan.deinit();
+
+    // The scan sits under the ORDER BY
+    const preds = logical_plan.children.?[0].predicates.?;
+    try std.testing.expectEqual(@as(usize, 3), preds.len);
+    try std.testing.expectEqualStrings("ts", preds[0].column);
+    try std.testing.expectEqual(PredicateOp.Ge, preds[0].op);
+    try std.testing.expectEqual(@as(i64, 200), preds[1].value.Integer);
+    try std.testing.expectEqual(PredicateOp.Eq, preds[2].op);
+    try std.testing.expectEqualStrings("it's", preds[2].value.String);
+
+    // Anything beyond simple conjunctions is rejected rather than scanned unfiltered
+    try std.testing.expect((try parsePredicates(allocator, "a = 1 OR b = 2")) == null);
+    try std.testing.expect((try parsePredicates(allocator, "name = 'open")) == null);
+    const unsupported = try planner.parse("SELECT * FROM events WHERE a = 1 OR b = 2");
+    defer unsupported.deinit();
+    try std.testing.expectError(error.UnsupportedPredicate, planner.plan(unsupported));
+}
+
+test "LIMIT is planned above the scan" {
+    const allocator = std.testing.allocator;
+    const planner = try QueryPlanner.init(allocator);
+    defer planner.deinit();
+
+    const ast = try planner.parse("SELECT * FROM events WHERE kind = 'click' LIMIT 25;");
+    defer ast.deinit();
+
+    const logical_plan = try planner.plan(ast);
+    defer logical_plan.deinit();
+    try std.testing.expectEqual(LogicalNodeType.Limit, logical_plan.node_type);
+    try std.testing.expectEqual(@as(?u64, 25), logical_plan.limit);
+    try std.testing.expectEqualStrings("click", logical_plan.children.?[0].predicates.?[0].value.String);
+
+    const physical_plan = try optimize(planner, logical_plan);
+    defer physical_plan.deinit();
+    try std.testing.expectEqual(PhysicalNodeType.Limit, physical_plan.node_type);
+    try std.testing.expectEqual(PhysicalNodeType.TableScan, physical_plan.children.?[0].node_type);
+
+    try std.testing.expectError(error.InvalidSyntax, planner.parse("SELECT * FROM events LIMIT all"));
+}
+
+test "clause keywords are whole words outside string literals" {
+    const allocator = std.testing.allocator;
+    const planner = try QueryPlanner.init(allocator);
+    defer planner.deinit();
+
+    // Any whitespace separates a keyword from its argument
+    const split = try planner.parse("SELECT *\nFROM events\tWHERE kind = 'click'\nORDER\tBY ts\nLIMIT\n5");
+    defer split.deinit();
+    try std.testing.expectEqualStrings("events", split.parse_info.?.table_name);
+    try std.testing.expectEqualStrings("kind = 'click'", split.parse_info.?.where_clause.?);
+    try std.testing.expectEqualStrings("ts", split.parse_info.?.order_by.?[0].column);
+    try std.testing.expectEqual(@as(?u64, 5), split.parse_info.?.limit);
+
+    // Keywords inside a literal belong to the literal
+    const quoted = try planner.parse("SELECT * FROM notes WHERE note = 'no limit here, order by nothing' LIMIT 2");
+    defer quoted.deinit();
+    try std.testing.expectEqualStrings("note = 'no limit here, order by nothing'", quoted.parse_info.?.where_clause.?);
+    try std.testing.expectEqual(@as(?[]const SortKey, null), quoted.parse_info.?.order_by);
+    try std.testing.expectEqual(@as(?u64, 2), quoted.parse_info.?.limit);
+
+    try std.testing.expect(startsWithWord("begin transaction", "BEGIN"));
+    try std.testing.expect(!startsWithWord("BEGINNING", "BEGIN"));
+}
+
+test "ORDER BY under a LIMIT is fused into a Top-N" {
+    const allocator = std.testing.allocator;
+    const planner = try QueryPlanner.init(allocator);
+    defer planner.deinit();
+
+    const ast = try planner.parse("SELECT * FROM events WHERE kind = 'click' ORDER BY events.ts DESC, id LIMIT 10");
+    defer ast.deinit();
+
+    const logical_plan = try planner.plan(ast);
+    defer logical_plan.deinit();
+    const sort = &logical_plan.children.?[0];
+    try std.testing.expectEqual(LogicalNodeType.Sort, sort.node_type);
+    try std.testing.expectEqualStrings("ts", sort.sort_keys.?[0].column);
+    try std.testing.expect(sort.sort_keys.?[0].descending);
+    try std.testing.expect(!sort.sort_keys.?[1].descending);
+
+    const physical_plan = try optimize(planner, logical_plan);
+    defer physical_plan.deinit();
+    try std.testing.expectEqual(PhysicalNodeType.TopN, physical_plan.node_type);
+    try std.testing.expectEqual(@as(?u64, 10), physical_plan.limit);
+    try std.testing.expectEqualStrings("id", physical_plan.sort_keys.?[1].column);
+    try std.testing.expectEqual(PhysicalNodeType.TableScan, physical_plan.children.?[0].node_type);
+
+    try std.testing.expectError(error.InvalidSyntax, planner.parse("SELECT * FROM events ORDER BY ts SIDEWAYS"));
+}
+
 /// Physical plan for query execution
 pub const PhysicalPlan = struct {
     allocator: std.mem.Allocator,
@@ -498,8 +1040,16 @@ pub const PhysicalPlan = struct {
     parallel_fragment_count: u8 = 1,
     parallel_range_start: u64 = 0,
     parallel_range_end: u64 = 0,
+    limit: ?u64 = null, // Limit and TopN: rows to return
+    sort_keys: ?[]const SortKey = null, // Sort and TopN: ORDER BY keys
 
     pub fn deinit(self: *PhysicalPlan) void {
+        self.freeFields();
+        self.allocator.destroy(self);
+    }
+
+    /// Free what the node owns, but not the node, which may live in its parent's children
+    fn freeFields(self: *PhysicalPlan) void {
         if (self.table_name) |name| {
             self.allocator.free(name);
         }
@@ -523,13 +1073,16 @@ pub const PhysicalPlan = struct {
             }
             self.allocator.free(cols);
         }
+        if (self.sort_keys) |keys| {
+            freeSortKeys(self.allocator, keys);
+            self.allocator.free(keys);
+        }
         if (self.children) |kids| {
             for (kids) |*child| {
-                child.deinit();
+                child.freeFields();
             }
             self.allocator.free(kids);
         }
-        self.allocator.destroy(self);
     }
 };
 
@@ -552,6 +1105,7 @@ pub fn optimize(planner: *QueryPlanner, logical_plan: *LogicalPlan) !*PhysicalPl
                 .allocator = planner.allocator,
                 .node_type = .TableScan,
                 .table_name = if (logical_plan.table_name) |name| try planner.allocator.dupe(u8, name) else null,
+                .predicates = if (logical_plan.predicates) |preds| try dupePredicates(planner.allocator, preds) else null,
                 .columns = if (logical_plan.columns) |cols| blk: {
                     var columns = try planner.allocator.alloc([]const u8, cols.len);
                     for (cols, 0..) |col, i| {
@@ -562,6 +1116,45 @@ pub fn optimize(planner: *QueryPlanner, logical_plan: *LogicalPlan) !*PhysicalPl
             };
             return physical_plan;
         },
+        .Sort => {
+            const kids = logical_plan.children orelse return error.MissingChild;
+            const child = try optimize(planner, &kids[0]);
+            const children = try planner.allocator.alloc(PhysicalPlan, 1);
+            children[0] = child.*;
+            planner.allocator.destroy(child);
+
+            const physical_plan = try planner.allocator.create(PhysicalPlan);
+            physical_plan.* = PhysicalPlan{
+                .allocator = planner.allocator,
+                .node_type = .Sort,
+                .children = children,
+                .sort_keys = try dupeSortKeys(planner.allocator, logical_plan.sort_keys orelse return error.MissingSortKeys),
+            };
+            return physical_plan;
+        },
+        .Limit => {
+            const kids = logical_plan.children orelse return error.MissingChild;
+            const child = try optimize(planner, &kids[0]);
+            // A sort under a LIMIT only has to find the first rows: fuse the
+            // two into a Top-N, which keeps `limit` rows instead of sorting all
+            if (child.node_type == .Sort) {
+                child.node_type = .TopN;
+                child.limit = logical_plan.limit;
+                return child;
+            }
+            const children = try planner.allocator.alloc(PhysicalPlan, 1);
+            children[0] = child.*;
+            planner.allocator.destroy(child);
+
+            const physical_plan = try planner.allocator.create(PhysicalPlan);
+            physical_plan.* = PhysicalPlan{
+                .allocator = planner.allocator,
+                .node_type = .Limit,
+                .children = children,
+                .limit = logical_plan.limit,
+            };
+            return physical_plan;
+        },
         else => {
             return error.UnsupportedLogicalNodeType;
         },
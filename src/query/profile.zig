@@ -0,0 +1,205 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const planner = @import("planner.zig");
+const PhysicalPlan = planner.PhysicalPlan;
+const PhysicalNodeType = planner.PhysicalNodeType;
+
+/// Runtime statistics collected for one physical operator by EXPLAIN ANALYZE
+pub const OperatorProfile = struct {
+    node_type: PhysicalNodeType,
+    executed: bool = false,
+    rows: u64 = 0,
+    batches: u64 = 0,
+    blocks_skipped: u64 = 0,
+    bytes_spilled: u64 = 0, // Written to temporary files by a sort over the memory limit
+    wall_ns: u64 = 0,
+    cpu_ns: u64 = 0,
+    bytes_allocated: u64 = 0,
+    allocations: u64 = 0,
+    parallel_degree: u8 = 1,
+    children: []OperatorProfile = &[_]OperatorProfile{},
+
+    /// Create an empty profile tree with the same shape as a physical plan
+    pub fn initForPlan(allocator: std.mem.Allocator, plan: *const PhysicalPlan) !OperatorProfile {
+        var profile = OperatorProfile{ .node_type = plan.node_type };
+
+        if (plan.children) |kids| {
+            const children = try allocator.alloc(OperatorProfile, kids.len);
+            var initialized: usize = 0;
+            errdefer {
+                for (children[0..initialized]) |*child| child.deinit(allocator);
+                allocator.free(children);
+            }
+            for (kids, 0..) |*kid, i| {
+                children[i] = try initForPlan(allocator, kid);
+                initialized += 1;
+            }
+            profile.children = children;
+        }
+
+        return profile;
+    }
+
+    /// Free the child profiles
+    pub fn deinit(self: *OperatorProfile, allocator: std.mem.Allocator) void {
+        for (self.children) |*child| {
+            child.deinit(allocator);
+        }
+        if (self.children.len > 0) {
+            allocator.free(self.children);
+        }
+        self.children = &[_]OperatorProfile{};
+    }
+};
+
+/// Collects wall time, CPU time and allocation counts around one operator
+pub const OperatorTimer = struct {
+    timer: std.time.Timer,
+    cpu_start_ns: u64,
+
+    pub fn start() !OperatorTimer {
+        return OperatorTimer{
+            .timer = try std.time.Timer.start(),
+            .cpu_start_ns = threadCpuTimeNs(),
+        };
+    }
+
+    /// Record elapsed wall and CPU time into a profile
+    pub fn stop(self: *OperatorTimer, profile: *OperatorProfile) void {
+        profile.wall_ns += self.timer.read();
+        const cpu_now = threadCpuTimeNs();
+        if (cpu_now >= self.cpu_start_ns) {
+            profile.cpu_ns += cpu_now - self.cpu_start_ns;
+        }
+        profile.executed = true;
+    }
+};
+
+/// CPU time consumed by the calling thread, in nanoseconds (0 if unsupported)
+pub fn threadCpuTimeNs() u64 {
+    if (builtin.os.tag == .windows or builtin.os.tag == .wasi) {
+        return 0;
+    }
+    const ts = std.posix.clock_gettime(std.posix.CLOCK.THREAD_CPUTIME_ID) catch return 0;
+    return @as(u64, @intCast(ts.sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.nsec));
+}
+
+/// Allocator wrapper that counts bytes and allocations passed through it.
+/// Counters are atomic so parallel workers can share one instance.
+pub const CountingAllocator = struct {
+    parent: std.mem.Allocator,
+    bytes_allocated: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    bytes_freed: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    allocations: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+
+    pub fn init(parent: std.mem.Allocator) CountingAllocator {
+        return CountingAllocator{ .parent = parent };
+    }
+
+    pub fn allocator(self: *CountingAllocator) std.mem.Allocator {
+        return .{
+            .ptr = self,
+            .vtable = &.{
+                .alloc = alloc,
+                .resize = resize,
+                .remap = remap,
+                .free = free,
+            },
+        };
+    }
+
+    /// Total bytes requested so far
+    pub fn bytesAllocated(self: *const CountingAllocator) u64 {
+        return self.bytes_allocated.load(.monotonic);
+    }
+
+    /// Bytes currently live (allocated minus freed)
+    pub fn bytesLive(self: *const CountingAllocator) u64 {
+        return self.bytes_allocated.load(.monotonic) -| self.bytes_freed.load(.monotonic);
+    }
+
+    /// Number of successful allocation calls so far
+    pub fn allocationCount(self: *const CountingAllocator) u64 {
+        return self.allocations.load(.monotonic);
+    }
+
+    /// Reset all counters to zero
+    pub fn reset(self: *CountingAllocator) void {
+        self.bytes_allocated.store(0, .monotonic);
+        self.bytes_freed.store(0, .monotonic);
+        self.allocations.store(0, .monotonic);
+    }
+
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const ptr = self.parent.rawAlloc(len, alignment, ret_addr) orelse return null;
+        _ = self.bytes_allocated.fetchAdd(len, .monotonic);
+        _ = self.allocations.fetchAdd(1, .monotonic);
+        return ptr;
+    }
+
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        if (!self.parent.rawResize(memory, alignment, new_len, ret_addr)) return false;
+        self.recordResize(memory.len, new_len);
+        return true;
+    }
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        const ptr = self.parent.rawRemap(memory, alignment, new_len, ret_addr) orelse return null;
+        self.recordResize(memory.len, new_len);
+        return ptr;
+    }
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *CountingAllocator = @ptrCast(@alignCast(ctx));
+        self.parent.rawFree(memory, alignment, ret_addr);
+        _ = self.bytes_freed.fetchAdd(memory.len, .monotonic);
+    }
+
+    fn recordResize(self: *CountingAllocator, old_len: usize, new_len: usize) void {
+        if (new_len > old_len) {
+            _ = self.bytes_allocated.fetchAdd(new_len - old_len, .monotonic);
+        } else {
+            _ = self.bytes_freed.fetchAdd(old_len - new_len, .monotonic);
+        }
+    }
+};
+
+test "CountingAllocator counts bytes" {
+    var counting = CountingAllocator.init(std.testing.allocator);
+    const allocator = counting.allocator();
+
+    const a = try allocator.alloc(u8, 100);
+    const b = try allocator.alloc(u64, 4);
+    try std.testing.expectEqual(@as(u64, 132), counting.bytesAllocated());
+    try std.testing.expectEqual(@as(u64, 2), counting.allocationCount());
+
+    allocator.free(a);
+    try std.testing.expectEqual(@as(u64, 32), counting.bytesLive());
+    allocator.free(b);
+    try std.testing.expectEqual(@as(u64, 0), counting.bytesLive());
+}
+
+test "OperatorProfile mirrors plan shape" {
+    const allocator = std.testing.allocator;
+
+    var children = [_]PhysicalPlan{
+        PhysicalPlan{ .allocator = allocator, .node_type = .TableScan },
+        PhysicalPlan{ .allocator = allocator, .node_type = .IndexSeek },
+    };
+    const plan = PhysicalPlan{
+        .allocator = allocator,
+        .node_type = .HashJoin,
+        .children = &children,
+    };
+
+    var profile = try OperatorProfile.initForPlan(allocator, &plan);
+    defer profile.deinit(allocator);
+
+    try std.testing.expectEqual(PhysicalNodeType.HashJoin, profile.node_type);
+    try std.testing.expectEqual(@as(usize, 2), profile.children.len);
+    try std.testing.expectEqual(PhysicalNodeType.IndexSeek, profile.children[1].node_type);
+    try std.testing.expect(!profile.children[0].executed);
+}
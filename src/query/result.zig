@@ -1,5 +1,6 @@
 const std = @import("std");
 const assert = @import("../build_options.zig").assert;
+const RowSegment = @import("../storage/column_segment.zig").RowSegment;
 
 /// Represents a value in a result set
 pub const Value = union(enum) {
@@ -84,27 +85,218 @@ pub const DataType = enum {
     Timestamp,
 };
 
-/// Represents a row in a result set
-pub const Row = struct {
-    values: []Value,
+/// Rows of a result stored column by column. A chunk owns its values, is a
+/// view of selected rows of a sealed table segment, decoded on access with
+/// text borrowed from the segment, or is a range of rows of another chunk.
+/// Chunks are reference counted and a view holds a reference to its segment,
+/// so the rows stay readable after garbage collection replaces the segment.
+pub const Chunk = struct {
+    allocator: std.mem.Allocator,
+    refs: std.atomic.Value(usize) = std.atomic.Value(usize).init(1),
+    row_count: usize = 0,
+    data: Data,
+
+    pub const Data = union(enum) {
+        owned: Owned,
+        view: SegmentView,
+        slice: Slice,
+    };
+
+    /// One vector of values per column. Text is freed value by value, or all
+    /// at once with `strings` when the chunk copied it there.
+    pub const Owned = struct {
+        columns: []std.ArrayListUnmanaged(Value),
+        strings: ?std.heap.ArenaAllocator,
+    };
+
+    pub const SegmentView = struct {
+        segment: *RowSegment,
+        segment_allocator: std.mem.Allocator, // Frees the segment with its last reference
+        rows: []const u32, // Selected rows of the segment, ascending
+    };
+
+    pub const Slice = struct {
+        parent: *Chunk,
+        start: usize,
+    };
+
+    /// An empty chunk that owns its values. With `copy_text`, appendRowCopy()
+    /// copies text into one arena instead of allocating each string.
+    pub fn createOwned(allocator: std.mem.Allocator, column_count: usize, capacity: usize, copy_text: bool) !*Chunk {
+        const columns = try allocator.alloc(std.ArrayListUnmanaged(Value), column_count);
+        @memset(columns, .{});
+        errdefer {
+            for (columns) |*column| column.deinit(allocator);
+            allocator.free(columns);
+        }
+        for (columns) |*column| try column.ensureTotalCapacity(allocator, capacity);
+
+        const chunk = try allocator.create(Chunk);
+        chunk.* = Chunk{
+            .allocator = allocator,
+            .data = .{ .owned = .{
+                .columns = columns,
+                .strings = if (copy_text) std.heap.ArenaAllocator.init(allocator) else null,
+            } },
+        };
+        return chunk;
+    }
+
+    /// A chunk reading `rows` of `segment` in place. Takes ownership of `rows`,
+    /// which must come from `allocator`, and retains the segment.
+    pub fn createView(allocator: std.mem.Allocator, segment: *RowSegment, segment_allocator: std.mem.Allocator, rows: []const u32) !*Chunk {
+        const chunk = try allocator.create(Chunk);
+        segment.retain();
+        chunk.* = Chunk{
+            .allocator = allocator,
+            .row_count = rows.len,
+            .data = .{ .view = .{ .segment = segment, .segment_allocator = segment_allocator, .rows = rows } },
+        };
+        return chunk;
+    }
+
+    /// A chunk of `len` rows of `parent` starting at `start`, sharing its storage
+    pub fn createSlice(allocator: std.mem.Allocator, parent: *Chunk, start: usize, len: usize) !*Chunk {
+        assert(start + len <= parent.row_count);
+        const chunk = try allocator.create(Chunk);
+        parent.retain();
+        chunk.* = Chunk{
+            .allocator = allocator,
+            .row_count = len,
+            .data = .{ .slice = .{ .parent = parent, .start = start } },
+        };
+        return chunk;
+    }
 
-    pub fn deinit(self: *Row, allocator: std.mem.Allocator) void {
-        for (self.values) |*value| {
-            value.deinit(allocator);
+    pub fn retain(self: *Chunk) void {
+        _ = self.refs.fetchAdd(1, .monotonic);
+    }
+
+    /// Drop a reference, freeing the chunk with the last one
+    pub fn release(self: *Chunk) void {
+        if (self.refs.fetchSub(1, .acq_rel) != 1) return;
+        switch (self.data) {
+            .owned => |*owned| {
+                for (owned.columns) |*column| {
+                    if (owned.strings == null) {
+                        for (column.items) |value| {
+                            if (value == .text and value.text.len > 0) self.allocator.free(value.text);
+                        }
+                    }
+                    column.deinit(self.allocator);
+                }
+                self.allocator.free(owned.columns);
+                if (owned.strings) |*strings| strings.deinit();
+            },
+            .view => |view| {
+                self.allocator.free(view.rows);
+                view.segment.release(view.segment_allocator);
+            },
+            .slice => |slice| slice.parent.release(),
         }
-        allocator.free(self.values);
+        self.allocator.destroy(self);
+    }
+
+    pub fn columnCount(self: *const Chunk) usize {
+        return switch (self.data) {
+            .owned => |owned| owned.columns.len,
+            .view => |view| view.segment.columns.len,
+            .slice => |slice| slice.parent.columnCount(),
+        };
+    }
+
+    pub fn get(self: *const Chunk, row: usize, col: usize) Value {
+        return switch (self.data) {
+            .owned => |owned| owned.columns[col].items[row],
+            .view => |view| view.segment.columns[col].get(view.rows[row]),
+            .slice => |slice| slice.parent.get(slice.start + row, col),
+        };
+    }
+
+    /// Append a row, taking ownership of its text
+    pub fn appendRow(self: *Chunk, values: []const Value) !void {
+        const owned = &self.data.owned;
+        assert(owned.strings == null);
+        for (owned.columns) |*column| try column.ensureUnusedCapacity(self.allocator, 1);
+        for (owned.columns, values) |*column, value| column.appendAssumeCapacity(value);
+        self.row_count += 1;
+    }
+
+    /// Append a copy of a row, copying its text into the chunk's arena
+    pub fn appendRowCopy(self: *Chunk, values: []const Value) !void {
+        const owned = &self.data.owned;
+        const strings = owned.strings.?.allocator();
+        for (owned.columns) |*column| try column.ensureUnusedCapacity(self.allocator, 1);
+        for (owned.columns, values) |*column, value| {
+            column.appendAssumeCapacity(switch (value) {
+                .text => |t| Value{ .text = strings.dupe(u8, t) catch |err| {
+                    // Undo the partial row
+                    for (owned.columns) |*c| c.shrinkRetainingCapacity(self.row_count);
+                    return err;
+                } },
+                else => value,
+            });
+        }
+        self.row_count += 1;
+    }
+
+    /// Point the chunk, and the arena its text lives in, at another allocator
+    /// that frees the same memory
+    fn rebind(self: *Chunk, allocator: std.mem.Allocator) void {
+        self.allocator = allocator;
+        switch (self.data) {
+            .owned => |*owned| if (owned.strings) |*strings| {
+                strings.child_allocator = allocator;
+            },
+            .view => {},
+            .slice => |slice| slice.parent.rebind(allocator),
+        }
+    }
+};
+
+/// One row of a result set, read through its chunk
+pub const RowRef = struct {
+    chunk: *const Chunk,
+    row: usize,
+
+    pub fn get(self: RowRef, col: usize) Value {
+        return self.chunk.get(self.row, col);
     }
 };
 
-/// Represents a result set from a query execution
+/// Visits the rows of a result set in order, one chunk at a time
+pub const RowIterator = struct {
+    chunks: []const *Chunk,
+    chunk_index: usize = 0,
+    row: usize = 0,
+
+    pub fn next(self: *RowIterator) ?RowRef {
+        while (self.chunk_index < self.chunks.len) {
+            const chunk = self.chunks[self.chunk_index];
+            if (self.row < chunk.row_count) {
+                defer self.row += 1;
+                return RowRef{ .chunk = chunk, .row = self.row };
+            }
+            self.chunk_index += 1;
+            self.row = 0;
+        }
+        return null;
+    }
+};
+
+/// Represents a result set from a query execution. Rows live in a list of
+/// chunks, which a scan can point straight at the table's sealed segments
+/// instead of copying every value.
 pub const ResultSet = struct {
     allocator: std.mem.Allocator,
     columns: []ResultColumn,
-    rows: []Row,
+    chunks: std.ArrayListUnmanaged(*Chunk) = .{},
     row_count: usize,
 
+    /// A result with `row_count` rows of NULLs, to be filled in with setValue()
     pub fn init(allocator: std.mem.Allocator, column_count: usize, row_count: usize) !ResultSet {
         const columns = try allocator.alloc(ResultColumn, column_count);
+        errdefer allocator.free(columns);
 
         // Initialize columns with empty values
         for (columns) |*column| {
@@ -117,26 +309,19 @@ pub const ResultSet = struct {
             };
         }
 
-        // Allocate rows
-        const rows = try allocator.alloc(Row, row_count);
-        for (rows) |*row| {
-            if (column_count > 0) {
-                const values = try allocator.alloc(Value, column_count);
-                for (values) |*value| {
-                    value.* = Value{ .null = {} };
-                }
-                row.* = Row{ .values = values };
-            } else {
-                row.* = Row{ .values = &[_]Value{} };
-            }
-        }
-
-        return ResultSet{
+        var result_set = ResultSet{
             .allocator = allocator,
             .columns = columns,
-            .rows = rows,
-            .row_count = row_count,
+            .row_count = 0,
         };
+        if (row_count > 0 and column_count > 0) {
+            const chunk = try Chunk.createOwned(allocator, column_count, row_count, false);
+            for (chunk.data.owned.columns) |*column| column.appendNTimesAssumeCapacity(Value{ .null = {} }, row_count);
+            chunk.row_count = row_count;
+            try result_set.appendChunk(chunk);
+        }
+        result_set.row_count = row_count;
+        return result_set;
     }
 
     pub fn deinit(self: *ResultSet) void {
@@ -145,48 +330,81 @@ pub const ResultSet = struct {
         }
         self.allocator.free(self.columns);
 
-        for (self.rows) |*row| {
-            row.deinit(self.allocator);
-        }
-        self.allocator.free(self.rows);
+        for (self.chunks.items) |chunk| chunk.release();
+        self.chunks.deinit(self.allocator);
     }
 
-    /// Add a row to the result set
+    /// Append a chunk, taking over the caller's reference. The reference is
+    /// released if the chunk cannot be added.
+    pub fn appendChunk(self: *ResultSet, chunk: *Chunk) !void {
+        assert(chunk.columnCount() == self.columns.len);
+        self.chunks.append(self.allocator, chunk) catch |err| {
+            chunk.release();
+            return err;
+        };
+        self.row_count += chunk.row_count;
+    }
+
+    /// Add a row to the result set, taking ownership of its text
     pub fn addRow(self: *ResultSet, values: []const Value) !void {
         if (values.len != self.columns.len) {
             return error.ColumnMismatch;
         }
 
-        const new_row_index = self.row_count;
-        if (new_row_index >= self.rows.len) {
-            // Grow the rows array
-            const new_size = if (self.rows.len == 0) 1 else self.rows.len * 2;
-            self.rows = try self.allocator.realloc(self.rows, new_size);
-
-            // Initialize new rows
-            for (self.rows[self.row_count..new_size]) |*row| {
-                const row_values = try self.allocator.alloc(Value, self.columns.len);
-                for (row_values) |*value| {
-                    value.* = Value{ .null = {} };
-                }
-                row.* = Row{ .values = row_values };
-            }
-        }
-
-        // Copy values to the new row
-        for (values, 0..) |value, i| {
-            self.rows[new_row_index].values[i] = value;
+        // Rows are appended to a private owned chunk at the end
+        const last: ?*Chunk = if (self.chunks.items.len > 0) self.chunks.items[self.chunks.items.len - 1] else null;
+        const appendable = if (last) |chunk|
+            chunk.data == .owned and chunk.data.owned.strings == null and chunk.refs.load(.monotonic) == 1
+        else
+            false;
+        if (!appendable) {
+            try self.appendChunk(try Chunk.createOwned(self.allocator, self.columns.len, 0, false));
         }
 
+        try self.chunks.items[self.chunks.items.len - 1].appendRow(values);
         self.row_count += 1;
     }
 
-    /// Get a value from the result set
+    /// Replace a value in a row held by the result set itself, taking
+    /// ownership of its text. Rows viewing table storage are read-only.
+    pub fn setValue(self: *ResultSet, row: usize, col: usize, value: Value) !void {
+        if (row >= self.row_count or col >= self.columns.len) return error.OutOfBounds;
+        const chunk, const chunk_row = self.locate(row);
+        if (chunk.data != .owned or chunk.data.owned.strings != null) return error.ReadOnlyRow;
+
+        const slot = &chunk.data.owned.columns[col].items[chunk_row];
+        if (slot.* == .text and slot.text.len > 0) self.allocator.free(slot.text);
+        slot.* = value;
+    }
+
+    /// Get a value from the result set. Finding the row's chunk is a walk of
+    /// the chunk list, so reading every row is cheaper with iterator().
     pub fn getValue(self: ResultSet, row: usize, col: usize) Value {
         if (row >= self.row_count or col >= self.columns.len) {
             return Value{ .null = {} };
         }
-        return self.rows[row].values[col];
+        const chunk, const chunk_row = self.locate(row);
+        return chunk.get(chunk_row, col);
+    }
+
+    pub fn iterator(self: *const ResultSet) RowIterator {
+        return RowIterator{ .chunks = self.chunks.items };
+    }
+
+    /// Hand the result to an allocator that frees the same memory as the one
+    /// it was built with, e.g. when a wrapping allocator goes out of scope
+    pub fn rebind(self: *ResultSet, allocator: std.mem.Allocator) void {
+        self.allocator = allocator;
+        for (self.chunks.items) |chunk| chunk.rebind(allocator);
+    }
+
+    fn locate(self: ResultSet, row: usize) struct { *Chunk, usize } {
+        var remaining = row;
+        for (self.chunks.items) |chunk| {
+            if (remaining < chunk.row_count) return .{ chunk, remaining };
+            remaining -= chunk.row_count;
+        }
+        unreachable;
     }
 };
 
@@ -0,0 +1,553 @@
+const std = @import("std");
+const planner = @import("planner.zig");
+const result = @import("result.zig");
+const column_segment = @import("../storage/column_segment.zig");
+const Chunk = result.Chunk;
+const Value = result.Value;
+
+/// Most threads one Top-N spreads its input over
+pub const max_sort_workers: usize = 16;
+
+/// Input rows below which another Top-N worker is not worth starting
+const min_rows_per_worker: usize = 64 * 1024;
+
+/// One ORDER BY key, resolved to a result column
+pub const SortColumn = struct {
+    column: usize,
+    descending: bool = false,
+};
+
+/// Resolve ORDER BY keys against the columns of a result. Caller frees the slice.
+pub fn resolveKeys(allocator: std.mem.Allocator, keys: []const planner.SortKey, columns: []const result.ResultColumn) ![]SortColumn {
+    const resolved = try allocator.alloc(SortColumn, keys.len);
+    errdefer allocator.free(resolved);
+    for (keys, resolved) |key, *out| {
+        const column = for (columns, 0..) |col, i| {
+            if (std.ascii.eqlIgnoreCase(col.name, key.column)) break i;
+        } else return error.ColumnNotFound;
+        out.* = SortColumn{ .column = column, .descending = key.descending };
+    }
+    return resolved;
+}
+
+/// Order of two values under ORDER BY. NULLs sort after every other value,
+/// so first when descending, as in PostgreSQL. Values that cannot be
+/// compared are ordered by type, which keeps the order total.
+pub fn compareForSort(a: Value, b: Value) std.math.Order {
+    if (a == .null or b == .null) return std.math.order(@intFromBool(a == .null), @intFromBool(b == .null));
+    return column_segment.compareValues(a, b) orelse
+        std.math.order(@intFromEnum(std.meta.activeTag(a)), @intFromEnum(std.meta.activeTag(b)));
+}
+
+/// A row of the input, by chunk and position in it
+const RowHandle = struct {
+    chunk: u32,
+    row: u32,
+};
+
+/// Order of input rows under the sort keys. Ties keep input order, so the
+/// result does not depend on how the input was split between workers.
+const Ordering = struct {
+    chunks: []const *Chunk,
+    keys: []const SortColumn,
+
+    fn order(self: Ordering, a: RowHandle, b: RowHandle) std.math.Order {
+        const chunk_a = self.chunks[a.chunk];
+        const chunk_b = self.chunks[b.chunk];
+        for (self.keys) |key| {
+            const cmp = compareForSort(chunk_a.get(a.row, key.column), chunk_b.get(b.row, key.column));
+            if (cmp != .eq) return if (key.descending) cmp.invert() else cmp;
+        }
+        if (a.chunk != b.chunk) return std.math.order(a.chunk, b.chunk);
+        return std.math.order(a.row, b.row);
+    }
+
+    fn lessThan(self: Ordering, a: RowHandle, b: RowHandle) bool {
+        return self.order(a, b) == .lt;
+    }
+};
+
+/// The first `items.len` rows offered so far, kept in a max-heap so the row
+/// a better one replaces is always at the root. Works in place: a full heap
+/// never allocates.
+const BoundedHeap = struct {
+    ordering: Ordering,
+    items: []RowHandle,
+    len: usize = 0,
+
+    fn offer(self: *BoundedHeap, row: RowHandle) void {
+        if (self.len < self.items.len) {
+            self.items[self.len] = row;
+            self.len += 1;
+            self.siftUp(self.len - 1);
+        } else if (self.len > 0 and self.ordering.lessThan(row, self.items[0])) {
+            self.items[0] = row;
+            self.siftDown(0);
+        }
+    }
+
+    fn siftUp(self: *BoundedHeap, start: usize) void {
+        var i = start;
+        while (i > 0) {
+            const parent = (i - 1) / 2;
+            if (!self.ordering.lessThan(self.items[parent], self.items[i])) return;
+            std.mem.swap(RowHandle, &self.items[parent], &self.items[i]);
+            i = parent;
+        }
+    }
+
+    fn siftDown(self: *BoundedHeap, start: usize) void {
+        var i = start;
+        while (true) {
+            var largest = i;
+            const left = 2 * i + 1;
+            const right = left + 1;
+            if (left < self.len and self.ordering.lessThan(self.items[largest], self.items[left])) largest = left;
+            if (right < self.len and self.ordering.lessThan(self.items[largest], self.items[right])) largest = right;
+            if (largest == i) return;
+            std.mem.swap(RowHandle, &self.items[i], &self.items[largest]);
+            i = largest;
+        }
+    }
+};
+
+/// Number of workers for a Top-N over `row_count` rows in `chunk_count`
+/// chunks. A plan's parallel degree above 1 is used as given; otherwise one
+/// worker per `min_rows_per_worker` rows, up to the CPU count.
+pub fn workerCount(row_count: usize, chunk_count: usize, parallel_degree: usize) usize {
+    const wanted = if (parallel_degree > 1) parallel_degree else blk: {
+        const cpu_count = std.Thread.getCpuCount() catch 1;
+        break :blk @min(cpu_count, row_count / min_rows_per_worker);
+    };
+    // Workers split the input on chunk boundaries
+    return @max(1, @min(@min(wanted, max_sort_workers), chunk_count));
+}
+
+/// The first `limit` rows of `chunks` in key order, copied into one chunk
+/// whose text shares an arena. The chunks are split into runs of about the
+/// same number of rows, one per worker. Each worker keeps the best `limit`
+/// rows of its run in a bounded heap, so memory is O(workers * limit) however
+/// large the input is, and the survivors are merged at the end. Heap space is
+/// reserved from `scratch` before any worker starts, so workers never
+/// allocate; the result chunk comes from `allocator`.
+pub fn topN(allocator: std.mem.Allocator, scratch: std.mem.Allocator, chunks: []const *Chunk, column_count: usize, keys: []const SortColumn, limit: usize, worker_count: usize) !*Chunk {
+    std.debug.assert(worker_count >= 1 and worker_count <= max_sort_workers);
+    const ordering = Ordering{ .chunks = chunks, .keys = keys };
+    var total_rows: usize = 0;
+    for (chunks) |chunk| total_rows += chunk.row_count;
+
+    // Runs of whole chunks
+    var bounds: [max_sort_workers + 1]usize = undefined;
+    bounds[0] = 0;
+    var next_chunk: usize = 0;
+    var rows_before: usize = 0;
+    for (1..worker_count) |w| {
+        const target = total_rows * w / worker_count;
+        while (next_chunk < chunks.len and rows_before < target) : (next_chunk += 1) {
+            rows_before += chunks[next_chunk].row_count;
+        }
+        bounds[w] = next_chunk;
+    }
+    bounds[worker_count] = chunks.len;
+
+    var heaps: [max_sort_workers]BoundedHeap = undefined;
+    var capacity: usize = 0;
+    for (0..worker_count) |w| capacity += @min(limit, rowCount(chunks[bounds[w]..bounds[w + 1]]));
+    const handles = try scratch.alloc(RowHandle, capacity);
+    defer scratch.free(handles);
+    var offset: usize = 0;
+    for (0..worker_count) |w| {
+        const size = @min(limit, rowCount(chunks[bounds[w]..bounds[w + 1]]));
+        heaps[w] = BoundedHeap{ .ordering = ordering, .items = handles[offset .. offset + size] };
+        offset += size;
+    }
+
+    if (worker_count == 1) {
+        collectRun(&heaps[0], 0, chunks.len);
+    } else {
+        var threads: [max_sort_workers]std.Thread = undefined;
+        var spawned: usize = 0;
+        for (0..worker_count) |w| {
+            if (heaps[w].items.len == 0) continue;
+            threads[w] = std.Thread.spawn(.{}, collectRun, .{ &heaps[w], bounds[w], bounds[w + 1] }) catch {
+                // Fall back to collecting this run on the calling thread
+                collectRun(&heaps[w], bounds[w], bounds[w + 1]);
+                continue;
+            };
+            spawned |= @as(usize, 1) << @intCast(w);
+        }
+        for (0..worker_count) |w| {
+            if (spawned & (@as(usize, 1) << @intCast(w)) != 0) threads[w].join();
+        }
+    }
+
+    // Every heap saw at least as many rows as it holds, so all of `handles`
+    // is filled: merge the survivors and keep the first `limit`
+    std.sort.pdq(RowHandle, handles, ordering, Ordering.lessThan);
+    return try copyRows(allocator, chunks, column_count, handles[0..@min(limit, handles.len)]);
+}
+
+/// All rows of `chunks` in key order, copied into one chunk whose text
+/// shares an arena
+pub fn sortRows(allocator: std.mem.Allocator, chunks: []const *Chunk, column_count: usize, keys: []const SortColumn) !*Chunk {
+    const handles = try allocator.alloc(RowHandle, rowCount(chunks));
+    defer allocator.free(handles);
+    var out: usize = 0;
+    for (chunks, 0..) |chunk, c| {
+        for (0..chunk.row_count) |r| {
+            handles[out] = RowHandle{ .chunk = @intCast(c), .row = @intCast(r) };
+            out += 1;
+        }
+    }
+    std.sort.pdq(RowHandle, handles, Ordering{ .chunks = chunks, .keys = keys }, Ordering.lessThan);
+    return try copyRows(allocator, chunks, column_count, handles);
+}
+
+/// ORDER BY over input of any size, within a memory budget. Rows are copied
+/// into a run until the next row would take the run over `memory_limit`;
+/// the run is then sorted and written to a temporary file in `spill_dir`.
+/// Once the input ends, an input that fit in memory is returned from its
+/// run, and spilled runs are merged with a k-way merge that holds one row
+/// per run. Either way rows are returned in chunks of at most `max_rows`,
+/// so the sorted result need never be in memory at once.
+pub const ExternalSort = struct {
+    allocator: std.mem.Allocator,
+    column_count: usize,
+    keys: []SortColumn,
+    memory_limit: usize,
+    spill_dir: ?std.fs.Dir, // Without one, a run over the budget is an error
+    run: *Chunk, // Rows not spilled yet
+    run_bytes: usize = 0,
+    row: []Value, // Scratch row
+    runs: std.ArrayListUnmanaged(SpillRun) = .{}, // In input order
+    bytes_spilled: u64 = 0,
+    // Output, once finished
+    order: []RowHandle = &.{}, // Sorted rows of `run` when nothing spilled
+    next_row: usize = 0,
+    merge: ?MergeQueue = null,
+
+    const MergeQueue = std.PriorityQueue(usize, *const ExternalSort, compareRuns);
+
+    /// A sorted run in a temporary file, and the row the merge is at
+    const SpillRun = struct {
+        name: []const u8,
+        file: std.fs.File,
+        rows: usize,
+        reader: std.io.BufferedReader(64 * 1024, std.fs.File.Reader) = undefined,
+        remaining: usize = 0,
+        current: []Value = &.{},
+        text: []std.ArrayListUnmanaged(u8) = &.{}, // Per column, backs `current`
+    };
+
+    pub fn create(allocator: std.mem.Allocator, column_count: usize, keys: []const SortColumn, memory_limit: usize, spill_dir: ?std.fs.Dir) !*ExternalSort {
+        const owned_keys = try allocator.dupe(SortColumn, keys);
+        errdefer allocator.free(owned_keys);
+        const row = try allocator.alloc(Value, column_count);
+        errdefer allocator.free(row);
+        const run = try Chunk.createOwned(allocator, column_count, 0, true);
+        errdefer run.release();
+
+        const self = try allocator.create(ExternalSort);
+        self.* = ExternalSort{
+            .allocator = allocator,
+            .column_count = column_count,
+            .keys = owned_keys,
+            .memory_limit = memory_limit,
+            .spill_dir = spill_dir,
+            .run = run,
+            .row = row,
+        };
+        return self;
+    }
+
+    /// Free everything and delete the temporary files
+    pub fn destroy(self: *ExternalSort) void {
+        if (self.merge) |*merge| merge.deinit();
+        for (self.runs.items) |*run| {
+            for (run.text) |*text| text.deinit(self.allocator);
+            self.allocator.free(run.text);
+            self.allocator.free(run.current);
+            run.file.close();
+            self.spill_dir.?.deleteFile(run.name) catch {};
+            self.allocator.free(run.name);
+        }
+        self.runs.deinit(self.allocator);
+        self.allocator.free(self.order);
+        self.run.release();
+        self.allocator.free(self.row);
+        self.allocator.free(self.keys);
+        self.allocator.destroy(self);
+    }
+
+    /// Copy the rows of `chunk` in, spilling the run first when they do not fit
+    pub fn add(self: *ExternalSort, chunk: *const Chunk) !void {
+        for (0..chunk.row_count) |r| {
+            var bytes: usize = self.column_count * @sizeOf(Value) + @sizeOf(RowHandle);
+            for (self.row, 0..) |*value, col| {
+                value.* = chunk.get(r, col);
+                if (value.* == .text) bytes += value.text.len;
+            }
+            if (self.run.row_count > 0 and self.run_bytes + bytes > self.memory_limit) try self.spillRun();
+            try self.run.appendRowCopy(self.row);
+            self.run_bytes += bytes;
+        }
+    }
+
+    /// End of input: sort what is in memory, or spill it and start the merge
+    pub fn finish(self: *ExternalSort) !void {
+        if (self.runs.items.len == 0) {
+            self.order = try self.sortRun();
+            return;
+        }
+        if (self.run.row_count > 0) try self.spillRun();
+
+        var merge = MergeQueue.init(self.allocator, self);
+        errdefer merge.deinit();
+        try merge.ensureTotalCapacity(self.runs.items.len);
+        for (self.runs.items, 0..) |*run, i| {
+            run.current = try self.allocator.alloc(Value, self.column_count);
+            run.text = try self.allocator.alloc(std.ArrayListUnmanaged(u8), self.column_count);
+            @memset(run.text, .{});
+            try run.file.seekTo(0);
+            run.reader = std.io.bufferedReader(run.file.reader());
+            run.remaining = run.rows;
+            try self.advance(run);
+            try merge.add(i);
+        }
+        self.merge = merge;
+    }
+
+    /// The next rows in key order, at most `max_rows` of them, or null when
+    /// all were returned. The caller owns the returned reference.
+    pub fn next(self: *ExternalSort, max_rows: usize) !?*Chunk {
+        const out = try Chunk.createOwned(self.allocator, self.column_count, 0, true);
+        errdefer out.release();
+
+        if (self.merge) |*merge| {
+            while (out.row_count < max_rows) {
+                const index = merge.removeOrNull() orelse break;
+                const run = &self.runs.items[index];
+                try out.appendRowCopy(run.current);
+                if (run.remaining > 0) {
+                    try self.advance(run);
+                    try merge.add(index);
+                }
+            }
+        } else {
+            while (out.row_count < max_rows and self.next_row < self.order.len) : (self.next_row += 1) {
+                for (self.row, 0..) |*value, col| value.* = self.run.get(self.order[self.next_row].row, col);
+                try out.appendRowCopy(self.row);
+            }
+        }
+
+        if (out.row_count == 0) {
+            out.release();
+            return null;
+        }
+        return out;
+    }
+
+    /// Handles of the run's rows in key order
+    fn sortRun(self: *ExternalSort) ![]RowHandle {
+        const handles = try self.allocator.alloc(RowHandle, self.run.row_count);
+        for (handles, 0..) |*handle, r| handle.* = RowHandle{ .chunk = 0, .row = @intCast(r) };
+        const ordering = Ordering{ .chunks = (&self.run)[0..1], .keys = self.keys };
+        std.sort.pdq(RowHandle, handles, ordering, Ordering.lessThan);
+        return handles;
+    }
+
+    /// Write the run, sorted, to a new temporary file and start a new run
+    fn spillRun(self: *ExternalSort) !void {
+        const dir = self.spill_dir orelse return error.QueryMemoryLimitExceeded;
+        try self.runs.ensureUnusedCapacity(self.allocator, 1);
+        const order = try self.sortRun();
+        defer self.allocator.free(order);
+
+        const name = try std.fmt.allocPrint(self.allocator, "sort-{d}.run", .{next_spill_file.fetchAdd(1, .monotonic)});
+        errdefer self.allocator.free(name);
+        const file = try dir.createFile(name, .{ .read = true, .exclusive = true });
+        errdefer {
+            file.close();
+            dir.deleteFile(name) catch {};
+        }
+
+        var buffered = std.io.bufferedWriter(file.writer());
+        var counting = std.io.countingWriter(buffered.writer());
+        for (order) |handle| {
+            for (self.row, 0..) |*value, col| value.* = self.run.get(handle.row, col);
+            try writeRow(counting.writer(), self.row);
+        }
+        try buffered.flush();
+
+        const fresh = try Chunk.createOwned(self.allocator, self.column_count, 0, true);
+        self.runs.appendAssumeCapacity(SpillRun{ .name = name, .file = file, .rows = self.run.row_count });
+        self.bytes_spilled += counting.bytes_written;
+        self.run.release();
+        self.run = fresh;
+        self.run_bytes = 0;
+    }
+
+    /// Read the next row of a run into its `current`
+    fn advance(self: *ExternalSort, run: *SpillRun) !void {
+        const reader = run.reader.reader();
+        for (run.current, run.text) |*value, *text| {
+            const tag = std.meta.intToEnum(std.meta.Tag(Value), try reader.readByte()) catch return error.CorruptSpillFile;
+            value.* = switch (tag) {
+                .integer => Value{ .integer = try reader.readInt(i64, .little) },
+                .float => Value{ .float = @bitCast(try reader.readInt(u64, .little)) },
+                .boolean => Value{ .boolean = try reader.readByte() != 0 },
+                .null => Value{ .null = {} },
+                .text => blk: {
+                    const len = try std.leb.readUleb128(usize, reader);
+                    try text.resize(self.allocator, len);
+                    try reader.readNoEof(text.items);
+                    break :blk Value{ .text = text.items };
+                },
+            };
+        }
+        run.remaining -= 1;
+    }
+
+    /// Merge order: the run whose current row sorts first. Ties go to the
+    /// earlier run, which holds the earlier input rows, so the sort is stable.
+    fn compareRuns(self: *const ExternalSort, a: usize, b: usize) std.math.Order {
+        const row_a = self.runs.items[a].current;
+        const row_b = self.runs.items[b].current;
+        for (self.keys) |key| {
+            const cmp = compareForSort(row_a[key.column], row_b[key.column]);
+            if (cmp != .eq) return if (key.descending) cmp.invert() else cmp;
+        }
+        return std.math.order(a, b);
+    }
+};
+
+/// Numbers the temporary files of every sort in the process
+var next_spill_file = std.atomic.Value(u64).init(0);
+
+/// One row of a spill file: per value, its tag and then its payload. Text is
+/// prefixed with its length as a LEB128 varint.
+fn writeRow(writer: anytype, values: []const Value) !void {
+    for (values) |value| {
+        try writer.writeByte(@intFromEnum(std.meta.activeTag(value)));
+        switch (value) {
+            .integer => |x| try writer.writeInt(i64, x, .little),
+            .float => |x| try writer.writeInt(u64, @bitCast(x), .little),
+            .boolean => |b| try writer.writeByte(@intFromBool(b)),
+            .null => {},
+            .text => |t| {
+                try std.leb.writeUleb128(writer, t.len);
+                try writer.writeAll(t);
+            },
+        }
+    }
+}
+
+fn collectRun(heap: *BoundedHeap, first_chunk: usize, end_chunk: usize) void {
+    for (first_chunk..end_chunk) |c| {
+        for (0..heap.ordering.chunks[c].row_count) |r| {
+            heap.offer(RowHandle{ .chunk = @intCast(c), .row = @intCast(r) });
+        }
+    }
+}
+
+fn rowCount(chunks: []const *Chunk) usize {
+    var rows: usize = 0;
+    for (chunks) |chunk| rows += chunk.row_count;
+    return rows;
+}
+
+fn copyRows(allocator: std.mem.Allocator, chunks: []const *Chunk, column_count: usize, rows: []const RowHandle) !*Chunk {
+    const out = try Chunk.createOwned(allocator, column_count, rows.len, true);
+    errdefer out.release();
+    const values = try allocator.alloc(Value, column_count);
+    defer allocator.free(values);
+    for (rows) |handle| {
+        const chunk = chunks[handle.chunk];
+        for (values, 0..) |*value, col| value.* = chunk.get(handle.row, col);
+        try out.appendRowCopy(values);
+    }
+    return out;
+}
+
+test "Top-N workers agree with a full sort" {
+    const allocator = std.testing.allocator;
+
+    // Three chunks of (group, score), with ties and NULLs
+    var chunks: [3]*Chunk = undefined;
+    var created: usize = 0;
+    defer for (chunks[0..created]) |chunk| chunk.release();
+    var i: i64 = 0;
+    for (&chunks) |*chunk| {
+        chunk.* = try Chunk.createOwned(allocator, 2, 100, true);
+        created += 1;
+        for (0..100) |_| {
+            const score: Value = if (@mod(i, 17) == 0) .null else .{ .integer = @mod(i * 37, 101) };
+            try chunk.*.appendRowCopy(&[_]Value{ .{ .text = if (@mod(i, 2) == 0) "even" else "odd" }, score });
+            i += 1;
+        }
+    }
+
+    const keys = [_]SortColumn{ .{ .column = 0 }, .{ .column = 1, .descending = true } };
+    const sorted = try sortRows(allocator, &chunks, 2, &keys);
+    defer sorted.release();
+    try std.testing.expectEqualStrings("even", sorted.get(0, 0).text);
+    // NULLs come first when descending
+    try std.testing.expect(sorted.get(0, 1) == .null);
+
+    for ([_]usize{ 1, 2, 3 }) |workers| {
+        const top = try topN(allocator, allocator, &chunks, 2, &keys, 25, workers);
+        defer top.release();
+        try std.testing.expectEqual(@as(usize, 25), top.row_count);
+        for (0..25) |r| {
+            try std.testing.expectEqualStrings(sorted.get(r, 0).text, top.get(r, 0).text);
+            try std.testing.expectEqual(compareForSort(sorted.get(r, 1), top.get(r, 1)), .eq);
+        }
+    }
+
+    // A limit beyond the input returns every row
+    const all = try topN(allocator, allocator, &chunks, 2, &keys, 1000, 2);
+    defer all.release();
+    try std.testing.expectEqual(@as(usize, 300), all.row_count);
+}
+
+test "ExternalSort spills runs and merges them in order" {
+    const allocator = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const input = try Chunk.createOwned(allocator, 2, 500, true);
+    defer input.release();
+    for (0..500) |i| {
+        const id: i64 = @intCast(i);
+        try input.appendRowCopy(&[_]Value{ .{ .integer = @mod(id * 7919, 500) }, .{ .text = if (i % 3 == 0) "fizz" else "buzz" } });
+    }
+    const keys = [_]SortColumn{ .{ .column = 1, .descending = true }, .{ .column = 0 } };
+    const chunks = [_]*Chunk{input};
+    const expected = try sortRows(allocator, &chunks, 2, &keys);
+    defer expected.release();
+
+    // About 60 bytes a row: a 2 KB budget makes more than ten runs
+    const sorter = try ExternalSort.create(allocator, 2, &keys, 2048, tmp.dir);
+    defer sorter.destroy();
+    try sorter.add(input);
+    try sorter.finish();
+    try std.testing.expect(sorter.runs.items.len > 10);
+    try std.testing.expect(sorter.bytes_spilled > 0);
+
+    var row: usize = 0;
+    while (try sorter.next(64)) |chunk| {
+        defer chunk.release();
+        try std.testing.expect(chunk.row_count <= 64);
+        for (0..chunk.row_count) |r| {
+            try std.testing.expectEqual(expected.get(row, 0).integer, chunk.get(r, 0).integer);
+            try std.testing.expectEqualStrings(expected.get(row, 1).text, chunk.get(r, 1).text);
+            row += 1;
+        }
+    }
+    try std.testing.expectEqual(@as(usize, 500), row);
+
+    // With nowhere to spill, going over the budget fails the query
+    const bounded = try ExternalSort.create(allocator, 2, &keys, 2048, null);
+    defer bounded.destroy();
+    try std.testing.expectError(error.QueryMemoryLimitExceeded, bounded.add(input));
+}
@@ -1,10 +1,15 @@
 const std = @import("std");
 const OLAPDatabase = @import("../core/database.zig").OLAPDatabase;
+const Session = @import("../core/session.zig").Session;
 const result = @import("../query/result.zig");
 const ResultSet = result.ResultSet;
 const Value = result.Value;
+const startsWithWord = @import("../query/planner.zig").startsWithWord;
 const assert = @import("../build_options.zig").assert;
 
+/// Rows written to the client per batch until it sends SET FETCH_SIZE
+pub const default_fetch_size: usize = 1024;
+
 /// Database server that listens for SQL queries over TCP
 pub const DatabaseServer = struct {
     allocator: std.mem.Allocator,
@@ -92,11 +97,18 @@ pub const DatabaseServer = struct {
         }
     }
 
-    /// Handle a client connection
+    /// Handle a client connection. Each connection has its own session, so
+    /// BEGIN ... COMMIT spans the statements it sends; a transaction still
+    /// open when the client disconnects is rolled back. SELECT results are
+    /// streamed in batches of the connection's fetch size.
     fn handleConnection(self: *DatabaseServer, connection: std.net.Server.Connection) !void {
         defer connection.stream.close();
 
+        var session = Session.init(self.allocator, self.db);
+        defer session.deinit();
+
         var buffer: [4096]u8 = undefined;
+        var fetch_size = default_fetch_size;
 
         while (true) {
             // Read query from client
@@ -112,9 +124,28 @@ pub const DatabaseServer = struct {
 
             // Extract SQL query
             const query = buffer[0..bytes_read];
+            const statement = std.mem.trim(u8, query, " \t\r\n;");
+
+            if (parseFetchSize(statement)) |size| {
+                fetch_size = size orelse {
+                    connection.stream.writeAll("ERROR: InvalidFetchSize\n") catch return;
+                    continue;
+                };
+                connection.stream.writeAll("OK\n") catch return;
+                continue;
+            }
+
+            if (startsWithWord(statement, "SELECT")) {
+                self.streamQuery(connection.stream, &session, query, fetch_size) catch |err| {
+                    const error_message = std.fmt.allocPrint(self.allocator, "ERROR: {s}\n", .{@errorName(err)}) catch return;
+                    defer self.allocator.free(error_message);
+                    connection.stream.writeAll(error_message) catch return;
+                };
+                continue;
+            }
 
             // Execute query
-            var result_set = self.db.execute(query) catch |err| {
+            var result_set = session.execute(query) catch |err| {
                 // Send error to client
                 const error_message = std.fmt.allocPrint(self.allocator, "ERROR: {s}\n", .{@errorName(err)}) catch "ERROR: Failed to format error message\n";
                 defer if (@TypeOf(error_message) != *const [0:0]u8) self.allocator.free(error_message);
@@ -146,6 +177,38 @@ pub const DatabaseServer = struct {
         }
     }
 
+    /// Run a SELECT through a cursor and write its rows as they are fetched,
+    /// `fetch_size` at a time. The client sees the first rows before the
+    /// query has read the rest, and only one batch is held in memory.
+    fn streamQuery(self: *DatabaseServer, stream: std.net.Stream, session: *Session, query: []const u8, fetch_size: usize) !void {
+        const cursor = try session.openCursor(query);
+        defer cursor.close();
+
+        if (cursor.header.columns.len == 0) {
+            try stream.writeAll("Query executed successfully. No results.\n");
+            return;
+        }
+
+        var buffer = std.ArrayList(u8).init(self.allocator);
+        defer buffer.deinit();
+        try writeHeader(buffer.writer(), cursor.header.columns);
+
+        var row_count: usize = 0;
+        while (true) {
+            var batch = try cursor.fetch(fetch_size);
+            defer batch.deinit();
+            try writeRows(buffer.writer(), &batch);
+            row_count += batch.row_count;
+
+            try stream.writeAll(buffer.items);
+            buffer.clearRetainingCapacity();
+            if (batch.row_count < fetch_size) break;
+        }
+
+        try buffer.writer().print("\n{d} row(s) returned\n", .{row_count});
+        try stream.writeAll(buffer.items);
+    }
+
     /// Format a result set as a string
     fn formatResultSet(allocator: std.mem.Allocator, result_set: ResultSet) ![]const u8 {
         // If there are no columns, return a simple message
@@ -157,45 +220,48 @@ pub const DatabaseServer = struct {
         var buffer = std.ArrayList(u8).init(allocator);
         defer buffer.deinit();
 
-        // Add column headers
-        try buffer.appendSlice("| ");
-        for (result_set.columns) |column| {
-            try buffer.writer().print("{s} | ", .{column.name});
+        try writeHeader(buffer.writer(), result_set.columns);
+        try writeRows(buffer.writer(), &result_set);
+
+        // Add row count summary
+        try buffer.writer().print("\n{d} row(s) returned\n", .{result_set.row_count});
+
+        // Return the formatted string
+        return buffer.toOwnedSlice();
+    }
+
+    /// Column names and a separator line
+    fn writeHeader(writer: anytype, columns: []const result.ResultColumn) !void {
+        try writer.writeAll("| ");
+        for (columns) |column| {
+            try writer.print("{s} | ", .{column.name});
         }
-        try buffer.appendSlice("\n");
+        try writer.writeAll("\n");
 
-        // Add a separator line
-        try buffer.appendSlice("|-");
-        for (result_set.columns) |column| {
-            for (0..column.name.len) |_| {
-                try buffer.appendSlice("-");
-            }
-            try buffer.appendSlice("-|-");
+        try writer.writeAll("|-");
+        for (columns) |column| {
+            try writer.writeByteNTimes('-', column.name.len);
+            try writer.writeAll("-|-");
         }
-        try buffer.appendSlice("\n");
+        try writer.writeAll("\n");
+    }
 
-        // Add rows
-        for (0..result_set.row_count) |row_idx| {
-            try buffer.appendSlice("| ");
+    fn writeRows(writer: anytype, result_set: *const ResultSet) !void {
+        var rows = result_set.iterator();
+        while (rows.next()) |row| {
+            try writer.writeAll("| ");
             for (0..result_set.columns.len) |col_idx| {
-                const value = result_set.getValue(row_idx, col_idx);
-                switch (value) {
-                    .integer => |i| try buffer.writer().print("{d}", .{i}),
-                    .float => |f| try buffer.writer().print("{d:.4}", .{f}),
-                    .text => |t| try buffer.writer().print("{s}", .{t}),
-                    .boolean => |b| try buffer.writer().print("{}", .{b}),
-                    .null => try buffer.writer().print("NULL", .{}),
+                switch (row.get(col_idx)) {
+                    .integer => |i| try writer.print("{d}", .{i}),
+                    .float => |f| try writer.print("{d:.4}", .{f}),
+                    .text => |t| try writer.print("{s}", .{t}),
+                    .boolean => |b| try writer.print("{}", .{b}),
+                    .null => try writer.writeAll("NULL"),
                 }
-                try buffer.appendSlice(" | ");
+                try writer.writeAll(" | ");
             }
-            try buffer.appendSlice("\n");
+            try writer.writeAll("\n");
         }
-
-        // Add row count summary
-        try buffer.writer().print("\n{d} row(s) returned\n", .{result_set.row_count});
-
-        // Return the formatted string
-        return buffer.toOwnedSlice();
     }
 
     /// Stop the server
@@ -219,3 +285,26 @@ pub const DatabaseServer = struct {
         self.allocator.destroy(self);
     }
 };
+
+/// Recognize SET FETCH_SIZE [=|TO] <rows>. Returns null if the statement is not
+/// a SET FETCH_SIZE, and an inner null if the row count is not a positive integer.
+fn parseFetchSize(statement: []const u8) ??usize {
+    if (!startsWithWord(statement, "SET")) return null;
+    var tokens = std.mem.tokenizeAny(u8, statement["SET".len..], " \t\r\n=");
+    const name = tokens.next() orelse return null;
+    if (!std.ascii.eqlIgnoreCase(name, "FETCH_SIZE")) return null;
+
+    var value = tokens.next() orelse return @as(?usize, null);
+    if (std.ascii.eqlIgnoreCase(value, "TO")) value = tokens.next() orelse return @as(?usize, null);
+    if (tokens.next() != null) return @as(?usize, null);
+    const size = std.fmt.parseInt(usize, value, 10) catch return @as(?usize, null);
+    return if (size == 0) @as(?usize, null) else size;
+}
+
+test "SET FETCH_SIZE accepts a positive row count" {
+    try std.testing.expectEqual(@as(??usize, 500), parseFetchSize("SET FETCH_SIZE 500"));
+    try std.testing.expectEqual(@as(??usize, 64), parseFetchSize("set fetch_size = 64"));
+    try std.testing.expectEqual(@as(??usize, 8), parseFetchSize("SET FETCH_SIZE TO 8"));
+    try std.testing.expectEqual(@as(??usize, @as(?usize, null)), parseFetchSize("SET FETCH_SIZE 0"));
+    try std.testing.expectEqual(@as(??usize, null), parseFetchSize("SELECT * FROM t"));
+}
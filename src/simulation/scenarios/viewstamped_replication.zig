@@ -35,6 +35,20 @@ pub const VRNode = struct {
     recovery_mode: bool = false, // Whether the node is in recovery mode
     state_transfer_in_progress: bool = false, // Whether state transfer is in progress
 
+    // State transfer: a lagging replica is sent the log suffix it is missing,
+    // or a checkpoint of the state when the gap is larger than the limit.
+    // The receiver pulls one chunk at a time and re-requests the chunk it is
+    // waiting for after a timeout, so a lost message resumes where it stopped.
+    state_transfer_suffix_limit: u64 = 1024, // Most operations sent instead of a checkpoint
+    state_transfer_chunk_ops: usize = 256, // Operations per NewState
+    state_transfer_chunk_bytes: usize = 16 * 1024, // Key and value bytes per CheckpointChunk
+    state_transfer_timeout: u64 = 100, // Ticks without progress before a request is resent
+    checkpoint_build_entries: usize = 1024, // State entries copied into a checkpoint per tick
+    checkpoint_lease: u64 = 1000, // Ticks a checkpoint no transfer reads is kept
+    state_transfer: ?StateTransfer = null, // Receiver side
+    checkpoints: std.ArrayList(Checkpoint), // Sender side, oldest first, shared by every transfer
+    checkpoint_build: ?CheckpointBuild = null, // Sender side, the next checkpoint being copied
+
     pub const Operation = struct {
         op_number: u64,
         client_id: []const u8,
@@ -65,6 +79,8 @@ pub const VRNode = struct {
         StartView,
         GetState,
         NewState,
+        GetCheckpoint,
+        CheckpointChunk,
     };
 
     pub const StateEntry = struct {
@@ -72,6 +88,63 @@ pub const VRNode = struct {
         value: []const u8,
     };
 
+    /// A copy of the state as of `op_number`. Its entries never change
+    /// order, so a chunk is named by the offset of its first entry.
+    pub const Checkpoint = struct {
+        arena: std.heap.ArenaAllocator,
+        op_number: u64,
+        entries: []StateEntry,
+        last_read: u64, // When a transfer last read it; it is dropped once the lease runs out
+    };
+
+    /// A checkpoint being copied a slice of keys per tick while operations
+    /// keep being applied. An operation about to change a key that is not
+    /// copied yet copies it first, and keys deleted meanwhile are freed only
+    /// when the build ends, so `keys` stays valid throughout.
+    pub const CheckpointBuild = struct {
+        arena: std.heap.ArenaAllocator, // The entries, handed over to the checkpoint
+        op_number: u64,
+        entries: std.ArrayListUnmanaged(StateEntry) = .{},
+        keys: [][]const u8, // The state's keys as of op_number, borrowed from it
+        next_key: usize = 0,
+        settled: std.AutoHashMapUnmanaged(usize, void) = .{}, // Keys by address, copied or created since
+        retired_keys: std.ArrayListUnmanaged([]const u8) = .{}, // Deleted since; freed with the build
+        waiters: std.ArrayListUnmanaged([]const u8) = .{}, // Receivers sent the first chunk when it is done
+        task: ?u64 = null,
+
+        /// Copy one entry as of op_number, unless it already was
+        fn copy(self: *CheckpointBuild, allocator: std.mem.Allocator, key: []const u8, value: []const u8) !void {
+            const slot = try self.settled.getOrPut(allocator, @intFromPtr(key.ptr));
+            if (slot.found_existing) return;
+            errdefer _ = self.settled.remove(@intFromPtr(key.ptr));
+            const arena = self.arena.allocator();
+            try self.entries.append(arena, StateEntry{
+                .key = try arena.dupe(u8, key),
+                .value = try arena.dupe(u8, value),
+            });
+        }
+
+        fn deinit(self: *CheckpointBuild, allocator: std.mem.Allocator) void {
+            for (self.retired_keys.items) |key| allocator.free(key);
+            self.retired_keys.deinit(allocator);
+            for (self.waiters.items) |waiter| allocator.free(waiter);
+            self.waiters.deinit(allocator);
+            self.settled.deinit(allocator);
+            allocator.free(self.keys);
+        }
+    };
+
+    /// Progress of a state transfer this node is receiving
+    pub const StateTransfer = struct {
+        source: []const u8,
+        checkpoint_op: ?u64 = null, // Checkpoint being streamed, if any
+        installed_op: ?u64 = null, // Checkpoint installed, whose suffix may exceed the limit
+        next_cursor: u64 = 0, // Offset of the next checkpoint entry wanted
+        staging: std.StringHashMap([]const u8), // Checkpoint entries received so far
+        last_progress: u64,
+        retry_task: ?u64 = null,
+    };
+
     pub const Message = struct {
         type: MessageType,
         view_number: u64,
@@ -80,6 +153,9 @@ pub const VRNode = struct {
         operation: ?Operation = null,
         log: ?[]Operation = null,
         state_entries: ?[]StateEntry = null,
+        checkpoint_op: ?u64 = null, // GetCheckpoint and CheckpointChunk; in GetState, the checkpoint installed
+        cursor: ?u64 = null, // Offset of the first checkpoint entry in the chunk
+        total: ?u64 = null, // Entries in the whole checkpoint
     };
 
     /// Initialize a new VR node
@@ -101,6 +177,7 @@ pub const VRNode = struct {
             .start_view_change_acks = std.StringHashMap(void).init(allocator),
             .do_view_change_msgs = std.StringHashMap(Message).init(allocator),
             .last_heartbeat_time = simulation.getCurrentTime(),
+            .checkpoints = std.ArrayList(Checkpoint).init(allocator),
         };
 
         // Add peers
@@ -156,6 +233,11 @@ pub const VRNode = struct {
         }
         self.do_view_change_msgs.deinit();
 
+        self.endStateTransfer();
+        self.abandonCheckpointBuild();
+        for (self.checkpoints.items) |*checkpoint| checkpoint.arena.deinit();
+        self.checkpoints.deinit();
+
         self.allocator.free(self.id);
         self.allocator.destroy(self);
     }
@@ -393,6 +475,7 @@ pub const VRNode = struct {
 
         switch (op.command) {
             .Put => |put| {
+                try self.preserveForCheckpoint(put.key);
                 // Check if key already exists
                 if (self.state.getKey(put.key)) |existing_key| {
                     // Free the old value
@@ -409,6 +492,8 @@ pub const VRNode = struct {
                     const value_copy = try self.allocator.dupe(u8, put.value);
                     errdefer self.allocator.free(value_copy);
 
+                    // A checkpoint being built must not pick up a key created after it
+                    if (self.checkpoint_build) |*build| try build.settled.put(self.allocator, @intFromPtr(key_copy.ptr), {});
                     try self.state.put(key_copy, value_copy);
                 }
 
@@ -420,11 +505,18 @@ pub const VRNode = struct {
                 std.debug.print("\n", .{});
             },
             .Delete => |delete| {
+                try self.preserveForCheckpoint(delete.key);
                 if (self.state.getKey(delete.key)) |existing_key| {
+                    // A checkpoint being built may still hold the key
+                    if (self.checkpoint_build) |*build| try build.retired_keys.ensureUnusedCapacity(self.allocator, 1);
                     const old_value = self.state.get(existing_key).?;
                     self.allocator.free(old_value);
                     _ = self.state.remove(existing_key);
-                    self.allocator.free(existing_key);
+                    if (self.checkpoint_build) |*build| {
+                        build.retired_keys.appendAssumeCapacity(existing_key);
+                    } else {
+                        self.allocator.free(existing_key);
+                    }
                 }
 
                 std.debug.print("Node {s} state after Delete: ", .{self.id});
@@ -482,6 +574,12 @@ pub const VRNode = struct {
             .NewState => {
                 try self.handleNewState(sender, message.value);
             },
+            .GetCheckpoint => {
+                try self.handleGetCheckpoint(sender, message.value);
+            },
+            .CheckpointChunk => {
+                try self.handleCheckpointChunk(sender, message.value);
+            },
         }
 
         // Clean up the message
@@ -910,213 +1008,401 @@ pub const VRNode = struct {
         self.do_view_change_msgs.clearRetainingCapacity();
     }
 
-    /// Request state transfer from another node
+    /// Request state transfer from another node. Only what this node is
+    /// missing is sent: the log suffix after its op_number, or a checkpoint
+    /// followed by the suffix after it when the gap is too large.
     pub fn requestStateTransfer(self: *VRNode, target_node: []const u8) !void {
+        self.endStateTransfer();
+        const source = try self.allocator.dupe(u8, target_node);
+        self.state_transfer = StateTransfer{
+            .source = source,
+            .staging = std.StringHashMap([]const u8).init(self.allocator),
+            .last_progress = self.simulation.getCurrentTime(),
+        };
         self.state_transfer_in_progress = true;
 
-        // Send GetState message
-        const message = Message{
+        try self.sendStateRequest();
+        self.state_transfer.?.retry_task = try self.simulation.scheduler.scheduleAfter(self.state_transfer_timeout, 0, checkStateTransfer, self);
+    }
+
+    /// Ask the source for whatever the transfer needs next
+    fn sendStateRequest(self: *VRNode) !void {
+        const transfer = &self.state_transfer.?;
+        const message = if (transfer.checkpoint_op) |checkpoint_op| Message{
+            .type = .GetCheckpoint,
+            .view_number = self.view_number,
+            .checkpoint_op = checkpoint_op,
+            .cursor = transfer.next_cursor,
+        } else Message{
             .type = .GetState,
             .view_number = self.view_number,
             .op_number = self.op_number,
             .commit_number = self.commit_number,
+            .checkpoint_op = transfer.installed_op,
         };
 
-        try self.sendMessage(target_node, message);
+        try self.sendMessage(transfer.source, message);
     }
 
-    /// Handle a GetState message
-    fn handleGetState(self: *VRNode, sender: []const u8, message: Message) !void {
-        // Check view number
-        if (message.view_number != self.view_number) {
-            return; // Ignore messages from different views
-        }
+    /// Resend the outstanding request if the transfer made no progress
+    fn checkStateTransfer(context: ?*anyopaque) void {
+        const node = @as(*VRNode, @ptrCast(@alignCast(context.?)));
+        const transfer = if (node.state_transfer) |*t| t else return;
+        transfer.retry_task = null;
 
-        // Create a copy of our log starting from the requester's op_number
-        var start_index: usize = 0;
-        if (message.op_number) |requester_op_number| {
-            for (self.log.items, 0..) |op, i| {
-                if (op.op_number > requester_op_number) {
-                    start_index = i;
-                    break;
-                }
-            }
+        const current_time = node.simulation.getCurrentTime();
+        if (node.active and current_time - transfer.last_progress >= node.state_transfer_timeout) {
+            transfer.last_progress = current_time;
+            node.sendStateRequest() catch {};
         }
+        transfer.retry_task = node.simulation.scheduler.scheduleAfter(node.state_transfer_timeout, 0, checkStateTransfer, node) catch null;
+    }
 
-        // Create log copy
-        var log_copy = try self.allocator.alloc(Operation, self.log.items.len - start_index);
-        errdefer self.allocator.free(log_copy);
+    /// Free the receiver-side transfer state, finished or not
+    fn endStateTransfer(self: *VRNode) void {
+        const transfer = if (self.state_transfer) |*t| t else return;
+        if (transfer.retry_task) |task| _ = self.simulation.scheduler.cancel(task);
+        freeStateMap(self.allocator, &transfer.staging);
+        transfer.staging.deinit();
+        self.allocator.free(transfer.source);
+        self.state_transfer = null;
+    }
 
-        var i: usize = 0;
-        errdefer {
-            // Free any operations we've already copied
-            for (log_copy[0..i]) |*op| {
-                self.allocator.free(op.client_id);
-                switch (op.command) {
-                    .Put => |put| {
-                        self.allocator.free(put.key);
-                        self.allocator.free(put.value);
-                    },
-                    .Get => |get| {
-                        self.allocator.free(get.key);
-                    },
-                    .Delete => |delete| {
-                        self.allocator.free(delete.key);
-                    },
-                }
-            }
+    fn freeStateMap(allocator: std.mem.Allocator, map: *std.StringHashMap([]const u8)) void {
+        var it = map.iterator();
+        while (it.next()) |entry| {
+            allocator.free(entry.key_ptr.*);
+            allocator.free(entry.value_ptr.*);
         }
+        map.clearRetainingCapacity();
+    }
 
-        for (self.log.items[start_index..], 0..) |op, idx| {
-            log_copy[idx] = Operation{
-                .op_number = op.op_number,
-                .client_id = try self.allocator.dupe(u8, op.client_id),
-                .request_number = op.request_number,
-                .command = try self.duplicateCommand(op.command),
-            };
-            i = idx + 1;
+    /// The state reflects operations up to here: the primary applies them on
+    /// commit and backups as soon as they are prepared
+    fn appliedOpNumber(self: *const VRNode) u64 {
+        return if (self.is_primary) self.commit_number else self.op_number;
+    }
+
+    /// Adopt a newer view announced by a state transfer source
+    fn adoptView(self: *VRNode, view_number: u64) void {
+        if (view_number > self.view_number) {
+            self.view_number = view_number;
+            self.is_primary = false;
         }
+    }
 
-        // Create a copy of our state for the recovering node
-        var state_entries = std.ArrayList(StateEntry).init(self.allocator);
-        defer state_entries.deinit();
+    /// Handle a GetState message
+    fn handleGetState(self: *VRNode, sender: []const u8, message: Message) !void {
+        // A requester in a newer view has nothing to learn from us
+        if (message.view_number > self.view_number) {
+            return;
+        }
 
-        var state_it = self.state.iterator();
-        while (state_it.next()) |entry| {
-            try state_entries.append(StateEntry{
-                .key = try self.allocator.dupe(u8, entry.key_ptr.*),
-                .value = try self.allocator.dupe(u8, entry.value_ptr.*),
-            });
+        // Send the log suffix after the requester's op_number if we still
+        // have all of it and it is short enough. After installing a checkpoint
+        // the requester takes the suffix however long it has grown meanwhile,
+        // rather than being sent another checkpoint it would fall behind again.
+        const requester_op_number = message.op_number orelse 0;
+        const has_suffix = requester_op_number >= self.op_number or
+            (self.log.items.len > 0 and self.log.items[0].op_number <= requester_op_number + 1);
+        const too_long = message.checkpoint_op == null and self.op_number -| requester_op_number > self.state_transfer_suffix_limit;
+        if (!has_suffix or too_long) {
+            return try self.sendCheckpointChunk(sender, null, 0);
         }
 
-        // Create owned slice for state entries
-        var state_entries_slice: ?[]StateEntry = null;
-        if (state_entries.items.len > 0) {
-            state_entries_slice = try state_entries.toOwnedSlice();
+        var start_index: usize = self.log.items.len;
+        for (self.log.items, 0..) |op, i| {
+            if (op.op_number > requester_op_number) {
+                start_index = i;
+                break;
+            }
         }
+        const end_index = @min(self.log.items.len, start_index + self.state_transfer_chunk_ops);
 
-        // Send NewState message
+        // The suffix is serialized straight from our log
         const response = Message{
             .type = .NewState,
             .view_number = self.view_number,
             .op_number = self.op_number,
             .commit_number = self.commit_number,
-            .log = log_copy,
-            .state_entries = state_entries_slice,
+            .log = self.log.items[start_index..end_index],
         };
 
         try self.sendMessage(sender, response);
     }
 
-    /// Handle a NewState message
+    /// Handle a NewState message carrying part of the log suffix
     fn handleNewState(self: *VRNode, sender: []const u8, message: Message) !void {
-        _ = sender;
+        const transfer = if (self.state_transfer) |*t| t else return;
+        if (!std.mem.eql(u8, transfer.source, sender)) {
+            return;
+        }
+        self.adoptView(message.view_number);
+        transfer.last_progress = self.simulation.getCurrentTime();
 
-        // Check view number
-        if (message.view_number != self.view_number) {
-            // Free the log if it exists
-            if (message.log) |log| {
-                for (log) |op| {
-                    self.freeOperation(op);
-                }
-                self.allocator.free(log);
+        // Append the operations that follow our log; anything else is a duplicate
+        if (message.log) |log| {
+            for (log) |op| {
+                if (op.op_number != self.op_number + 1) continue;
+
+                const client_id = if (std.mem.eql(u8, op.client_id, "client1"))
+                    "client1"
+                else
+                    try self.allocator.dupe(u8, op.client_id);
+                try self.log.append(Operation{
+                    .op_number = op.op_number,
+                    .client_id = client_id,
+                    .request_number = op.request_number,
+                    .command = try self.duplicateCommand(op.command),
+                });
+                self.op_number = op.op_number;
+
+                // Apply the operation to our state
+                try self.applyOperation(self.log.items[self.log.items.len - 1]);
             }
+        }
 
-            // Free state entries if they exist
-            if (message.state_entries) |entries| {
-                for (entries) |entry| {
-                    self.allocator.free(entry.key);
-                    self.allocator.free(entry.value);
-                }
-                self.allocator.free(entries);
+        // Update commit_number
+        if (message.commit_number) |commit_number| {
+            if (commit_number > self.commit_number) {
+                self.commit_number = @min(commit_number, self.op_number);
             }
+        }
 
-            return; // Ignore messages from different views
+        // Pull the next part of the suffix until we reach the source's op_number
+        if (self.op_number < (message.op_number orelse 0)) {
+            return try self.sendStateRequest();
         }
+        self.finishStateTransfer();
+    }
 
-        // If we're in recovery mode, clear our state and replace it with the received state
-        if (self.recovery_mode) {
-            // Clear our existing state
-            var state_it = self.state.iterator();
-            while (state_it.next()) |entry| {
-                self.allocator.free(entry.key_ptr.*);
-                self.allocator.free(entry.value_ptr.*);
-            }
-            self.state.clearRetainingCapacity();
+    fn finishStateTransfer(self: *VRNode) void {
+        self.endStateTransfer();
+        self.state_transfer_in_progress = false;
+        self.recovery_mode = false;
+        self.view_change_status = .Normal;
+    }
 
-            // Apply the received state
-            if (message.state_entries) |entries| {
-                for (entries) |entry| {
-                    const key_copy = try self.allocator.dupe(u8, entry.key);
-                    errdefer self.allocator.free(key_copy);
+    /// Handle a GetCheckpoint message asking for the chunk at `cursor`
+    fn handleGetCheckpoint(self: *VRNode, sender: []const u8, message: Message) !void {
+        if (message.view_number > self.view_number) {
+            return;
+        }
+        try self.sendCheckpointChunk(sender, message.checkpoint_op, message.cursor orelse 0);
+    }
 
-                    const value_copy = try self.allocator.dupe(u8, entry.value);
-                    errdefer self.allocator.free(value_copy);
+    /// Send one chunk of the checkpoint taken at `checkpoint_op`. The
+    /// checkpoint is kept while transfers read it; a requester whose
+    /// checkpoint has expired, or that has none yet, starts on the current
+    /// one, which may first have to be built.
+    fn sendCheckpointChunk(self: *VRNode, recipient: []const u8, checkpoint_op: ?u64, cursor: u64) !void {
+        self.dropIdleCheckpoints();
+        const held = if (checkpoint_op) |op| self.findCheckpoint(op) else null;
+        const checkpoint = held orelse (try self.currentCheckpoint(recipient) orelse return);
+        checkpoint.last_read = self.simulation.getCurrentTime();
+        const start: usize = if (checkpoint_op == checkpoint.op_number) @intCast(@min(cursor, checkpoint.entries.len)) else 0;
+
+        var end = start;
+        var bytes: usize = 0;
+        while (end < checkpoint.entries.len) : (end += 1) {
+            const entry_bytes = checkpoint.entries[end].key.len + checkpoint.entries[end].value.len;
+            if (end > start and bytes + entry_bytes > self.state_transfer_chunk_bytes) break;
+            bytes += entry_bytes;
+        }
 
-                    try self.state.put(key_copy, value_copy);
-                }
+        const response = Message{
+            .type = .CheckpointChunk,
+            .view_number = self.view_number,
+            .commit_number = checkpoint.op_number,
+            .state_entries = checkpoint.entries[start..end],
+            .checkpoint_op = checkpoint.op_number,
+            .cursor = start,
+            .total = checkpoint.entries.len,
+        };
 
-                // Free the received state entries
-                for (entries) |entry| {
-                    self.allocator.free(entry.key);
-                    self.allocator.free(entry.value);
-                }
-                self.allocator.free(entries);
+        try self.sendMessage(recipient, response);
+    }
+
+    fn findCheckpoint(self: *VRNode, op_number: u64) ?*Checkpoint {
+        for (self.checkpoints.items) |*checkpoint| {
+            if (checkpoint.op_number == op_number) return checkpoint;
+        }
+        return null;
+    }
+
+    /// The checkpoint a new transfer starts on: the newest one unless the log
+    /// since it has grown past the suffix limit. Otherwise a new one is built
+    /// over the next ticks and null is returned; `recipient` is sent its first
+    /// chunk when it is done.
+    fn currentCheckpoint(self: *VRNode, recipient: []const u8) !?*Checkpoint {
+        if (self.checkpoints.items.len > 0 and self.checkpoint_build == null) {
+            const newest = &self.checkpoints.items[self.checkpoints.items.len - 1];
+            if (self.appliedOpNumber() -| newest.op_number <= self.state_transfer_suffix_limit) {
+                return newest;
             }
+        }
+        if (self.checkpoint_build == null) try self.startCheckpointBuild();
 
-            // We're no longer in recovery mode
-            self.recovery_mode = false;
+        const build = &self.checkpoint_build.?;
+        for (build.waiters.items) |waiter| {
+            if (std.mem.eql(u8, waiter, recipient)) return null;
         }
+        const waiter = try self.allocator.dupe(u8, recipient);
+        errdefer self.allocator.free(waiter);
+        try build.waiters.append(self.allocator, waiter);
+        return null;
+    }
 
-        // Update our log with the received operations
-        if (message.log) |log| {
-            for (log) |op| {
-                // Check if we already have this operation
-                var found = false;
-                for (self.log.items) |existing_op| {
-                    if (existing_op.op_number == op.op_number) {
-                        found = true;
-                        break;
-                    }
-                }
+    /// Start copying the state as of now into a checkpoint. Only the keys
+    /// are listed here; their values are copied a slice per tick.
+    fn startCheckpointBuild(self: *VRNode) !void {
+        const keys = try self.allocator.alloc([]const u8, self.state.count());
+        errdefer self.allocator.free(keys);
+        var it = self.state.keyIterator();
+        var i: usize = 0;
+        while (it.next()) |key| : (i += 1) {
+            keys[i] = key.*;
+        }
 
-                if (!found) {
-                    // Add the operation to our log
-                    try self.log.append(Operation{
-                        .op_number = op.op_number,
-                        .client_id = try self.allocator.dupe(u8, op.client_id),
-                        .request_number = op.request_number,
-                        .command = try self.duplicateCommand(op.command),
-                    });
+        self.checkpoint_build = CheckpointBuild{
+            .arena = std.heap.ArenaAllocator.init(self.allocator),
+            .op_number = self.appliedOpNumber(),
+            .keys = keys,
+        };
+        self.checkpoint_build.?.task = try self.simulation.scheduler.scheduleAfter(1, 0, continueCheckpointBuild, self);
+    }
 
-                    // Apply the operation to our state
-                    try self.applyOperation(self.log.items[self.log.items.len - 1]);
-                }
-            }
+    fn continueCheckpointBuild(context: ?*anyopaque) void {
+        const node = @as(*VRNode, @ptrCast(@alignCast(context.?)));
+        const build = if (node.checkpoint_build) |*b| b else return;
+        build.task = null;
+        node.copyCheckpointSlice() catch |err| {
+            std.debug.print("Error building checkpoint: {}\n", .{err});
+            node.abandonCheckpointBuild();
+        };
+    }
 
-            // Free the received log
-            for (log) |op| {
-                self.freeOperation(op);
-            }
-            self.allocator.free(log);
+    /// Copy the next slice of keys into the checkpoint being built, and
+    /// publish it once every key is copied
+    fn copyCheckpointSlice(self: *VRNode) !void {
+        const build = &self.checkpoint_build.?;
+        const end = @min(build.keys.len, build.next_key + self.checkpoint_build_entries);
+        // A key changed since the build started was copied before the change
+        for (build.keys[build.next_key..end]) |key| {
+            if (build.settled.contains(@intFromPtr(key.ptr))) continue;
+            try build.copy(self.allocator, key, self.state.get(key).?);
+        }
+        build.next_key = end;
+        if (end < build.keys.len) {
+            build.task = try self.simulation.scheduler.scheduleAfter(1, 0, continueCheckpointBuild, self);
+            return;
         }
 
-        // Update op_number
-        if (message.op_number) |op_number| {
-            if (op_number > self.op_number) {
-                self.op_number = op_number;
-            }
+        try self.checkpoints.append(Checkpoint{
+            .arena = build.arena,
+            .op_number = build.op_number,
+            .entries = build.entries.items,
+            .last_read = self.simulation.getCurrentTime(),
+        });
+        var waiters = build.waiters;
+        build.waiters = .{};
+        build.deinit(self.allocator);
+        self.checkpoint_build = null;
+
+        defer {
+            for (waiters.items) |waiter| self.allocator.free(waiter);
+            waiters.deinit(self.allocator);
+        }
+        for (waiters.items) |waiter| {
+            try self.sendCheckpointChunk(waiter, self.checkpoints.items[self.checkpoints.items.len - 1].op_number, 0);
         }
+    }
 
-        // Update commit_number
-        if (message.commit_number) |commit_number| {
-            if (commit_number > self.commit_number) {
-                self.commit_number = commit_number;
+    /// Stop building a checkpoint, e.g. because the state is about to be replaced
+    fn abandonCheckpointBuild(self: *VRNode) void {
+        const build = if (self.checkpoint_build) |*b| b else return;
+        if (build.task) |task| _ = self.simulation.scheduler.cancel(task);
+        build.deinit(self.allocator);
+        build.arena.deinit();
+        self.checkpoint_build = null;
+    }
+
+    /// Drop checkpoints no transfer has read within the lease, except the
+    /// newest, which the next transfer may still start on
+    fn dropIdleCheckpoints(self: *VRNode) void {
+        const now = self.simulation.getCurrentTime();
+        var i: usize = 0;
+        while (i + 1 < self.checkpoints.items.len) {
+            const checkpoint = &self.checkpoints.items[i];
+            if (now - checkpoint.last_read > self.checkpoint_lease) {
+                checkpoint.arena.deinit();
+                _ = self.checkpoints.orderedRemove(i);
+            } else {
+                i += 1;
             }
         }
+    }
 
-        // State transfer is complete
-        self.state_transfer_in_progress = false;
+    /// Copy a key's value into the checkpoint being built before an
+    /// operation changes it
+    fn preserveForCheckpoint(self: *VRNode, key: []const u8) !void {
+        const build = if (self.checkpoint_build) |*b| b else return;
+        const existing_key = self.state.getKey(key) orelse return;
+        try build.copy(self.allocator, existing_key, self.state.get(existing_key).?);
+    }
+
+    /// Handle a CheckpointChunk message. Chunks are staged and installed
+    /// together once the last one arrives, then the suffix after the
+    /// checkpoint is requested.
+    fn handleCheckpointChunk(self: *VRNode, sender: []const u8, message: Message) !void {
+        const transfer = if (self.state_transfer) |*t| t else return;
+        if (!std.mem.eql(u8, transfer.source, sender)) {
+            return;
+        }
+        const checkpoint_op = message.checkpoint_op orelse return;
+        self.adoptView(message.view_number);
+
+        // The source took a new checkpoint; start over with it
+        if (transfer.checkpoint_op != checkpoint_op) {
+            freeStateMap(self.allocator, &transfer.staging);
+            transfer.checkpoint_op = checkpoint_op;
+            transfer.next_cursor = 0;
+        }
+        // A duplicate, or a chunk other than the one we asked for
+        if ((message.cursor orelse 0) != transfer.next_cursor) {
+            return;
+        }
+        transfer.last_progress = self.simulation.getCurrentTime();
+
+        const entries = message.state_entries orelse &[_]StateEntry{};
+        for (entries) |entry| {
+            const key_copy = try self.allocator.dupe(u8, entry.key);
+            errdefer self.allocator.free(key_copy);
+            const value_copy = try self.allocator.dupe(u8, entry.value);
+            errdefer self.allocator.free(value_copy);
+            try transfer.staging.put(key_copy, value_copy);
+        }
+        transfer.next_cursor += entries.len;
+
+        if (transfer.next_cursor < (message.total orelse 0)) {
+            return try self.sendStateRequest();
+        }
+
+        // Install the checkpoint in place of our state and log
+        self.abandonCheckpointBuild();
+        freeStateMap(self.allocator, &self.state);
+        std.mem.swap(std.StringHashMap([]const u8), &self.state, &transfer.staging);
+        for (self.log.items) |op| {
+            self.freeOperation(op);
+        }
+        self.log.clearRetainingCapacity();
+        self.op_number = checkpoint_op;
+        self.commit_number = checkpoint_op;
+
+        // Catch up on what was committed after the checkpoint was taken
+        transfer.checkpoint_op = null;
+        transfer.installed_op = checkpoint_op;
+        try self.sendStateRequest();
     }
 };
 
@@ -0,0 +1,114 @@
+const std = @import("std");
+const Value = @import("../query/result.zig").Value;
+
+/// Filter bits budgeted per distinct key (about 1% false positives)
+pub const bits_per_key: usize = 10;
+
+/// Bits in one block; a block is one 64-byte cache line
+const block_bits: usize = 512;
+
+/// Multipliers that pick one bit per word from the low half of the hash
+const salts = [8]u32{ 0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d, 0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31 };
+
+/// Blocked Bloom filter. Each key touches a single cache-line block, setting
+/// one bit in each of its eight words, so a probe costs one memory access.
+pub const BlockedBloomFilter = struct {
+    blocks: [][8]u64,
+
+    pub fn init(allocator: std.mem.Allocator, expected_keys: usize) !BlockedBloomFilter {
+        const block_count = @max(1, (expected_keys * bits_per_key + block_bits - 1) / block_bits);
+        const blocks = try allocator.alloc([8]u64, block_count);
+        @memset(blocks, [_]u64{0} ** 8);
+        return BlockedBloomFilter{ .blocks = blocks };
+    }
+
+    pub fn deinit(self: *BlockedBloomFilter, allocator: std.mem.Allocator) void {
+        allocator.free(self.blocks);
+    }
+
+    pub fn insertHash(self: *BlockedBloomFilter, hash: u64) void {
+        const block = &self.blocks[self.blockIndex(hash)];
+        const key: u32 = @truncate(hash);
+        for (block, salts) |*word, salt| {
+            word.* |= bitFor(key, salt);
+        }
+    }
+
+    /// False means the key is definitely absent
+    pub fn mayContainHash(self: *const BlockedBloomFilter, hash: u64) bool {
+        const block = &self.blocks[self.blockIndex(hash)];
+        const key: u32 = @truncate(hash);
+        for (block, salts) |word, salt| {
+            if (word & bitFor(key, salt) == 0) return false;
+        }
+        return true;
+    }
+
+    pub fn insert(self: *BlockedBloomFilter, value: Value) void {
+        if (hashValue(value)) |hash| self.insertHash(hash);
+    }
+
+    pub fn mayContain(self: *const BlockedBloomFilter, value: Value) bool {
+        const hash = hashValue(value) orelse return false;
+        return self.mayContainHash(hash);
+    }
+
+    pub fn memoryBytes(self: *const BlockedBloomFilter) usize {
+        return self.blocks.len * @sizeOf([8]u64);
+    }
+
+    fn blockIndex(self: *const BlockedBloomFilter, hash: u64) usize {
+        // Map the high half of the hash onto [0, blocks.len) without a division
+        return @intCast(((hash >> 32) * self.blocks.len) >> 32);
+    }
+};
+
+fn bitFor(key: u32, salt: u32) u64 {
+    return @as(u64, 1) << @intCast((key *% salt) >> 26);
+}
+
+/// Hash a value so that values that compare equal hash equally
+/// (an integral float hashes like the integer). NULL has no hash.
+pub fn hashValue(value: Value) ?u64 {
+    return switch (value) {
+        .null => null,
+        .integer => |i| hashInt(i),
+        .boolean => |b| hashInt(@intFromBool(b)),
+        .float => |f| if (@floor(f) == f and f >= -9.2e18 and f <= 9.2e18)
+            hashInt(@intFromFloat(f))
+        else
+            std.hash.Wyhash.hash(1, std.mem.asBytes(&f)),
+        .text => |t| std.hash.Wyhash.hash(2, t),
+    };
+}
+
+fn hashInt(i: i64) u64 {
+    return std.hash.Wyhash.hash(0, std.mem.asBytes(&i));
+}
+
+test "BlockedBloomFilter has no false negatives and few false positives" {
+    const allocator = std.testing.allocator;
+    var filter = try BlockedBloomFilter.init(allocator, 10_000);
+    defer filter.deinit(allocator);
+
+    var buf: [32]u8 = undefined;
+    for (0..10_000) |i| {
+        filter.insert(Value{ .text = try std.fmt.bufPrint(&buf, "session-{d}", .{i}) });
+    }
+    for (0..10_000) |i| {
+        try std.testing.expect(filter.mayContain(Value{ .text = try std.fmt.bufPrint(&buf, "session-{d}", .{i}) }));
+    }
+
+    var false_positives: usize = 0;
+    for (10_000..20_000) |i| {
+        if (filter.mayContain(Value{ .text = try std.fmt.bufPrint(&buf, "session-{d}", .{i}) })) false_positives += 1;
+    }
+    try std.testing.expect(false_positives < 300);
+
+    try std.testing.expect(!filter.mayContain(Value{ .null = {} }));
+}
+
+test "hashValue treats integral floats like integers" {
+    try std.testing.expectEqual(hashValue(Value{ .integer = 42 }), hashValue(Value{ .float = 42.0 }));
+    try std.testing.expect(hashValue(Value{ .float = 42.5 }) != hashValue(Value{ .integer = 42 }));
+}
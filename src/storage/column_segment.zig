@@ -0,0 +1,799 @@
+const std = @import("std");
+const Value = @import("../query/result.zig").Value;
+const ColumnSchema = @import("../core/database.zig").ColumnSchema;
+const DataType = ColumnSchema.DataType;
+const ZoneMap = @import("zone_map.zig").ZoneMap;
+const BlockedBloomFilter = @import("bloom_filter.zig").BlockedBloomFilter;
+const SegmentVersions = @import("row_versions.zig").SegmentVersions;
+
+/// Number of rows sealed into one compressed segment
+pub const default_segment_rows: usize = 64 * 1024;
+
+/// Comparison operators the scan kernels can evaluate on encoded data
+pub const CompareOp = enum {
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+};
+
+/// Physical encoding of one column segment
+pub const Encoding = enum {
+    Plain, // One Value per row
+    Dictionary, // Sorted distinct strings plus bit-packed codes
+    RunLength, // One Value per run of identical values
+    FrameOfReference, // Bit-packed offsets from the segment minimum
+};
+
+/// Fixed-width unsigned integers packed back to back into 64-bit words
+pub const BitPacked = struct {
+    words: []const u64 = &[_]u64{},
+    bit_width: u7 = 0,
+    len: usize = 0,
+
+    /// Pack values that all fit in `bit_width` bits
+    pub fn pack(allocator: std.mem.Allocator, values: []const u64, bit_width: u7) !BitPacked {
+        const words = try allocator.alloc(u64, (values.len * bit_width + 63) / 64);
+        @memset(words, 0);
+
+        if (bit_width > 0) {
+            for (values, 0..) |v, i| {
+                const bit = i * bit_width;
+                const offset: u6 = @intCast(bit % 64);
+                words[bit / 64] |= v << offset;
+                if (@as(usize, offset) + bit_width > 64) {
+                    words[bit / 64 + 1] |= v >> @intCast(64 - @as(u7, offset));
+                }
+            }
+        }
+
+        return BitPacked{ .words = words, .bit_width = bit_width, .len = values.len };
+    }
+
+    /// Read the i-th packed value
+    pub fn get(self: BitPacked, i: usize) u64 {
+        if (self.bit_width == 0) return 0;
+        const bit = i * self.bit_width;
+        const offset: u6 = @intCast(bit % 64);
+        var v = self.words[bit / 64] >> offset;
+        if (@as(usize, offset) + self.bit_width > 64) {
+            v |= self.words[bit / 64 + 1] << @intCast(64 - @as(u7, offset));
+        }
+        return v & maxForWidth(self.bit_width);
+    }
+
+    pub fn deinit(self: *BitPacked, allocator: std.mem.Allocator) void {
+        allocator.free(self.words);
+        self.words = &[_]u64{};
+    }
+};
+
+fn maxForWidth(bit_width: u7) u64 {
+    if (bit_width >= 64) return std.math.maxInt(u64);
+    return (@as(u64, 1) << @intCast(bit_width)) - 1;
+}
+
+fn bitsNeeded(max_value: u64) u7 {
+    return 64 - @clz(max_value);
+}
+
+/// A range of packed codes that satisfies a predicate.
+/// Rows match when their code is inside [lo, hi], or outside it when `negate` is set.
+const CodeRange = struct {
+    lo: u64,
+    hi: u64,
+    negate: bool,
+
+    fn init(lo: i128, hi: i128, max_code: i128, negate: bool) CodeRange {
+        const clamped_lo = @max(lo, 0);
+        const clamped_hi = @min(hi, max_code);
+        if (clamped_lo > clamped_hi) {
+            // Empty range: nothing matches, or everything does when negated
+            return CodeRange{ .lo = 1, .hi = 0, .negate = negate };
+        }
+        return CodeRange{
+            .lo = @intCast(clamped_lo),
+            .hi = @intCast(clamped_hi),
+            .negate = negate,
+        };
+    }
+
+    fn contains(self: CodeRange, code: u64) bool {
+        return (code >= self.lo and code <= self.hi) != self.negate;
+    }
+};
+
+/// One column of a sealed segment, stored in whichever encoding is smallest
+pub const ColumnSegment = struct {
+    data_type: DataType,
+    encoding: Encoding,
+    row_count: usize,
+    null_count: usize = 0,
+    /// Null rows for the Dictionary and FrameOfReference encodings (bit set = null)
+    nulls: ?[]const u64 = null,
+    /// Plain: one value per row. RunLength: one value per run.
+    values: []const Value = &[_]Value{},
+    /// RunLength: exclusive end row of each run
+    run_ends: []const u32 = &[_]u32{},
+    /// Dictionary: distinct strings in ascending order, so codes preserve order
+    dictionary: []const []const u8 = &[_][]const u8{},
+    /// Dictionary codes or frame-of-reference offsets
+    codes: BitPacked = .{},
+    /// FrameOfReference: segment minimum subtracted before packing
+    base: i64 = 0,
+    /// Min/max/null summary used to skip the whole segment during scans
+    zone_map: ZoneMap = .{},
+    /// Optional Bloom filter for skipping the segment on equality predicates
+    bloom: ?BlockedBloomFilter = null,
+
+    /// Encode a column, choosing the encoding with the smallest footprint.
+    /// Text is copied; the caller keeps ownership of `values`.
+    pub fn encode(allocator: std.mem.Allocator, values: []const Value, data_type: DataType) !ColumnSegment {
+        var null_count: usize = 0;
+        var runs: usize = 0;
+        var text_bytes: usize = 0;
+        var run_text_bytes: usize = 0;
+        var integral = data_type == .Int or data_type == .Bool;
+        var all_text = data_type == .Text;
+        var min_int: i64 = std.math.maxInt(i64);
+        var max_int: i64 = std.math.minInt(i64);
+
+        for (values, 0..) |v, i| {
+            const starts_run = i == 0 or !identical(values[i - 1], v);
+            if (starts_run) runs += 1;
+            switch (v) {
+                .null => null_count += 1,
+                .integer => |x| {
+                    min_int = @min(min_int, x);
+                    max_int = @max(max_int, x);
+                    if (data_type != .Int) integral = false;
+                },
+                .boolean => |b| {
+                    min_int = @min(min_int, @intFromBool(b));
+                    max_int = @max(max_int, @intFromBool(b));
+                    if (data_type != .Bool) integral = false;
+                },
+                .text => |t| {
+                    text_bytes += t.len;
+                    if (starts_run) run_text_bytes += t.len;
+                    // Frame of reference only holds integers and NULLs
+                    integral = false;
+                },
+                .float => integral = false,
+            }
+            if (v != .text and v != .null) all_text = false;
+        }
+        if (min_int > max_int) {
+            // All nulls
+            min_int = 0;
+            max_int = 0;
+        }
+
+        const null_bitmap_bytes = if (null_count > 0) (values.len + 63) / 64 * 8 else 0;
+        var best = Encoding.Plain;
+        var best_bytes = values.len * @sizeOf(Value) + text_bytes;
+
+        const rle_bytes = runs * (@sizeOf(Value) + @sizeOf(u32)) + run_text_bytes;
+        if (rle_bytes < best_bytes) {
+            best = .RunLength;
+            best_bytes = rle_bytes;
+        }
+
+        var for_width: u7 = 0;
+        if (integral) {
+            for_width = bitsNeeded(@intCast(@as(i128, max_int) - min_int));
+            const for_bytes = (values.len * for_width + 7) / 8 + null_bitmap_bytes;
+            if (for_bytes < best_bytes) {
+                best = .FrameOfReference;
+                best_bytes = for_bytes;
+            }
+        }
+
+        var distinct = std.StringHashMap(u32).init(allocator);
+        defer distinct.deinit();
+        if (all_text) {
+            var distinct_bytes: usize = 0;
+            for (values) |v| {
+                if (v != .text) continue;
+                const entry = try distinct.getOrPut(v.text);
+                if (!entry.found_existing) {
+                    entry.value_ptr.* = 0;
+                    distinct_bytes += v.text.len;
+                }
+            }
+            const code_width = bitsNeeded(@max(distinct.count(), 1) - 1);
+            const dict_bytes = distinct_bytes + distinct.count() * @sizeOf([]const u8) +
+                (values.len * code_width + 7) / 8 + null_bitmap_bytes;
+            if (dict_bytes < best_bytes) {
+                best = .Dictionary;
+                best_bytes = dict_bytes;
+            }
+        }
+
+        var segment = ColumnSegment{
+            .data_type = data_type,
+            .encoding = best,
+            .row_count = values.len,
+            .null_count = null_count,
+        };
+        errdefer segment.deinit(allocator);
+
+        switch (best) {
+            .Plain => segment.values = try dupeValues(allocator, values),
+            .RunLength => try segment.buildRunLength(allocator, values, runs),
+            .FrameOfReference => try segment.buildFrameOfReference(allocator, values, min_int, for_width),
+            .Dictionary => try segment.buildDictionary(allocator, values, &distinct),
+        }
+        // Bounds point into the segment's own storage, not the caller's values
+        segment.zone_map = ZoneMap.fromSegment(&segment);
+
+        return segment;
+    }
+
+    fn buildRunLength(self: *ColumnSegment, allocator: std.mem.Allocator, values: []const Value, runs: usize) !void {
+        const run_values = try allocator.alloc(Value, runs);
+        var filled: usize = 0;
+        errdefer {
+            freeValues(allocator, run_values[0..filled]);
+            allocator.free(run_values);
+        }
+        const run_ends = try allocator.alloc(u32, runs);
+        errdefer allocator.free(run_ends);
+
+        for (values, 0..) |v, i| {
+            if (i > 0 and identical(values[i - 1], v)) {
+                run_ends[filled - 1] = @intCast(i + 1);
+                continue;
+            }
+            run_values[filled] = try dupeValue(allocator, v);
+            run_ends[filled] = @intCast(i + 1);
+            filled += 1;
+        }
+
+        self.values = run_values;
+        self.run_ends = run_ends;
+    }
+
+    fn buildFrameOfReference(self: *ColumnSegment, allocator: std.mem.Allocator, values: []const Value, base: i64, bit_width: u7) !void {
+        const offsets = try allocator.alloc(u64, values.len);
+        defer allocator.free(offsets);
+
+        var nulls: ?[]u64 = null;
+        if (self.null_count > 0) {
+            nulls = try allocator.alloc(u64, (values.len + 63) / 64);
+            @memset(nulls.?, 0);
+        }
+        errdefer if (nulls) |n| allocator.free(n);
+
+        for (values, 0..) |v, i| {
+            const x: i64 = switch (v) {
+                .integer => |x| x,
+                .boolean => |b| @intFromBool(b),
+                else => {
+                    nulls.?[i / 64] |= @as(u64, 1) << @intCast(i % 64);
+                    offsets[i] = 0;
+                    continue;
+                },
+            };
+            offsets[i] = @intCast(@as(i128, x) - base);
+        }
+
+        self.codes = try BitPacked.pack(allocator, offsets, bit_width);
+        self.base = base;
+        self.nulls = nulls;
+    }
+
+    fn buildDictionary(self: *ColumnSegment, allocator: std.mem.Allocator, values: []const Value, distinct: *std.StringHashMap(u32)) !void {
+        // Sort the distinct strings so that code order matches string order
+        const dictionary = try allocator.alloc([]const u8, distinct.count());
+        var owned: usize = 0;
+        errdefer {
+            for (dictionary[0..owned]) |s| allocator.free(s);
+            allocator.free(dictionary);
+        }
+        var key_it = distinct.keyIterator();
+        var filled: usize = 0;
+        while (key_it.next()) |key| {
+            dictionary[filled] = key.*;
+            filled += 1;
+        }
+        std.mem.sort([]const u8, dictionary, {}, lessThanString);
+        for (dictionary, 0..) |s, code| {
+            distinct.getPtr(s).?.* = @intCast(code);
+        }
+
+        const codes = try allocator.alloc(u64, values.len);
+        defer allocator.free(codes);
+
+        var nulls: ?[]u64 = null;
+        if (self.null_count > 0) {
+            nulls = try allocator.alloc(u64, (values.len + 63) / 64);
+            @memset(nulls.?, 0);
+        }
+        errdefer if (nulls) |n| allocator.free(n);
+
+        for (values, 0..) |v, i| {
+            if (v == .text) {
+                codes[i] = distinct.get(v.text).?;
+            } else {
+                nulls.?[i / 64] |= @as(u64, 1) << @intCast(i % 64);
+                codes[i] = 0;
+            }
+        }
+        const code_width = bitsNeeded(@max(dictionary.len, 1) - 1);
+        self.codes = try BitPacked.pack(allocator, codes, code_width);
+
+        // Copy the strings only once the codes are built, since the map keys
+        // still point at the caller's values
+        for (dictionary) |*s| {
+            s.* = try allocator.dupe(u8, s.*);
+            owned += 1;
+        }
+        self.dictionary = dictionary;
+        self.nulls = nulls;
+    }
+
+    pub fn deinit(self: *ColumnSegment, allocator: std.mem.Allocator) void {
+        freeValues(allocator, self.values);
+        allocator.free(self.values);
+        allocator.free(self.run_ends);
+        for (self.dictionary) |s| allocator.free(s);
+        allocator.free(self.dictionary);
+        self.codes.deinit(allocator);
+        if (self.nulls) |n| allocator.free(n);
+        if (self.bloom) |*bloom| bloom.deinit(allocator);
+        self.* = undefined;
+    }
+
+    /// Decode the value of one row. Text is borrowed from the segment.
+    pub fn get(self: *const ColumnSegment, row: usize) Value {
+        switch (self.encoding) {
+            .Plain => return self.values[row],
+            .RunLength => return self.values[self.runIndex(row)],
+            .FrameOfReference => {
+                if (self.isNull(row)) return Value{ .null = {} };
+                const x: i64 = @intCast(@as(i128, self.base) + self.codes.get(row));
+                if (self.data_type == .Bool) return Value{ .boolean = x != 0 };
+                return Value{ .integer = x };
+            },
+            .Dictionary => {
+                if (self.isNull(row)) return Value{ .null = {} };
+                return Value{ .text = self.dictionary[self.codes.get(row)] };
+            },
+        }
+    }
+
+    fn isNull(self: *const ColumnSegment, row: usize) bool {
+        const nulls = self.nulls orelse return false;
+        return nulls[row / 64] & (@as(u64, 1) << @intCast(row % 64)) != 0;
+    }
+
+    /// Index of the run containing `row`
+    fn runIndex(self: *const ColumnSegment, row: usize) usize {
+        var lo: usize = 0;
+        var hi: usize = self.run_ends.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.run_ends[mid] <= row) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /// Clear the bits in `selection` for rows that do not satisfy `value <op> literal`.
+    /// Dictionary and frame-of-reference segments compare packed codes without
+    /// decoding; run-length segments evaluate each run once.
+    pub fn filter(self: *const ColumnSegment, op: CompareOp, literal: Value, selection: []u64) void {
+        if (literal == .null) {
+            // Comparisons with NULL are never true
+            @memset(selection, 0);
+            return;
+        }
+
+        switch (self.encoding) {
+            .FrameOfReference => {
+                const lit: ?i64 = switch (literal) {
+                    .integer => |x| if (self.data_type == .Int) x else null,
+                    .boolean => |b| if (self.data_type == .Bool) @as(i64, @intFromBool(b)) else null,
+                    else => null,
+                };
+                if (lit) |x| {
+                    const offset = @as(i128, x) - self.base;
+                    self.filterCodes(codeRange(op, offset, offset, offset, maxForWidth(self.codes.bit_width)), selection);
+                    return;
+                }
+            },
+            .Dictionary => {
+                if (literal == .text) {
+                    const lb = lowerBound(self.dictionary, literal.text);
+                    const found = lb < self.dictionary.len and std.mem.eql(u8, self.dictionary[lb], literal.text);
+                    const lb_i: i128 = @intCast(lb);
+                    // Codes below `lb` are less than the literal; `lb` itself is equal when found
+                    const eq_lo: i128 = if (found) lb_i else 1;
+                    const eq_hi: i128 = if (found) lb_i else 0;
+                    const le_hi: i128 = if (found) lb_i else lb_i - 1;
+                    self.filterCodes(codeRange(op, eq_lo, eq_hi, le_hi, @as(i128, @intCast(self.dictionary.len)) - 1), selection);
+                    return;
+                }
+            },
+            .RunLength => {
+                var start: usize = 0;
+                for (self.values, self.run_ends) |v, end| {
+                    if (!matches(v, op, literal)) clearRange(selection, start, end);
+                    start = end;
+                }
+                return;
+            },
+            .Plain => {},
+        }
+
+        for (0..self.row_count) |row| {
+            if (!matches(self.get(row), op, literal)) clearBit(selection, row);
+        }
+    }
+
+    fn filterCodes(self: *const ColumnSegment, range: CodeRange, selection: []u64) void {
+        for (0..self.row_count) |row| {
+            if (!range.contains(self.codes.get(row))) clearBit(selection, row);
+        }
+        if (self.nulls) |nulls| {
+            for (selection, nulls) |*word, null_word| word.* &= ~null_word;
+        }
+    }
+
+    /// Bytes used by this segment's encoded data
+    pub fn memoryBytes(self: *const ColumnSegment) usize {
+        var bytes = self.values.len * @sizeOf(Value) +
+            self.run_ends.len * @sizeOf(u32) +
+            self.dictionary.len * @sizeOf([]const u8) +
+            self.codes.words.len * @sizeOf(u64);
+        for (self.values) |v| {
+            if (v == .text) bytes += v.text.len;
+        }
+        for (self.dictionary) |s| bytes += s.len;
+        if (self.nulls) |n| bytes += n.len * @sizeOf(u64);
+        if (self.bloom) |*bloom| bytes += bloom.memoryBytes();
+        return bytes;
+    }
+};
+
+/// Map a comparison against a literal onto a range of order-preserving codes.
+/// [eq_lo, eq_hi] are the codes equal to the literal (empty when lo > hi) and
+/// le_hi is the largest code less than or equal to it.
+fn codeRange(op: CompareOp, eq_lo: i128, eq_hi: i128, le_hi: i128, max_code: i128) CodeRange {
+    const lt_hi = if (eq_lo <= eq_hi) eq_lo - 1 else le_hi;
+    return switch (op) {
+        .Eq => CodeRange.init(eq_lo, eq_hi, max_code, false),
+        .Ne => CodeRange.init(eq_lo, eq_hi, max_code, true),
+        .Lt => CodeRange.init(0, lt_hi, max_code, false),
+        .Le => CodeRange.init(0, le_hi, max_code, false),
+        .Gt => CodeRange.init(le_hi + 1, max_code, max_code, false),
+        .Ge => CodeRange.init(lt_hi + 1, max_code, max_code, false),
+    };
+}
+
+/// A sealed block of rows stored column by column. Its column data never
+/// changes once built, so result sets can read it in place; a heap-allocated
+/// segment is reference counted and freed by its last holder.
+pub const RowSegment = struct {
+    row_count: usize,
+    columns: []ColumnSegment,
+    versions: SegmentVersions, // Begin/end commit timestamps of each row
+    refs: std.atomic.Value(usize) = std.atomic.Value(usize).init(1), // The table's own, plus result views
+
+    /// Encode a block of rows, adding Bloom filters to the columns that ask for them.
+    /// `begin_ts` and `end_ts` hold each row's version timestamps.
+    /// The caller keeps ownership of `rows`.
+    pub fn build(allocator: std.mem.Allocator, rows: []const []Value, schema_columns: []const ColumnSchema, begin_ts: []const u64, end_ts: []const u64) !RowSegment {
+        var versions = try SegmentVersions.init(allocator, begin_ts, end_ts);
+        errdefer versions.deinit(allocator);
+
+        const columns = try allocator.alloc(ColumnSegment, schema_columns.len);
+        var built: usize = 0;
+        errdefer {
+            for (columns[0..built]) |*col| col.deinit(allocator);
+            allocator.free(columns);
+        }
+
+        const column_values = try allocator.alloc(Value, rows.len);
+        defer allocator.free(column_values);
+
+        for (schema_columns, 0..) |schema_column, c| {
+            for (rows, 0..) |row, r| {
+                column_values[r] = row[c];
+            }
+            columns[c] = try ColumnSegment.encode(allocator, column_values, schema_column.data_type);
+            built += 1;
+
+            if (schema_column.bloom_filter) {
+                var bloom = try BlockedBloomFilter.init(allocator, rows.len);
+                for (column_values) |v| bloom.insert(v);
+                columns[c].bloom = bloom;
+            }
+        }
+
+        return RowSegment{ .row_count = rows.len, .columns = columns, .versions = versions };
+    }
+
+    /// Build a segment on the heap holding one reference for the caller
+    pub fn create(allocator: std.mem.Allocator, rows: []const []Value, schema_columns: []const ColumnSchema, begin_ts: []const u64, end_ts: []const u64) !*RowSegment {
+        const segment = try allocator.create(RowSegment);
+        errdefer allocator.destroy(segment);
+        segment.* = try build(allocator, rows, schema_columns, begin_ts, end_ts);
+        return segment;
+    }
+
+    pub fn retain(self: *RowSegment) void {
+        _ = self.refs.fetchAdd(1, .monotonic);
+    }
+
+    /// Drop a reference to a segment from create(), freeing it with the last one
+    pub fn release(self: *RowSegment, allocator: std.mem.Allocator) void {
+        if (self.refs.fetchSub(1, .acq_rel) != 1) return;
+        self.deinit(allocator);
+        allocator.destroy(self);
+    }
+
+    /// False if the zone map, or for equality the Bloom filter, proves that no
+    /// row in the segment satisfies `column <op> literal`
+    pub fn mayMatch(self: *const RowSegment, column: usize, op: CompareOp, literal: Value) bool {
+        const col = &self.columns[column];
+        if (!col.zone_map.mayMatch(op, literal)) return false;
+        if (op == .Eq) {
+            if (col.bloom) |*bloom| return bloom.mayContain(literal);
+        }
+        return true;
+    }
+
+    pub fn deinit(self: *RowSegment, allocator: std.mem.Allocator) void {
+        for (self.columns) |*col| col.deinit(allocator);
+        allocator.free(self.columns);
+        self.versions.deinit(allocator);
+    }
+
+    pub fn memoryBytes(self: *const RowSegment) usize {
+        var bytes: usize = self.versions.memoryBytes();
+        for (self.columns) |*col| bytes += col.memoryBytes();
+        return bytes;
+    }
+};
+
+/// Compare two values; null if either is NULL or the types are not comparable
+pub fn compareValues(a: Value, b: Value) ?std.math.Order {
+    return switch (a) {
+        .null => null,
+        .integer => |x| switch (b) {
+            .integer => |y| std.math.order(x, y),
+            .float => |y| std.math.order(@as(f64, @floatFromInt(x)), y),
+            else => null,
+        },
+        .float => |x| switch (b) {
+            .integer => |y| std.math.order(x, @as(f64, @floatFromInt(y))),
+            .float => |y| std.math.order(x, y),
+            else => null,
+        },
+        .text => |x| switch (b) {
+            .text => |y| std.mem.order(u8, x, y),
+            else => null,
+        },
+        .boolean => |x| switch (b) {
+            .boolean => |y| std.math.order(@intFromBool(x), @intFromBool(y)),
+            else => null,
+        },
+    };
+}
+
+/// Evaluate `value <op> literal` with SQL NULL semantics
+pub fn matches(value: Value, op: CompareOp, literal: Value) bool {
+    const order = compareValues(value, literal) orelse return false;
+    return switch (op) {
+        .Eq => order == .eq,
+        .Ne => order != .eq,
+        .Lt => order == .lt,
+        .Le => order != .gt,
+        .Gt => order == .gt,
+        .Ge => order != .lt,
+    };
+}
+
+/// Allocate a selection bitmap with every row selected
+pub fn initSelection(allocator: std.mem.Allocator, row_count: usize) ![]u64 {
+    const selection = try allocator.alloc(u64, (row_count + 63) / 64);
+    @memset(selection, std.math.maxInt(u64));
+    if (row_count % 64 != 0) {
+        selection[selection.len - 1] = (@as(u64, 1) << @intCast(row_count % 64)) - 1;
+    }
+    return selection;
+}
+
+pub fn isSelected(selection: []const u64, row: usize) bool {
+    return selection[row / 64] & (@as(u64, 1) << @intCast(row % 64)) != 0;
+}
+
+pub fn countSelected(selection: []const u64) usize {
+    var count: usize = 0;
+    for (selection) |word| count += @popCount(word);
+    return count;
+}
+
+pub fn clearBit(selection: []u64, row: usize) void {
+    selection[row / 64] &= ~(@as(u64, 1) << @intCast(row % 64));
+}
+
+fn clearRange(selection: []u64, start: usize, end: usize) void {
+    var row = start;
+    while (row < end and row % 64 != 0) : (row += 1) clearBit(selection, row);
+    while (row + 64 <= end) : (row += 64) selection[row / 64] = 0;
+    while (row < end) : (row += 1) clearBit(selection, row);
+}
+
+/// Values are equal and of the same type (runs never merge 1 and 1.0)
+fn identical(a: Value, b: Value) bool {
+    return switch (a) {
+        .null => b == .null,
+        .integer => |x| b == .integer and b.integer == x,
+        .float => |x| b == .float and b.float == x,
+        .boolean => |x| b == .boolean and b.boolean == x,
+        .text => |x| b == .text and std.mem.eql(u8, x, b.text),
+    };
+}
+
+fn lowerBound(dictionary: []const []const u8, key: []const u8) usize {
+    var lo: usize = 0;
+    var hi: usize = dictionary.len;
+    while (lo < hi) {
+        const mid = lo + (hi - lo) / 2;
+        if (std.mem.order(u8, dictionary[mid], key) == .lt) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+fn lessThanString(_: void, a: []const u8, b: []const u8) bool {
+    return std.mem.order(u8, a, b) == .lt;
+}
+
+fn dupeValue(allocator: std.mem.Allocator, v: Value) !Value {
+    return switch (v) {
+        .text => |t| Value{ .text = try allocator.dupe(u8, t) },
+        else => v,
+    };
+}
+
+fn dupeValues(allocator: std.mem.Allocator, values: []const Value) ![]Value {
+    const copy = try allocator.alloc(Value, values.len);
+    var filled: usize = 0;
+    errdefer {
+        freeValues(allocator, copy[0..filled]);
+        allocator.free(copy);
+    }
+    for (values, 0..) |v, i| {
+        copy[i] = try dupeValue(allocator, v);
+        filled += 1;
+    }
+    return copy;
+}
+
+fn freeValues(allocator: std.mem.Allocator, values: []const Value) void {
+    for (values) |v| {
+        if (v == .text) allocator.free(v.text);
+    }
+}
+
+test "BitPacked round trips across word boundaries" {
+    const allocator = std.testing.allocator;
+    var input: [100]u64 = undefined;
+    for (&input, 0..) |*v, i| v.* = (i * 7919) % 1024;
+
+    var bits = try BitPacked.pack(allocator, &input, 10);
+    defer bits.deinit(allocator);
+
+    try std.testing.expectEqual(@as(usize, 16), bits.words.len);
+    for (input, 0..) |v, i| {
+        try std.testing.expectEqual(v, bits.get(i));
+    }
+}
+
+test "ColumnSegment picks frame-of-reference and filters packed values" {
+    const allocator = std.testing.allocator;
+    var values: [1000]Value = undefined;
+    for (&values, 0..) |*v, i| v.* = Value{ .integer = 1_000_000 + @as(i64, @intCast((i * 37) % 500)) };
+    values[10] = Value{ .null = {} };
+
+    var segment = try ColumnSegment.encode(allocator, &values, .Int);
+    defer segment.deinit(allocator);
+
+    try std.testing.expectEqual(Encoding.FrameOfReference, segment.encoding);
+    try std.testing.expectEqual(@as(u7, 9), segment.codes.bit_width);
+    try std.testing.expect(segment.memoryBytes() * 10 < values.len * @sizeOf(Value));
+    try std.testing.expectEqual(values[3].integer, segment.get(3).integer);
+    try std.testing.expect(segment.get(10) == .null);
+
+    const selection = try initSelection(allocator, values.len);
+    defer allocator.free(selection);
+    segment.filter(.Lt, Value{ .integer = 1_000_100 }, selection);
+
+    var expected: usize = 0;
+    for (values) |v| {
+        if (matches(v, .Lt, Value{ .integer = 1_000_100 })) expected += 1;
+    }
+    try std.testing.expectEqual(expected, countSelected(selection));
+    try std.testing.expect(!isSelected(selection, 10));
+}
+
+test "ColumnSegment dictionary-encodes low-cardinality text" {
+    const allocator = std.testing.allocator;
+    const cities = [_][]const u8{ "Oslo", "Berlin", "Paris", "Madrid" };
+    var values: [400]Value = undefined;
+    for (&values, 0..) |*v, i| v.* = Value{ .text = cities[(i * 3) % cities.len] };
+
+    var segment = try ColumnSegment.encode(allocator, &values, .Text);
+    defer segment.deinit(allocator);
+
+    try std.testing.expectEqual(Encoding.Dictionary, segment.encoding);
+    try std.testing.expectEqual(@as(usize, 4), segment.dictionary.len);
+    try std.testing.expectEqualStrings("Berlin", segment.dictionary[0]);
+    try std.testing.expectEqualStrings(values[7].text, segment.get(7).text);
+
+    const ops = [_]CompareOp{ .Eq, .Ne, .Lt, .Le, .Gt, .Ge };
+    const literals = [_][]const u8{ "Paris", "Lisbon", "Aarhus", "Zurich" };
+    for (ops) |op| {
+        for (literals) |lit| {
+            const selection = try initSelection(allocator, values.len);
+            defer allocator.free(selection);
+            segment.filter(op, Value{ .text = lit }, selection);
+            for (values, 0..) |v, i| {
+                try std.testing.expectEqual(matches(v, op, Value{ .text = lit }), isSelected(selection, i));
+            }
+        }
+    }
+}
+
+test "ColumnSegment run-length encodes sorted columns" {
+    const allocator = std.testing.allocator;
+    var values: [300]Value = undefined;
+    for (&values, 0..) |*v, i| v.* = Value{ .float = @floatFromInt(i / 100) };
+
+    var segment = try ColumnSegment.encode(allocator, &values, .Float);
+    defer segment.deinit(allocator);
+
+    try std.testing.expectEqual(Encoding.RunLength, segment.encoding);
+    try std.testing.expectEqual(@as(usize, 3), segment.run_ends.len);
+    try std.testing.expectEqual(@as(f64, 1.0), segment.get(150).float);
+
+    const selection = try initSelection(allocator, values.len);
+    defer allocator.free(selection);
+    segment.filter(.Ge, Value{ .integer = 1 }, selection);
+    try std.testing.expectEqual(@as(usize, 200), countSelected(selection));
+    try std.testing.expect(!isSelected(selection, 99));
+    try std.testing.expect(isSelected(selection, 100));
+}
+
+test "ColumnSegment keeps a text value in an integer column" {
+    const allocator = std.testing.allocator;
+    var values: [200]Value = undefined;
+    for (&values, 0..) |*v, i| v.* = Value{ .integer = @intCast(i) };
+    values[50] = Value{ .text = "5" };
+
+    // Without NULLs frame of reference has no bitmap to fall back on
+    var segment = try ColumnSegment.encode(allocator, &values, .Int);
+    defer segment.deinit(allocator);
+    try std.testing.expect(segment.encoding != .FrameOfReference);
+    try std.testing.expectEqualStrings("5", segment.get(50).text);
+    try std.testing.expectEqual(@as(i64, 51), segment.get(51).integer);
+
+    // With NULLs the text must not turn into one
+    values[7] = Value{ .null = {} };
+    var with_nulls = try ColumnSegment.encode(allocator, &values, .Int);
+    defer with_nulls.deinit(allocator);
+    try std.testing.expectEqualStrings("5", with_nulls.get(50).text);
+    try std.testing.expect(with_nulls.get(7) == .null);
+}
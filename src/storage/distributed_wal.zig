@@ -5,14 +5,24 @@ const Simulation = @import("../simulation/simulation.zig").Simulation;
 const replica_management = @import("../simulation/scenarios/replica_management.zig");
 const ReplicaRegistry = replica_management.ReplicaRegistry;
 const ReplicaState = replica_management.ReplicaState;
+const wal_message = @import("wal_message.zig");
 
-/// Message types for distributed WAL communication
-pub const DistributedMessageType = enum {
-    PREPARE,
-    PREPARE_OK,
-    COMMIT,
-    FORWARD,
-};
+pub const DistributedMessageType = wal_message.DistributedMessageType;
+pub const DistributedWALMessage = wal_message.DistributedWALMessage;
+pub const Entry = wal_message.Entry;
+
+/// A PREPARE batch is sent once it holds this many payload bytes
+pub const default_max_batch_bytes: usize = 64 * 1024;
+
+/// Simulation ticks an operation may wait for more to join its PREPARE batch
+pub const default_max_batch_delay: u64 = 1;
+
+/// Operations that may be prepared but not yet acknowledged, per backup
+pub const default_max_in_flight: usize = 64;
+
+/// Simulation ticks without an acknowledgment before a backup's unacknowledged
+/// operations are sent again
+pub const default_retransmit_timeout: u64 = 50;
 
 /// PrepareOK acknowledgment message
 pub const PrepareOK = struct {
@@ -20,16 +30,38 @@ pub const PrepareOK = struct {
     sender: []const u8,
 };
 
-/// Message for distributed WAL communication
-pub const DistributedWALMessage = struct {
-    type: DistributedMessageType,
-    op_number: u64,
+/// Replication state the primary keeps for one backup
+pub const BackupProgress = struct {
+    acked_op: u64, // Every operation up to here is prepared on the backup
+    sent_op: u64, // Last operation sent in a PREPARE
+    last_ack_time: u64, // When acked_op last advanced, or sending resumed
+};
+
+/// Freshness a read-only query asks of the node that serves it. Every bound
+/// that is set must hold.
+pub const ReadRequirement = struct {
+    min_commit_point: u64 = 0, // e.g. the commit point of the client's last write
+    max_lag_ops: ?u64 = null, // Behind the primary's latest known commit point by at most this many
+    max_staleness: ?u64 = null, // Was up to date with the primary at most this many ticks ago
+};
+
+/// Called with each committed operation, in order, to apply it to the node's database
+pub const ApplyFn = *const fn (context: ?*anyopaque, op_number: u64, data: []const u8) anyerror!void;
+
+/// A PREPARE that arrived before the one it follows. Its entries are owned.
+const HeldBatch = struct {
     commit_point: u64,
-    data: ?[]const u8,
-    sender: []const u8,
+    entries: []Entry,
 };
 
 /// Distributed Write-Ahead Log for replicated operations
+///
+/// Replication is pipelined: the primary keeps up to max_in_flight operations
+/// outstanding per backup without waiting for their acknowledgments. Each
+/// PREPARE names the operation it follows, so a backup applies PREPAREs in log
+/// order however the network reorders them, and its PREPARE_OK acknowledges
+/// every operation up to the one it names. The primary commits everything up
+/// to the highest operation a quorum of backups has acknowledged in one step.
 pub const DistributedWAL = struct {
     allocator: std.mem.Allocator,
     simulation: *Simulation,
@@ -39,10 +71,45 @@ pub const DistributedWAL = struct {
     last_prepared_op: u64 = 0,
     commit_point: u64 = 0,
 
-    // Track responses for replication
-    prepare_responses: std.AutoHashMap(u64, std.StringHashMap(void)),
     received_operations: std.AutoHashMap(u64, []const u8),
 
+    // Primary: operations not yet acknowledged by every backup, in order.
+    // Payloads are owned by received_operations.
+    log: std.ArrayListUnmanaged(Entry) = .{},
+    log_base_op: u64 = 0, // The operation just before log[0]
+    backup_progress: std.StringHashMapUnmanaged(BackupProgress) = .{},
+    max_in_flight: usize = default_max_in_flight,
+    retransmit_timeout: u64 = default_retransmit_timeout,
+    retransmit_task: ?u64 = null,
+
+    // Operations after released_op wait to be sent together, until they hold
+    // max_batch_bytes or max_batch_delay ticks have passed
+    max_batch_bytes: usize = default_max_batch_bytes,
+    max_batch_delay: u64 = default_max_batch_delay, // 0 sends every operation at once
+    released_op: u64 = 0,
+    pending_batch_bytes: usize = 0,
+    flush_task: ?u64 = null,
+
+    // Backup: PREPAREs received ahead of a gap, keyed by the operation they follow
+    held_batches: std.AutoHashMapUnmanaged(u64, HeldBatch) = .{},
+
+    // Follower reads: committed operations are applied in order, and a backup
+    // tracks how far behind the primary its applied state is
+    apply_fn: ?ApplyFn = null,
+    apply_context: ?*anyopaque = null,
+    applied_op: u64 = 0, // Last operation applied
+    apply_queue: std.ArrayListUnmanaged(u64) = .{}, // Prepared operations not yet applied
+    apply_queue_head: usize = 0,
+    primary_commit_point: u64 = 0, // Highest commit point the primary has announced
+    caught_up_time: u64 = 0, // When applied_op last reached primary_commit_point
+    heartbeat_interval: u64 = 0, // Ticks between idle COMMITs from the primary; 0 disables
+    heartbeat_task: ?u64 = null,
+
+    // Scratch space reused by every message sent or received
+    encode_buffer: std.ArrayListUnmanaged(u8) = .{},
+    decode_entries: std.ArrayListUnmanaged(Entry) = .{},
+    messages_sent: u64 = 0,
+
     /// Initialize a distributed WAL
     pub fn init(allocator: std.mem.Allocator, simulation: *Simulation, node_id: []const u8, registry: *ReplicaRegistry, data_dir: []const u8) !*DistributedWAL {
         const dwal = try allocator.create(DistributedWAL);
@@ -56,7 +123,6 @@ pub const DistributedWAL = struct {
             .node_id = try allocator.dupe(u8, node_id),
             .registry = registry,
             .wal = wal,
-            .prepare_responses = std.AutoHashMap(u64, std.StringHashMap(void)).init(allocator),
             .received_operations = std.AutoHashMap(u64, []const u8).init(allocator),
         };
 
@@ -65,12 +131,17 @@ pub const DistributedWAL = struct {
 
     /// Clean up resources
     pub fn deinit(self: *DistributedWAL) void {
-        // Free prepare responses
-        var it = self.prepare_responses.iterator();
-        while (it.next()) |entry| {
-            entry.value_ptr.deinit();
-        }
-        self.prepare_responses.deinit();
+        if (self.flush_task) |task| _ = self.simulation.scheduler.cancel(task);
+        if (self.retransmit_task) |task| _ = self.simulation.scheduler.cancel(task);
+        if (self.heartbeat_task) |task| _ = self.simulation.scheduler.cancel(task);
+        self.apply_queue.deinit(self.allocator);
+        self.log.deinit(self.allocator);
+        self.clearBackupProgress();
+        self.backup_progress.deinit(self.allocator);
+        self.clearHeldBatches();
+        self.held_batches.deinit(self.allocator);
+        self.encode_buffer.deinit(self.allocator);
+        self.decode_entries.deinit(self.allocator);
 
         // Free received operations
         var op_it = self.received_operations.iterator();
@@ -89,7 +160,7 @@ pub const DistributedWAL = struct {
         self.allocator.destroy(self);
     }
 
-    /// Log a transaction to the distributed WAL
+    /// Log a transaction to the distributed WAL. Operation numbers must increase.
     pub fn logTransaction(self: *DistributedWAL, txn_id: u64, data: []const u8) !void {
         // Check if this node is the primary
         const node_state = self.registry.getReplicaState(self.node_id) catch .BACKUP;
@@ -98,10 +169,13 @@ pub const DistributedWAL = struct {
             try self.forwardOperation(txn_id, data);
             return error.NotPrimary;
         }
+        if (txn_id <= self.last_prepared_op) return error.StaleOpNumber;
 
         // Clone the data before using it
         const data_copy = try self.allocator.dupe(u8, data);
         errdefer self.allocator.free(data_copy);
+        try self.log.ensureUnusedCapacity(self.allocator, 1);
+        try self.apply_queue.ensureUnusedCapacity(self.allocator, 1);
 
         // Store in local WAL
         try self.wal.logTransaction(txn_id, data_copy);
@@ -111,11 +185,76 @@ pub const DistributedWAL = struct {
 
         // Update last prepared op
         self.last_prepared_op = txn_id;
+        self.log.appendAssumeCapacity(Entry{ .op_number = txn_id, .data = data_copy });
+        self.apply_queue.appendAssumeCapacity(txn_id);
 
         // Prepare for replication
-        try self.prepareOperation(txn_id, data_copy);
+        try self.enqueuePrepare(data_copy.len);
+    }
+
+    /// Account for an operation just added to the log. It is sent when the
+    /// unsent operations reach max_batch_bytes or max_batch_delay ticks after
+    /// the first of them was logged, whichever comes first.
+    fn enqueuePrepare(self: *DistributedWAL, data_len: usize) !void {
+        self.pending_batch_bytes += data_len;
 
-        return;
+        if (self.max_batch_delay == 0 or self.pending_batch_bytes >= self.max_batch_bytes) {
+            try self.flushBatch();
+        } else if (self.flush_task == null) {
+            self.flush_task = try self.simulation.scheduler.scheduleAfter(self.max_batch_delay, 0, flushCallback, self);
+        }
+    }
+
+    fn flushCallback(context: ?*anyopaque) void {
+        const self: *DistributedWAL = @ptrCast(@alignCast(context.?));
+        self.flush_task = null;
+        self.flushBatch() catch |err| {
+            std.debug.print("[DWAL] {s}: sending PREPARE batch failed: {s}\n", .{ self.node_id, @errorName(err) });
+        };
+    }
+
+    /// Release the pending operations and send them to every backup whose
+    /// window has room
+    pub fn flushBatch(self: *DistributedWAL) !void {
+        if (self.flush_task) |task| {
+            _ = self.simulation.scheduler.cancel(task);
+            self.flush_task = null;
+        }
+        if (self.released_op == self.last_prepared_op) return;
+        self.released_op = self.last_prepared_op;
+        self.pending_batch_bytes = 0;
+        try self.replicate();
+    }
+
+    /// Send released operations to all backups
+    fn replicate(self: *DistributedWAL) !void {
+        const backups = self.registry.getReplicasByState(.BACKUP);
+        defer self.allocator.free(backups);
+
+        if (backups.len == 0) {
+            // No backups, we can commit immediately
+            try self.commitOperation(self.released_op);
+            self.trimLog(self.released_op);
+            return;
+        }
+        for (backups) |backup| try self.sendPrepares(backup);
+    }
+
+    /// Encode `msg` once and send it to each recipient
+    fn broadcast(self: *DistributedWAL, recipients: []const []const u8, msg: DistributedWALMessage) !void {
+        self.encode_buffer.clearRetainingCapacity();
+        try wal_message.encode(self.allocator, &self.encode_buffer, msg);
+        for (recipients) |recipient| {
+            self.simulation.sendMessage(self.node_id, recipient, self.encode_buffer.items) catch continue;
+            self.messages_sent += 1;
+        }
+    }
+
+    fn send(self: *DistributedWAL, recipient: []const u8, msg: DistributedWALMessage) !void {
+        self.encode_buffer.clearRetainingCapacity();
+        try wal_message.encode(self.allocator, &self.encode_buffer, msg);
+        try self.simulation.sendMessage(self.node_id, recipient, self.encode_buffer.items);
+        self.messages_sent += 1;
     }
 
     /// Forward an operation to the primary
@@ -132,49 +271,107 @@ pub const DistributedWAL = struct {
             .sender = self.node_id,
         };
 
-        // Serialize and send to primary
-        var buf: [4096]u8 = undefined;
-        var fbs = std.io.fixedBufferStream(&buf);
-        try std.json.stringify(forward_msg, .{}, fbs.writer());
-        const msg_slice = fbs.getWritten();
+        try self.send(primary_node, forward_msg);
+    }
 
-        _ = try self.simulation.sendMessage(self.node_id, primary_node, msg_slice);
+    /// Send `backup` the released operations after the last one it was sent,
+    /// as PREPAREs of up to max_batch_bytes, while its window has room
+    fn sendPrepares(self: *DistributedWAL, backup: []const u8) !void {
+        const progress = try self.progressFor(backup);
+        const now = self.simulation.getCurrentTime();
+        if (progress.sent_op == progress.acked_op) progress.last_ack_time = now;
+
+        var start = self.logIndexAfter(progress.sent_op);
+        const limit = @min(self.logIndexAfter(self.released_op), self.logIndexAfter(progress.acked_op) + self.max_in_flight);
+        while (start < limit) {
+            var end = start + 1;
+            var bytes = self.log.items[start].data.len;
+            while (end < limit and bytes + self.log.items[end].data.len <= self.max_batch_bytes) : (end += 1) {
+                bytes += self.log.items[end].data.len;
+            }
+
+            const entries = self.log.items[start..end];
+            const prepare_msg = DistributedWALMessage{
+                .type = .PREPARE,
+                .op_number = entries[entries.len - 1].op_number,
+                .commit_point = self.commit_point,
+                .prev_op_number = progress.sent_op,
+                .data = null,
+                .sender = self.node_id,
+                .entries = entries,
+            };
+            // An unreachable backup is tried again with the next batch
+            self.send(backup, prepare_msg) catch break;
+            progress.sent_op = prepare_msg.op_number;
+            start = end;
+        }
+
+        if (progress.sent_op > progress.acked_op and self.retransmit_task == null) {
+            self.retransmit_task = try self.simulation.scheduler.scheduleAfter(self.retransmit_timeout, 0, retransmitCallback, self);
+        }
     }
 
-    /// Prepare an operation for replication to backups
-    fn prepareOperation(self: *DistributedWAL, op_number: u64, data: []const u8) !void {
-        // Get all backup nodes
-        const backups = self.registry.getReplicasByState(.BACKUP);
-        defer self.allocator.free(backups);
+    fn progressFor(self: *DistributedWAL, backup: []const u8) !*BackupProgress {
+        const entry = try self.backup_progress.getOrPut(self.allocator, backup);
+        if (!entry.found_existing) {
+            entry.key_ptr.* = self.allocator.dupe(u8, backup) catch |err| {
+                self.backup_progress.removeByPtr(entry.key_ptr);
+                return err;
+            };
+            entry.value_ptr.* = BackupProgress{
+                .acked_op = self.log_base_op,
+                .sent_op = self.log_base_op,
+                .last_ack_time = self.simulation.getCurrentTime(),
+            };
+        }
+        return entry.value_ptr;
+    }
 
-        if (backups.len == 0) {
-            // No backups, we can commit immediately
-            try self.commitOperation(op_number);
-            return;
+    /// Index of the first log entry after `op_number`
+    fn logIndexAfter(self: *const DistributedWAL, op_number: u64) usize {
+        var low: usize = 0;
+        var high: usize = self.log.items.len;
+        while (low < high) {
+            const mid = low + (high - low) / 2;
+            if (self.log.items[mid].op_number <= op_number) low = mid + 1 else high = mid;
         }
+        return low;
+    }
 
-        // Initialize responses tracking
-        var responses = std.StringHashMap(void).init(self.allocator);
-        responses = responses; // Suppress unused variable warning
-        try self.prepare_responses.put(op_number, responses);
+    /// Drop log entries up to `op_number`; no backup needs them again
+    fn trimLog(self: *DistributedWAL, op_number: u64) void {
+        const count = self.logIndexAfter(op_number);
+        if (count == 0) return;
+        self.log_base_op = self.log.items[count - 1].op_number;
+        std.mem.copyForwards(Entry, self.log.items, self.log.items[count..]);
+        self.log.shrinkRetainingCapacity(self.log.items.len - count);
+    }
 
-        // Create a prepare message
-        const prepare_msg = DistributedWALMessage{
-            .type = .PREPARE,
-            .op_number = op_number,
-            .commit_point = self.commit_point,
-            .data = data,
-            .sender = self.node_id,
+    fn retransmitCallback(context: ?*anyopaque) void {
+        const self: *DistributedWAL = @ptrCast(@alignCast(context.?));
+        self.retransmit_task = null;
+        self.retransmit() catch |err| {
+            std.debug.print("[DWAL] {s}: retransmitting PREPAREs failed: {s}\n", .{ self.node_id, @errorName(err) });
         };
+    }
 
-        // Serialize and send to backups
-        var buf: [4096]u8 = undefined;
-        var fbs = std.io.fixedBufferStream(&buf);
-        try std.json.stringify(prepare_msg, .{}, fbs.writer());
-        const msg_slice = fbs.getWritten();
+    /// Resend the unacknowledged operations of every backup that has not
+    /// acknowledged anything for retransmit_timeout ticks. A PREPARE or its
+    /// PREPARE_OK may have been lost; duplicates are acknowledged again.
+    fn retransmit(self: *DistributedWAL) !void {
+        const node_state = self.registry.getReplicaState(self.node_id) catch .BACKUP;
+        if (node_state != .PRIMARY) return;
 
+        const now = self.simulation.getCurrentTime();
+        const backups = self.registry.getReplicasByState(.BACKUP);
+        defer self.allocator.free(backups);
         for (backups) |backup| {
-            _ = self.simulation.sendMessage(self.node_id, backup, msg_slice) catch continue;
+            const progress = self.backup_progress.getPtr(backup) orelse continue;
+            if (progress.sent_op == progress.acked_op) continue;
+            if (now - progress.last_ack_time >= self.retransmit_timeout) {
+                progress.sent_op = progress.acked_op;
+            }
+            try self.sendPrepares(backup);
         }
     }
 
@@ -185,31 +382,86 @@ pub const DistributedWAL = struct {
         if (!std.mem.eql(u8, primary_node, msg.sender)) {
             return error.SenderNotPrimary;
         }
+        if (msg.entries.len == 0) return;
 
-        // Apply the operation locally
-        if (msg.data) |data| {
-            const data_copy = try self.allocator.dupe(u8, data);
+        if (msg.prev_op_number > self.last_prepared_op) {
+            // An earlier PREPARE is still on its way, or was lost and will be resent
+            try self.holdBatch(msg);
+            return;
+        }
+        try self.applyEntries(msg.entries, msg.commit_point);
+
+        // Batches that were waiting for this one can go in now
+        while (self.held_batches.fetchRemove(self.last_prepared_op)) |held| {
+            defer self.freeHeldBatch(held.value);
+            try self.applyEntries(held.value.entries, held.value.commit_point);
+        }
+
+        // One PREPARE_OK acknowledges every operation up to last_prepared_op
+        try self.sendPrepareOK(self.last_prepared_op, primary_node);
+    }
+
+    /// Log the entries after last_prepared_op, in order
+    fn applyEntries(self: *DistributedWAL, entries: []const Entry, commit_point: u64) !void {
+        for (entries) |entry| {
+            // Already prepared; PREPAREs are resent after a timeout
+            if (entry.op_number <= self.last_prepared_op) continue;
+
+            const data_copy = try self.allocator.dupe(u8, entry.data);
             errdefer self.allocator.free(data_copy);
+            try self.apply_queue.ensureUnusedCapacity(self.allocator, 1);
 
             // Log to local WAL
-            try self.wal.logTransaction(msg.op_number, data_copy);
+            try self.wal.logTransaction(entry.op_number, data_copy);
 
             // Record in received operations
-            try self.received_operations.put(msg.op_number, data_copy);
+            try self.received_operations.put(entry.op_number, data_copy);
 
             // Update last prepared op
-            if (msg.op_number > self.last_prepared_op) {
-                self.last_prepared_op = msg.op_number;
-            }
+            self.last_prepared_op = entry.op_number;
+            self.apply_queue.appendAssumeCapacity(entry.op_number);
+        }
 
-            // Update commit point if primary is ahead
-            if (msg.commit_point > self.commit_point) {
-                self.commit_point = msg.commit_point;
-            }
+        try self.learnCommitPoint(commit_point);
+    }
 
-            // Send PREPARE_OK
-            try self.sendPrepareOK(msg.op_number, primary_node);
+    /// Keep a copy of a PREPARE that arrived ahead of a gap. At most
+    /// max_in_flight are kept; the primary resends anything dropped.
+    fn holdBatch(self: *DistributedWAL, msg: *const DistributedWALMessage) !void {
+        if (self.held_batches.contains(msg.prev_op_number)) return;
+        if (self.held_batches.count() >= self.max_in_flight) self.clearHeldBatches();
+
+        const entries = try self.allocator.alloc(Entry, msg.entries.len);
+        var copied: usize = 0;
+        errdefer {
+            for (entries[0..copied]) |entry| self.allocator.free(entry.data);
+            self.allocator.free(entries);
+        }
+        for (msg.entries, 0..) |entry, i| {
+            entries[i] = Entry{ .op_number = entry.op_number, .data = try self.allocator.dupe(u8, entry.data) };
+            copied += 1;
         }
+        try self.held_batches.put(self.allocator, msg.prev_op_number, HeldBatch{
+            .commit_point = msg.commit_point,
+            .entries = entries,
+        });
+    }
+
+    fn freeHeldBatch(self: *DistributedWAL, held: HeldBatch) void {
+        for (held.entries) |entry| self.allocator.free(entry.data);
+        self.allocator.free(held.entries);
+    }
+
+    fn clearHeldBatches(self: *DistributedWAL) void {
+        var it = self.held_batches.valueIterator();
+        while (it.next()) |held| self.freeHeldBatch(held.*);
+        self.held_batches.clearRetainingCapacity();
+    }
+
+    fn clearBackupProgress(self: *DistributedWAL) void {
+        var it = self.backup_progress.keyIterator();
+        while (it.next()) |key| self.allocator.free(key.*);
+        self.backup_progress.clearRetainingCapacity();
     }
 
     /// Send a PREPARE_OK acknowledgment
@@ -222,12 +474,7 @@ pub const DistributedWAL = struct {
             .sender = self.node_id,
         };
 
-        var buf: [1024]u8 = undefined;
-        var fbs = std.io.fixedBufferStream(&buf);
-        try std.json.stringify(prepare_ok_msg, .{}, fbs.writer());
-        const msg_slice = fbs.getWritten();
-
-        _ = try self.simulation.sendMessage(self.node_id, to, msg_slice);
+        try self.send(to, prepare_ok_msg);
     }
 
     /// Handle a PREPARE_OK message
@@ -238,28 +485,40 @@ pub const DistributedWAL = struct {
             return error.NotPrimary;
         }
 
-        // Record the response
-        if (self.prepare_responses.getPtr(msg.op_number)) |responses| {
-            const sender_copy = try self.allocator.dupe(u8, msg.sender);
-            try responses.put(sender_copy, {});
+        const progress = self.backup_progress.getPtr(msg.sender) orelse return;
+        if (msg.op_number <= progress.acked_op) return;
+        progress.acked_op = @min(msg.op_number, self.last_prepared_op);
+        progress.sent_op = @max(progress.sent_op, progress.acked_op);
+        progress.last_ack_time = self.simulation.getCurrentTime();
 
-            // Check if we have enough responses to commit
-            const backups = self.registry.getReplicasByState(.BACKUP);
-            defer self.allocator.free(backups);
+        const backups = self.registry.getReplicasByState(.BACKUP);
+        defer self.allocator.free(backups);
 
-            const quorum_size = (backups.len / 2) + 1;
-            if (responses.count() >= quorum_size) {
-                try self.commitOperation(msg.op_number);
-            }
+        // The quorum_size-th highest acknowledgment is prepared on a quorum
+        const acked = try self.allocator.alloc(u64, backups.len);
+        defer self.allocator.free(acked);
+        for (backups, acked) |backup, *op| {
+            op.* = if (self.backup_progress.get(backup)) |p| p.acked_op else self.log_base_op;
+        }
+        std.mem.sort(u64, acked, {}, std.sort.desc(u64));
+
+        const quorum_size = (backups.len / 2) + 1;
+        if (acked.len >= quorum_size and acked[quorum_size - 1] > self.commit_point) {
+            try self.commitOperation(acked[quorum_size - 1]);
         }
+        if (acked.len > 0) self.trimLog(acked[acked.len - 1]);
+
+        // The acknowledgment opened the sender's window
+        try self.sendPrepares(msg.sender);
     }
 
-    /// Commit an operation after receiving enough acknowledgments
+    /// Commit every operation up to `op_number` after a quorum prepared it
     fn commitOperation(self: *DistributedWAL, op_number: u64) !void {
         // Update commit point
         if (op_number > self.commit_point) {
             self.commit_point = op_number;
         }
+        try self.applyCommitted();
 
         // Send commit message to backups
         const backups = self.registry.getReplicasByState(.BACKUP);
@@ -273,33 +532,93 @@ pub const DistributedWAL = struct {
             .sender = self.node_id,
         };
 
-        var buf: [1024]u8 = undefined;
-        var fbs = std.io.fixedBufferStream(&buf);
-        try std.json.stringify(commit_msg, .{}, fbs.writer());
-        const msg_slice = fbs.getWritten();
+        try self.broadcast(backups, commit_msg);
+    }
 
-        for (backups) |backup| {
-            _ = self.simulation.sendMessage(self.node_id, backup, msg_slice) catch continue;
+    /// Handle a COMMIT message
+    fn handleCommitMessage(self: *DistributedWAL, msg: *const DistributedWALMessage) !void {
+        if (!std.mem.eql(u8, self.registry.getPrimaryNode(), msg.sender)) {
+            return error.SenderNotPrimary;
+        }
+        try self.learnCommitPoint(msg.commit_point);
+    }
+
+    /// Take a commit point announced by the primary and apply what it commits
+    fn learnCommitPoint(self: *DistributedWAL, commit_point: u64) !void {
+        // Update commit point if primary is ahead
+        if (commit_point > self.commit_point) {
+            self.commit_point = commit_point;
         }
+        self.primary_commit_point = @max(self.primary_commit_point, commit_point);
+        try self.applyCommitted();
+        if (self.applied_op >= self.primary_commit_point) {
+            self.caught_up_time = self.simulation.getCurrentTime();
+        }
+    }
 
-        // Clean up responses for this operation
-        if (self.prepare_responses.fetchRemove(op_number)) |entry| {
-            var it = entry.value.keyIterator();
-            while (it.next()) |key| {
-                self.allocator.free(key.*);
+    /// Apply prepared operations up to the commit point, in order
+    fn applyCommitted(self: *DistributedWAL) !void {
+        while (self.apply_queue_head < self.apply_queue.items.len) {
+            const op_number = self.apply_queue.items[self.apply_queue_head];
+            if (op_number > self.commit_point) break;
+            if (self.apply_fn) |apply| {
+                try apply(self.apply_context, op_number, self.received_operations.get(op_number).?);
             }
-            // Make a mutable copy to be able to call deinit
-            var value_copy = entry.value;
-            value_copy.deinit();
+            self.applied_op = op_number;
+            self.apply_queue_head += 1;
+        }
+
+        // Drop the applied prefix once it is most of the queue
+        if (self.apply_queue_head > 0 and self.apply_queue_head * 2 >= self.apply_queue.items.len) {
+            const remaining = self.apply_queue.items.len - self.apply_queue_head;
+            std.mem.copyForwards(u64, self.apply_queue.items, self.apply_queue.items[self.apply_queue_head..]);
+            self.apply_queue.shrinkRetainingCapacity(remaining);
+            self.apply_queue_head = 0;
         }
     }
 
-    /// Handle a COMMIT message
-    fn handleCommitMessage(self: *DistributedWAL, msg: *const DistributedWALMessage) !void {
-        // Update commit point
-        if (msg.commit_point > self.commit_point) {
-            self.commit_point = msg.commit_point;
+    /// Whether this node's applied state satisfies `requirement`. The primary
+    /// is never stale; a backup measures its lag against the latest commit
+    /// point it has heard from the primary, and how long ago it caught up to
+    /// one. Without heartbeats an idle primary makes backups look stale.
+    pub fn canServeRead(self: *const DistributedWAL, requirement: ReadRequirement) bool {
+        if (self.applied_op < requirement.min_commit_point) return false;
+        if (self.isPrimary()) return true;
+
+        if (requirement.max_lag_ops) |max_lag_ops| {
+            if (self.primary_commit_point -| self.applied_op > max_lag_ops) return false;
+        }
+        if (requirement.max_staleness) |max_staleness| {
+            if (self.simulation.getCurrentTime() - self.caught_up_time > max_staleness) return false;
         }
+        return true;
+    }
+
+    pub fn isPrimary(self: *const DistributedWAL) bool {
+        const node_state = self.registry.getReplicaState(self.node_id) catch .BACKUP;
+        return node_state == .PRIMARY;
+    }
+
+    /// Have the primary announce its commit point every `interval` ticks, so
+    /// that backups of an idle primary still know they are current
+    pub fn setHeartbeatInterval(self: *DistributedWAL, interval: u64) !void {
+        if (self.heartbeat_task) |task| _ = self.simulation.scheduler.cancel(task);
+        self.heartbeat_task = null;
+        self.heartbeat_interval = interval;
+        if (interval > 0) {
+            self.heartbeat_task = try self.simulation.scheduler.scheduleAfter(interval, 0, heartbeatCallback, self);
+        }
+    }
+
+    fn heartbeatCallback(context: ?*anyopaque) void {
+        const self: *DistributedWAL = @ptrCast(@alignCast(context.?));
+        self.heartbeat_task = null;
+        if (self.isPrimary()) {
+            self.commitOperation(self.commit_point) catch |err| {
+                std.debug.print("[DWAL] {s}: sending heartbeat failed: {s}\n", .{ self.node_id, @errorName(err) });
+            };
+        }
+        self.heartbeat_task = self.simulation.scheduler.scheduleAfter(self.heartbeat_interval, 0, heartbeatCallback, self) catch null;
     }
 
     /// Handle a FORWARD message
@@ -316,12 +635,9 @@ pub const DistributedWAL = struct {
         }
     }
 
-    /// Handle an incoming message
+    /// Handle an incoming message. Payloads are read in place from `message`.
     pub fn handleMessage(self: *DistributedWAL, from: []const u8, message: []const u8) !void {
-        var parsed = try std.json.parseFromSlice(DistributedWALMessage, self.allocator, message, .{});
-        defer parsed.deinit();
-
-        const msg = parsed.value;
+        const msg = try wal_message.decode(self.allocator, message, &self.decode_entries);
 
         switch (msg.type) {
             .PREPARE => try self.handlePrepareMessage(&msg),
@@ -342,16 +658,19 @@ pub const DistributedWAL = struct {
 
     /// Called when this node becomes the primary after a view change
     pub fn becomePrimary(self: *DistributedWAL) !void {
-        // Clear prepare responses from previous view
-        var it = self.prepare_responses.iterator();
-        while (it.next()) |entry| {
-            var response_it = entry.value_ptr.keyIterator();
-            while (response_it.next()) |key| {
-                self.allocator.free(key.*);
-            }
-            entry.value_ptr.clearAndFree();
-        }
-        self.prepare_responses.clearRetainingCapacity();
+        // Operations batched in an earlier view were never prepared
+        if (self.flush_task) |task| _ = self.simulation.scheduler.cancel(task);
+        self.flush_task = null;
+        if (self.retransmit_task) |task| _ = self.simulation.scheduler.cancel(task);
+        self.retransmit_task = null;
+        self.pending_batch_bytes = 0;
+
+        // Replication restarts after this node's last prepared operation
+        self.log.clearRetainingCapacity();
+        self.log_base_op = self.last_prepared_op;
+        self.released_op = self.last_prepared_op;
+        self.clearBackupProgress();
+        self.clearHeldBatches();
     }
 
     /// Update view after a view change
@@ -373,24 +692,9 @@ pub const DistributedWAL = struct {
             .sender = self.node_id,
         };
 
-        // Serialize and send to primary
-        var buf: [4096]u8 = undefined;
-        var fbs = std.io.fixedBufferStream(&buf);
-        try std.json.stringify(sync_msg, .{}, fbs.writer());
-        const msg_slice = fbs.getWritten();
-
-        _ = try self.simulation.sendMessage(self.node_id, primary_node, msg_slice);
-
-        // Reset any pending state that might be inconsistent after view change
-        var it = self.prepare_responses.iterator();
-        while (it.next()) |entry| {
-            if (entry.key_ptr.* > self.commit_point) {
-                var response_it = entry.value_ptr.keyIterator();
-                while (response_it.next()) |key| {
-                    self.allocator.free(key.*);
-                }
-                entry.value_ptr.clearAndFree();
-            }
-        }
+        try self.send(primary_node, sync_msg);
+
+        // PREPAREs held from the old primary may not follow the new one's log
+        self.clearHeldBatches();
     }
 };
@@ -0,0 +1,51 @@
+const std = @import("std");
+const distributed_wal = @import("distributed_wal.zig");
+const DistributedWAL = distributed_wal.DistributedWAL;
+const ReadRequirement = distributed_wal.ReadRequirement;
+
+/// Routes read-only queries across a replica set. Backups whose applied
+/// state meets the query's ReadRequirement take turns, so analytical reads
+/// spread over the backups; the primary serves a read only when no backup
+/// is fresh enough.
+pub const ReadRouter = struct {
+    allocator: std.mem.Allocator,
+    replicas: std.ArrayListUnmanaged(*DistributedWAL) = .{},
+    next_replica: usize = 0,
+    primary_reads: u64 = 0, // Reads no backup could serve
+
+    pub fn init(allocator: std.mem.Allocator) ReadRouter {
+        return ReadRouter{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *ReadRouter) void {
+        self.replicas.deinit(self.allocator);
+    }
+
+    pub fn addReplica(self: *ReadRouter, replica: *DistributedWAL) !void {
+        try self.replicas.append(self.allocator, replica);
+    }
+
+    /// Choose the node to run a read-only query on
+    pub fn route(self: *ReadRouter, requirement: ReadRequirement) !*DistributedWAL {
+        var primary: ?*DistributedWAL = null;
+        const count = self.replicas.items.len;
+        for (0..count) |i| {
+            const index = (self.next_replica + i) % count;
+            const replica = self.replicas.items[index];
+            if (replica.isPrimary()) {
+                primary = replica;
+            } else if (replica.canServeRead(requirement)) {
+                self.next_replica = index + 1;
+                return replica;
+            }
+        }
+
+        if (primary) |replica| {
+            if (replica.canServeRead(requirement)) {
+                self.primary_reads += 1;
+                return replica;
+            }
+        }
+        return error.NoReplicaAvailable;
+    }
+};
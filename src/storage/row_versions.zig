@@ -0,0 +1,127 @@
+const std = @import("std");
+const column_segment = @import("column_segment.zig");
+const BitPacked = column_segment.BitPacked;
+const transaction_manager = @import("../transaction/manager.zig");
+const Snapshot = transaction_manager.Snapshot;
+const live_ts = transaction_manager.live_ts;
+
+/// Begin/end commit timestamps of the rows in a sealed segment.
+/// Begin timestamps are bit-packed as offsets from the oldest one; end
+/// timestamps are only materialized once a row of the segment is deleted.
+pub const SegmentVersions = struct {
+    row_count: usize,
+    min_begin_ts: u64,
+    max_begin_ts: u64,
+    begin_offsets: BitPacked,
+    end_ts: ?[]u64 = null, // null while every row is live
+    deleted_count: usize = 0,
+    oldest_end_ts: u64 = live_ts, // Earliest delete in the segment, for garbage collection
+
+    pub fn init(allocator: std.mem.Allocator, begin_ts: []const u64, end_ts: []const u64) !SegmentVersions {
+        std.debug.assert(begin_ts.len == end_ts.len);
+
+        var min_begin: u64 = live_ts;
+        var max_begin: u64 = 0;
+        for (begin_ts) |ts| {
+            min_begin = @min(min_begin, ts);
+            max_begin = @max(max_begin, ts);
+        }
+        if (begin_ts.len == 0) min_begin = 0;
+
+        const offsets = try allocator.alloc(u64, begin_ts.len);
+        defer allocator.free(offsets);
+        for (begin_ts, offsets) |ts, *offset| offset.* = ts - min_begin;
+
+        var versions = SegmentVersions{
+            .row_count = begin_ts.len,
+            .min_begin_ts = min_begin,
+            .max_begin_ts = max_begin,
+            .begin_offsets = try BitPacked.pack(allocator, offsets, 64 - @clz(max_begin - min_begin)),
+        };
+        errdefer versions.deinit(allocator);
+
+        for (end_ts, 0..) |ts, row| {
+            if (ts != live_ts) try versions.markDeleted(allocator, row, ts);
+        }
+        return versions;
+    }
+
+    pub fn deinit(self: *SegmentVersions, allocator: std.mem.Allocator) void {
+        self.begin_offsets.deinit(allocator);
+        if (self.end_ts) |end_ts| allocator.free(end_ts);
+        self.end_ts = null;
+    }
+
+    pub fn beginTs(self: *const SegmentVersions, row: usize) u64 {
+        return self.min_begin_ts + self.begin_offsets.get(row);
+    }
+
+    pub fn endTs(self: *const SegmentVersions, row: usize) u64 {
+        const end_ts = self.end_ts orelse return live_ts;
+        return end_ts[row];
+    }
+
+    /// Record that `row` was deleted by the commit at `ts`
+    pub fn markDeleted(self: *SegmentVersions, allocator: std.mem.Allocator, row: usize, ts: u64) !void {
+        const end_ts = self.end_ts orelse blk: {
+            const fresh = try allocator.alloc(u64, self.row_count);
+            @memset(fresh, live_ts);
+            self.end_ts = fresh;
+            break :blk fresh;
+        };
+        if (end_ts[row] != live_ts) return;
+        end_ts[row] = ts;
+        self.deleted_count += 1;
+        self.oldest_end_ts = @min(self.oldest_end_ts, ts);
+    }
+
+    /// Clear the selection bits of rows the snapshot cannot see
+    pub fn filterVisible(self: *const SegmentVersions, snapshot: Snapshot, selection: []u64) void {
+        // Segments written before the snapshot with no deletes are entirely visible
+        if (self.max_begin_ts <= snapshot.read_ts and self.deleted_count == 0) return;
+        if (self.min_begin_ts > snapshot.read_ts) {
+            @memset(selection, 0);
+            return;
+        }
+        for (0..self.row_count) |row| {
+            if (!snapshot.isVisible(self.beginTs(row), self.endTs(row))) {
+                column_segment.clearBit(selection, row);
+            }
+        }
+    }
+
+    /// True if some deleted row is invisible to every snapshot at or after `oldest_read_ts`
+    pub fn hasReclaimable(self: *const SegmentVersions, oldest_read_ts: u64) bool {
+        return self.deleted_count > 0 and self.oldest_end_ts <= oldest_read_ts;
+    }
+
+    pub fn memoryBytes(self: *const SegmentVersions) usize {
+        var bytes = self.begin_offsets.words.len * @sizeOf(u64);
+        if (self.end_ts) |end_ts| bytes += end_ts.len * @sizeOf(u64);
+        return bytes;
+    }
+};
+
+test "SegmentVersions filters rows by snapshot" {
+    const allocator = std.testing.allocator;
+    const begin_ts = [_]u64{ 3, 3, 5, 7 };
+    const end_ts = [_]u64{ live_ts, 6, live_ts, live_ts };
+    var versions = try SegmentVersions.init(allocator, &begin_ts, &end_ts);
+    defer versions.deinit(allocator);
+
+    try std.testing.expectEqual(@as(u64, 5), versions.beginTs(2));
+    try std.testing.expectEqual(@as(u64, 6), versions.endTs(1));
+    try std.testing.expectEqual(@as(usize, 1), versions.deleted_count);
+
+    var selection = try column_segment.initSelection(allocator, begin_ts.len);
+    defer allocator.free(selection);
+    versions.filterVisible(Snapshot.at(5), selection);
+    try std.testing.expectEqual(@as(u64, 0b0111), selection[0]);
+
+    selection[0] = 0b1111;
+    versions.filterVisible(Snapshot.at(7), selection);
+    try std.testing.expectEqual(@as(u64, 0b1101), selection[0]);
+
+    try std.testing.expect(!versions.hasReclaimable(5));
+    try std.testing.expect(versions.hasReclaimable(6));
+}
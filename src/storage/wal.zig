@@ -1,6 +1,10 @@
 const std = @import("std");
 const assert = @import("../build_options.zig").assert;
 
+/// Largest record the WAL accepts. An explicit transaction is logged as one
+/// record, so this bounds the size of a transaction's write set.
+pub const max_record_bytes: usize = 64 * 1024 * 1024;
+
 /// Write-Ahead Log for durability and crash recovery
 pub const WAL = struct {
     allocator: std.mem.Allocator,
@@ -9,6 +13,8 @@ pub const WAL = struct {
     transactions: std.AutoHashMap(u64, []const u8),
     is_recovered: bool,
     current_position: u64 = 0, // Track current position in the WAL
+    sync_count: u64 = 0, // Number of fsyncs issued, i.e. durable writes
+    append_mutex: std.Thread.Mutex = .{}, // Appends from concurrent connections go one at a time
 
     /// Initialize a new WAL instance
     pub fn init(allocator: std.mem.Allocator, data_dir: []const u8) !*WAL {
@@ -108,12 +114,17 @@ pub const WAL = struct {
         return self.current_position;
     }
 
-    /// Log a transaction
+    /// Log a transaction. Safe to call from several threads; records are
+    /// appended and synced one at a time.
     pub fn logTransaction(self: *WAL, txn_id: u64, data: []const u8) !void {
+        self.append_mutex.lock();
+        defer self.append_mutex.unlock();
+
         if (self.file == null) {
             std.debug.print("[WAL] logTransaction: WAL file is null!\n", .{});
             return error.WALClosed;
         }
+        if (data.len > max_record_bytes) return error.RecordTooLarge;
 
         // Store the transaction in memory
         const data_copy = try self.allocator.dupe(u8, data);
@@ -125,7 +136,7 @@ pub const WAL = struct {
         try file.seekFromEnd(0);
         var writer = file.writer();
 
-        std.debug.print("[WAL] logTransaction: Writing txn_id {} with data '{s}' (len: {}) to WAL file\n", .{ txn_id, data, data.len });
+        std.debug.print("[WAL] logTransaction: Writing txn_id {} ({} bytes) to WAL file\n", .{ txn_id, data.len });
 
         // Write transaction header (id and length)
         try writer.writeInt(u64, txn_id, .little);
@@ -139,6 +150,7 @@ pub const WAL = struct {
 
         // Flush to ensure data is written to disk
         try file.sync();
+        self.sync_count += 1;
         const file_size = try file.getEndPos();
         std.debug.print("[WAL] logTransaction: WAL file flushed, file size now {}\n", .{file_size});
     }
@@ -223,8 +235,8 @@ pub const WAL = struct {
             std.debug.print("[WAL] recover() reading transaction {} with data length {}\\n", .{ txn_id, data_len });
 
             // Validate data length to prevent excessive memory allocation
-            if (data_len > 1024 * 1024) { // 1MB limit
-                std.debug.print("[WAL] recover() data length {} exceeds 1MB limit, skipping\\n", .{data_len});
+            if (data_len > max_record_bytes) {
+                std.debug.print("[WAL] recover() data length {} exceeds the record size limit, skipping\\n", .{data_len});
                 break;
             }
 
@@ -241,7 +253,7 @@ pub const WAL = struct {
                 break;
             };
 
-            std.debug.print("[WAL] recover() recovered transaction {}: {s}\\n", .{ txn_id, data });
+            std.debug.print("[WAL] recover() recovered transaction {} ({} bytes)\\n", .{ txn_id, data.len });
 
             // Store in memory
             self.transactions.put(txn_id, data) catch {
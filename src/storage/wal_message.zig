@@ -0,0 +1,169 @@
+const std = @import("std");
+
+/// Message types for distributed WAL communication
+pub const DistributedMessageType = enum(u8) {
+    PREPARE,
+    PREPARE_OK,
+    COMMIT,
+    FORWARD,
+};
+
+/// One replicated operation inside a PREPARE
+pub const Entry = struct {
+    op_number: u64,
+    data: []const u8,
+};
+
+/// Message for distributed WAL communication
+pub const DistributedWALMessage = struct {
+    type: DistributedMessageType,
+    op_number: u64, // For a PREPARE, the last operation in `entries`
+    commit_point: u64,
+    prev_op_number: u64 = 0, // PREPARE only: the operation just before `entries`
+    data: ?[]const u8,
+    sender: []const u8,
+    entries: []const Entry = &.{}, // PREPARE only, in operation order
+};
+
+/// Version byte at the start of every frame
+pub const format_version: u8 = 2;
+
+/// Encode `msg` as one frame appended to `buffer`:
+///
+///   version u8 | type u8 | op_number | commit_point | prev_op_number | sender
+///   | has_data u8 [| data] | entry count | entries... | crc32 (u32 LE)
+///
+/// Integers and lengths are unsigned LEB128 varints. Entry op numbers are
+/// stored as the delta from the previous entry, so a batch of consecutive
+/// operations costs one byte per op number. The CRC covers the whole frame.
+pub fn encode(allocator: std.mem.Allocator, buffer: *std.ArrayListUnmanaged(u8), msg: DistributedWALMessage) !void {
+    const start = buffer.items.len;
+    const writer = buffer.writer(allocator);
+
+    try writer.writeByte(format_version);
+    try writer.writeByte(@intFromEnum(msg.type));
+    try std.leb.writeUleb128(writer, msg.op_number);
+    try std.leb.writeUleb128(writer, msg.commit_point);
+    try std.leb.writeUleb128(writer, msg.prev_op_number);
+    try writeBytes(writer, msg.sender);
+    if (msg.data) |data| {
+        try writer.writeByte(1);
+        try writeBytes(writer, data);
+    } else {
+        try writer.writeByte(0);
+    }
+
+    try std.leb.writeUleb128(writer, msg.entries.len);
+    var previous_op: u64 = 0;
+    for (msg.entries) |entry| {
+        if (entry.op_number < previous_op) return error.EntriesOutOfOrder;
+        try std.leb.writeUleb128(writer, entry.op_number - previous_op);
+        try writeBytes(writer, entry.data);
+        previous_op = entry.op_number;
+    }
+
+    try writer.writeInt(u32, std.hash.Crc32.hash(buffer.items[start..]), .little);
+}
+
+/// Decode one frame. Byte slices in the result point into `bytes`, and the
+/// entries are stored in `entries`, which is cleared first.
+pub fn decode(allocator: std.mem.Allocator, bytes: []const u8, entries: *std.ArrayListUnmanaged(Entry)) !DistributedWALMessage {
+    if (bytes.len < 6) return error.TruncatedMessage;
+    const body = bytes[0 .. bytes.len - 4];
+    const checksum = std.mem.readInt(u32, bytes[bytes.len - 4 ..][0..4], .little);
+    if (std.hash.Crc32.hash(body) != checksum) return error.ChecksumMismatch;
+
+    var stream = std.io.fixedBufferStream(body);
+    const reader = stream.reader();
+
+    if (try reader.readByte() != format_version) return error.UnsupportedMessageVersion;
+    const msg_type = std.meta.intToEnum(DistributedMessageType, try reader.readByte()) catch return error.InvalidMessage;
+    const op_number = try readVarint(reader);
+    const commit_point = try readVarint(reader);
+    const prev_op_number = try readVarint(reader);
+    const sender = try readBytes(&stream);
+    const data = switch (try reader.readByte()) {
+        0 => null,
+        1 => try readBytes(&stream),
+        else => return error.InvalidMessage,
+    };
+
+    entries.clearRetainingCapacity();
+    const entry_count = try readVarint(reader);
+    // Every entry takes at least two bytes, which bounds the reservation
+    if (entry_count > body.len / 2) return error.InvalidMessage;
+    try entries.ensureTotalCapacity(allocator, entry_count);
+    var op: u64 = 0;
+    for (0..entry_count) |_| {
+        op = std.math.add(u64, op, try readVarint(reader)) catch return error.InvalidMessage;
+        entries.appendAssumeCapacity(Entry{ .op_number = op, .data = try readBytes(&stream) });
+    }
+    if (stream.pos != body.len) return error.InvalidMessage;
+
+    return DistributedWALMessage{
+        .type = msg_type,
+        .op_number = op_number,
+        .commit_point = commit_point,
+        .prev_op_number = prev_op_number,
+        .data = data,
+        .sender = sender,
+        .entries = entries.items,
+    };
+}
+
+fn writeBytes(writer: anytype, bytes: []const u8) !void {
+    try std.leb.writeUleb128(writer, bytes.len);
+    try writer.writeAll(bytes);
+}
+
+fn readVarint(reader: anytype) !u64 {
+    return std.leb.readUleb128(u64, reader) catch |err| switch (err) {
+        error.EndOfStream => error.TruncatedMessage,
+        else => error.InvalidMessage,
+    };
+}
+
+fn readBytes(stream: *std.io.FixedBufferStream([]const u8)) ![]const u8 {
+    const len = try readVarint(stream.reader());
+    if (len > stream.buffer.len - stream.pos) return error.TruncatedMessage;
+    const start = stream.pos;
+    stream.pos += @intCast(len);
+    return stream.buffer[start..stream.pos];
+}
+
+test "DistributedWALMessage round-trips through the binary format" {
+    const allocator = std.testing.allocator;
+    var buffer = std.ArrayListUnmanaged(u8){};
+    defer buffer.deinit(allocator);
+    var entries = std.ArrayListUnmanaged(Entry){};
+    defer entries.deinit(allocator);
+
+    const large = try allocator.alloc(u8, 10_000);
+    defer allocator.free(large);
+    @memset(large, 'x');
+
+    const batch = [_]Entry{
+        .{ .op_number = 41, .data = "INSERT:t:a" },
+        .{ .op_number = 42, .data = large },
+        .{ .op_number = 43, .data = "" },
+    };
+    try encode(allocator, &buffer, .{ .type = .PREPARE, .op_number = 43, .commit_point = 40, .prev_op_number = 40, .data = null, .sender = "node1", .entries = &batch });
+    // Consecutive op numbers cost one byte each on top of the payloads
+    try std.testing.expect(buffer.items.len < large.len + 48);
+
+    const msg = try decode(allocator, buffer.items, &entries);
+    try std.testing.expectEqual(DistributedMessageType.PREPARE, msg.type);
+    try std.testing.expectEqual(@as(u64, 43), msg.op_number);
+    try std.testing.expectEqual(@as(u64, 40), msg.commit_point);
+    try std.testing.expectEqual(@as(u64, 40), msg.prev_op_number);
+    try std.testing.expectEqualStrings("node1", msg.sender);
+    try std.testing.expect(msg.data == null);
+    try std.testing.expectEqual(@as(usize, 3), msg.entries.len);
+    try std.testing.expectEqual(@as(u64, 42), msg.entries[1].op_number);
+    try std.testing.expectEqualSlices(u8, large, msg.entries[1].data);
+
+    // A flipped bit anywhere is caught by the checksum
+    buffer.items[buffer.items.len / 2] ^= 0x10;
+    try std.testing.expectError(error.ChecksumMismatch, decode(allocator, buffer.items, &entries));
+    try std.testing.expectError(error.TruncatedMessage, decode(allocator, buffer.items[0..3], &entries));
+}
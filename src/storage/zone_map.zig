@@ -0,0 +1,81 @@
+const std = @import("std");
+const Value = @import("../query/result.zig").Value;
+const column_segment = @import("column_segment.zig");
+const CompareOp = column_segment.CompareOp;
+const ColumnSegment = column_segment.ColumnSegment;
+
+/// Min/max and null count of one column over a block of rows.
+/// Text bounds are borrowed from the block's own storage.
+pub const ZoneMap = struct {
+    min: ?Value = null,
+    max: ?Value = null,
+    null_count: usize = 0,
+    row_count: usize = 0,
+
+    /// Summarize the values of a sealed column segment
+    pub fn fromSegment(segment: *const ColumnSegment) ZoneMap {
+        var zone = ZoneMap{};
+        for (0..segment.row_count) |row| {
+            zone.update(segment.get(row));
+        }
+        return zone;
+    }
+
+    /// Widen the summary to include one more value
+    pub fn update(self: *ZoneMap, value: Value) void {
+        self.row_count += 1;
+        if (value == .null) {
+            self.null_count += 1;
+            return;
+        }
+        if (self.min == null or column_segment.compareValues(value, self.min.?) == .lt) {
+            self.min = value;
+        }
+        if (self.max == null or column_segment.compareValues(value, self.max.?) == .gt) {
+            self.max = value;
+        }
+    }
+
+    /// False only if no row in the block can satisfy `value <op> literal`
+    pub fn mayMatch(self: *const ZoneMap, op: CompareOp, literal: Value) bool {
+        if (literal == .null) return false;
+        // A block of only nulls never matches a comparison
+        const min = self.min orelse return false;
+        const max = self.max.?;
+        // Types the bounds cannot be compared with are left to the row-level check
+        const lo = column_segment.compareValues(min, literal) orelse return true;
+        const hi = column_segment.compareValues(max, literal) orelse return true;
+        return switch (op) {
+            .Eq => lo != .gt and hi != .lt,
+            .Ne => !(lo == .eq and hi == .eq),
+            .Lt => lo == .lt,
+            .Le => lo != .gt,
+            .Gt => hi == .gt,
+            .Ge => hi != .lt,
+        };
+    }
+};
+
+test "ZoneMap prunes ranges that cannot match" {
+    var zone = ZoneMap{};
+    zone.update(Value{ .integer = 100 });
+    zone.update(Value{ .null = {} });
+    zone.update(Value{ .integer = 250 });
+    zone.update(Value{ .integer = 180 });
+
+    try std.testing.expectEqual(@as(i64, 100), zone.min.?.integer);
+    try std.testing.expectEqual(@as(i64, 250), zone.max.?.integer);
+    try std.testing.expectEqual(@as(usize, 1), zone.null_count);
+
+    try std.testing.expect(zone.mayMatch(.Eq, Value{ .integer = 180 }));
+    try std.testing.expect(!zone.mayMatch(.Eq, Value{ .integer = 99 }));
+    try std.testing.expect(!zone.mayMatch(.Lt, Value{ .integer = 100 }));
+    try std.testing.expect(zone.mayMatch(.Le, Value{ .integer = 100 }));
+    try std.testing.expect(!zone.mayMatch(.Gt, Value{ .float = 250.0 }));
+    try std.testing.expect(zone.mayMatch(.Ge, Value{ .integer = 250 }));
+    try std.testing.expect(!zone.mayMatch(.Eq, Value{ .null = {} }));
+
+    var all_null = ZoneMap{};
+    all_null.update(Value{ .null = {} });
+    try std.testing.expect(!all_null.mayMatch(.Ne, Value{ .integer = 1 }));
+}
@@ -29,6 +29,22 @@ test "Database initialization" {
     try testing.expect(@intFromPtr(db.txn_manager) != 0);
 }
 
+test "Database loads cost model weights from its data directory" {
+    const allocator = testing.allocator;
+    const dir = "test_db_cost_model";
+    fs.cwd().deleteTree(dir) catch {};
+    defer fs.cwd().deleteTree(dir) catch {};
+
+    const Weights = @import("geeqodb").query.cost_model.CostModel.Weights;
+    var calibrated = Weights{};
+    calibrated.cpu_scan_cost_per_row = 3.5;
+    try calibrated.saveToFile(dir ++ "/cost_model.json");
+
+    const db = try database.init(allocator, dir);
+    defer db.deinit();
+    try testing.expectEqual(@as(f64, 3.5), db.db_context.cost_weights.cpu_scan_cost_per_row);
+}
+
 test "Database execute query" {
     const allocator = testing.allocator;
 
@@ -126,13 +142,13 @@ test "Database recovery after crash" {
     _ = try db.execute("INSERT INTO test VALUES (3, 'test3')");
     var result = try db.execute("SELECT * FROM test");
     defer result.deinit();
-    try testing.expectEqual(@as(usize, 3), result.rows.len);
-    try testing.expectEqual(@as(i64, 1), result.rows[0].values[0].integer);
-    try testing.expectEqualStrings("test1", result.rows[0].values[1].text);
-    try testing.expectEqual(@as(i64, 2), result.rows[1].values[0].integer);
-    try testing.expectEqualStrings("test2", result.rows[1].values[1].text);
-    try testing.expectEqual(@as(i64, 3), result.rows[2].values[0].integer);
-    try testing.expectEqualStrings("test3", result.rows[2].values[1].text);
+    try testing.expectEqual(@as(usize, 3), result.row_count);
+    try testing.expectEqual(@as(i64, 1), result.getValue(0, 0).integer);
+    try testing.expectEqualStrings("test1", result.getValue(0, 1).text);
+    try testing.expectEqual(@as(i64, 2), result.getValue(1, 0).integer);
+    try testing.expectEqualStrings("test2", result.getValue(1, 1).text);
+    try testing.expectEqual(@as(i64, 3), result.getValue(2, 0).integer);
+    try testing.expectEqualStrings("test3", result.getValue(2, 1).text);
 
     db.deinit();
 }
@@ -203,9 +219,11 @@ test "CREATE TABLE creates schema and prevents duplicates" {
     // Create a table
     _ = try db.execute("CREATE TABLE users (id INT, name TEXT, email TEXT)");
 
-    // Try to create the same table again and expect an error
+    // Try to create the same table again and expect an error, with nothing logged
+    const syncs_before = db.wal.sync_count;
     const dup_result = db.execute("CREATE TABLE users (id INT, name TEXT, email TEXT)");
     try testing.expectError(error.TableAlreadyExists, dup_result);
+    try testing.expectEqual(syncs_before, db.wal.sync_count);
 
     // Select from the table and check columns
     var result_set = try db.execute("SELECT * FROM users");
@@ -242,7 +260,7 @@ test "INSERT INTO stores data and handles errors" {
     defer result.deinit();
 
     // Verify we have 2 rows
-    try testing.expectEqual(@as(usize, 2), result.rows.len);
+    try testing.expectEqual(@as(usize, 2), result.row_count);
     try testing.expectEqual(@as(usize, 3), result.columns.len);
 
     // Verify column names
@@ -251,14 +269,14 @@ test "INSERT INTO stores data and handles errors" {
     try testing.expectEqualStrings("email", result.columns[2].name);
 
     // Verify first row data
-    try testing.expectEqual(@as(i64, 1), result.rows[0].values[0].integer);
-    try testing.expectEqualStrings("Alice", result.rows[0].values[1].text);
-    try testing.expectEqualStrings("alice@example.com", result.rows[0].values[2].text);
+    try testing.expectEqual(@as(i64, 1), result.getValue(0, 0).integer);
+    try testing.expectEqualStrings("Alice", result.getValue(0, 1).text);
+    try testing.expectEqualStrings("alice@example.com", result.getValue(0, 2).text);
 
     // Verify second row data
-    try testing.expectEqual(@as(i64, 2), result.rows[1].values[0].integer);
-    try testing.expectEqualStrings("Bob", result.rows[1].values[1].text);
-    try testing.expectEqualStrings("bob@example.com", result.rows[1].values[2].text);
+    try testing.expectEqual(@as(i64, 2), result.getValue(1, 0).integer);
+    try testing.expectEqualStrings("Bob", result.getValue(1, 1).text);
+    try testing.expectEqualStrings("bob@example.com", result.getValue(1, 2).text);
 
     // Test error: inserting into non-existent table
     const invalid_result = db.execute("INSERT INTO nonexistent VALUES (1, 'test')");
@@ -269,6 +287,575 @@ test "INSERT INTO stores data and handles errors" {
     try testing.expectError(error.ColumnCountMismatch, mismatch_result);
 }
 
+test "multi-row INSERT appends all rows" {
+    const allocator = testing.allocator;
+    std.fs.cwd().deleteTree("test_multi_insert") catch {};
+    defer std.fs.cwd().deleteTree("test_multi_insert") catch {};
+
+    const db = try database.init(allocator, "test_multi_insert");
+    defer db.deinit();
+
+    _ = try db.execute("CREATE TABLE users (id INT, name TEXT)");
+    _ = try db.execute("INSERT INTO users VALUES (1, 'Alice'), (2, 'Smith, Bob'), (3, 'O''Hara')");
+
+    var result = try db.execute("SELECT * FROM users");
+    defer result.deinit();
+
+    try testing.expectEqual(@as(usize, 3), result.row_count);
+    try testing.expectEqualStrings("Smith, Bob", result.getValue(1, 1).text);
+    try testing.expectEqualStrings("O'Hara", result.getValue(2, 1).text);
+
+    // A bad tuple rejects the whole statement
+    try testing.expectError(error.ColumnCountMismatch, db.execute("INSERT INTO users VALUES (4, 'Dan'), (5)"));
+    var after = try db.execute("SELECT * FROM users");
+    defer after.deinit();
+    try testing.expectEqual(@as(usize, 3), after.row_count);
+}
+
+test "COPY loads a CSV file and survives recovery" {
+    const allocator = testing.allocator;
+    const dir = "test_copy";
+    std.fs.cwd().deleteTree(dir) catch {};
+    try std.fs.cwd().makePath(dir);
+    defer std.fs.cwd().deleteTree(dir) catch {};
+
+    // Enough rows to span several WAL batches
+    const row_count: usize = 20000;
+    {
+        var file = try std.fs.cwd().createFile(dir ++ "/users.csv", .{});
+        defer file.close();
+        var buffered = std.io.bufferedWriter(file.writer());
+        const writer = buffered.writer();
+        try writer.writeAll("id,name,score\n");
+        for (0..row_count) |i| {
+            try writer.print("{d},\"user {d}, the {d}th\",{d}.5\n", .{ i, i, i, i });
+        }
+        try buffered.flush();
+    }
+
+    {
+        const db = try database.init(allocator, dir);
+        defer db.deinit();
+
+        _ = try db.execute("CREATE TABLE users (id INT, name TEXT, score FLOAT)");
+        _ = try db.execute("COPY users FROM 'test_copy/users.csv' WITH (FORMAT csv, HEADER)");
+
+        var result = try db.execute("SELECT * FROM users");
+        defer result.deinit();
+        try testing.expectEqual(row_count, result.row_count);
+        try testing.expectEqual(@as(i64, 42), result.getValue(42, 0).integer);
+        try testing.expectEqualStrings("user 42, the 42th", result.getValue(42, 1).text);
+        try testing.expectEqual(@as(f64, 42.5), result.getValue(42, 2).float);
+
+        try testing.expectError(error.TableNotFound, db.execute("COPY missing FROM 'test_copy/users.csv'"));
+        try testing.expectError(error.FileNotFound, db.execute("COPY users FROM 'test_copy/missing.csv'"));
+    }
+
+    // The batches were logged to the WAL and replay into the same rows
+    {
+        const db = try database.recoverDatabase(allocator, dir);
+        defer db.deinit();
+
+        var result = try db.execute("SELECT * FROM users");
+        defer result.deinit();
+        try testing.expectEqual(row_count, result.row_count);
+    }
+}
+
+test "sealed segments are compressed and filtered during scans" {
+    const allocator = testing.allocator;
+    const geeqodb = @import("geeqodb");
+    const planner = geeqodb.query.planner;
+    const QueryExecutor = geeqodb.query.executor.QueryExecutor;
+
+    std.fs.cwd().deleteTree("test_segments") catch {};
+    defer std.fs.cwd().deleteTree("test_segments") catch {};
+
+    const db = try database.init(allocator, "test_segments");
+    defer db.deinit();
+
+    _ = try db.execute("CREATE TABLE events (id INT, kind TEXT, ok BOOL)");
+    const schema = db.table_schemas.get("events").?;
+    schema.segment_rows = 256;
+
+    var query = std.ArrayList(u8).init(allocator);
+    defer query.deinit();
+    try query.appendSlice("INSERT INTO events VALUES ");
+    for (0..600) |i| {
+        if (i > 0) try query.appendSlice(", ");
+        try query.writer().print("({d}, '{s}', {s})", .{ i, if (i % 3 == 0) "click" else "view", if (i % 2 == 0) "true" else "false" });
+    }
+    _ = try db.execute(query.items);
+
+    // Two full segments were sealed and 88 rows remain in the tail
+    try testing.expectEqual(@as(usize, 2), schema.segments.items.len);
+    try testing.expectEqual(@as(usize, 88), schema.rows.items.len);
+    try testing.expectEqual(@as(usize, 600), schema.rowCount());
+    const segment = schema.segments.items[0];
+    try testing.expectEqual(geeqodb.storage.column_segment.Encoding.FrameOfReference, segment.columns[0].encoding);
+    try testing.expectEqual(geeqodb.storage.column_segment.Encoding.Dictionary, segment.columns[1].encoding);
+
+    // kind = 'click' AND id >= 250 spans the end of a segment and the tail
+    const predicates = [_]planner.Predicate{
+        .{ .column = "kind", .op = .Eq, .value = .{ .String = "click" } },
+        .{ .column = "id", .op = .Ge, .value = .{ .Integer = 250 } },
+    };
+    var plan = planner.PhysicalPlan{
+        .allocator = allocator,
+        .node_type = .TableScan,
+        .table_name = "events",
+        .predicates = &predicates,
+    };
+    var result = try QueryExecutor.execute(allocator, &plan, db.db_context);
+    defer result.deinit();
+
+    try testing.expectEqual(@as(usize, 116), result.row_count);
+    try testing.expectEqual(@as(i64, 252), result.getValue(0, 0).integer);
+    try testing.expectEqualStrings("click", result.getValue(0, 1).text);
+    try testing.expectEqual(true, result.getValue(0, 2).boolean);
+    try testing.expectEqual(@as(i64, 597), result.getValue(115, 0).integer);
+}
+
+test "zone maps skip blocks that cannot match the WHERE clause" {
+    const allocator = testing.allocator;
+
+    std.fs.cwd().deleteTree("test_zone_maps") catch {};
+    defer std.fs.cwd().deleteTree("test_zone_maps") catch {};
+
+    const db = try database.init(allocator, "test_zone_maps");
+    defer db.deinit();
+
+    _ = try db.execute("CREATE TABLE events (ts INT, kind TEXT)");
+    const schema = db.table_schemas.get("events").?;
+    schema.segment_rows = 256;
+
+    var query = std.ArrayList(u8).init(allocator);
+    defer query.deinit();
+    try query.appendSlice("INSERT INTO events VALUES ");
+    for (0..1100) |i| {
+        if (i > 0) try query.appendSlice(", ");
+        try query.writer().print("({d}, 'k{d}')", .{ i, i % 7 });
+    }
+    _ = try db.execute(query.items);
+
+    // Tail zone maps track the rows that have not been sealed yet
+    try testing.expectEqual(@as(i64, 1024), schema.tail_zone_maps[0].min.?.integer);
+    try testing.expectEqual(@as(i64, 1099), schema.tail_zone_maps[0].max.?.integer);
+
+    var result = try db.execute("SELECT * FROM events WHERE ts >= 900 AND ts < 1000");
+    defer result.deinit();
+    try testing.expectEqual(@as(usize, 100), result.row_count);
+    try testing.expectEqual(@as(i64, 900), result.getValue(0, 0).integer);
+
+    // Segments 0-2 and the tail are skipped; only segment 3 is filtered
+    var explained = try db.execute("EXPLAIN ANALYZE SELECT * FROM events WHERE ts >= 900 AND ts < 1000");
+    defer explained.deinit();
+    try testing.expect(std.mem.indexOf(u8, explained.getValue(0, 0).text, "skipped=4") != null);
+}
+
+test "BLOOM columns skip segments on equality lookups" {
+    const allocator = testing.allocator;
+
+    std.fs.cwd().deleteTree("test_bloom") catch {};
+    defer std.fs.cwd().deleteTree("test_bloom") catch {};
+
+    const db = try database.init(allocator, "test_bloom");
+    defer db.deinit();
+
+    _ = try db.execute("CREATE TABLE sessions (session_id TEXT BLOOM, hits INT)");
+    const schema = db.table_schemas.get("sessions").?;
+    try testing.expect(schema.columns[0].bloom_filter);
+    try testing.expect(!schema.columns[1].bloom_filter);
+    schema.segment_rows = 256;
+
+    // Scattered ids give every segment a wide min/max, so zone maps cannot prune
+    var query = std.ArrayList(u8).init(allocator);
+    defer query.deinit();
+    try query.appendSlice("INSERT INTO sessions VALUES ");
+    for (0..1024) |i| {
+        if (i > 0) try query.appendSlice(", ");
+        try query.writer().print("('s{d}', {d})", .{ (i * 7919) % 1024, i });
+    }
+    _ = try db.execute(query.items);
+
+    try testing.expect(schema.segments.items[0].columns[0].bloom != null);
+    try testing.expect(schema.segments.items[0].columns[1].bloom == null);
+
+    var result = try db.execute("SELECT * FROM sessions WHERE session_id = 's5'");
+    defer result.deinit();
+    try testing.expectEqual(@as(usize, 1), result.row_count);
+    try testing.expectEqualStrings("s5", result.getValue(0, 0).text);
+
+    var explained = try db.execute("EXPLAIN ANALYZE SELECT * FROM sessions WHERE session_id = 's5'");
+    defer explained.deinit();
+    try testing.expect(std.mem.indexOf(u8, explained.getValue(0, 0).text, "skipped=") != null);
+}
+
+test "snapshots keep seeing deleted rows until garbage collection" {
+    const allocator = testing.allocator;
+    const geeqodb = @import("geeqodb");
+    const planner = geeqodb.query.planner;
+    const QueryExecutor = geeqodb.query.executor.QueryExecutor;
+
+    std.fs.cwd().deleteTree("test_mvcc") catch {};
+    defer std.fs.cwd().deleteTree("test_mvcc") catch {};
+
+    const db = try database.init(allocator, "test_mvcc");
+    defer db.deinit();
+
+    _ = try db.execute("CREATE TABLE items (id INT, name TEXT)");
+    const schema = db.table_schemas.get("items").?;
+    schema.segment_rows = 4;
+    _ = try db.execute("INSERT INTO items VALUES (0, 'a'), (1, 'b'), (2, 'c'), (3, 'd'), (4, 'e'), (5, 'f')");
+
+    // A reader that starts now must not see anything that happens afterwards
+    const reader = try db.txn_manager.beginTransaction();
+
+    _ = try db.execute("INSERT INTO items VALUES (6, 'g'), (7, 'h')");
+    _ = try db.execute("DELETE FROM items WHERE id < 2");
+    _ = try db.execute("DELETE FROM items WHERE id = 5");
+    try testing.expectError(error.TableNotFound, db.execute("DELETE FROM missing"));
+
+    var latest = try db.execute("SELECT * FROM items");
+    defer latest.deinit();
+    try testing.expectEqual(@as(usize, 5), latest.row_count);
+    try testing.expectEqual(@as(i64, 2), latest.getValue(0, 0).integer);
+
+    var plan = planner.PhysicalPlan{
+        .allocator = allocator,
+        .node_type = .TableScan,
+        .table_name = "items",
+    };
+    var old = try QueryExecutor.executeAt(allocator, &plan, db.db_context, reader.snapshot());
+    defer old.deinit();
+    try testing.expectEqual(@as(usize, 6), old.row_count);
+    try testing.expectEqual(@as(i64, 0), old.getValue(0, 0).integer);
+    try testing.expectEqualStrings("f", old.getValue(5, 1).text);
+
+    // The deleted versions are kept while the reader is active
+    try testing.expectEqual(@as(usize, 0), try db.collectGarbage());
+    try testing.expectEqual(@as(usize, 8), schema.rowCount());
+
+    try db.txn_manager.commitTransaction(reader);
+    try testing.expectEqual(@as(usize, 3), try db.collectGarbage());
+    try testing.expectEqual(@as(usize, 5), schema.rowCount());
+    try testing.expectEqual(@as(usize, 2), schema.segments.items[0].row_count);
+
+    var after_gc = try db.execute("SELECT * FROM items");
+    defer after_gc.deinit();
+    try testing.expectEqual(@as(usize, 5), after_gc.row_count);
+    try testing.expectEqualStrings("c", after_gc.getValue(0, 1).text);
+
+    // The old result still reads the segment that garbage collection replaced
+    try testing.expectEqualStrings("a", old.getValue(0, 1).text);
+}
+
+/// A `logs` table with three sealed segments of 256 rows and the rest in the
+/// tail. Every tenth row is a warning.
+fn createLogs(db: *database.OLAPDatabase, row_count: usize) !*database.TableSchema {
+    _ = try db.execute("CREATE TABLE logs (id INT, level TEXT)");
+    const schema = db.table_schemas.get("logs").?;
+    schema.segment_rows = 256;
+
+    var query = std.ArrayList(u8).init(db.allocator);
+    defer query.deinit();
+    try query.appendSlice("INSERT INTO logs VALUES ");
+    for (0..row_count) |i| {
+        if (i > 0) try query.appendSlice(", ");
+        try query.writer().print("({d}, '{s}')", .{ i, if (i % 10 == 0) "warn" else "info" });
+    }
+    _ = try db.execute(query.items);
+    return schema;
+}
+
+test "DELETE collects only its own table once enough versions are dead" {
+    const allocator = testing.allocator;
+
+    std.fs.cwd().deleteTree("test_delete_gc") catch {};
+    defer std.fs.cwd().deleteTree("test_delete_gc") catch {};
+
+    const db = try database.init(allocator, "test_delete_gc");
+    defer db.deinit();
+
+    const logs = try createLogs(db, 2000);
+    _ = try db.execute("CREATE TABLE items (id INT)");
+    const items = db.table_schemas.get("items").?;
+    _ = try db.execute("INSERT INTO items VALUES (0), (1), (2)");
+    _ = try db.execute("DELETE FROM items WHERE id = 0");
+
+    // Below the threshold the dead versions are left for a later collection
+    _ = try db.execute("DELETE FROM logs WHERE id < 100");
+    try testing.expectEqual(@as(usize, 100), logs.dead_versions);
+    try testing.expectEqual(@as(usize, 2000), logs.rowCount());
+
+    _ = try db.execute("DELETE FROM logs WHERE id < 1200");
+    try testing.expectEqual(@as(usize, 0), logs.dead_versions);
+    try testing.expectEqual(@as(usize, 800), logs.rowCount());
+
+    // Deleting from logs left items alone
+    try testing.expectEqual(@as(usize, 1), items.dead_versions);
+    try testing.expectEqual(@as(usize, 3), items.rowCount());
+    try testing.expectEqual(@as(usize, 1), try db.collectGarbage());
+    try testing.expectEqual(@as(usize, 0), items.dead_versions);
+}
+
+test "scans return views of sealed segments instead of copies" {
+    const allocator = testing.allocator;
+    const Chunk = @import("geeqodb").query.result.Chunk;
+
+    std.fs.cwd().deleteTree("test_result_views") catch {};
+    defer std.fs.cwd().deleteTree("test_result_views") catch {};
+
+    const db = try database.init(allocator, "test_result_views");
+    defer db.deinit();
+
+    const schema = try createLogs(db, 1000);
+
+    var result = try db.execute("SELECT * FROM logs");
+    defer result.deinit();
+    try testing.expectEqual(@as(usize, 1000), result.row_count);
+
+    // Three sealed segments are viewed in place; only the 232 tail rows were copied
+    try testing.expectEqual(@as(usize, 4), result.chunks.items.len);
+    for (result.chunks.items[0..3]) |chunk| {
+        try testing.expect(chunk.data == Chunk.Data.view);
+        try testing.expectEqual(schema.segments.items[0].columns.len, chunk.columnCount());
+    }
+    try testing.expect(result.chunks.items[3].data == Chunk.Data.owned);
+    try testing.expectEqual(@as(usize, 232), result.chunks.items[3].row_count);
+
+    var expected_id: i64 = 0;
+    var rows = result.iterator();
+    while (rows.next()) |row| : (expected_id += 1) {
+        try testing.expectEqual(expected_id, row.get(0).integer);
+        try testing.expectEqualStrings(if (@mod(expected_id, 10) == 0) "warn" else "info", row.get(1).text);
+    }
+    try testing.expectEqual(@as(i64, 1000), expected_id);
+
+    // Deleting everything lets garbage collection drop the segments from the
+    // table; the result keeps them alive until it is freed
+    _ = try db.execute("DELETE FROM logs WHERE id >= 0");
+    try testing.expectEqual(@as(usize, 1000), try db.collectGarbage());
+    try testing.expectEqual(@as(usize, 0), schema.segments.items.len);
+    try testing.expectEqualStrings("warn", result.getValue(500, 1).text);
+}
+
+test "explicit transactions buffer writes and commit with one WAL write" {
+    const allocator = testing.allocator;
+    const Session = @import("geeqodb").session.Session;
+    const dir = "test_session";
+    std.fs.cwd().deleteTree(dir) catch {};
+    defer std.fs.cwd().deleteTree(dir) catch {};
+
+    const row_count: usize = 10_000;
+    {
+        const db = try database.init(allocator, dir);
+        defer db.deinit();
+        _ = try db.execute("CREATE TABLE readings (id INT, sensor TEXT)");
+
+        var session = Session.init(allocator, db);
+        defer session.deinit();
+
+        _ = try session.execute("BEGIN");
+        try testing.expectError(error.TransactionAlreadyActive, session.execute("BEGIN"));
+        const syncs_before = db.wal.sync_count;
+        var buf: [96]u8 = undefined;
+        for (0..row_count) |i| {
+            _ = try session.execute(try std.fmt.bufPrint(&buf, "INSERT INTO readings VALUES ({d}, 'sensor-{d}')", .{ i, i % 16 }));
+        }
+        _ = try session.execute("DELETE FROM readings WHERE id < 0");
+
+        // Nothing is logged or visible before COMMIT
+        try testing.expectEqual(syncs_before, db.wal.sync_count);
+        var before = try db.execute("SELECT * FROM readings");
+        defer before.deinit();
+        try testing.expectEqual(@as(usize, 0), before.row_count);
+
+        _ = try session.execute("COMMIT");
+        try testing.expectEqual(syncs_before + 1, db.wal.sync_count);
+        var after = try db.execute("SELECT * FROM readings");
+        defer after.deinit();
+        try testing.expectEqual(row_count, after.row_count);
+
+        // ROLLBACK discards the write set without touching the WAL
+        _ = try session.execute("BEGIN");
+        _ = try session.execute("INSERT INTO readings VALUES (-1, 'x')");
+        _ = try session.execute("DELETE FROM readings WHERE id < 100");
+        _ = try session.execute("ROLLBACK");
+        try testing.expectEqual(syncs_before + 1, db.wal.sync_count);
+        try testing.expectError(error.NoActiveTransaction, session.execute("COMMIT"));
+
+        var unchanged = try session.execute("SELECT * FROM readings");
+        defer unchanged.deinit();
+        try testing.expectEqual(row_count, unchanged.row_count);
+    }
+
+    // The single transaction record replays every write
+    {
+        const db = try database.recoverDatabase(allocator, dir);
+        defer db.deinit();
+
+        var result = try db.execute("SELECT * FROM readings");
+        defer result.deinit();
+        try testing.expectEqual(row_count, result.row_count);
+        try testing.expectEqualStrings("sensor-3", result.getValue(3, 1).text);
+    }
+}
+
+test "serializable sessions hold table locks until commit" {
+    const allocator = testing.allocator;
+    const geeqodb = @import("geeqodb");
+    const Session = geeqodb.session.Session;
+    const lock_manager = geeqodb.transaction.lock_manager;
+    const dir = "test_session_locks";
+    std.fs.cwd().deleteTree(dir) catch {};
+    defer std.fs.cwd().deleteTree(dir) catch {};
+
+    const db = try database.init(allocator, dir);
+    defer db.deinit();
+    _ = try db.execute("CREATE TABLE accounts (id INT, balance INT)");
+    _ = try db.execute("INSERT INTO accounts VALUES (1, 100)");
+
+    var session = Session.init(allocator, db);
+    defer session.deinit();
+    try testing.expectError(error.InvalidIsolationLevel, session.execute("BEGIN ISOLATION LEVEL CHAOS"));
+
+    _ = try session.execute("BEGIN TRANSACTION ISOLATION LEVEL SERIALIZABLE");
+    const txn_id = session.txn.?.id;
+    const accounts = lock_manager.LockTarget.forTable(lock_manager.tableId("accounts"));
+
+    var read = try session.execute("SELECT * FROM accounts");
+    defer read.deinit();
+    try testing.expectEqual(@as(usize, 1), read.row_count);
+    try testing.expectEqual(lock_manager.LockMode.S, db.txn_manager.locks.heldMode(txn_id, accounts).?);
+
+    // A write after a read in the same transaction upgrades S + IX to X
+    _ = try session.execute("INSERT INTO accounts VALUES (2, 50)");
+    try testing.expectEqual(lock_manager.LockMode.X, db.txn_manager.locks.heldMode(txn_id, accounts).?);
+
+    _ = try session.execute("COMMIT");
+    try testing.expect(db.txn_manager.locks.heldMode(txn_id, accounts) == null);
+
+    // READ COMMITTED transactions lock what they write, but not what they read
+    _ = try session.execute("START TRANSACTION ISOLATION LEVEL READ COMMITTED");
+    const rc_id = session.txn.?.id;
+    var rc_read = try session.execute("SELECT * FROM accounts");
+    defer rc_read.deinit();
+    try testing.expect(db.txn_manager.locks.heldMode(rc_id, accounts) == null);
+    _ = try session.execute("DELETE FROM accounts WHERE id = 2");
+    try testing.expectEqual(lock_manager.LockMode.X, db.txn_manager.locks.heldMode(rc_id, accounts).?);
+    _ = try session.execute("ROLLBACK");
+}
+
+test "autocommit writes wait for a serializable reader's locks" {
+    const allocator = testing.allocator;
+    const Session = @import("geeqodb").session.Session;
+    const dir = "test_session_phantoms";
+    std.fs.cwd().deleteTree(dir) catch {};
+    defer std.fs.cwd().deleteTree(dir) catch {};
+
+    const db = try database.init(allocator, dir);
+    defer db.deinit();
+    _ = try db.execute("CREATE TABLE orders (id INT, amount INT)");
+    _ = try db.execute("INSERT INTO orders VALUES (1, 10), (2, 20)");
+
+    var session = Session.init(allocator, db);
+    defer session.deinit();
+    _ = try session.execute("BEGIN ISOLATION LEVEL SERIALIZABLE");
+    var first = try session.execute("SELECT * FROM orders");
+    defer first.deinit();
+    try testing.expectEqual(@as(usize, 2), first.row_count);
+
+    // The insert needs IX on the table, so it waits for the reader's S lock
+    const Writer = struct {
+        fn run(d: *OLAPDatabase, done: *std.atomic.Value(bool)) void {
+            var result_set = d.execute("INSERT INTO orders VALUES (3, 30)") catch return;
+            result_set.deinit();
+            done.store(true, .release);
+        }
+    };
+    var inserted = std.atomic.Value(bool).init(false);
+    const writer = try std.Thread.spawn(.{}, Writer.run, .{ db, &inserted });
+    std.time.sleep(50 * std.time.ns_per_ms);
+
+    // A repeated read sees no phantom
+    var second = try session.execute("SELECT * FROM orders");
+    defer second.deinit();
+    try testing.expectEqual(@as(usize, 2), second.row_count);
+    try testing.expect(!inserted.load(.acquire));
+
+    _ = try session.execute("COMMIT");
+    writer.join();
+    try testing.expect(inserted.load(.acquire));
+    var after = try db.execute("SELECT * FROM orders");
+    defer after.deinit();
+    try testing.expectEqual(@as(usize, 3), after.row_count);
+}
+
+test "concurrent readers never see a partly applied insert" {
+    const allocator = testing.allocator;
+    const dir = "test_concurrent_queries";
+    std.fs.cwd().deleteTree(dir) catch {};
+    defer std.fs.cwd().deleteTree(dir) catch {};
+
+    const db = try database.init(allocator, dir);
+    defer db.deinit();
+    _ = try db.execute("CREATE TABLE ticks (id INT, source TEXT)");
+
+    const insert_count = 50;
+    // Expectations inside threads only log, so failures are counted here and
+    // asserted after join(). The writer's done flag bounds the readers' loop
+    // even when it stops early.
+    const Shared = struct {
+        db: *database.OLAPDatabase,
+        failures: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+        writer_done: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+        fn write(self: *@This()) void {
+            defer self.writer_done.store(true, .release);
+            var buf: [160]u8 = undefined;
+            for (0..insert_count) |i| {
+                const query = std.fmt.bufPrint(&buf, "INSERT INTO ticks VALUES ({d}, 'a'), ({d}, 'b'), ({d}, 'c'), ({d}, 'd')", .{ i, i, i, i }) catch unreachable;
+                var result_set = self.db.execute(query) catch {
+                    _ = self.failures.fetchAdd(1, .monotonic);
+                    return;
+                };
+                result_set.deinit();
+            }
+        }
+
+        fn read(self: *@This()) void {
+            var last_seen: usize = 0;
+            while (true) {
+                // Read the flag first so the last pass sees every committed insert
+                const writer_done = self.writer_done.load(.acquire);
+                var result_set = self.db.execute("SELECT * FROM ticks") catch {
+                    _ = self.failures.fetchAdd(1, .monotonic);
+                    return;
+                };
+                defer result_set.deinit();
+                // Each INSERT commits four rows at one timestamp, and rows never disappear
+                if (result_set.row_count % 4 != 0 or result_set.row_count < last_seen) {
+                    _ = self.failures.fetchAdd(1, .monotonic);
+                }
+                last_seen = result_set.row_count;
+                if (writer_done or last_seen >= insert_count * 4) return;
+            }
+        }
+    };
+
+    var shared = Shared{ .db = db };
+    var threads: [4]std.Thread = undefined;
+    threads[0] = try std.Thread.spawn(.{}, Shared.write, .{&shared});
+    for (threads[1..]) |*thread| thread.* = try std.Thread.spawn(.{}, Shared.read, .{&shared});
+    for (threads) |thread| thread.join();
+    try testing.expectEqual(@as(u32, 0), shared.failures.load(.acquire));
+
+    var final = try db.execute("SELECT * FROM ticks");
+    defer final.deinit();
+    try testing.expectEqual(@as(usize, insert_count * 4), final.row_count);
+}
+
 test "Table schemas are restored after backup/recovery" {
     const allocator = std.testing.allocator;
 
@@ -318,3 +905,171 @@ test "Table schemas are restored after backup/recovery" {
         }
     }.callback);
 }
+
+test "cursors fetch in batches and stop scanning at the LIMIT" {
+    const allocator = testing.allocator;
+
+    std.fs.cwd().deleteTree("test_cursor") catch {};
+    defer std.fs.cwd().deleteTree("test_cursor") catch {};
+
+    const db = try database.init(allocator, "test_cursor");
+    defer db.deinit();
+    const schema = try createLogs(db, 1000);
+
+    // 100 warnings come back 64 at a time; a short batch ends the cursor
+    {
+        const cursor = try db.db_context.openCursor("SELECT * FROM logs WHERE level = 'warn'", null);
+        defer cursor.close();
+        try testing.expectEqualStrings("level", cursor.header.columns[1].name);
+
+        var first = try cursor.fetch(64);
+        defer first.deinit();
+        try testing.expectEqual(@as(usize, 64), first.row_count);
+        try testing.expectEqual(@as(i64, 630), first.getValue(63, 0).integer);
+
+        var second = try cursor.fetch(64);
+        defer second.deinit();
+        try testing.expectEqual(@as(usize, 36), second.row_count);
+        try testing.expectEqual(@as(i64, 990), second.getValue(35, 0).integer);
+    }
+
+    // LIMIT 10 is met inside the first segment. The rest are released
+    // without being filtered, while the rows already fetched stay readable.
+    {
+        const cursor = try db.db_context.openCursor("SELECT * FROM logs LIMIT 10", null);
+        defer cursor.close();
+        try testing.expectEqual(@as(usize, 2), schema.segments.items[2].refs.load(.monotonic));
+
+        var first = try cursor.fetch(4);
+        defer first.deinit();
+        var second = try cursor.fetch(100);
+        defer second.deinit();
+        try testing.expectEqual(@as(usize, 6), second.row_count);
+        try testing.expectEqual(@as(i64, 9), second.getValue(5, 0).integer);
+        try testing.expect(cursor.source == null);
+        try testing.expectEqual(@as(usize, 1), schema.segments.items[2].refs.load(.monotonic));
+
+        var done = try cursor.fetch(100);
+        defer done.deinit();
+        try testing.expectEqual(@as(usize, 0), done.row_count);
+    }
+
+    // Executed without a cursor, LIMIT runs the same way
+    var limited = try db.execute("SELECT * FROM logs WHERE level = 'info' LIMIT 300");
+    defer limited.deinit();
+    try testing.expectEqual(@as(usize, 300), limited.row_count);
+    try testing.expectEqual(@as(i64, 333), limited.getValue(299, 0).integer);
+
+    var explained = try db.execute("EXPLAIN SELECT * FROM logs LIMIT 5");
+    defer explained.deinit();
+    try testing.expect(std.mem.startsWith(u8, explained.getValue(0, 0).text, "Limit 5"));
+}
+
+test "ORDER BY with a LIMIT keeps only the first rows" {
+    const allocator = testing.allocator;
+    const planner = @import("geeqodb").query.planner;
+    const QueryExecutor = @import("geeqodb").query.executor.QueryExecutor;
+
+    std.fs.cwd().deleteTree("test_top_n") catch {};
+    defer std.fs.cwd().deleteTree("test_top_n") catch {};
+
+    const db = try database.init(allocator, "test_top_n");
+    defer db.deinit();
+    _ = try createLogs(db, 1000);
+
+    var top = try db.execute("SELECT * FROM logs ORDER BY level DESC, id DESC LIMIT 5");
+    defer top.deinit();
+    try testing.expectEqual(@as(usize, 5), top.row_count);
+    for (0..5) |i| {
+        try testing.expectEqualStrings("warn", top.getValue(i, 1).text);
+        try testing.expectEqual(@as(i64, 990 - 10 * @as(i64, @intCast(i))), top.getValue(i, 0).integer);
+    }
+
+    var filtered = try db.execute("SELECT * FROM logs WHERE level = 'info' ORDER BY id LIMIT 3");
+    defer filtered.deinit();
+    try testing.expectEqual(@as(i64, 3), filtered.getValue(2, 0).integer);
+
+    // Without a LIMIT every row is sorted
+    var sorted = try db.execute("SELECT * FROM logs ORDER BY level, id DESC");
+    defer sorted.deinit();
+    try testing.expectEqual(@as(usize, 1000), sorted.row_count);
+    try testing.expectEqual(@as(i64, 999), sorted.getValue(0, 0).integer);
+    try testing.expectEqual(@as(i64, 990), sorted.getValue(900, 0).integer);
+
+    // Split across workers, the heaps merge to the same rows
+    const query_planner = try planner.QueryPlanner.init(allocator);
+    defer query_planner.deinit();
+    const ast = try query_planner.parse("SELECT * FROM logs ORDER BY level DESC, id DESC LIMIT 5");
+    defer ast.deinit();
+    const logical_plan = try query_planner.plan(ast);
+    defer logical_plan.deinit();
+    const physical_plan = try planner.optimize(query_planner, logical_plan);
+    defer physical_plan.deinit();
+    physical_plan.parallel_degree = 3;
+    var parallel = try QueryExecutor.execute(allocator, physical_plan, db.db_context);
+    defer parallel.deinit();
+    for (0..5) |i| {
+        try testing.expectEqual(top.getValue(i, 0).integer, parallel.getValue(i, 0).integer);
+    }
+
+    var explained = try db.execute("EXPLAIN SELECT * FROM logs ORDER BY level DESC, id DESC LIMIT 5");
+    defer explained.deinit();
+    try testing.expect(std.mem.startsWith(u8, explained.getValue(0, 0).text, "TopN 5 by level DESC, id DESC"));
+}
+
+test "ORDER BY over the query memory limit spills sorted runs" {
+    const allocator = testing.allocator;
+
+    std.fs.cwd().deleteTree("test_sort_spill") catch {};
+    defer std.fs.cwd().deleteTree("test_sort_spill") catch {};
+
+    const db = try database.init(allocator, "test_sort_spill");
+    defer db.deinit();
+    _ = try createLogs(db, 1000);
+    db.db_context.query_memory_limit = 8 * 1024;
+
+    {
+        const cursor = try db.db_context.openCursor("SELECT * FROM logs ORDER BY level DESC, id DESC", null);
+        defer cursor.close();
+        const sorted = &cursor.source.?.sorted;
+        try testing.expect(sorted.sorter.runs.items.len > 1);
+
+        // The warnings first, then the rest, each by id descending
+        var expected = std.ArrayList(i64).init(allocator);
+        defer expected.deinit();
+        var id: i64 = 990;
+        while (id >= 0) : (id -= 10) try expected.append(id);
+        id = 999;
+        while (id >= 0) : (id -= 1) {
+            if (@mod(id, 10) != 0) try expected.append(id);
+        }
+
+        var rows: usize = 0;
+        while (true) {
+            var batch = try cursor.fetch(128);
+            defer batch.deinit();
+            var it = batch.iterator();
+            while (it.next()) |row| : (rows += 1) {
+                try testing.expectEqual(expected.items[rows], row.get(0).integer);
+            }
+            if (batch.row_count < 128) break;
+        }
+        try testing.expectEqual(@as(usize, 1000), rows);
+    }
+
+    // The runs were deleted with the cursor
+    var spill_dir = try std.fs.cwd().openDir("test_sort_spill/spill", .{ .iterate = true });
+    defer spill_dir.close();
+    var files = spill_dir.iterate();
+    try testing.expect((try files.next()) == null);
+
+    var analyzed = try db.execute("EXPLAIN ANALYZE SELECT * FROM logs ORDER BY id");
+    defer analyzed.deinit();
+    try testing.expect(std.mem.indexOf(u8, analyzed.getValue(0, 0).text, "spilled=") != null);
+
+    // Without a spill directory the query fails instead of growing
+    const spill_dir_handle = db.db_context.spill_dir;
+    db.db_context.spill_dir = null;
+    defer db.db_context.spill_dir = spill_dir_handle;
+    try testing.expectError(error.QueryMemoryLimitExceeded, db.execute("SELECT * FROM logs ORDER BY id"));
+}
@@ -45,3 +45,81 @@ test "QueryExecutor execute with complex query" {
     // Skip this test for now since our parser doesn't support WHERE and ORDER BY clauses yet
     return;
 }
+
+test "DatabaseContext EXPLAIN prints the physical plan" {
+    const allocator = testing.allocator;
+
+    // Initialize DatabaseContext
+    const db_context = try DatabaseContext.init(allocator);
+    defer db_context.deinit();
+
+    var result_set = try db_context.executeRaw("EXPLAIN SELECT * FROM test");
+    defer result_set.deinit();
+
+    // One line for the scan plus the planning time summary
+    try testing.expectEqual(@as(usize, 1), result_set.columns.len);
+    try testing.expectEqualStrings("QUERY PLAN", result_set.columns[0].name);
+    try testing.expectEqual(@as(usize, 2), result_set.row_count);
+
+    const plan_line = result_set.getValue(0, 0).text;
+    try testing.expect(std.mem.startsWith(u8, plan_line, "TableScan on test"));
+    try testing.expect(std.mem.indexOf(u8, plan_line, "cost=") != null);
+    try testing.expect(std.mem.indexOf(u8, plan_line, "actual") == null);
+}
+
+test "DatabaseContext EXPLAIN costs plans with the calibrated weights" {
+    const allocator = testing.allocator;
+
+    const db_context = try DatabaseContext.init(allocator);
+    defer db_context.deinit();
+
+    var default_plan = try db_context.executeRaw("EXPLAIN SELECT * FROM test");
+    defer default_plan.deinit();
+
+    db_context.cost_weights.cpu_scan_cost_per_row *= 1000;
+    var calibrated_plan = try db_context.executeRaw("EXPLAIN SELECT * FROM test");
+    defer calibrated_plan.deinit();
+
+    // Same plan, different cost
+    try testing.expect(std.mem.startsWith(u8, calibrated_plan.getValue(0, 0).text, "TableScan on test"));
+    try testing.expect(!std.mem.eql(u8, default_plan.getValue(0, 0).text, calibrated_plan.getValue(0, 0).text));
+}
+
+test "DatabaseContext EXPLAIN ANALYZE annotates operators with actuals" {
+    const allocator = testing.allocator;
+
+    // Initialize DatabaseContext
+    const db_context = try DatabaseContext.init(allocator);
+    defer db_context.deinit();
+
+    var result_set = try db_context.executeRaw("EXPLAIN ANALYZE SELECT * FROM test");
+    defer result_set.deinit();
+
+    // Scan line, planning time and execution time
+    try testing.expectEqual(@as(usize, 3), result_set.row_count);
+
+    const plan_line = result_set.getValue(0, 0).text;
+    try testing.expect(std.mem.indexOf(u8, plan_line, "actual rows=1") != null);
+    try testing.expect(std.mem.indexOf(u8, plan_line, "workers=1") != null);
+    try testing.expect(std.mem.startsWith(u8, result_set.getValue(2, 0).text, "Execution time:"));
+}
+
+test "DatabaseContext plans short queries without heap allocations" {
+    var counting = @import("geeqodb").query.profile.CountingAllocator.init(testing.allocator);
+    const allocator = counting.allocator();
+
+    // Initialize DatabaseContext
+    const db_context = try DatabaseContext.init(allocator);
+    defer db_context.deinit();
+
+    counting.reset();
+
+    var result_set = try db_context.executeRaw("SELECT * FROM test");
+
+    // Only the result set itself (columns, rows, values, column name, message)
+    // is allocated from the context allocator; planning uses the query arena
+    try testing.expect(counting.allocationCount() <= 5);
+
+    result_set.deinit();
+    try testing.expectEqual(@as(u64, 0), counting.bytesLive());
+}
@@ -93,3 +93,41 @@ test "Query planner index selection" {
     try std.testing.expectEqual(AccessMethod.IndexSeek, try query_planner.findBestAccessMethod("users", "id"));
     try std.testing.expectEqual(AccessMethod.TableScan, try query_planner.findBestAccessMethod("users", "name"));
 }
+
+test "QueryPlanner finds indexes in the pinned catalog" {
+    const allocator = testing.allocator;
+    const dir = "test_planner_catalog";
+    std.fs.cwd().deleteTree(dir) catch {};
+    defer std.fs.cwd().deleteTree(dir) catch {};
+
+    const db = try geeqodb.core.init(allocator, dir);
+    defer db.deinit();
+    _ = try db.execute("CREATE TABLE users (id INT, email TEXT)");
+    try db.registerIndex("idx_users_email", "users", "email", .BTree, 1000);
+    try testing.expectError(error.ColumnNotFound, db.registerIndex("idx_users_name", "users", "name", .BTree, null));
+
+    var query_planner = try QueryPlanner.init(allocator);
+    defer query_planner.deinit();
+    const version = db.table_schemas.acquire();
+    defer db.table_schemas.release(version);
+    query_planner.catalog = version;
+
+    const indexes = try query_planner.findIndexesForColumn("users", "email");
+    defer allocator.free(indexes);
+    try testing.expectEqual(@as(usize, 1), indexes.len);
+    try testing.expectEqual(AccessMethod.IndexSeek, try query_planner.findBestAccessMethod("users", "email"));
+    try testing.expectEqual(AccessMethod.TableScan, try query_planner.findBestAccessMethod("users", "id"));
+
+    // Registered with both the planner and the catalog, listed once
+    try query_planner.addIndex("users", "email", .BTree);
+    const merged = try query_planner.findIndexesForColumn("users", "email");
+    defer allocator.free(merged);
+    try testing.expectEqual(@as(usize, 1), merged.len);
+
+    // Too few distinct values for a seek to pay off
+    try db.table_schemas.setColumnStatistics("users", "email", 3);
+    const updated = db.table_schemas.acquire();
+    defer db.table_schemas.release(updated);
+    query_planner.catalog = updated;
+    try testing.expectEqual(AccessMethod.TableScan, try query_planner.findBestAccessMethod("users", "email"));
+}
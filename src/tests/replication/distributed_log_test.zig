@@ -6,6 +6,7 @@ const Simulation = @import("../../simulation/simulation.zig").Simulation;
 const distributed_wal = @import("../../storage/distributed_wal.zig");
 const DistributedWAL = distributed_wal.DistributedWAL;
 const PrepareOK = distributed_wal.PrepareOK;
+const ReadRouter = @import("../../storage/read_router.zig").ReadRouter;
 const replica_management = @import("../../simulation/scenarios/replica_management.zig");
 const ReplicaState = replica_management.ReplicaState;
 const ReplicaRegistry = replica_management.ReplicaRegistry;
@@ -272,3 +273,214 @@ test "DistributedWAL view change support" {
     try testing.expectEqual(@as(u64, 4), backup1_wal.commit_point);
     try testing.expectEqual(@as(u64, 4), backup2_wal.commit_point);
 }
+
+test "DistributedWAL batches PREPAREs and replicates large payloads" {
+    const allocator = testing.allocator;
+
+    var simulation = try Simulation.init(allocator, 42);
+    defer {
+        while (simulation.scheduler.tasks.items.len > 0) {
+            _ = simulation.scheduler.tasks.pop();
+        }
+        simulation.deinit();
+    }
+
+    var registry = try ReplicaRegistry.init(allocator);
+    defer registry.deinit();
+    try registry.registerReplica("node1", .PRIMARY);
+    try registry.registerReplica("node2", .BACKUP);
+    try registry.registerReplica("node3", .BACKUP);
+
+    var primary_wal = try DistributedWAL.init(allocator, simulation, "node1", registry, "test_data_batch_primary");
+    defer primary_wal.deinit();
+    var backup1_wal = try DistributedWAL.init(allocator, simulation, "node2", registry, "test_data_batch_backup1");
+    defer backup1_wal.deinit();
+    var backup2_wal = try DistributedWAL.init(allocator, simulation, "node3", registry, "test_data_batch_backup2");
+    defer backup2_wal.deinit();
+
+    try simulation.registerNode("node1", messageHandlerNoReturn, primary_wal);
+    try simulation.registerNode("node2", messageHandlerNoReturn, backup1_wal);
+    try simulation.registerNode("node3", messageHandlerNoReturn, backup2_wal);
+
+    // Larger than the old 4KB message buffer
+    const large = try allocator.alloc(u8, 16 * 1024);
+    defer allocator.free(large);
+    @memset(large, 'v');
+
+    primary_wal.max_batch_delay = 10;
+    try primary_wal.logTransaction(1, "txn1");
+    try primary_wal.logTransaction(2, large);
+    try primary_wal.logTransaction(3, "txn3");
+    try primary_wal.logTransaction(4, "txn4");
+    try testing.expectEqual(@as(u64, 0), primary_wal.messages_sent);
+
+    try simulation.run(100);
+
+    try testing.expectEqualSlices(u8, large, backup1_wal.received_operations.get(2).?);
+    try testing.expect(backup2_wal.hasReceivedOperation(4));
+    try testing.expectEqual(@as(u64, 4), primary_wal.commit_point);
+    try testing.expectEqual(@as(u64, 4), backup1_wal.commit_point);
+    // One PREPARE and one COMMIT per backup for all four operations
+    try testing.expectEqual(@as(u64, 4), primary_wal.messages_sent);
+    try testing.expectEqual(@as(u64, 1), backup1_wal.messages_sent);
+
+    // A full batch goes out without waiting for the delay
+    primary_wal.max_batch_bytes = large.len;
+    try primary_wal.logTransaction(5, large);
+    try testing.expectEqual(@as(u64, 6), primary_wal.messages_sent);
+}
+
+test "DistributedWAL pipelines PREPAREs within the in-flight window" {
+    const allocator = testing.allocator;
+
+    var simulation = try Simulation.init(allocator, 7);
+    defer {
+        while (simulation.scheduler.tasks.items.len > 0) {
+            _ = simulation.scheduler.tasks.pop();
+        }
+        simulation.deinit();
+    }
+
+    var registry = try ReplicaRegistry.init(allocator);
+    defer registry.deinit();
+    try registry.registerReplica("node1", .PRIMARY);
+    try registry.registerReplica("node2", .BACKUP);
+    try registry.registerReplica("node3", .BACKUP);
+
+    var primary_wal = try DistributedWAL.init(allocator, simulation, "node1", registry, "test_data_pipeline_primary");
+    defer primary_wal.deinit();
+    var backup1_wal = try DistributedWAL.init(allocator, simulation, "node2", registry, "test_data_pipeline_backup1");
+    defer backup1_wal.deinit();
+    var backup2_wal = try DistributedWAL.init(allocator, simulation, "node3", registry, "test_data_pipeline_backup2");
+    defer backup2_wal.deinit();
+
+    try simulation.registerNode("node1", messageHandlerNoReturn, primary_wal);
+    try simulation.registerNode("node2", messageHandlerNoReturn, backup1_wal);
+    try simulation.registerNode("node3", messageHandlerNoReturn, backup2_wal);
+
+    // A slow network that reorders messages
+    simulation.setNetworkMessageDelay(20, 30);
+    primary_wal.max_batch_delay = 0;
+    primary_wal.max_in_flight = 8;
+
+    var op: u64 = 1;
+    while (op <= 40) : (op += 1) {
+        try primary_wal.logTransaction(op, "txn");
+    }
+    // Only a window's worth of PREPAREs is outstanding per backup
+    try testing.expectEqual(@as(u64, 16), primary_wal.messages_sent);
+
+    try simulation.run(simulation.getCurrentTime() + 2000);
+
+    try testing.expectEqual(@as(u64, 40), primary_wal.commit_point);
+    try testing.expectEqual(@as(u64, 40), backup1_wal.last_prepared_op);
+    try testing.expectEqual(@as(u64, 40), backup2_wal.commit_point);
+    // Every backup acknowledged everything, so nothing is kept for resending
+    try testing.expectEqual(@as(usize, 0), primary_wal.log.items.len);
+
+    // Lost PREPAREs and PREPARE_OKs are resent after the retransmit timeout
+    simulation.setNetworkMessageLossProbability(0.3);
+    while (op <= 80) : (op += 1) {
+        try primary_wal.logTransaction(op, "txn");
+    }
+    try simulation.run(simulation.getCurrentTime() + 20_000);
+
+    try testing.expectEqual(@as(u64, 80), primary_wal.commit_point);
+    try testing.expectEqual(@as(u64, 80), backup1_wal.last_prepared_op);
+    try testing.expectEqual(@as(u64, 80), backup2_wal.last_prepared_op);
+    try testing.expect(backup2_wal.hasReceivedOperation(57));
+}
+
+fn countApplied(context: ?*anyopaque, op_number: u64, data: []const u8) anyerror!void {
+    const applied: *std.ArrayList(u64) = @ptrCast(@alignCast(context.?));
+    _ = data;
+    try applied.append(op_number);
+}
+
+test "ReadRouter sends reads to backups that are fresh enough" {
+    const allocator = testing.allocator;
+
+    var simulation = try Simulation.init(allocator, 42);
+    defer {
+        while (simulation.scheduler.tasks.items.len > 0) {
+            _ = simulation.scheduler.tasks.pop();
+        }
+        simulation.deinit();
+    }
+
+    var registry = try ReplicaRegistry.init(allocator);
+    defer registry.deinit();
+    try registry.registerReplica("node1", .PRIMARY);
+    try registry.registerReplica("node2", .BACKUP);
+    try registry.registerReplica("node3", .BACKUP);
+    try registry.registerReplica("node4", .BACKUP);
+
+    var primary_wal = try DistributedWAL.init(allocator, simulation, "node1", registry, "test_data_reads_primary");
+    defer primary_wal.deinit();
+    var backup1_wal = try DistributedWAL.init(allocator, simulation, "node2", registry, "test_data_reads_backup1");
+    defer backup1_wal.deinit();
+    var backup2_wal = try DistributedWAL.init(allocator, simulation, "node3", registry, "test_data_reads_backup2");
+    defer backup2_wal.deinit();
+    var backup3_wal = try DistributedWAL.init(allocator, simulation, "node4", registry, "test_data_reads_backup3");
+    defer backup3_wal.deinit();
+
+    try simulation.registerNode("node1", messageHandlerNoReturn, primary_wal);
+    try simulation.registerNode("node2", messageHandlerNoReturn, backup1_wal);
+    try simulation.registerNode("node3", messageHandlerNoReturn, backup2_wal);
+    try simulation.registerNode("node4", messageHandlerNoReturn, backup3_wal);
+
+    var applied = std.ArrayList(u64).init(allocator);
+    defer applied.deinit();
+    backup1_wal.apply_fn = countApplied;
+    backup1_wal.apply_context = &applied;
+
+    var router = ReadRouter.init(allocator);
+    defer router.deinit();
+    for ([_]*DistributedWAL{ primary_wal, backup1_wal, backup2_wal, backup3_wal }) |replica| {
+        try router.addReplica(replica);
+    }
+
+    try primary_wal.setHeartbeatInterval(5);
+    try primary_wal.logTransaction(1, "txn1");
+    try primary_wal.logTransaction(2, "txn2");
+    try primary_wal.logTransaction(3, "txn3");
+    try simulation.run(simulation.getCurrentTime() + 100);
+
+    // Every backup is current, so reads take turns among them
+    const read_your_writes = distributed_wal.ReadRequirement{ .min_commit_point = 3 };
+    const first = try router.route(read_your_writes);
+    const second = try router.route(read_your_writes);
+    try testing.expect(first != primary_wal and second != primary_wal and first != second);
+    try testing.expectEqualSlices(u64, &.{ 1, 2, 3 }, applied.items);
+
+    // Cut node4 off; the other two backups still form a quorum
+    try simulation.createPartition(&.{ "node1", "node2", "node3" }, &.{"node4"});
+    try primary_wal.logTransaction(4, "txn4");
+    try primary_wal.logTransaction(5, "txn5");
+    try simulation.run(simulation.getCurrentTime() + 100);
+    try testing.expectEqual(@as(u64, 5), primary_wal.commit_point);
+    try testing.expectEqual(@as(u64, 3), backup3_wal.applied_op);
+
+    const bounds = [_]distributed_wal.ReadRequirement{
+        .{ .min_commit_point = 5 },
+        .{ .max_staleness = 20 },
+    };
+    for (bounds) |bound| {
+        for (0..6) |_| {
+            try testing.expect(try router.route(bound) != backup3_wal);
+        }
+    }
+    // node4 cannot know how far behind it is, but it knows how long ago it was current
+    try testing.expect(backup3_wal.canServeRead(.{ .max_lag_ops = 0 }));
+    try testing.expect(!backup3_wal.canServeRead(.{ .max_staleness = 20 }));
+    try testing.expectEqual(@as(u64, 0), router.primary_reads);
+
+    // Nobody has applied a commit point that does not exist yet
+    try testing.expectError(error.NoReplicaAvailable, router.route(.{ .min_commit_point = 100 }));
+
+    // After the partition heals, node4 catches up and serves reads again
+    simulation.healPartitions();
+    try primary_wal.logTransaction(6, "txn6");
+    try simulation.run(simulation.getCurrentTime() + 200);
+    try testing.expect(backup3_wal.canServeRead(.{ .min_commit_point = 6, .max_staleness = 20 }));
+}
@@ -646,3 +646,140 @@ test "VRNode multiple operations" {
         try testing.expectEqual(@as(u64, 5), node.commit_number);
     }
 }
+
+test "VRNode state transfer sends the log suffix or a chunked checkpoint" {
+    var gpa = std.heap.GeneralPurposeAllocator(.{ .enable_memory_limit = true }){};
+    defer {
+        const leaked = gpa.deinit();
+        if (leaked == .leak) {
+            std.debug.print("Memory leak detected!\n", .{});
+        }
+    }
+    const allocator = gpa.allocator();
+
+    var simulation = try Simulation.init(allocator, 42);
+    defer {
+        while (simulation.scheduler.tasks.items.len > 0) {
+            _ = simulation.scheduler.tasks.pop();
+        }
+        simulation.deinit();
+    }
+
+    var node1 = try VRNode.init(allocator, simulation, "node1", &[_][]const u8{ "node2", "node3" });
+    defer node1.deinit();
+    var node2 = try VRNode.init(allocator, simulation, "node2", &[_][]const u8{ "node1", "node3" });
+    defer node2.deinit();
+    var node3 = try VRNode.init(allocator, simulation, "node3", &[_][]const u8{ "node1", "node2" });
+    defer node3.deinit();
+
+    // No view changes while node3 is away
+    for ([_]*VRNode{ node1, node2, node3 }) |node| {
+        node.view_change_timeout = 10_000;
+        node.is_primary = false;
+        node.view_number = 1;
+    }
+    node1.is_primary = true;
+
+    var key_buffer: [16]u8 = undefined;
+    var value_buffer: [16]u8 = undefined;
+
+    // A short outage is caught up from the log alone
+    node3.stop();
+    var request: u64 = 1;
+    while (request <= 3) : (request += 1) {
+        const key = try std.fmt.bufPrint(&key_buffer, "k{d}", .{request});
+        const value = try std.fmt.bufPrint(&value_buffer, "v{d}", .{request});
+        try node1.processRequest("client1", request, .{ .Put = .{ .key = key, .value = value } });
+    }
+    try simulation.run(simulation.getCurrentTime() + 100);
+
+    node3.active = true;
+    try node3.requestStateTransfer("node1");
+    try simulation.run(simulation.getCurrentTime() + 100);
+
+    try testing.expect(!node3.state_transfer_in_progress);
+    try testing.expectEqual(@as(u64, 3), node3.op_number);
+    try testing.expectEqualStrings("v2", node3.state.get("k2").?);
+    try testing.expectEqual(@as(usize, 0), node1.checkpoints.items.len);
+
+    // A long one gets a checkpoint, streamed in small chunks over a lossy network
+    node3.stop();
+    while (request <= 23) : (request += 1) {
+        const key = try std.fmt.bufPrint(&key_buffer, "k{d}", .{request});
+        const value = try std.fmt.bufPrint(&value_buffer, "v{d}", .{request});
+        try node1.processRequest("client1", request, .{ .Put = .{ .key = key, .value = value } });
+    }
+    try simulation.run(simulation.getCurrentTime() + 100);
+
+    node1.state_transfer_suffix_limit = 4;
+    node1.state_transfer_chunk_bytes = 16;
+    simulation.setNetworkMessageLossProbability(0.3);
+    node3.active = true;
+    node3.recovery_mode = true;
+    try node3.requestStateTransfer("node1");
+    try simulation.run(simulation.getCurrentTime() + 5000);
+
+    try testing.expect(!node3.state_transfer_in_progress);
+    try testing.expect(!node3.recovery_mode);
+    try testing.expectEqual(@as(u64, 23), node1.checkpoints.items[0].op_number);
+    try testing.expectEqual(node1.op_number, node3.op_number);
+    try testing.expectEqual(node1.state.count(), node3.state.count());
+    try testing.expectEqualStrings("v17", node3.state.get("k17").?);
+
+    // Writes made while the checkpoint is built and streamed stay out of it,
+    // and the receiver then takes their suffix even past the limit
+    node3.stop();
+    simulation.setNetworkMessageLossProbability(0);
+    while (request <= 40) : (request += 1) {
+        const key = try std.fmt.bufPrint(&key_buffer, "k{d}", .{request});
+        const value = try std.fmt.bufPrint(&value_buffer, "v{d}", .{request});
+        try node1.processRequest("client1", request, .{ .Put = .{ .key = key, .value = value } });
+    }
+    try simulation.run(simulation.getCurrentTime() + 100);
+
+    node1.checkpoint_build_entries = 4;
+    node3.active = true;
+    node3.recovery_mode = true;
+    try node3.requestStateTransfer("node1");
+    while (request <= 80) : (request += 1) {
+        const key = try std.fmt.bufPrint(&key_buffer, "k{d}", .{request % 50});
+        const value = try std.fmt.bufPrint(&value_buffer, "w{d}", .{request});
+        const command: VRNode.Command = if (request % 7 == 0)
+            .{ .Delete = .{ .key = key } }
+        else
+            .{ .Put = .{ .key = key, .value = value } };
+        try node1.processRequest("client1", request, command);
+        try simulation.run(simulation.getCurrentTime() + 5);
+    }
+    try simulation.run(simulation.getCurrentTime() + 1000);
+
+    try testing.expect(!node3.state_transfer_in_progress);
+    try testing.expect(node1.checkpoint_build == null);
+    try testing.expectEqual(node1.op_number, node3.op_number);
+
+    // One checkpoint was built for the transfer and it was never restarted
+    var built: ?VRNode.Checkpoint = null;
+    for (node1.checkpoints.items) |checkpoint| {
+        if (checkpoint.op_number < 40) continue;
+        try testing.expect(built == null);
+        built = checkpoint;
+    }
+
+    // It holds the state as of its op_number, not the writes made while it was copied
+    var expected_arena = std.heap.ArenaAllocator.init(allocator);
+    defer expected_arena.deinit();
+    var expected = std.StringHashMap([]const u8).init(expected_arena.allocator());
+    const built_op: usize = @intCast(built.?.op_number);
+    for (1..built_op + 1) |op| {
+        const key = try std.fmt.allocPrint(expected_arena.allocator(), "k{d}", .{if (op <= 40) op else op % 50});
+        if (op > 40 and op % 7 == 0) {
+            _ = expected.remove(key);
+        } else {
+            try expected.put(key, try std.fmt.allocPrint(expected_arena.allocator(), "{s}{d}", .{ if (op <= 40) "v" else "w", op }));
+        }
+    }
+    try testing.expectEqual(@as(usize, expected.count()), built.?.entries.len);
+    for (built.?.entries) |entry| {
+        try testing.expectEqualStrings(expected.get(entry.key).?, entry.value);
+    }
+}
@@ -15,7 +15,7 @@ test "TransactionManager initialization" {
 
     // Verify that TransactionManager was initialized correctly
     try testing.expectEqual(allocator, txn_manager.allocator);
-    try testing.expectEqual(@as(u64, 1), txn_manager.next_txn_id);
+    try testing.expectEqual(@as(u64, 1), txn_manager.nextTxnId());
     try testing.expectEqual(@as(usize, 0), txn_manager.active_txns.count());
 }
 
@@ -40,7 +40,7 @@ test "TransactionManager begin transaction" {
     try testing.expectEqual(txn, txn_manager.active_txns.get(1).?);
 
     // Verify that the next transaction ID was incremented
-    try testing.expectEqual(@as(u64, 2), txn_manager.next_txn_id);
+    try testing.expectEqual(@as(u64, 2), txn_manager.nextTxnId());
 
     // Commit the transaction to clean up
     try txn_manager.commitTransaction(txn);
@@ -0,0 +1,251 @@
+const std = @import("std");
+const harness = @import("harness");
+
+/// Benchmarks are matched across runs by suite, name and parameters
+const Key = struct {
+    suite: []const u8,
+    name: []const u8,
+    params: []const u8,
+};
+
+const Verdict = enum {
+    unchanged,
+    improved,
+    regressed,
+
+    fn label(self: Verdict) []const u8 {
+        return switch (self) {
+            .unchanged => "",
+            .improved => "improved",
+            .regressed => "REGRESSED",
+        };
+    }
+};
+
+pub fn main() !void {
+    // Initialize allocator
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    var arena = std.heap.ArenaAllocator.init(gpa.allocator());
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // Parse command-line arguments
+    const args = try std.process.argsAlloc(allocator);
+    var paths = std.ArrayList([]const u8).init(allocator);
+    var threshold_percent: f64 = 5.0;
+    var alpha: f64 = 0.05;
+    var all_hot = false;
+    var allow_missing = false;
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "--threshold") or std.mem.eql(u8, arg, "--alpha")) {
+            i += 1;
+            if (i >= args.len) {
+                std.debug.print("Error: Missing value for {s}\n", .{arg});
+                return error.InvalidArguments;
+            }
+            const value = std.fmt.parseFloat(f64, args[i]) catch {
+                std.debug.print("Error: Invalid value for {s}: {s}\n", .{ arg, args[i] });
+                return error.InvalidArguments;
+            };
+            if (std.mem.eql(u8, arg, "--threshold")) threshold_percent = value else alpha = value;
+        } else if (std.mem.eql(u8, arg, "--all")) {
+            all_hot = true;
+        } else if (std.mem.eql(u8, arg, "--allow-missing")) {
+            allow_missing = true;
+        } else if (std.mem.eql(u8, arg, "--help")) {
+            printUsage();
+            return;
+        } else {
+            try paths.append(arg);
+        }
+    }
+
+    if (paths.items.len == 0) {
+        try findLatestSummaries(allocator, "benchmark_results", &paths);
+    }
+    if (paths.items.len != 2) {
+        printUsage();
+        return error.InvalidArguments;
+    }
+
+    const baseline = try loadResults(allocator, paths.items[0]);
+    const candidate = try loadResults(allocator, paths.items[1]);
+
+    const stdout = std.io.getStdOut().writer();
+    try stdout.print("Baseline:  {s}\nCandidate: {s}\n", .{ paths.items[0], paths.items[1] });
+    try warnIfHostsDiffer(stdout, baseline, candidate);
+    try stdout.print("Significance p < {d}, hot-path regression threshold {d:.1}%\n\n", .{ alpha, threshold_percent });
+    try stdout.print("{s:<48} {s:>12} {s:>12} {s:>9} {s:>8}\n", .{ "benchmark", "baseline", "candidate", "change", "p" });
+
+    var regressions: usize = 0;
+    var improvements: usize = 0;
+    var failures: usize = 0;
+    var missing: usize = 0;
+    var missing_hot: usize = 0;
+    for (baseline.suites) |base_report| {
+        for (base_report.benchmarks) |base| {
+            const key = Key{ .suite = base_report.suite, .name = base.name, .params = base.params };
+            const label = try std.fmt.allocPrint(allocator, "{s}/{s}{s}{s}", .{
+                key.suite,
+                key.name,
+                if (key.params.len > 0) " " else "",
+                key.params,
+            });
+            // A hot-path benchmark the candidate did not produce, say because
+            // its suite crashed, is not a pass
+            const cand = find(candidate, key) orelse {
+                const hot = all_hot or base.hot_path;
+                missing += 1;
+                if (hot) missing_hot += 1;
+                try stdout.print("{s:<48} {s:>12} {s}\n", .{ label, "missing", if (hot) "(hot path)" else "" });
+                continue;
+            };
+
+            const base_median = median(allocator, base.trial_ns_per_op);
+            const cand_median = median(allocator, cand.trial_ns_per_op);
+            const change = if (base_median > 0) (cand_median - base_median) / base_median * 100.0 else 0;
+            const test_result = try harness.mannWhitney(allocator, cand.trial_ns_per_op, base.trial_ns_per_op);
+
+            // Significant shifts are reported either way; only a hot-path one
+            // beyond the threshold fails the comparison
+            const verdict: Verdict = if (test_result.p_value >= alpha or change == 0)
+                .unchanged
+            else if (change > 0) .regressed else .improved;
+            const hot = all_hot or base.hot_path or cand.hot_path;
+            const fails = verdict == .regressed and hot and change > threshold_percent;
+            switch (verdict) {
+                .unchanged => {},
+                .improved => improvements += 1,
+                .regressed => regressions += 1,
+            }
+            if (fails) failures += 1;
+
+            try stdout.print("{s:<48} {d:>10.1}ns {d:>10.1}ns {d:>8.1}% {d:>8.4} {s}{s}\n", .{
+                label,
+                base_median,
+                cand_median,
+                change,
+                test_result.p_value,
+                verdict.label(),
+                if (fails) " (hot path)" else "",
+            });
+        }
+    }
+
+    try stdout.print("\n{d} regressed, {d} improved", .{ regressions, improvements });
+    if (missing > 0) try stdout.print(", {d} missing from the candidate", .{missing});
+    try stdout.writeAll("\n");
+    for (candidate.failed) |suite| {
+        try stdout.print("Suite {s} failed in the candidate run\n", .{suite});
+    }
+
+    var failed = false;
+    if (failures > 0) {
+        try stdout.print("{d} hot-path benchmark(s) regressed by more than {d:.1}%\n", .{ failures, threshold_percent });
+        failed = true;
+    }
+    if (!allow_missing and (candidate.failed.len > 0 or missing_hot > 0)) {
+        try stdout.print("{d} failed suite(s) and {d} missing hot-path benchmark(s) in the candidate (--allow-missing to accept)\n", .{ candidate.failed.len, missing_hot });
+        failed = true;
+    }
+    if (failed) std.process.exit(1);
+}
+
+/// Load a run_benchmarks summary, or a single suite's report as a summary of one
+fn loadResults(allocator: std.mem.Allocator, path: []const u8) !harness.Summary {
+    const json = std.fs.cwd().readFileAlloc(allocator, path, 256 * 1024 * 1024) catch |err| {
+        std.debug.print("Error: Cannot read {s}: {}\n", .{ path, err });
+        return err;
+    };
+    const options = std.json.ParseOptions{ .ignore_unknown_fields = true };
+    if (std.json.parseFromSliceLeaky(harness.Summary, allocator, json, options)) |summary| {
+        return summary;
+    } else |_| {}
+    const report = std.json.parseFromSliceLeaky(harness.Report, allocator, json, options) catch |err| {
+        std.debug.print("Error: {s} is neither a benchmark summary nor a suite report: {}\n", .{ path, err });
+        return err;
+    };
+    const suites = try allocator.alloc(harness.Report, 1);
+    suites[0] = report;
+    return harness.Summary{ .timestamp = report.timestamp, .suites = suites };
+}
+
+/// Append the two newest benchmark_summary_<ts>.json files in `dir_path`, oldest first
+fn findLatestSummaries(allocator: std.mem.Allocator, dir_path: []const u8, paths: *std.ArrayList([]const u8)) !void {
+    var dir = std.fs.cwd().openDir(dir_path, .{ .iterate = true }) catch return;
+    defer dir.close();
+
+    const prefix = "benchmark_summary_";
+    var newest = [2]?struct { timestamp: i64, name: []const u8 }{ null, null };
+    var it = dir.iterate();
+    while (try it.next()) |entry| {
+        if (entry.kind != .file or !std.mem.startsWith(u8, entry.name, prefix) or !std.mem.endsWith(u8, entry.name, ".json")) continue;
+        const timestamp = std.fmt.parseInt(i64, entry.name[prefix.len .. entry.name.len - ".json".len], 10) catch continue;
+        const name = try allocator.dupe(u8, entry.name);
+        if (newest[0] == null or timestamp > newest[0].?.timestamp) {
+            newest[1] = newest[0];
+            newest[0] = .{ .timestamp = timestamp, .name = name };
+        } else if (newest[1] == null or timestamp > newest[1].?.timestamp) {
+            newest[1] = .{ .timestamp = timestamp, .name = name };
+        }
+    }
+    if (newest[1] == null) return;
+    try paths.append(try std.fs.path.join(allocator, &.{ dir_path, newest[1].?.name }));
+    try paths.append(try std.fs.path.join(allocator, &.{ dir_path, newest[0].?.name }));
+}
+
+fn find(summary: harness.Summary, key: Key) ?harness.Result {
+    for (summary.suites) |report| {
+        if (!std.mem.eql(u8, report.suite, key.suite)) continue;
+        for (report.benchmarks) |result| {
+            if (std.mem.eql(u8, result.name, key.name) and std.mem.eql(u8, result.params, key.params)) return result;
+        }
+    }
+    return null;
+}
+
+fn median(allocator: std.mem.Allocator, samples: []const f64) f64 {
+    if (samples.len == 0) return 0;
+    const sorted = allocator.dupe(f64, samples) catch return samples[0];
+    std.mem.sort(f64, sorted, {}, std.sort.asc(f64));
+    const mid = sorted.len / 2;
+    return if (sorted.len % 2 == 1) sorted[mid] else (sorted[mid - 1] + sorted[mid]) / 2;
+}
+
+/// Numbers from different build modes or machines are not comparable
+fn warnIfHostsDiffer(writer: anytype, baseline: harness.Summary, candidate: harness.Summary) !void {
+    if (baseline.suites.len == 0 or candidate.suites.len == 0) return;
+    const a = baseline.suites[0];
+    const b = candidate.suites[0];
+    if (!std.mem.eql(u8, a.build_mode, b.build_mode) or !std.mem.eql(u8, a.arch, b.arch) or a.cpu_count != b.cpu_count) {
+        try writer.print("Warning: runs differ in build or host ({s} {s} {d} CPUs vs {s} {s} {d} CPUs)\n", .{
+            a.build_mode, a.arch, a.cpu_count, b.build_mode, b.arch, b.cpu_count,
+        });
+    }
+}
+
+fn printUsage() void {
+    std.debug.print(
+        \\Usage: bench_compare [options] [BASELINE CANDIDATE]
+        \\
+        \\Compares two benchmark runs: summaries written by `zig build benchmark`
+        \\or single suite reports. Without files, compares the two newest
+        \\summaries in benchmark_results/. Benchmarks are matched by suite, name
+        \\and parameters, and their trial means are compared with a Mann-Whitney
+        \\U test. Exits with status 1 if a hot-path benchmark regressed
+        \\significantly by more than the threshold, or if the candidate lists
+        \\failed suites or lacks a hot-path benchmark the baseline has.
+        \\
+        \\Options:
+        \\  --threshold <percent>  Hot-path regression that fails (default: 5)
+        \\  --alpha <p>            Significance level (default: 0.05)
+        \\  --all                  Treat every benchmark as hot path
+        \\  --allow-missing        Do not fail on failed suites or missing benchmarks
+        \\  --help                 Show this help message
+        \\
+    , .{});
+}
@@ -0,0 +1,297 @@
+const std = @import("std");
+const geeqodb = @import("geeqodb");
+const CostModel = geeqodb.query.cost_model.CostModel;
+const Weights = CostModel.Weights;
+const GpuDevice = geeqodb.gpu.GpuDevice;
+const GpuMemory = geeqodb.gpu.GpuMemory;
+
+/// Number of elements used by the array micro-benchmarks (32 MB of u64, larger than typical LLC)
+const array_len: usize = 4 * 1024 * 1024;
+
+/// Number of rows used by the hash table and sort micro-benchmarks
+const hash_rows: usize = 1024 * 1024;
+
+/// Size of the buffer used to measure memcpy and transfer bandwidth
+const copy_bytes: usize = 64 * 1024 * 1024;
+
+/// Number of repetitions per micro-benchmark; the fastest one is kept
+const repetitions: usize = 5;
+
+/// Host-to-device bandwidth is assumed to be this many times slower than
+/// host memcpy when no GPU is available to measure it directly (PCIe vs DRAM).
+const assumed_pcie_slowdown: f64 = 4.0;
+
+/// Raw measurements in nanoseconds
+const Measurements = struct {
+    seq_scan_ns_per_row: f64,
+    filter_ns_per_row: f64,
+    random_lookup_ns: f64,
+    gather_ns_per_row: f64,
+    hash_build_ns_per_row: f64,
+    hash_probe_ns_per_row: f64,
+    sort_ns_per_row_log: f64,
+    memcpy_ns_per_byte: f64,
+    gpu_transfer_ns_per_byte: ?f64,
+};
+
+pub fn main() !void {
+    // Initialize allocator
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    // Parse command-line arguments
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+
+    var output_path: []const u8 = CostModel.default_weights_path;
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "--output") or std.mem.eql(u8, arg, "-o")) {
+            i += 1;
+            if (i >= args.len) {
+                std.debug.print("Error: Missing value for --output\n", .{});
+                return error.InvalidArguments;
+            }
+            output_path = args[i];
+        } else if (std.mem.eql(u8, arg, "--help")) {
+            printUsage();
+            return;
+        }
+    }
+
+    std.debug.print("Calibrating cost model weights for this host...\n", .{});
+
+    const m = try runMeasurements(allocator);
+
+    std.debug.print("\nRaw measurements:\n", .{});
+    std.debug.print("  Sequential scan:   {d:.3} ns/row\n", .{m.seq_scan_ns_per_row});
+    std.debug.print("  Filter:            {d:.3} ns/row\n", .{m.filter_ns_per_row});
+    std.debug.print("  Random lookup:     {d:.3} ns/lookup\n", .{m.random_lookup_ns});
+    std.debug.print("  Sorted gather:     {d:.3} ns/row\n", .{m.gather_ns_per_row});
+    std.debug.print("  Hash build:        {d:.3} ns/row\n", .{m.hash_build_ns_per_row});
+    std.debug.print("  Hash probe:        {d:.3} ns/row\n", .{m.hash_probe_ns_per_row});
+    std.debug.print("  Sort:              {d:.3} ns/(row*log2 n)\n", .{m.sort_ns_per_row_log});
+    std.debug.print("  memcpy:            {d:.2} GB/s\n", .{1.0 / m.memcpy_ns_per_byte});
+    if (m.gpu_transfer_ns_per_byte) |t| {
+        std.debug.print("  Host-to-GPU copy:  {d:.2} GB/s\n", .{1.0 / t});
+    } else {
+        std.debug.print("  Host-to-GPU copy:  no GPU, assuming memcpy / {d:.1}\n", .{assumed_pcie_slowdown});
+    }
+
+    const weights = fitWeights(m);
+
+    try weights.saveToFile(output_path);
+    std.debug.print("\nCalibrated weights written to {s}\n", .{output_path});
+}
+
+/// Convert raw timings into cost weights. All CPU weights are expressed in
+/// units of one sequential scan row, which is the unit the default weights use.
+fn fitWeights(m: Measurements) Weights {
+    const unit = m.seq_scan_ns_per_row;
+    const defaults = Weights{};
+
+    var weights = Weights{};
+    weights.cpu_scan_cost_per_row = 1.0;
+    weights.cpu_filter_cost_per_row = m.filter_ns_per_row / unit;
+    weights.cpu_index_seek_cost = m.random_lookup_ns / unit;
+    weights.cpu_index_range_cost_per_row = m.gather_ns_per_row / unit;
+    weights.cpu_join_cost_per_row = (m.hash_build_ns_per_row + m.hash_probe_ns_per_row) / unit;
+    weights.cpu_aggregate_cost_per_row = m.hash_probe_ns_per_row / unit;
+    weights.cpu_sort_cost_per_row = m.sort_ns_per_row_log / unit;
+
+    const transfer_ns_per_byte = m.gpu_transfer_ns_per_byte orelse m.memcpy_ns_per_byte * assumed_pcie_slowdown;
+    weights.gpu_transfer_cost_per_byte = transfer_ns_per_byte / unit;
+
+    // GPU kernel costs cannot be measured without running kernels; keep their
+    // default ratio to the CPU scan cost so the relative CPU/GPU tradeoff is
+    // driven by the measured transfer cost.
+    weights.gpu_scan_cost_per_row = defaults.gpu_scan_cost_per_row;
+    weights.gpu_filter_cost_per_row = defaults.gpu_filter_cost_per_row;
+    weights.gpu_join_cost_per_row = defaults.gpu_join_cost_per_row;
+    weights.gpu_aggregate_cost_per_row = defaults.gpu_aggregate_cost_per_row;
+    weights.gpu_sort_cost_per_row = defaults.gpu_sort_cost_per_row;
+    weights.gpu_kernel_launch_overhead = defaults.gpu_kernel_launch_overhead;
+
+    return weights;
+}
+
+/// Run all micro-benchmarks
+fn runMeasurements(allocator: std.mem.Allocator) !Measurements {
+    var prng = std.Random.DefaultPrng.init(0x5eed);
+    const random = prng.random();
+
+    const values = try allocator.alloc(u64, array_len);
+    defer allocator.free(values);
+    for (values) |*v| v.* = random.int(u64);
+
+    // Random permutation of indices for lookups
+    const indices = try allocator.alloc(u32, array_len);
+    defer allocator.free(indices);
+    for (indices, 0..) |*idx, j| idx.* = @intCast(j);
+    random.shuffle(u32, indices);
+
+    std.debug.print("  sequential scan...\n", .{});
+    const seq_ns = try bestOf(struct {
+        fn run(vals: []const u64) void {
+            var sum: u64 = 0;
+            for (vals) |v| sum +%= v;
+            std.mem.doNotOptimizeAway(sum);
+        }
+    }.run, .{values});
+
+    std.debug.print("  filter...\n", .{});
+    const filter_ns = try bestOf(struct {
+        fn run(vals: []const u64) void {
+            var count: u64 = 0;
+            const threshold = std.math.maxInt(u64) / 3;
+            for (vals) |v| {
+                if (v < threshold) count += 1;
+            }
+            std.mem.doNotOptimizeAway(count);
+        }
+    }.run, .{values});
+
+    std.debug.print("  random lookup...\n", .{});
+    const random_ns = try bestOf(struct {
+        fn run(vals: []const u64, idxs: []const u32) void {
+            var sum: u64 = 0;
+            for (idxs) |idx| sum +%= vals[idx];
+            std.mem.doNotOptimizeAway(sum);
+        }
+    }.run, .{ values, indices });
+
+    // Sorted subset of row ids, as produced by an index range scan
+    const range_ids = try allocator.dupe(u32, indices[0 .. array_len / 4]);
+    defer allocator.free(range_ids);
+    std.mem.sort(u32, range_ids, {}, std.sort.asc(u32));
+
+    std.debug.print("  sorted gather...\n", .{});
+    const gather_ns = try bestOf(struct {
+        fn run(vals: []const u64, idxs: []const u32) void {
+            var sum: u64 = 0;
+            for (idxs) |idx| sum +%= vals[idx];
+            std.mem.doNotOptimizeAway(sum);
+        }
+    }.run, .{ values, range_ids });
+
+    std.debug.print("  hash build/probe...\n", .{});
+    var build_ns: u64 = std.math.maxInt(u64);
+    var probe_ns: u64 = std.math.maxInt(u64);
+    for (0..repetitions) |_| {
+        var map = std.AutoHashMap(u64, u64).init(allocator);
+        defer map.deinit();
+
+        var timer = try std.time.Timer.start();
+        for (values[0..hash_rows], 0..) |v, row| {
+            try map.put(v, row);
+        }
+        build_ns = @min(build_ns, timer.read());
+
+        timer.reset();
+        var hits: u64 = 0;
+        for (indices[0..hash_rows]) |idx| {
+            if (map.get(values[idx % hash_rows]) != null) hits += 1;
+        }
+        probe_ns = @min(probe_ns, timer.read());
+        std.mem.doNotOptimizeAway(hits);
+    }
+
+    std.debug.print("  sort...\n", .{});
+    const sort_buf = try allocator.alloc(u64, hash_rows);
+    defer allocator.free(sort_buf);
+    var sort_ns: u64 = std.math.maxInt(u64);
+    for (0..repetitions) |_| {
+        @memcpy(sort_buf, values[0..hash_rows]);
+        var timer = try std.time.Timer.start();
+        std.mem.sort(u64, sort_buf, {}, std.sort.asc(u64));
+        sort_ns = @min(sort_ns, timer.read());
+    }
+
+    std.debug.print("  memcpy bandwidth...\n", .{});
+    const src = try allocator.alloc(u8, copy_bytes);
+    defer allocator.free(src);
+    const dst = try allocator.alloc(u8, copy_bytes);
+    defer allocator.free(dst);
+    @memset(src, 0xAB);
+    @memset(dst, 0);
+    const memcpy_ns = try bestOf(struct {
+        fn run(d: []u8, s: []const u8) void {
+            @memcpy(d, s);
+            std.mem.doNotOptimizeAway(d[d.len - 1]);
+        }
+    }.run, .{ dst, src });
+
+    std.debug.print("  host-to-GPU transfer...\n", .{});
+    const gpu_ns = measureGpuTransfer(allocator, src) catch null;
+
+    const n: f64 = @floatFromInt(array_len);
+    const hn: f64 = @floatFromInt(hash_rows);
+    return Measurements{
+        .seq_scan_ns_per_row = @as(f64, @floatFromInt(seq_ns)) / n,
+        .filter_ns_per_row = @as(f64, @floatFromInt(filter_ns)) / n,
+        .random_lookup_ns = @as(f64, @floatFromInt(random_ns)) / n,
+        .gather_ns_per_row = @as(f64, @floatFromInt(gather_ns)) / @as(f64, @floatFromInt(range_ids.len)),
+        .hash_build_ns_per_row = @as(f64, @floatFromInt(build_ns)) / hn,
+        .hash_probe_ns_per_row = @as(f64, @floatFromInt(probe_ns)) / hn,
+        .sort_ns_per_row_log = @as(f64, @floatFromInt(sort_ns)) / (hn * std.math.log2(hn)),
+        .memcpy_ns_per_byte = @as(f64, @floatFromInt(memcpy_ns)) / @as(f64, @floatFromInt(copy_bytes)),
+        .gpu_transfer_ns_per_byte = gpu_ns,
+    };
+}
+
+/// Measure host-to-device copy bandwidth, or return null if no GPU is available
+fn measureGpuTransfer(allocator: std.mem.Allocator, data: []const u8) !?f64 {
+    const gpu_device = try GpuDevice.init(allocator);
+    defer gpu_device.deinit();
+
+    if (!gpu_device.hasGpu()) {
+        return null;
+    }
+
+    const memory = try GpuMemory.init(allocator, try gpu_device.getBestDevice());
+    defer memory.deinit();
+
+    const buffer = try memory.allocate(data.len);
+    defer memory.free(buffer);
+
+    var best: u64 = std.math.maxInt(u64);
+    for (0..repetitions) |_| {
+        var timer = try std.time.Timer.start();
+        try memory.copyToDevice(data.ptr, buffer, data.len);
+        best = @min(best, timer.read());
+    }
+
+    return @as(f64, @floatFromInt(best)) / @as(f64, @floatFromInt(data.len));
+}
+
+/// Run a micro-benchmark several times and return the fastest run in nanoseconds
+fn bestOf(comptime func: anytype, args: anytype) !u64 {
+    // Warm up caches and page tables
+    @call(.auto, func, args);
+
+    var best: u64 = std.math.maxInt(u64);
+    for (0..repetitions) |_| {
+        var timer = try std.time.Timer.start();
+        @call(.auto, func, args);
+        best = @min(best, timer.read());
+    }
+    return @max(best, 1);
+}
+
+fn printUsage() void {
+    std.debug.print(
+        \\Usage: calibrate_cost_model [options]
+        \\
+        \\Runs micro-benchmarks on this host and writes fitted cost model
+        \\weights. A database loads cost_model.json from its data directory
+        \\when it opens, so write the file into the server's data directory.
+        \\
+        \\Options:
+        \\  --output, -o <path>  Output file (default: data/cost_model.json)
+        \\  --help               Show this help message
+        \\
+    , .{});
+}
@@ -0,0 +1,408 @@
+const std = @import("std");
+const harness = @import("harness");
+const Histogram = harness.Histogram;
+
+/// Kinds of statements the load is made of, reported separately
+const QueryClass = enum {
+    point,
+    insert,
+    analytical,
+};
+
+const class_count = std.meta.fields(QueryClass).len;
+const table_name = "load_items";
+const category_count = 16;
+
+/// The server reads one statement per 4 KiB read, so seed rows are inserted in
+/// batches that stay well below that
+const rows_per_insert = 100;
+
+const Config = struct {
+    host: []const u8 = "127.0.0.1",
+    port: u16 = 5252,
+    connections: usize = 8,
+    rate: f64 = 1000, // Target operations per second over all connections; 0 runs closed-loop
+    duration_s: f64 = 10,
+    rows: u64 = 10_000,
+    setup: bool = true,
+    seed: u64 = 42,
+    mix: [class_count]u32 = .{ 80, 15, 5 },
+};
+
+/// What one connection measured
+const Stats = struct {
+    latency: [class_count]Histogram = [_]Histogram{.{}} ** class_count,
+    errors: [class_count]u64 = [_]u64{0} ** class_count,
+    max_lag_ns: u64 = 0, // How far behind schedule a send started
+    failure: ?anyerror = null,
+};
+
+pub fn main() !void {
+    // Initialize allocator
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    // Parse command-line arguments
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    var config = Config{};
+
+    var i: usize = 1;
+    while (i < args.len) : (i += 1) {
+        const arg = args[i];
+        if (std.mem.eql(u8, arg, "--help")) {
+            printUsage();
+            return;
+        } else if (std.mem.eql(u8, arg, "--no-setup")) {
+            config.setup = false;
+            continue;
+        }
+
+        i += 1;
+        if (i >= args.len) {
+            std.debug.print("Error: Missing value for {s}\n", .{arg});
+            return error.InvalidArguments;
+        }
+        const value = args[i];
+        parseOption(&config, arg, value) catch |err| {
+            if (err == error.UnknownOption) {
+                std.debug.print("Error: Unknown option {s}\n", .{arg});
+            } else {
+                std.debug.print("Error: Invalid value for {s}: {s}\n", .{ arg, value });
+            }
+            return error.InvalidArguments;
+        };
+    }
+    if (config.connections == 0 or config.rate < 0 or config.duration_s <= 0) {
+        printUsage();
+        return error.InvalidArguments;
+    }
+
+    const address = std.net.Address.resolveIp(config.host, config.port) catch |err| {
+        std.debug.print("Error: Invalid host {s}: {}\n", .{ config.host, err });
+        return err;
+    };
+    if (config.setup) try setup(allocator, address, config);
+
+    // Inserted rows continue the ids of the seed rows
+    var next_id = std.atomic.Value(u64).init(config.rows);
+    const stats = try allocator.alloc(Stats, config.connections);
+    defer allocator.free(stats);
+    @memset(stats, .{});
+    const threads = try allocator.alloc(std.Thread, config.connections);
+    defer allocator.free(threads);
+
+    if (config.rate > 0) {
+        std.debug.print("Running {d} connections at {d:.0} ops/s for {d}s (open loop, Poisson arrivals)...\n", .{ config.connections, config.rate, config.duration_s });
+    } else {
+        std.debug.print("Running {d} connections as fast as possible for {d}s (closed loop)...\n", .{ config.connections, config.duration_s });
+    }
+
+    var timer = try std.time.Timer.start();
+    for (threads, stats, 0..) |*thread, *connection_stats, index| {
+        thread.* = try std.Thread.spawn(.{}, runConnection, .{ Connection{
+            .allocator = allocator,
+            .config = &config,
+            .address = address,
+            .index = index,
+            .timer = timer,
+            .next_id = &next_id,
+            .stats = connection_stats,
+        }});
+    }
+    for (threads) |thread| thread.join();
+    const elapsed_ns = timer.read();
+
+    try report(stats, config, elapsed_ns);
+}
+
+fn parseOption(config: *Config, name: []const u8, value: []const u8) !void {
+    if (std.mem.eql(u8, name, "--host") or std.mem.eql(u8, name, "-h")) {
+        config.host = value;
+    } else if (std.mem.eql(u8, name, "--port") or std.mem.eql(u8, name, "-p")) {
+        config.port = try std.fmt.parseInt(u16, value, 10);
+    } else if (std.mem.eql(u8, name, "--connections") or std.mem.eql(u8, name, "-c")) {
+        config.connections = try std.fmt.parseInt(usize, value, 10);
+    } else if (std.mem.eql(u8, name, "--rate")) {
+        config.rate = try std.fmt.parseFloat(f64, value);
+    } else if (std.mem.eql(u8, name, "--duration")) {
+        config.duration_s = try std.fmt.parseFloat(f64, value);
+    } else if (std.mem.eql(u8, name, "--rows")) {
+        config.rows = try std.fmt.parseInt(u64, value, 10);
+    } else if (std.mem.eql(u8, name, "--seed")) {
+        config.seed = try std.fmt.parseInt(u64, value, 0);
+    } else if (std.mem.eql(u8, name, "--mix")) {
+        config.mix = try parseMix(value);
+    } else {
+        return error.UnknownOption;
+    }
+}
+
+/// Parse class weights such as "point=80,insert=15,analytical=5"; classes not
+/// named get no share of the load
+fn parseMix(text: []const u8) ![class_count]u32 {
+    var mix = [_]u32{0} ** class_count;
+    var parts = std.mem.tokenizeScalar(u8, text, ',');
+    while (parts.next()) |part| {
+        const eq = std.mem.indexOfScalar(u8, part, '=') orelse return error.InvalidMix;
+        const class = std.meta.stringToEnum(QueryClass, part[0..eq]) orelse return error.InvalidMix;
+        mix[@intFromEnum(class)] = try std.fmt.parseInt(u32, part[eq + 1 ..], 10);
+    }
+    var weight: u64 = 0;
+    for (mix) |share| weight += share;
+    if (weight == 0) return error.InvalidMix;
+    return mix;
+}
+
+/// Create the table and insert the rows that point lookups hit. If the table
+/// already exists the rows are added to it again; --no-setup reuses it as is.
+fn setup(allocator: std.mem.Allocator, address: std.net.Address, config: Config) !void {
+    const stream = std.net.tcpConnectToAddress(address) catch |err| {
+        std.debug.print("Error connecting to server: {}\n", .{err});
+        std.debug.print("Make sure the server is running at {s}:{d}\n", .{ config.host, config.port });
+        return err;
+    };
+    defer stream.close();
+
+    var response = std.ArrayList(u8).init(allocator);
+    defer response.deinit();
+    var statement = std.ArrayList(u8).init(allocator);
+    defer statement.deinit();
+
+    std.debug.print("Seeding {s} with {d} rows...\n", .{ table_name, config.rows });
+    const create = "CREATE TABLE " ++ table_name ++ " (id INTEGER, category TEXT, amount INTEGER)";
+    if (!try roundTrip(stream, create, &response)) {
+        std.debug.print("  {s}", .{response.items});
+    }
+
+    var prng = std.Random.DefaultPrng.init(config.seed);
+    const random = prng.random();
+    var id: u64 = 0;
+    while (id < config.rows) {
+        statement.clearRetainingCapacity();
+        try statement.appendSlice("INSERT INTO " ++ table_name ++ " VALUES ");
+        const end = @min(id + rows_per_insert, config.rows);
+        const batch_start = id;
+        while (id < end) : (id += 1) {
+            if (id > batch_start) try statement.appendSlice(", ");
+            try writeRow(statement.writer(), id, random);
+        }
+        if (!try roundTrip(stream, statement.items, &response)) {
+            std.debug.print("Error seeding rows: {s}", .{response.items});
+            return error.SetupFailed;
+        }
+    }
+}
+
+fn writeRow(writer: anytype, id: u64, random: std.Random) !void {
+    try writer.print("({d}, 'cat{d}', {d})", .{ id, random.uintLessThan(u32, category_count), random.uintLessThan(u32, 10_000) });
+}
+
+/// Send one statement and read its whole response; false if it failed
+fn roundTrip(stream: std.net.Stream, statement: []const u8, response: *std.ArrayList(u8)) !bool {
+    try stream.writeAll(statement);
+    response.clearRetainingCapacity();
+    while (true) {
+        try response.ensureUnusedCapacity(4096);
+        const bytes_read = try stream.read(response.unusedCapacitySlice());
+        if (bytes_read == 0) return error.ConnectionClosed;
+        response.items.len += bytes_read;
+        if (responseStatus(response.items)) |ok| return ok;
+    }
+}
+
+/// The server does not frame its responses, so a response is complete once its
+/// last line is one that ends it: a row count, an empty result, OK or an error.
+/// Returns null while more is to come.
+fn responseStatus(response: []const u8) ?bool {
+    if (response.len == 0 or response[response.len - 1] != '\n') return null;
+    const body = response[0 .. response.len - 1];
+    const line_start = if (std.mem.lastIndexOfScalar(u8, body, '\n')) |newline| newline + 1 else 0;
+    const last_line = body[line_start..];
+    if (std.mem.startsWith(u8, last_line, "ERROR: ")) return false;
+    if (std.mem.endsWith(u8, last_line, " row(s) returned")) return true;
+    if (std.mem.eql(u8, last_line, "Query executed successfully. No results.")) return true;
+    if (std.mem.eql(u8, last_line, "OK")) return true;
+    return null;
+}
+
+/// One client connection. With a target rate, sends are scheduled at Poisson
+/// arrival times independent of how fast the server answers, and latency is
+/// measured from the scheduled time. A slow response then delays the sends
+/// behind it, and that queueing counts against the server instead of quietly
+/// lowering the offered load.
+const Connection = struct {
+    allocator: std.mem.Allocator,
+    config: *const Config,
+    address: std.net.Address,
+    index: usize,
+    timer: std.time.Timer, // Started when all connections were
+    next_id: *std.atomic.Value(u64),
+    stats: *Stats,
+};
+
+fn runConnection(connection: Connection) void {
+    drive(connection) catch |err| {
+        connection.stats.failure = err;
+    };
+}
+
+fn drive(connection: Connection) !void {
+    const config = connection.config;
+    var timer = connection.timer;
+    const stream = try std.net.tcpConnectToAddress(connection.address);
+    defer stream.close();
+
+    var prng = std.Random.DefaultPrng.init(config.seed +% connection.index +% 1);
+    const random = prng.random();
+    var response = std.ArrayList(u8).init(connection.allocator);
+    defer response.deinit();
+
+    const duration_ns: u64 = @intFromFloat(config.duration_s * std.time.ns_per_s);
+    const mean_interval_ns = if (config.rate > 0)
+        @as(f64, @floatFromInt(config.connections)) / config.rate * std.time.ns_per_s
+    else
+        0;
+    var scheduled_ns: f64 = if (config.rate > 0) random.floatExp(f64) * mean_interval_ns else 0;
+
+    var statement_buffer: [256]u8 = undefined;
+    while (true) {
+        var now = timer.read();
+        if (config.rate > 0) {
+            const scheduled: u64 = @intFromFloat(scheduled_ns);
+            if (scheduled >= duration_ns) break;
+            if (now < scheduled) {
+                std.time.sleep(scheduled - now);
+                now = timer.read();
+            }
+            connection.stats.max_lag_ns = @max(connection.stats.max_lag_ns, now -| scheduled);
+        } else if (now >= duration_ns) break;
+        const start = if (config.rate > 0) @as(u64, @intFromFloat(scheduled_ns)) else now;
+
+        const class = pickClass(random, config.mix);
+        const statement = try formatStatement(&statement_buffer, class, random, config.rows, connection.next_id);
+        const ok = try roundTrip(stream, statement, &response);
+        const done = timer.read();
+
+        if (ok) {
+            connection.stats.latency[@intFromEnum(class)].record(done -| start);
+        } else {
+            connection.stats.errors[@intFromEnum(class)] += 1;
+        }
+        scheduled_ns += random.floatExp(f64) * mean_interval_ns;
+    }
+}
+
+fn pickClass(random: std.Random, mix: [class_count]u32) QueryClass {
+    var weight: u64 = 0;
+    for (mix) |share| weight += share;
+    var point = random.uintLessThan(u64, weight);
+    for (mix, 0..) |share, index| {
+        if (point < share) return @enumFromInt(index);
+        point -= share;
+    }
+    unreachable;
+}
+
+fn formatStatement(buffer: []u8, class: QueryClass, random: std.Random, rows: u64, next_id: *std.atomic.Value(u64)) ![]const u8 {
+    var stream = std.io.fixedBufferStream(buffer);
+    const writer = stream.writer();
+    switch (class) {
+        .point => try writer.print("SELECT * FROM " ++ table_name ++ " WHERE id = {d}", .{random.uintLessThan(u64, @max(rows, 1))}),
+        .insert => {
+            try writer.writeAll("INSERT INTO " ++ table_name ++ " VALUES ");
+            try writeRow(writer, next_id.fetchAdd(1, .monotonic), random);
+        },
+        // Scans of the whole table: a top-N within a category, or an amount range
+        .analytical => if (random.boolean()) {
+            try writer.print("SELECT * FROM " ++ table_name ++ " WHERE category = 'cat{d}' ORDER BY amount DESC LIMIT 10", .{random.uintLessThan(u32, category_count)});
+        } else {
+            const low = random.uintLessThan(u32, 9_500);
+            try writer.print("SELECT * FROM " ++ table_name ++ " WHERE amount BETWEEN {d} AND {d}", .{ low, low + 100 });
+        },
+    }
+    return stream.getWritten();
+}
+
+fn report(stats: []const Stats, config: Config, elapsed_ns: u64) !void {
+    const stdout = std.io.getStdOut().writer();
+    const elapsed_s = @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_s;
+
+    var total = Histogram{};
+    var total_errors: u64 = 0;
+    var max_lag_ns: u64 = 0;
+    for (stats, 0..) |*connection_stats, index| {
+        if (connection_stats.failure) |err| {
+            std.debug.print("Connection {d} stopped early: {}\n", .{ index, err });
+        }
+        max_lag_ns = @max(max_lag_ns, connection_stats.max_lag_ns);
+    }
+
+    try stdout.print("\n{s:<12} {s:>10} {s:>8} {s:>10} {s:>10} {s:>10} {s:>10} {s:>10} {s:>10}\n", .{ "class", "ops", "errors", "ops/s", "mean", "p50", "p95", "p99", "max" });
+    for (0..class_count) |class_index| {
+        var histogram = Histogram{};
+        var errors: u64 = 0;
+        for (stats) |*connection_stats| {
+            histogram.merge(&connection_stats.latency[class_index]);
+            errors += connection_stats.errors[class_index];
+        }
+        total.merge(&histogram);
+        total_errors += errors;
+        if (histogram.total + errors == 0) continue;
+        try printRow(stdout, @tagName(@as(QueryClass, @enumFromInt(class_index))), &histogram, errors, elapsed_s);
+    }
+    try printRow(stdout, "total", &total, total_errors, elapsed_s);
+
+    if (config.rate > 0) {
+        try stdout.print("\nOffered {d:.0} ops/s, completed {d:.0} ops/s; sends ran up to {} behind schedule\n", .{
+            config.rate,
+            @as(f64, @floatFromInt(total.total + total_errors)) / elapsed_s,
+            std.fmt.fmtDuration(max_lag_ns),
+        });
+    }
+}
+
+fn printRow(writer: anytype, label: []const u8, histogram: *const Histogram, errors: u64, elapsed_s: f64) !void {
+    try writer.print("{s:<12} {d:>10} {d:>8} {d:>10.1} {:>10} {:>10} {:>10} {:>10} {:>10}\n", .{
+        label,
+        histogram.total,
+        errors,
+        @as(f64, @floatFromInt(histogram.total)) / elapsed_s,
+        std.fmt.fmtDuration(@intFromFloat(histogram.mean())),
+        std.fmt.fmtDuration(histogram.percentile(50)),
+        std.fmt.fmtDuration(histogram.percentile(95)),
+        std.fmt.fmtDuration(histogram.percentile(99)),
+        std.fmt.fmtDuration(histogram.max),
+    });
+}
+
+fn printUsage() void {
+    std.debug.print(
+        \\Usage: load_client [options]
+        \\
+        \\Drives a running database server from several connections at once with
+        \\a mix of point lookups, inserts and analytical scans, and reports the
+        \\throughput and latency percentiles of each class. With a target rate,
+        \\statements are sent at Poisson arrival times whether or not the server
+        \\keeps up, and latency is measured from when a statement was due.
+        \\
+        \\Options:
+        \\  --host, -h <host>         Server IP address (default: 127.0.0.1)
+        \\  --port, -p <port>         Server port (default: 5252)
+        \\  --connections, -c <n>     Concurrent connections (default: 8)
+        \\  --rate <ops/s>            Target rate over all connections; 0 runs
+        \\                            closed-loop, as fast as possible (default: 1000)
+        \\  --duration <seconds>      How long to run (default: 10)
+        \\  --mix <class=weight,...>  Share of point, insert and analytical
+        \\                            statements (default: point=80,insert=15,analytical=5)
+        \\  --rows <n>                Rows to seed load_items with (default: 10000)
+        \\  --no-setup                Use the existing load_items table as is
+        \\  --seed <n>                Random seed (default: 42)
+        \\  --help                    Show this help message
+        \\
+        \\Example:
+        \\  load_client --connections 32 --rate 5000 --duration 30
+        \\
+    , .{});
+}
@@ -0,0 +1,427 @@
+const std = @import("std");
+const assert = @import("../build_options.zig").assert;
+
+/// Lock modes of the table/row hierarchy. Intention modes are taken on a
+/// table before locking rows inside it.
+pub const LockMode = enum {
+    IS, // Intends to read some rows
+    IX, // Intends to write some rows
+    S, // Reads the whole resource
+    X, // Writes the whole resource
+
+    pub fn compatible(a: LockMode, b: LockMode) bool {
+        return switch (a) {
+            .IS => b != .X,
+            .IX => b == .IS or b == .IX,
+            .S => b == .IS or b == .S,
+            .X => false,
+        };
+    }
+
+    /// True if holding `self` already grants everything `wanted` does
+    pub fn covers(self: LockMode, wanted: LockMode) bool {
+        return switch (self) {
+            .X => true,
+            .S => wanted == .S or wanted == .IS,
+            .IX => wanted == .IX or wanted == .IS,
+            .IS => wanted == .IS,
+        };
+    }
+
+    /// Weakest mode covering both; S plus IX has no mode of its own here and becomes X
+    pub fn combine(self: LockMode, other: LockMode) LockMode {
+        if (self.covers(other)) return self;
+        if (other.covers(self)) return other;
+        return .X;
+    }
+
+    /// Mode to take on the table before locking a row in `row_mode`
+    pub fn intention(row_mode: LockMode) LockMode {
+        return switch (row_mode) {
+            .S, .IS => .IS,
+            .X, .IX => .IX,
+        };
+    }
+};
+
+/// A lockable resource: a whole table, or one row of it
+pub const LockTarget = struct {
+    table: u64,
+    row: u64 = whole_table,
+
+    pub const whole_table = std.math.maxInt(u64);
+
+    pub fn forTable(table: u64) LockTarget {
+        return LockTarget{ .table = table };
+    }
+
+    pub fn forRow(table: u64, row: u64) LockTarget {
+        return LockTarget{ .table = table, .row = row };
+    }
+
+    fn hash(self: LockTarget) u64 {
+        return std.hash.Wyhash.hash(self.table, std.mem.asBytes(&self.row));
+    }
+};
+
+/// Stable lock id for a table name
+pub fn tableId(name: []const u8) u64 {
+    return std.hash.Wyhash.hash(0, name);
+}
+
+/// Number of lock table partitions; a power of two so hashes map with a mask
+pub const partition_count: usize = 64;
+
+/// How long a request waits before giving up with error.LockTimeout
+pub const default_wait_timeout_ns: u64 = 5 * std.time.ns_per_s;
+
+/// Hierarchical lock manager for strict two-phase locking. The lock table is
+/// split into partitions with their own mutex and condition variable, so
+/// requests for unrelated resources never contend. Blocked requests wait in
+/// FIFO order; before each wait the requester's waits-for edges are
+/// published to a deadlock detector, and a request that would close a cycle
+/// fails with error.Deadlock so its transaction can be aborted.
+pub const LockManager = struct {
+    allocator: std.mem.Allocator,
+    partitions: [partition_count]Partition = [_]Partition{.{}} ** partition_count,
+    detector: DeadlockDetector = .{},
+    wait_timeout_ns: u64 = default_wait_timeout_ns,
+
+    const Request = struct {
+        txn_id: u64,
+        mode: LockMode,
+        granted: bool,
+    };
+
+    /// Requests on one resource in arrival order, granted and waiting
+    const LockQueue = std.ArrayListUnmanaged(Request);
+
+    const Partition = struct {
+        mutex: std.Thread.Mutex align(std.atomic.cache_line) = .{},
+        released: std.Thread.Condition = .{},
+        queues: std.AutoHashMapUnmanaged(LockTarget, LockQueue) = .{},
+        // Locks granted to transactions whose id maps to this partition
+        held: std.AutoHashMapUnmanaged(u64, std.ArrayListUnmanaged(LockTarget)) = .{},
+    };
+
+    pub fn init(allocator: std.mem.Allocator) LockManager {
+        return LockManager{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *LockManager) void {
+        for (&self.partitions) |*partition| {
+            var queues = partition.queues.valueIterator();
+            while (queues.next()) |queue| queue.deinit(self.allocator);
+            partition.queues.deinit(self.allocator);
+            var held = partition.held.valueIterator();
+            while (held.next()) |targets| targets.deinit(self.allocator);
+            partition.held.deinit(self.allocator);
+        }
+        self.detector.deinit(self.allocator);
+    }
+
+    /// Lock a whole table
+    pub fn lockTable(self: *LockManager, txn_id: u64, table: u64, mode: LockMode) !void {
+        try self.acquire(txn_id, LockTarget.forTable(table), mode);
+    }
+
+    /// Lock one row, first taking the matching intention lock on its table
+    pub fn lockRow(self: *LockManager, txn_id: u64, table: u64, row: u64, mode: LockMode) !void {
+        assert(mode == .S or mode == .X);
+        try self.acquire(txn_id, LockTarget.forTable(table), LockMode.intention(mode));
+        try self.acquire(txn_id, LockTarget.forRow(table, row), mode);
+    }
+
+    /// Acquire `mode` on `target`, waiting while incompatible locks are held.
+    /// Re-acquiring a held lock is free and a stronger request upgrades it.
+    pub fn acquire(self: *LockManager, txn_id: u64, target: LockTarget, mode: LockMode) !void {
+        // Room to remember the lock for releaseAll is reserved up front, and the
+        // two partitions are locked one after the other, never together
+        const txn_partition = self.partitionForTxn(txn_id);
+        {
+            txn_partition.mutex.lock();
+            defer txn_partition.mutex.unlock();
+            const gop = try txn_partition.held.getOrPut(self.allocator, txn_id);
+            if (!gop.found_existing) gop.value_ptr.* = .{};
+            try gop.value_ptr.ensureUnusedCapacity(self.allocator, 1);
+        }
+
+        const newly_granted = try self.acquireInPartition(txn_id, target, mode);
+        if (!newly_granted) return;
+
+        txn_partition.mutex.lock();
+        defer txn_partition.mutex.unlock();
+        txn_partition.held.getPtr(txn_id).?.appendAssumeCapacity(target);
+    }
+
+    /// Returns true if the transaction did not hold the target before
+    fn acquireInPartition(self: *LockManager, txn_id: u64, target: LockTarget, mode: LockMode) !bool {
+        const partition = self.partitionFor(target);
+        partition.mutex.lock();
+        defer partition.mutex.unlock();
+
+        const gop = try partition.queues.getOrPut(self.allocator, target);
+        if (!gop.found_existing) gop.value_ptr.* = .{};
+        const queue = gop.value_ptr;
+
+        // An upgrade keeps its place; a new request joins the back of the queue
+        var wanted = mode;
+        var upgrade_from: ?LockMode = null;
+        if (findRequest(queue, txn_id)) |index| {
+            const held = queue.items[index].mode;
+            if (held.covers(mode)) return false;
+            upgrade_from = held;
+            wanted = held.combine(mode);
+        } else {
+            try queue.append(self.allocator, Request{ .txn_id = txn_id, .mode = mode, .granted = false });
+        }
+
+        var timer = try std.time.Timer.start();
+        while (true) {
+            // The queue may have been reallocated while we waited
+            const current = partition.queues.getPtr(target).?;
+            const index = findRequest(current, txn_id).?;
+            if (grantable(current, index, wanted, upgrade_from != null)) {
+                current.items[index].mode = wanted;
+                current.items[index].granted = true;
+                self.detector.clear(txn_id);
+                return upgrade_from == null;
+            }
+
+            if (try self.detector.wouldDeadlock(self.allocator, txn_id, current.items, index, wanted)) {
+                self.abandonRequest(partition, target, txn_id, upgrade_from);
+                return error.Deadlock;
+            }
+
+            const elapsed = timer.read();
+            if (elapsed >= self.wait_timeout_ns) {
+                self.abandonRequest(partition, target, txn_id, upgrade_from);
+                return error.LockTimeout;
+            }
+            partition.released.timedWait(&partition.mutex, self.wait_timeout_ns - elapsed) catch {};
+        }
+    }
+
+    /// A request is granted once it is compatible with every other granted
+    /// request and, unless it is an upgrade, nobody queued ahead is waiting
+    fn grantable(queue: *const LockQueue, index: usize, mode: LockMode, is_upgrade: bool) bool {
+        for (queue.items, 0..) |request, i| {
+            if (i == index) continue;
+            if (request.granted) {
+                if (!mode.compatible(request.mode)) return false;
+            } else if (i < index and !is_upgrade) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Withdraw a request that will not be granted; an upgrade keeps the lock it had
+    fn abandonRequest(self: *LockManager, partition: *Partition, target: LockTarget, txn_id: u64, upgrade_from: ?LockMode) void {
+        self.detector.clear(txn_id);
+        const queue = partition.queues.getPtr(target).?;
+        const index = findRequest(queue, txn_id).?;
+        if (upgrade_from) |held| {
+            queue.items[index].mode = held;
+        } else {
+            _ = queue.orderedRemove(index);
+            if (queue.items.len == 0) {
+                queue.deinit(self.allocator);
+                _ = partition.queues.remove(target);
+            }
+        }
+        // Requests queued behind this one may now be grantable
+        partition.released.broadcast();
+    }
+
+    /// Release every lock the transaction holds, at commit or abort
+    pub fn releaseAll(self: *LockManager, txn_id: u64) void {
+        var targets = blk: {
+            const partition = self.partitionForTxn(txn_id);
+            partition.mutex.lock();
+            defer partition.mutex.unlock();
+            const entry = partition.held.fetchRemove(txn_id) orelse return;
+            break :blk entry.value;
+        };
+        defer targets.deinit(self.allocator);
+
+        for (targets.items) |target| self.releaseOne(txn_id, target);
+        self.detector.clear(txn_id);
+    }
+
+    fn releaseOne(self: *LockManager, txn_id: u64, target: LockTarget) void {
+        const partition = self.partitionFor(target);
+        partition.mutex.lock();
+        defer partition.mutex.unlock();
+
+        const queue = partition.queues.getPtr(target) orelse return;
+        const index = findRequest(queue, txn_id) orelse return;
+        _ = queue.orderedRemove(index);
+        if (queue.items.len == 0) {
+            queue.deinit(self.allocator);
+            _ = partition.queues.remove(target);
+        }
+        partition.released.broadcast();
+    }
+
+    /// Mode the transaction holds on `target`, if any
+    pub fn heldMode(self: *LockManager, txn_id: u64, target: LockTarget) ?LockMode {
+        const partition = self.partitionFor(target);
+        partition.mutex.lock();
+        defer partition.mutex.unlock();
+
+        const queue = partition.queues.getPtr(target) orelse return null;
+        const index = findRequest(queue, txn_id) orelse return null;
+        if (!queue.items[index].granted) return null;
+        return queue.items[index].mode;
+    }
+
+    fn partitionFor(self: *LockManager, target: LockTarget) *Partition {
+        return &self.partitions[target.hash() & (partition_count - 1)];
+    }
+
+    fn partitionForTxn(self: *LockManager, txn_id: u64) *Partition {
+        return &self.partitions[txn_id & (partition_count - 1)];
+    }
+
+    fn findRequest(queue: *const LockQueue, txn_id: u64) ?usize {
+        for (queue.items, 0..) |request, i| {
+            if (request.txn_id == txn_id) return i;
+        }
+        return null;
+    }
+};
+
+/// Waits-for graph over blocked transactions. Only blocked requests touch it,
+/// so its single mutex is off the path of requests that are granted at once.
+/// Partition mutexes may be held when it is called; it never takes one.
+const DeadlockDetector = struct {
+    mutex: std.Thread.Mutex = .{},
+    waits_for: std.AutoHashMapUnmanaged(u64, std.ArrayListUnmanaged(u64)) = .{},
+
+    fn deinit(self: *DeadlockDetector, allocator: std.mem.Allocator) void {
+        var it = self.waits_for.valueIterator();
+        while (it.next()) |edges| edges.deinit(allocator);
+        self.waits_for.deinit(allocator);
+    }
+
+    /// Record what the request at `index` waits for and report whether that
+    /// closes a cycle. It waits for incompatible holders and for every
+    /// request queued ahead of it.
+    fn wouldDeadlock(self: *DeadlockDetector, allocator: std.mem.Allocator, txn_id: u64, queue: []const LockManager.Request, index: usize, mode: LockMode) !bool {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const gop = try self.waits_for.getOrPut(allocator, txn_id);
+        if (!gop.found_existing) gop.value_ptr.* = .{};
+        const edges = gop.value_ptr;
+        edges.clearRetainingCapacity();
+        for (queue, 0..) |request, i| {
+            if (i == index or request.txn_id == txn_id) continue;
+            const blocks = if (request.granted) !mode.compatible(request.mode) else i < index;
+            if (blocks) try edges.append(allocator, request.txn_id);
+        }
+
+        // Depth-first search for a path back to the requester
+        var stack = std.ArrayList(u64).init(allocator);
+        defer stack.deinit();
+        var visited = std.AutoHashMap(u64, void).init(allocator);
+        defer visited.deinit();
+        try stack.appendSlice(edges.items);
+        while (stack.pop()) |waiter| {
+            if (waiter == txn_id) {
+                self.removeLocked(allocator, txn_id);
+                return true;
+            }
+            if ((try visited.getOrPut(waiter)).found_existing) continue;
+            if (self.waits_for.get(waiter)) |next| try stack.appendSlice(next.items);
+        }
+        return false;
+    }
+
+    fn clear(self: *DeadlockDetector, txn_id: u64) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.waits_for.getPtr(txn_id)) |edges| edges.clearRetainingCapacity();
+    }
+
+    fn removeLocked(self: *DeadlockDetector, allocator: std.mem.Allocator, txn_id: u64) void {
+        var entry = self.waits_for.fetchRemove(txn_id) orelse return;
+        entry.value.deinit(allocator);
+    }
+};
+
+test "LockMode compatibility matrix" {
+    try std.testing.expect(LockMode.IS.compatible(.IX));
+    try std.testing.expect(LockMode.IS.compatible(.S));
+    try std.testing.expect(!LockMode.IS.compatible(.X));
+    try std.testing.expect(LockMode.IX.compatible(.IX));
+    try std.testing.expect(!LockMode.IX.compatible(.S));
+    try std.testing.expect(LockMode.S.compatible(.S));
+    try std.testing.expect(!LockMode.S.compatible(.IX));
+    try std.testing.expect(!LockMode.X.compatible(.IS));
+    try std.testing.expectEqual(LockMode.X, LockMode.S.combine(.IX));
+    try std.testing.expectEqual(LockMode.S, LockMode.IS.combine(.S));
+}
+
+test "LockManager grants compatible locks and upgrades" {
+    const allocator = std.testing.allocator;
+    var locks = LockManager.init(allocator);
+    defer locks.deinit();
+    locks.wait_timeout_ns = 10 * std.time.ns_per_ms;
+
+    const orders = tableId("orders");
+    try locks.lockRow(1, orders, 7, .X);
+    try locks.lockRow(2, orders, 8, .S);
+    try std.testing.expectEqual(LockMode.IX, locks.heldMode(1, LockTarget.forTable(orders)).?);
+    try std.testing.expectEqual(LockMode.IS, locks.heldMode(2, LockTarget.forTable(orders)).?);
+
+    // A table scan conflicts with the writer's intention lock
+    try std.testing.expectError(error.LockTimeout, locks.lockTable(2, orders, .S));
+    try std.testing.expectEqual(LockMode.IS, locks.heldMode(2, LockTarget.forTable(orders)).?);
+
+    locks.releaseAll(1);
+    try locks.lockTable(2, orders, .S);
+    try std.testing.expectEqual(LockMode.S, locks.heldMode(2, LockTarget.forTable(orders)).?);
+    locks.releaseAll(2);
+    try std.testing.expectEqual(@as(?LockMode, null), locks.heldMode(2, LockTarget.forTable(orders)));
+}
+
+test "LockManager detects a deadlock between two transactions" {
+    const allocator = std.testing.allocator;
+    var locks = LockManager.init(allocator);
+    defer locks.deinit();
+
+    const a = LockTarget.forTable(tableId("a"));
+    const b = LockTarget.forTable(tableId("b"));
+    try locks.acquire(1, a, .X);
+    try locks.acquire(2, b, .X);
+
+    const Waiter = struct {
+        fn run(manager: *LockManager, outcome: *?anyerror) void {
+            // Transaction 1 blocks on b until transaction 2 gives up and releases it
+            manager.acquire(1, LockTarget.forTable(tableId("b")), .X) catch |err| {
+                outcome.* = err;
+            };
+        }
+    };
+    var outcome: ?anyerror = null;
+    const thread = try std.Thread.spawn(.{}, Waiter.run, .{ &locks, &outcome });
+
+    // Wait until transaction 1 is queued behind transaction 2
+    while (true) {
+        locks.detector.mutex.lock();
+        const waiting = if (locks.detector.waits_for.get(1)) |edges| edges.items.len > 0 else false;
+        locks.detector.mutex.unlock();
+        if (waiting) break;
+        std.time.sleep(std.time.ns_per_ms);
+    }
+
+    try std.testing.expectError(error.Deadlock, locks.acquire(2, a, .X));
+    locks.releaseAll(2);
+    thread.join();
+
+    try std.testing.expectEqual(@as(?anyerror, null), outcome);
+    try std.testing.expectEqual(LockMode.X, locks.heldMode(1, b).?);
+    locks.releaseAll(1);
+}
@@ -1,5 +1,6 @@
 const std = @import("std");
 const assert = @import("../build_options.zig").assert;
+const LockManager = @import("lock_manager.zig").LockManager;
 
 /// Transaction status
 pub const TransactionStatus = enum {
@@ -14,6 +15,41 @@ pub const IsolationLevel = enum {
     ReadCommitted, // Prevents dirty reads, but allows non-repeatable reads and phantom reads
     RepeatableRead, // Prevents dirty reads and non-repeatable reads, but allows phantom reads
     Serializable, // Prevents dirty reads, non-repeatable reads, and phantom reads
+
+    /// Parse the SQL spelling, e.g. "REPEATABLE READ"
+    pub fn fromString(text: []const u8) ?IsolationLevel {
+        const levels = [_]struct { []const u8, IsolationLevel }{
+            .{ "READ UNCOMMITTED", .ReadUncommitted },
+            .{ "READ COMMITTED", .ReadCommitted },
+            .{ "REPEATABLE READ", .RepeatableRead },
+            .{ "SERIALIZABLE", .Serializable },
+        };
+        for (levels) |entry| {
+            if (std.ascii.eqlIgnoreCase(text, entry[0])) return entry[1];
+        }
+        return null;
+    }
+};
+
+/// Commit timestamp of a row version that has not been deleted
+pub const live_ts: u64 = std.math.maxInt(u64);
+
+/// A consistent read view: sees exactly the versions committed at or before `read_ts`
+pub const Snapshot = struct {
+    read_ts: u64,
+
+    /// Sees every committed version
+    pub const latest = Snapshot{ .read_ts = live_ts - 1 };
+
+    pub fn at(read_ts: u64) Snapshot {
+        return Snapshot{ .read_ts = read_ts };
+    }
+
+    /// A version created at `begin_ts` and deleted at `end_ts` is visible
+    /// if it was created before the snapshot and not yet deleted in it
+    pub fn isVisible(self: Snapshot, begin_ts: u64, end_ts: u64) bool {
+        return begin_ts <= self.read_ts and end_ts > self.read_ts;
+    }
 };
 
 /// Transaction for managing database operations
@@ -23,6 +59,13 @@ pub const Transaction = struct {
     isolation_level: IsolationLevel,
     start_time: i64,
     commit_time: ?i64,
+    read_ts: u64 = 0, // Last commit timestamp visible to this transaction
+    commit_ts: u64 = 0, // Assigned when the transaction commits
+
+    /// The read view this transaction scans with
+    pub fn snapshot(self: *const Transaction) Snapshot {
+        return Snapshot.at(self.read_ts);
+    }
 
     /// Commit the transaction
     pub fn commit(self: *Transaction) void {
@@ -49,19 +92,148 @@ pub const Transaction = struct {
     }
 };
 
-/// Transaction manager for handling database transactions
+/// Hands out transaction ids and commit timestamps from atomic counters,
+/// so begin and commit never take a lock to number themselves.
+/// A commit timestamp is allocated before the commit's versions are written
+/// and published once they all are; snapshots only ever read published ones.
+pub const TimestampOracle = struct {
+    next_txn_id: std.atomic.Value(u64) = std.atomic.Value(u64).init(1),
+    allocated_commit_ts: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    last_commit_ts: std.atomic.Value(u64) = std.atomic.Value(u64).init(0), // Latest published
+
+    pub fn nextTxnId(self: *TimestampOracle) u64 {
+        return self.next_txn_id.fetchAdd(1, .monotonic);
+    }
+
+    /// Advance the logical clock for a commit
+    pub fn nextCommitTimestamp(self: *TimestampOracle) u64 {
+        return self.allocated_commit_ts.fetchAdd(1, .seq_cst) + 1;
+    }
+
+    /// Make a commit visible to new snapshots
+    pub fn publish(self: *TimestampOracle, commit_ts: u64) void {
+        assert(commit_ts <= self.allocated_commit_ts.load(.seq_cst));
+        _ = self.last_commit_ts.fetchMax(commit_ts, .seq_cst);
+    }
+
+    pub fn lastCommitTimestamp(self: *const TimestampOracle) u64 {
+        return self.last_commit_ts.load(.seq_cst);
+    }
+};
+
+/// Number of active-transaction shards; a power of two so ids map with a mask
+pub const txn_shard_count: usize = 64;
+
+/// Active transactions sharded by id. Each shard has its own lock and sits on
+/// its own cache line, so begins and commits on different shards never
+/// contend. Each shard also publishes the smallest read timestamp among its
+/// members, so the oldest active snapshot is found without taking any lock.
+pub const ActiveTxnTable = struct {
+    allocator: std.mem.Allocator,
+    shards: [txn_shard_count]Shard = [_]Shard{.{}} ** txn_shard_count,
+
+    const Shard = struct {
+        mutex: std.Thread.Mutex align(std.atomic.cache_line) = .{},
+        txns: std.AutoHashMapUnmanaged(u64, *Transaction) = .{},
+        // Smallest read_ts of the shard's members, live_ts when empty. Briefly
+        // lower while a member registers.
+        min_read_ts: std.atomic.Value(u64) = std.atomic.Value(u64).init(live_ts),
+
+        fn recomputeMin(self: *Shard) void {
+            var min: u64 = live_ts;
+            var it = self.txns.valueIterator();
+            while (it.next()) |txn| min = @min(min, txn.*.read_ts);
+            self.min_read_ts.store(min, .seq_cst);
+        }
+    };
+
+    pub fn init(allocator: std.mem.Allocator) ActiveTxnTable {
+        return ActiveTxnTable{ .allocator = allocator };
+    }
+
+    /// Free the table and every transaction still in it
+    pub fn deinit(self: *ActiveTxnTable) void {
+        for (&self.shards) |*shard| {
+            var it = shard.txns.valueIterator();
+            while (it.next()) |txn| self.allocator.destroy(txn.*);
+            shard.txns.deinit(self.allocator);
+        }
+    }
+
+    fn shardFor(self: *ActiveTxnTable, txn_id: u64) *Shard {
+        return &self.shards[txn_id & (txn_shard_count - 1)];
+    }
+
+    /// Register `txn` and give it a read timestamp from `oracle`. The shard's
+    /// minimum is lowered before the timestamp is read, so a concurrent
+    /// oldestSnapshot() either sees this transaction or returns a timestamp
+    /// no newer than the one it reads.
+    pub fn register(self: *ActiveTxnTable, txn: *Transaction, oracle: *TimestampOracle) !void {
+        const shard = self.shardFor(txn.id);
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+
+        try shard.txns.ensureUnusedCapacity(self.allocator, 1);
+        const old_min = shard.min_read_ts.load(.seq_cst);
+        const floor = oracle.lastCommitTimestamp();
+        if (floor < old_min) shard.min_read_ts.store(floor, .seq_cst);
+        txn.read_ts = oracle.lastCommitTimestamp();
+        shard.txns.putAssumeCapacity(txn.id, txn);
+        shard.min_read_ts.store(@min(old_min, txn.read_ts), .seq_cst);
+    }
+
+    pub fn remove(self: *ActiveTxnTable, txn_id: u64) void {
+        const shard = self.shardFor(txn_id);
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+
+        const removed = shard.txns.fetchRemove(txn_id) orelse return;
+        if (removed.value.read_ts <= shard.min_read_ts.load(.seq_cst)) shard.recomputeMin();
+    }
+
+    pub fn get(self: *ActiveTxnTable, txn_id: u64) ?*Transaction {
+        const shard = self.shardFor(txn_id);
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+        return shard.txns.get(txn_id);
+    }
+
+    /// Number of active transactions; a moment-in-time sum over the shards
+    pub fn count(self: *ActiveTxnTable) usize {
+        var total: usize = 0;
+        for (&self.shards) |*shard| {
+            shard.mutex.lock();
+            defer shard.mutex.unlock();
+            total += shard.txns.count();
+        }
+        return total;
+    }
+
+    /// Smallest read timestamp of any active transaction, or live_ts if none
+    pub fn oldestSnapshot(self: *const ActiveTxnTable) u64 {
+        var oldest: u64 = live_ts;
+        for (&self.shards) |*shard| {
+            oldest = @min(oldest, shard.min_read_ts.load(.seq_cst));
+        }
+        return oldest;
+    }
+};
+
+/// Transaction manager for handling database transactions.
+/// Safe to share between threads.
 pub const TransactionManager = struct {
     allocator: std.mem.Allocator,
-    next_txn_id: u64,
-    active_txns: std.AutoHashMap(u64, *Transaction),
+    oracle: TimestampOracle = .{},
+    active_txns: ActiveTxnTable,
+    locks: LockManager, // Table and row locks of RepeatableRead and Serializable transactions
 
     /// Initialize a new transaction manager
     pub fn init(allocator: std.mem.Allocator) !*TransactionManager {
         const manager = try allocator.create(TransactionManager);
         manager.* = TransactionManager{
             .allocator = allocator,
-            .next_txn_id = 1,
-            .active_txns = std.AutoHashMap(u64, *Transaction).init(allocator),
+            .active_txns = ActiveTxnTable.init(allocator),
+            .locks = LockManager.init(allocator),
         };
 
         return manager;
@@ -70,11 +242,8 @@ pub const TransactionManager = struct {
     /// Deinitialize the transaction manager
     pub fn deinit(self: *TransactionManager) void {
         // Free all active transactions
-        var it = self.active_txns.iterator();
-        while (it.next()) |entry| {
-            self.allocator.destroy(entry.value_ptr.*);
-        }
         self.active_txns.deinit();
+        self.locks.deinit();
         self.allocator.destroy(self);
     }
 
@@ -85,10 +254,10 @@ pub const TransactionManager = struct {
 
     /// Begin a new transaction with a specific isolation level
     pub fn beginTransactionWithIsolationLevel(self: *TransactionManager, isolation_level: IsolationLevel) !*Transaction {
-        const txn_id = self.next_txn_id;
-        self.next_txn_id += 1;
+        const txn_id = self.oracle.nextTxnId();
 
         const txn = try self.allocator.create(Transaction);
+        errdefer self.allocator.destroy(txn);
         txn.* = Transaction{
             .id = txn_id,
             .status = .Active,
@@ -103,7 +272,8 @@ pub const TransactionManager = struct {
         assert(txn.start_time > 0);
         assert(txn.commit_time == null);
 
-        try self.active_txns.put(txn_id, txn);
+        // Takes the read timestamp too
+        try self.active_txns.register(txn, &self.oracle);
         return txn;
     }
 
@@ -113,13 +283,17 @@ pub const TransactionManager = struct {
             return error.TransactionNotActive;
         }
 
+        // Read-only transactions do not advance the clock; writers set
+        // commit_ts from allocateCommitTimestamp() before committing
         txn.commit();
 
         // Validate commit
         assert(txn.status == .Committed);
         assert(txn.commit_time != null);
 
-        _ = self.active_txns.remove(txn.id);
+        self.active_txns.remove(txn.id);
+        // Strict two-phase locking: locks are held until the transaction ends
+        self.locks.releaseAll(txn.id);
 
         // Free the transaction memory
         self.allocator.destroy(txn);
@@ -136,12 +310,51 @@ pub const TransactionManager = struct {
         // Validate abort
         assert(txn.status == .Aborted);
 
-        _ = self.active_txns.remove(txn.id);
+        self.active_txns.remove(txn.id);
+        // Strict two-phase locking: locks are held until the transaction ends
+        self.locks.releaseAll(txn.id);
 
         // Free the transaction memory
         self.allocator.destroy(txn);
     }
 
+    /// Id the next transaction will get
+    pub fn nextTxnId(self: *const TransactionManager) u64 {
+        return self.oracle.next_txn_id.load(.monotonic);
+    }
+
+    /// Advance the logical clock for a commit. Versions written by the commit
+    /// carry this timestamp and become visible to snapshots taken after it
+    /// is passed to publishCommit().
+    pub fn allocateCommitTimestamp(self: *TransactionManager) u64 {
+        return self.oracle.nextCommitTimestamp();
+    }
+
+    /// Make every version written at `commit_ts` visible. Writers publish in
+    /// timestamp order, once all of the commit's versions are in place.
+    pub fn publishCommit(self: *TransactionManager, commit_ts: u64) void {
+        self.oracle.publish(commit_ts);
+    }
+
+    /// Timestamp of the latest published commit
+    pub fn lastCommitTimestamp(self: *const TransactionManager) u64 {
+        return self.oracle.lastCommitTimestamp();
+    }
+
+    /// Read view of everything committed so far
+    pub fn currentSnapshot(self: *TransactionManager) Snapshot {
+        return Snapshot.at(self.oracle.lastCommitTimestamp());
+    }
+
+    /// Oldest read timestamp any active transaction may still use. Versions
+    /// deleted at or before it are invisible to everyone and can be reclaimed.
+    pub fn oldestActiveSnapshot(self: *TransactionManager) u64 {
+        // Read the clock before the shards: a transaction registering meanwhile
+        // gets a read timestamp no older than this
+        const last_commit_ts = self.oracle.lastCommitTimestamp();
+        return @min(last_commit_ts, self.active_txns.oldestSnapshot());
+    }
+
     /// Get a transaction by ID
     pub fn getTransaction(self: *TransactionManager, txn_id: u64) ?*Transaction {
         // Validate inputs
@@ -162,3 +375,59 @@ test "TransactionManager basic functionality" {
     try manager.commitTransaction(txn);
     try std.testing.expectEqual(TransactionStatus.Committed, txn.status);
 }
+
+test "Snapshots see only versions committed before them" {
+    const allocator = std.testing.allocator;
+    const manager = try TransactionManager.init(allocator);
+    defer manager.deinit();
+
+    const insert_ts = manager.allocateCommitTimestamp();
+    manager.publishCommit(insert_ts);
+    const reader = try manager.beginTransaction();
+    const delete_ts = manager.allocateCommitTimestamp();
+    const late_insert_ts = manager.allocateCommitTimestamp();
+
+    // Allocated commits stay invisible until they are published
+    try std.testing.expect(manager.currentSnapshot().isVisible(insert_ts, delete_ts));
+    manager.publishCommit(late_insert_ts);
+
+    const snapshot = reader.snapshot();
+    try std.testing.expect(snapshot.isVisible(insert_ts, live_ts));
+    try std.testing.expect(snapshot.isVisible(insert_ts, delete_ts));
+    try std.testing.expect(!snapshot.isVisible(late_insert_ts, live_ts));
+    try std.testing.expect(!manager.currentSnapshot().isVisible(insert_ts, delete_ts));
+
+    // The reader holds back reclamation until it finishes
+    try std.testing.expectEqual(insert_ts, manager.oldestActiveSnapshot());
+    try manager.commitTransaction(reader);
+    try std.testing.expectEqual(manager.lastCommitTimestamp(), manager.oldestActiveSnapshot());
+}
+
+test "TransactionManager begin and commit from many threads" {
+    const allocator = std.testing.allocator;
+    const manager = try TransactionManager.init(allocator);
+    defer manager.deinit();
+
+    const thread_count = 8;
+    const pairs_per_thread = 2_000;
+    const Worker = struct {
+        fn run(m: *TransactionManager) !void {
+            for (0..pairs_per_thread) |_| {
+                const txn = try m.beginTransaction();
+                // A live transaction always holds back reclamation to its snapshot
+                std.debug.assert(m.oldestActiveSnapshot() <= txn.read_ts);
+                try m.commitTransaction(txn);
+            }
+        }
+    };
+
+    var threads: [thread_count]std.Thread = undefined;
+    for (&threads) |*thread| thread.* = try std.Thread.spawn(.{}, Worker.run, .{manager});
+    for (threads) |thread| thread.join();
+
+    try std.testing.expectEqual(@as(usize, 0), manager.active_txns.count());
+    try std.testing.expectEqual(@as(u64, thread_count * pairs_per_thread + 1), manager.nextTxnId());
+    // Read-only transactions leave the clock alone
+    try std.testing.expectEqual(@as(u64, 0), manager.lastCommitTimestamp());
+    try std.testing.expectEqual(manager.lastCommitTimestamp(), manager.oldestActiveSnapshot());
+}